@@ -0,0 +1,720 @@
+// Command-line interface for running BPCells conversions without an R session.
+//
+// Usage: bpcells <command> [options] <args...>
+// Commands:
+//   convert      Convert 10x/AnnData HDF5 matrices or fragment files to BPCells directories
+//   transpose    Flip the storage order of a matrix directory
+//   peak-matrix  Compute a cell x peak matrix from a fragments directory and a BED file
+//   merge-fragments  Merge fragments directories into one, renumbering cells
+//   stats        Print per-row or per-column non-zero count, mean, and variance
+//   verify       Check the CRC32C checksums of a matrix or fragments directory
+// Run `bpcells <command> --help` for the options of each command.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <utils/filesystem_compat.h>
+
+#include <arrayIO/binaryfile.h>
+#include <arrayIO/checksum.h>
+#include <arrayIO/vector.h>
+#include <fragmentIterators/BedFragments.h>
+#include <fragmentIterators/MergeFragments.h>
+#include <fragmentIterators/StoredFragments.h>
+#include <matrixIterators/ConcatenateMatrix.h>
+#include <matrixIterators/DualOrientationMatrix.h>
+#include <matrixIterators/ImportMatrixHDF5.h>
+#include <matrixIterators/MatrixIndexSelect.h>
+#include <matrixIterators/MatrixOrientation.h>
+#include <matrixIterators/PeakMatrix.h>
+#include <matrixIterators/RenameDims.h>
+#include <matrixIterators/StoredMatrix.h>
+#include <matrixIterators/StoredMatrixParallel.h>
+#include <matrixIterators/StoredMatrixTransposeWriter.h>
+#include <matrixIterators/StoredMatrixWriter.h>
+
+using namespace BPCells;
+
+namespace {
+
+const char *usage_text =
+    "Usage: bpcells <command> [options] <args...>\n"
+    "\n"
+    "Commands:\n"
+    "  convert      Convert 10x/AnnData HDF5 matrices or fragment files to BPCells directories\n"
+    "  transpose    Flip the storage order of a matrix directory\n"
+    "  peak-matrix  Compute a cell x peak matrix from a fragments directory and a BED file\n"
+    "  merge-fragments  Merge fragments directories into one, renumbering cells\n"
+    "  stats        Print per-row or per-column non-zero count, mean, and variance\n"
+    "  verify       Check the CRC32C checksums of a matrix or fragments directory\n"
+    "\n"
+    "Global options:\n"
+    "  --threads N      Number of worker threads (default 1)\n"
+    "  --memory SIZE    Memory budget for sorting and buffering, e.g. 512M or 4G (default 1G)\n";
+
+const char *convert_usage =
+    "Usage: bpcells convert --format FORMAT [options] <input> <output_dir>\n"
+    "Formats:\n"
+    "  10x            10x Genomics feature matrix HDF5 file (.h5)\n"
+    "  anndata        AnnData HDF5 file (.h5ad), reading --group (default X)\n"
+    "  fragments-tsv  10x-style fragments TSV file, optionally gzipped\n"
+    "Options:\n"
+    "  --group NAME   AnnData group to read (default X)\n"
+    "  --unpacked     Write without bitpacking compression\n"
+    "  --adaptive     Choose the smallest encoding per 128-value block (matrix formats only)\n"
+    "  --checksum     Store CRC32C checksums, verified when the output is read\n"
+    "  --threads N    If N > 1, pack the output on worker threads (HDF5 reads stay serial)\n"
+    "  --keep-cells FILE  Only import barcodes listed in FILE, one per line (fragments only)\n"
+    "  --min-fragments N  Only import barcodes with at least N fragments (fragments only)\n"
+    "  --overwrite    Allow writing to an existing output directory\n";
+
+const char *transpose_usage =
+    "Usage: bpcells transpose [options] <input_dir> <output_dir>\n"
+    "Options:\n"
+    "  --tmpdir DIR   Directory for temporary sort files (default: system temp directory)\n"
+    "  --memory SIZE  Sort buffer size (default 1G)\n"
+    "  --dual         Write a dual-orientation matrix: a copy of the input plus its transpose.\n"
+    "                 Readers use whichever copy streams for each operation\n";
+
+const char *peak_matrix_usage =
+    "Usage: bpcells peak-matrix [options] <fragments_dir> <peaks.bed> <output_dir>\n"
+    "Output columns follow the order of peaks in the BED file, and are named chr:start-end.\n"
+    "Peaks on chromosomes absent from the fragments get all-zero columns.\n"
+    "Options:\n"
+    "  --mode MODE    One of insertions, fragments, or overlaps (default insertions)\n"
+    "  --threads N    Compute column ranges of the matrix in parallel\n"
+    "  --overwrite    Allow writing to an existing output directory\n";
+
+const char *merge_fragments_usage =
+    "Usage: bpcells merge-fragments [options] <output_dir> <fragments_dir>...\n"
+    "Cells are numbered in input order. Chromosomes are output in order of first appearance.\n"
+    "Options:\n"
+    "  --max-open N   Merge at most N inputs at once, writing intermediate results to --tmpdir\n"
+    "                 to stay under open file limits (default 64)\n"
+    "  --threads N    Merge groups of inputs in parallel\n"
+    "  --tmpdir DIR   Directory for intermediate merges (default: system temp directory)\n"
+    "  --overwrite    Allow writing to an existing output directory\n";
+
+const char *stats_usage =
+    "Usage: bpcells stats [options] <matrix_dir>\n"
+    "Options:\n"
+    "  --axis AXIS    row or col (default col). Stats stream over the matrix when AXIS\n"
+    "                 matches its storage order, and accumulate across it otherwise\n"
+    "  --threads N    Compute stats on column ranges in parallel\n";
+
+const char *verify_usage =
+    "Usage: bpcells verify <dir>\n"
+    "Checks every array that has CRC32C checksums, exiting with status 1 on any mismatch\n";
+
+class Args {
+  public:
+    std::vector<std::string> positional;
+    std::map<std::string, std::string> flags;
+
+    bool has(const std::string &name) const { return flags.find(name) != flags.end(); }
+    std::string get(const std::string &name, const std::string &default_val) const {
+        auto it = flags.find(name);
+        return it == flags.end() ? default_val : it->second;
+    }
+};
+
+// Parse `--name value` flags, `--name` boolean flags, and positional arguments
+Args parseArgs(int argc, char **argv, int start, const std::set<std::string> &bool_flags) {
+    Args ret;
+    for (int i = start; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            ret.positional.push_back(arg);
+            continue;
+        }
+        std::string name = arg.substr(2);
+        auto eq = name.find('=');
+        if (eq != std::string::npos) {
+            ret.flags[name.substr(0, eq)] = name.substr(eq + 1);
+        } else if (bool_flags.count(name)) {
+            ret.flags[name] = "";
+        } else {
+            if (i + 1 >= argc) throw std::invalid_argument("Missing value for option " + arg);
+            ret.flags[name] = argv[++i];
+        }
+    }
+    return ret;
+}
+
+// Parse a byte count with an optional K/M/G/T suffix (powers of 1024)
+uint64_t parseBytes(const std::string &s) {
+    size_t idx;
+    double val = std::stod(s, &idx);
+    std::string suffix = s.substr(idx);
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::toupper);
+    if (!suffix.empty() && suffix.back() == 'B') suffix.pop_back();
+    if (!suffix.empty() && suffix.back() == 'I') suffix.pop_back();
+    uint64_t mult = 1;
+    if (suffix == "K") mult = 1ULL << 10;
+    else if (suffix == "M") mult = 1ULL << 20;
+    else if (suffix == "G") mult = 1ULL << 30;
+    else if (suffix == "T") mult = 1ULL << 40;
+    else if (!suffix.empty()) throw std::invalid_argument("Unrecognized size suffix: " + s);
+    return (uint64_t)(val * mult);
+}
+
+uint32_t parseThreads(const Args &args) {
+    int threads = std::stoi(args.get("threads", "1"));
+    if (threads < 1) throw std::invalid_argument("--threads must be >= 1");
+    return threads;
+}
+
+// Memory budget given by --memory, shared by the sort buffers and caches of one command
+uint64_t parseMemory(const Args &args) { return parseBytes(args.get("memory", "1G")); }
+
+// Returns the value type of a matrix directory ("uint", "float", "double", or "ulong"),
+// and whether it is packed
+std::string matrixDirType(const std::string &dir, bool &packed) {
+    FileReaderBuilder rb(dir);
+    std::string version = rb.readVersion();
+    packed = version.rfind("packed-", 0) == 0;
+    size_t type_start = version.find('-') + 1;
+    size_t type_end = version.find("-matrix");
+    if (type_end == std::string::npos)
+        throw std::runtime_error("Not a BPCells matrix directory: " + dir + " (" + version + ")");
+    return version.substr(type_start, type_end - type_start);
+}
+
+bool isRowMajorDir(const std::string &dir) {
+    FileReaderBuilder rb(dir);
+    return StoredMatrix<uint32_t>::isRowMajor(rb);
+}
+
+template <typename T> StoredMatrix<T> openMatrixDir(ReaderBuilder &rb, bool packed) {
+    return packed ? StoredMatrix<T>::openPacked(rb) : StoredMatrix<T>::openUnpacked(rb);
+}
+
+template <typename T>
+void writeMatrixDir(
+    MatrixLoader<T> &mat,
+    const std::string &out,
+    bool packed,
+    bool row_major,
+    bool overwrite,
+    bool adaptive = false,
+    bool checksum = false
+) {
+    FileWriterBuilder file_wb(out, 8192, overwrite);
+    ChecksumWriterBuilder checksum_wb(file_wb);
+    WriterBuilder &wb = checksum ? (WriterBuilder &)checksum_wb : file_wb;
+    auto w = packed ? StoredMatrixWriter<T>::createPacked(wb, row_major, 1024, adaptive)
+                    : StoredMatrixWriter<T>::createUnpacked(wb, row_major);
+    w.write(mat);
+}
+
+// Convert an HDF5 matrix, reading and packing it on worker threads when threads > 1
+template <typename T>
+void convertMatrixDir(
+    const std::function<StoredMatrix<T>()> &open,
+    const std::string &out,
+    bool packed,
+    bool row_major,
+    bool overwrite,
+    bool adaptive,
+    bool checksum,
+    uint32_t threads,
+    uint64_t memory_bytes
+) {
+    if (!packed || threads <= 1) {
+        StoredMatrix<T> mat = open();
+        writeMatrixDir(mat, out, packed, row_major, overwrite, adaptive, checksum);
+        return;
+    }
+    FileWriterBuilder file_wb(out, 8192, overwrite);
+    ChecksumWriterBuilder checksum_wb(file_wb);
+    WriterBuilder &wb = checksum ? (WriterBuilder &)checksum_wb : file_wb;
+    writePackedMatrixParallel<T>(
+        open, wb, row_major, threads, adaptive, ExecutionContext(NULL, threads, memory_bytes)
+    );
+}
+
+int runConvert(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"unpacked", "adaptive", "checksum", "overwrite", "help"});
+    if (args.has("help") || args.positional.size() != 2 || !args.has("format")) {
+        std::cerr << convert_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    std::string format = args.get("format", "");
+    std::string input = args.positional[0];
+    std::string output = args.positional[1];
+    bool packed = !args.has("unpacked");
+    bool overwrite = args.has("overwrite");
+    bool adaptive = args.has("adaptive");
+    bool checksum = args.has("checksum");
+    uint64_t memory_bytes = parseMemory(args);
+    uint64_t buffer_size = std::min<uint64_t>(memory_bytes / 64, 1 << 20);
+    buffer_size = std::max<uint64_t>(buffer_size, 8192);
+
+    uint32_t threads = parseThreads(args);
+
+    if (format == "10x") {
+        convertMatrixDir<uint32_t>(
+            [&]() { return open10xFeatureMatrix(input, buffer_size); },
+            output, packed, false, overwrite, adaptive, checksum, threads, memory_bytes
+        );
+    } else if (format == "anndata") {
+        std::string group = args.get("group", "X");
+        std::string type = getAnnDataMatrixType(input, group);
+        bool row_major = isRowOrientedAnnDataMatrix(input, group);
+        if (type == "uint32_t") {
+            convertMatrixDir<uint32_t>(
+                [&]() { return openAnnDataMatrix<uint32_t>(input, group, buffer_size); },
+                output, packed, row_major, overwrite, adaptive, checksum, threads, memory_bytes
+            );
+        } else if (type == "float") {
+            convertMatrixDir<float>(
+                [&]() { return openAnnDataMatrix<float>(input, group, buffer_size); },
+                output, packed, row_major, overwrite, adaptive, checksum, threads, memory_bytes
+            );
+        } else if (type == "double") {
+            convertMatrixDir<double>(
+                [&]() { return openAnnDataMatrix<double>(input, group, buffer_size); },
+                output, packed, row_major, overwrite, adaptive, checksum, threads, memory_bytes
+            );
+        } else {
+            throw std::runtime_error("Unsupported AnnData matrix type: " + type);
+        }
+    } else if (format == "fragments-tsv") {
+        std::vector<std::string> keep_cells;
+        if (args.has("keep-cells")) {
+            std::ifstream in(args.get("keep-cells", ""));
+            if (!in) {
+                throw std::runtime_error(
+                    "Could not open barcode file: " + args.get("keep-cells", "")
+                );
+            }
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty()) keep_cells.push_back(line);
+            }
+        }
+        int min_fragments = std::stoi(args.get("min-fragments", "0"));
+        if (min_fragments < 0) throw std::invalid_argument("--min-fragments must be >= 0");
+        BedFragments frags(input.c_str(), "#", keep_cells, min_fragments);
+        FileWriterBuilder file_wb(output, buffer_size, overwrite);
+        ChecksumWriterBuilder checksum_wb(file_wb);
+        WriterBuilder &wb = checksum ? (WriterBuilder &)checksum_wb : file_wb;
+        bool pipelined = threads > 1;
+        auto w = packed ? StoredFragmentsWriter::createPacked(wb, 1024, pipelined)
+                        : StoredFragmentsWriter::createUnpacked(wb);
+        w.write(frags);
+    } else {
+        throw std::invalid_argument("Unrecognized --format: " + format);
+    }
+    return 0;
+}
+
+template <typename T>
+void transposeMatrixDir(
+    const std::string &input,
+    const std::string &output,
+    const std::string &tmpdir,
+    bool packed,
+    uint64_t sort_bytes,
+    bool dual
+) {
+    FileReaderBuilder rb(input);
+    StoredMatrix<T> mat = openMatrixDir<T>(rb, packed);
+    bool row_major = isRowMajorDir(input);
+
+    FileWriterBuilder wb(output);
+    uint64_t load_bytes = std::min<uint64_t>(4 << 20, sort_bytes / 8);
+    if (dual) {
+        writeDualOrientationMatrix<T>(
+            mat, wb, tmpdir.c_str(), row_major, load_bytes, sort_bytes
+        );
+        return;
+    }
+    StoredMatrixTransposeWriter<T> w(wb, tmpdir.c_str(), load_bytes, sort_bytes, !row_major);
+    w.write(mat);
+}
+
+int runTranspose(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"dual", "help"});
+    if (args.has("help") || args.positional.size() != 2) {
+        std::cerr << transpose_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    std::string input = args.positional[0];
+    std::string output = args.positional[1];
+    uint64_t sort_bytes = parseMemory(args);
+
+    std_fs::path tmpdir = args.get("tmpdir", std_fs::temp_directory_path().string());
+    tmpdir /= "bpcells_transpose_" + std::to_string(std::hash<std::string>{}(output));
+    std_fs::remove_all(tmpdir);
+
+    bool packed;
+    std::string type = matrixDirType(input, packed);
+    try {
+        std::string tmp = tmpdir.string();
+        bool dual = args.has("dual");
+        if (type == "uint") {
+            transposeMatrixDir<uint32_t>(input, output, tmp, packed, sort_bytes, dual);
+        } else if (type == "float") {
+            transposeMatrixDir<float>(input, output, tmp, packed, sort_bytes, dual);
+        } else if (type == "double") {
+            transposeMatrixDir<double>(input, output, tmp, packed, sort_bytes, dual);
+        } else throw std::runtime_error("Unsupported matrix type for transpose: " + type);
+    } catch (...) {
+        std_fs::remove_all(tmpdir);
+        throw;
+    }
+    std_fs::remove_all(tmpdir);
+    return 0;
+}
+
+class BedRegion {
+  public:
+    std::string chr;
+    uint32_t start, end;
+};
+
+std::vector<BedRegion> readBed(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Could not open BED file: " + path);
+    std::vector<BedRegion> ret;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line.rfind("track", 0) == 0 ||
+            line.rfind("browser", 0) == 0)
+            continue;
+        std::istringstream fields(line);
+        BedRegion r;
+        if (!(fields >> r.chr >> r.start >> r.end))
+            throw std::runtime_error("Malformed BED line: " + line);
+        ret.push_back(r);
+    }
+    return ret;
+}
+
+template <int MODE>
+std::unique_ptr<MatrixLoader<uint32_t>> openPeakMatrix(
+    const std::string &frag_dir,
+    const std::vector<uint32_t> &chr,
+    const std::vector<uint32_t> &start,
+    const std::vector<uint32_t> &end,
+    const std::vector<std::string> &chr_levels
+) {
+    FileReaderBuilder rb(frag_dir);
+    auto frags = std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(rb));
+    return std::make_unique<PeakMatrixBase<MODE>>(
+        std::move(frags), chr, start, end, std::make_unique<VecStringReader>(chr_levels)
+    );
+}
+
+int runPeakMatrix(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"overwrite", "help"});
+    if (args.has("help") || args.positional.size() != 3) {
+        std::cerr << peak_matrix_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    std::string frag_dir = args.positional[0];
+    std::string output = args.positional[2];
+    std::string mode = args.get("mode", "insertions");
+    uint32_t threads = parseThreads(args);
+
+    // Match peak chromosome names to the fragment chromosome IDs
+    std::vector<std::string> chr_levels;
+    {
+        FileReaderBuilder rb(frag_dir);
+        auto chr_names = rb.openStringReader("chr_names");
+        for (uint64_t i = 0; i < chr_names->size(); i++)
+            chr_levels.push_back(chr_names->get(i));
+    }
+    std::unordered_map<std::string, uint32_t> chr_lookup;
+    for (uint32_t i = 0; i < chr_levels.size(); i++)
+        chr_lookup[chr_levels[i]] = i;
+
+    std::vector<BedRegion> bed = readBed(args.positional[1]);
+    // (chr, end, start, BED line index). Peaks on chromosomes without fragments all share one
+    // placeholder peak past the end of the first chromosome, marked by a UINT32_MAX index
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> peaks;
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < bed.size(); i++) {
+        auto it = chr_lookup.find(bed[i].chr);
+        if (it == chr_lookup.end()) {
+            missing += 1;
+            continue;
+        }
+        peaks.push_back({it->second, bed[i].end, bed[i].start, i});
+    }
+    if (missing > 0) {
+        if (chr_levels.empty())
+            throw std::runtime_error("Fragments directory has no chromosomes to count peaks on");
+        std::cerr << "Writing empty columns for " << missing
+                  << " peaks on chromosomes absent from the fragments\n";
+        peaks.push_back({0, UINT32_MAX - 1, UINT32_MAX - 2, UINT32_MAX});
+    }
+    // PeakMatrix requires peaks sorted by (chr, end, start)
+    std::sort(peaks.begin(), peaks.end());
+
+    // Output column for each BED line, to restore the BED order on write
+    std::vector<uint32_t> bed_order(bed.size(), UINT32_MAX);
+    uint32_t placeholder_col = UINT32_MAX;
+    for (uint32_t j = 0; j < peaks.size(); j++) {
+        uint32_t bed_idx = std::get<3>(peaks[j]);
+        if (bed_idx == UINT32_MAX) placeholder_col = j;
+        else bed_order[bed_idx] = j;
+    }
+    bool reordered = peaks.size() != bed.size();
+    for (uint32_t i = 0; i < bed.size(); i++) {
+        if (bed_order[i] == UINT32_MAX) bed_order[i] = placeholder_col;
+        reordered = reordered || bed_order[i] != i;
+    }
+
+    // Split the peaks into contiguous column ranges, compute each in its own thread
+    // into memory, then concatenate the pieces on write
+    uint32_t n_chunks = std::max<uint32_t>(1, std::min<uint32_t>(threads, peaks.size()));
+    std::vector<VecReaderWriterBuilder> pieces(n_chunks);
+    std::vector<std::thread> workers;
+    std::vector<std::string> errors(n_chunks);
+    for (uint32_t i = 0; i < n_chunks; i++) {
+        workers.push_back(std::thread([&, i] {
+            try {
+                size_t begin = peaks.size() * i / n_chunks;
+                size_t end = peaks.size() * (i + 1) / n_chunks;
+                std::vector<uint32_t> chr_vec, start_vec, end_vec;
+                for (size_t j = begin; j < end; j++) {
+                    chr_vec.push_back(std::get<0>(peaks[j]));
+                    end_vec.push_back(std::get<1>(peaks[j]));
+                    start_vec.push_back(std::get<2>(peaks[j]));
+                }
+                std::unique_ptr<MatrixLoader<uint32_t>> mat;
+                if (mode == "insertions")
+                    mat = openPeakMatrix<0>(frag_dir, chr_vec, start_vec, end_vec, chr_levels);
+                else if (mode == "fragments")
+                    mat = openPeakMatrix<1>(frag_dir, chr_vec, start_vec, end_vec, chr_levels);
+                else if (mode == "overlaps")
+                    mat = openPeakMatrix<2>(frag_dir, chr_vec, start_vec, end_vec, chr_levels);
+                else throw std::invalid_argument("Unrecognized --mode: " + mode);
+                StoredMatrixWriter<uint32_t>::createPacked(pieces[i]).write(*mat);
+            } catch (std::exception &e) {
+                errors[i] = e.what();
+            }
+        }));
+    }
+    for (auto &w : workers)
+        w.join();
+    for (const auto &e : errors) {
+        if (!e.empty()) throw std::runtime_error(e);
+    }
+
+    std::unique_ptr<MatrixLoader<uint32_t>> result;
+    if (n_chunks == 1) {
+        result = std::make_unique<StoredMatrix<uint32_t>>(
+            StoredMatrix<uint32_t>::openPacked(pieces[0])
+        );
+    } else {
+        std::vector<std::unique_ptr<MatrixLoader<uint32_t>>> mats;
+        for (auto &p : pieces) {
+            mats.push_back(
+                std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(p))
+            );
+        }
+        result = std::make_unique<ConcatCols<uint32_t>>(std::move(mats), 0);
+    }
+    if (reordered) {
+        result = std::make_unique<MatrixColSelect<uint32_t>>(std::move(result), bed_order);
+    }
+    std::vector<std::string> col_names;
+    for (const auto &r : bed) {
+        col_names.push_back(r.chr + ":" + std::to_string(r.start) + "-" + std::to_string(r.end));
+    }
+    result = std::make_unique<RenameDims<uint32_t>>(
+        std::move(result), std::vector<std::string>(), col_names
+    );
+    writeMatrixDir(*result, output, true, false, args.has("overwrite"));
+    return 0;
+}
+
+std::unique_ptr<FragmentLoader> openFragmentsDir(const std::string &dir) {
+    FileReaderBuilder rb(dir);
+    if (rb.readVersion().rfind("packed-", 0) == 0)
+        return std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(rb));
+    return std::make_unique<StoredFragments>(StoredFragments::openUnpacked(rb));
+}
+
+int runMergeFragments(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"overwrite", "help"});
+    if (args.has("help") || args.positional.size() < 2) {
+        std::cerr << merge_fragments_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    std::string output = args.positional[0];
+    std::vector<std::string> inputs(args.positional.begin() + 1, args.positional.end());
+    uint32_t threads = parseThreads(args);
+    int max_open = std::stoi(args.get("max-open", "64"));
+    if (max_open < 2) throw std::invalid_argument("--max-open must be >= 2");
+
+    // Chromosome order is the order of first appearance across inputs
+    std::vector<std::string> chr_order;
+    std::set<std::string> seen_chr;
+    for (const auto &dir : inputs) {
+        FileReaderBuilder rb(dir);
+        auto chr_names = rb.openStringReader("chr_names");
+        for (uint64_t i = 0; i < chr_names->size(); i++) {
+            if (seen_chr.insert(chr_names->get(i)).second) chr_order.push_back(chr_names->get(i));
+        }
+    }
+
+    std_fs::path tmpdir = args.get("tmpdir", std_fs::temp_directory_path().string());
+    tmpdir /= "bpcells_merge_" + std::to_string(std::hash<std::string>{}(output));
+    std_fs::remove_all(tmpdir);
+    try {
+        FileWriterBuilder wb(output, 8192, args.has("overwrite"));
+        std::unique_ptr<FragmentLoader> merged = mergeFragmentsHierarchical(
+            [&](uint32_t i) { return openFragmentsDir(inputs[i]); },
+            inputs.size(),
+            chr_order,
+            tmpdir.string(),
+            max_open,
+            threads,
+            ExecutionContext(NULL, threads, parseMemory(args))
+        );
+        StoredFragmentsWriter::createPacked(wb, 1024, threads > 1).write(*merged);
+    } catch (...) {
+        std_fs::remove_all(tmpdir);
+        throw;
+    }
+    std_fs::remove_all(tmpdir);
+    return 0;
+}
+
+// Stats split stored column ranges across threads, so rather than a DualOrientationMatrix this
+// opens whichever single copy streams for the requested axis
+template <typename T>
+StoredMatrix<T> openStatsCopy(ReaderBuilder &rb, bool packed, bool use_transposed) {
+    if (!use_transposed) return openMatrixDir<T>(rb, packed);
+    return DualOrientationMatrix<T>::openTransposed(rb);
+}
+
+template <typename T>
+Eigen::ArrayXXd computeStats(
+    const std::string &dir, bool packed, Axis axis, uint32_t threads, uint64_t memory_bytes
+) {
+    bool row_major, use_transposed = false;
+    uint32_t cols;
+    {
+        FileReaderBuilder rb(dir);
+        row_major = StoredMatrix<T>::isRowMajor(rb);
+        // Dual-orientation matrices have a transposed copy that streams for the other axis
+        if (planAxisKernel(axis, row_major) == AxisKernel::Scatter &&
+            DualOrientationMatrix<T>::isDualOrientation(rb)) {
+            use_transposed = true;
+            row_major = !row_major;
+        }
+        cols = openStatsCopy<T>(rb, packed, use_transposed).cols();
+    }
+    // Keep >= 2 columns per chunk so per-chunk sample variances are defined
+    threads = std::max<uint32_t>(1, std::min(threads, cols / 2));
+
+    // Each thread reads its own copy of the matrix, restricted to a range of columns
+    std::vector<std::unique_ptr<MatrixLoader<T>>> mats;
+    for (uint32_t i = 0; i < threads; i++) {
+        std::vector<uint32_t> col_indices;
+        for (uint32_t c = (uint64_t)cols * i / threads; c < (uint64_t)cols * (i + 1) / threads; c++)
+            col_indices.push_back(c);
+        FileReaderBuilder rb(dir);
+        auto mat = std::make_unique<StoredMatrix<T>>(openStatsCopy<T>(rb, packed, use_transposed));
+        mats.push_back(std::make_unique<MatrixColSelect<T>>(std::move(mat), col_indices));
+    }
+    // Only the requested axis is computed, streaming over stored columns when the storage
+    // order allows (e.g. per-row stats of a row-major matrix)
+    if (threads == 1) return computeAxisStats(*mats[0], axis, row_major, Stats::Variance);
+    ConcatCols<T> concat(std::move(mats), threads);
+    ExecutionContext ctx(NULL, threads, memory_bytes);
+    return computeAxisStats<T>(concat, axis, row_major, Stats::Variance, ctx);
+}
+
+int runStats(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"help"});
+    if (args.has("help") || args.positional.size() != 1) {
+        std::cerr << stats_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    std::string dir = args.positional[0];
+    std::string axis = args.get("axis", "col");
+    if (axis != "row" && axis != "col") throw std::invalid_argument("--axis must be row or col");
+    uint32_t threads = parseThreads(args);
+    uint64_t memory_bytes = parseMemory(args);
+
+    bool packed;
+    std::string type = matrixDirType(dir, packed);
+    Axis stats_axis = axis == "row" ? Axis::Row : Axis::Col;
+    Eigen::ArrayXXd stats;
+    if (type == "uint")
+        stats = computeStats<uint32_t>(dir, packed, stats_axis, threads, memory_bytes);
+    else if (type == "float")
+        stats = computeStats<float>(dir, packed, stats_axis, threads, memory_bytes);
+    else if (type == "double")
+        stats = computeStats<double>(dir, packed, stats_axis, threads, memory_bytes);
+    else throw std::runtime_error("Unsupported matrix type for stats: " + type);
+
+    FileReaderBuilder rb(dir);
+    auto names = rb.openStringReader(axis == "row" ? "row_names" : "col_names");
+
+    std::cout << "name\tnonzero\tmean\tvariance\n";
+    for (Eigen::Index i = 0; i < stats.cols(); i++) {
+        const char *name = (uint64_t)i < names->size() ? names->get(i) : NULL;
+        if (name != NULL) std::cout << name;
+        else std::cout << i;
+        std::cout << "\t" << stats(0, i) << "\t" << stats(1, i) << "\t" << stats(2, i) << "\n";
+    }
+    return 0;
+}
+
+int runVerify(int argc, char **argv) {
+    Args args = parseArgs(argc, argv, 2, {"help"});
+    if (args.has("help") || args.positional.size() != 1) {
+        std::cerr << verify_usage;
+        return args.has("help") ? 0 : 1;
+    }
+    FileReaderBuilder rb(args.positional[0]);
+    ChecksumReport report = verifyChecksums(rb);
+    for (const auto &failure : report.failures)
+        std::cout << "FAILED " << failure << "\n";
+    std::cout << "Checked " << report.arrays << " arrays, " << report.chunks << " chunks, "
+              << report.bytes << " bytes";
+    if (!crc32cHardwareAccelerated()) std::cout << " (software CRC32C)";
+    std::cout << "\n";
+    if (report.arrays == 0) std::cout << "No checksummed arrays found\n";
+    return report.failures.empty() ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2 || std::string(argv[1]) == "--help" || std::string(argv[1]) == "-h") {
+        std::cerr << usage_text;
+        return argc < 2 ? 1 : 0;
+    }
+    std::string command = argv[1];
+    try {
+        if (command == "convert") return runConvert(argc, argv);
+        if (command == "transpose") return runTranspose(argc, argv);
+        if (command == "peak-matrix") return runPeakMatrix(argc, argv);
+        if (command == "merge-fragments") return runMergeFragments(argc, argv);
+        if (command == "stats") return runStats(argc, argv);
+        if (command == "verify") return runVerify(argc, argv);
+    } catch (std::exception &e) {
+        std::cerr << "bpcells " << command << ": " << e.what() << "\n";
+        return 1;
+    }
+    std::cerr << "Unrecognized command: " << command << "\n\n" << usage_text;
+    return 1;
+}
@@ -0,0 +1,122 @@
+# Static library targets for the BPCells C++ core, usable without R.
+# Included by tests/googletest and cli. Callers must have found HDF5, ZLIB, and Eigen3.
+#
+# Targets:
+#   bitpacking         - BP128 SIMD bitpacking kernels
+#   arrayIO            - Number/string array storage (binary files, HDF5, in-memory, BP128)
+#   fragmentIterators  - Fragment loading, filtering, and writing
+#   fragmentUtils      - Footprinting and other fragment summaries (needs Eigen)
+#   matrixIterators    - Matrix loading, import, peak/tile matrices, stats, and SVD
+#   matrixTransforms   - Normalization and other matrix transformations
+if(TARGET bitpacking)
+    return()
+endif()
+
+set(BPCELLS_SRC ${CMAKE_CURRENT_LIST_DIR}/../src)
+
+add_library(
+    bitpacking
+    ${BPCELLS_SRC}/bitpacking/bp128.cpp
+    ${BPCELLS_SRC}/bitpacking/simd_vec.cpp
+)
+target_include_directories(
+    bitpacking
+    PUBLIC
+    ${BPCELLS_SRC}
+)
+
+add_library(
+    arrayIO
+    ${BPCELLS_SRC}/arrayIO/array_interfaces.cpp
+    ${BPCELLS_SRC}/arrayIO/binaryfile.cpp
+    ${BPCELLS_SRC}/arrayIO/hdf5.cpp
+    ${BPCELLS_SRC}/arrayIO/vector.cpp
+    ${BPCELLS_SRC}/arrayIO/bp128.cpp
+    ${BPCELLS_SRC}/arrayIO/checksum.cpp
+    ${BPCELLS_SRC}/arrayIO/prefix.cpp
+)
+target_link_libraries(
+    arrayIO
+    ${HDF5_LIBRARIES}
+    bitpacking
+)
+target_include_directories(
+    arrayIO
+    PUBLIC
+    ${HDF5_INCLUDE_DIRS}
+    ${BPCELLS_SRC}
+)
+
+add_library(
+    fragmentIterators
+    ${BPCELLS_SRC}/fragmentIterators/BedFragments.cpp
+    ${BPCELLS_SRC}/fragmentIterators/Bgzf.cpp
+    ${BPCELLS_SRC}/fragmentIterators/CellSelect.cpp
+    ${BPCELLS_SRC}/fragmentIterators/ChrSelect.cpp
+    ${BPCELLS_SRC}/fragmentIterators/FragmentIterator.cpp
+    ${BPCELLS_SRC}/fragmentIterators/LengthSelect.cpp
+    ${BPCELLS_SRC}/fragmentIterators/MergeFragments.cpp
+    ${BPCELLS_SRC}/fragmentIterators/MultiSampleFragments.cpp
+    ${BPCELLS_SRC}/fragmentIterators/RegionSelect.cpp
+    ${BPCELLS_SRC}/fragmentIterators/Rename.cpp
+    ${BPCELLS_SRC}/fragmentIterators/ShiftCoords.cpp
+    ${BPCELLS_SRC}/fragmentIterators/StoredFragments.cpp
+    ${BPCELLS_SRC}/fragmentUtils/InsertionIterator.cpp
+)
+target_link_libraries(
+    fragmentIterators
+    arrayIO
+    ${ZLIB_LIBRARIES}
+)
+target_include_directories(
+    fragmentIterators
+    PUBLIC
+    ${ZLIB_INCLUDE_DIRS}
+    ${BPCELLS_SRC}
+)
+
+add_library(
+    fragmentUtils
+    ${BPCELLS_SRC}/fragmentUtils/FootprintMatrix.cpp
+    ${BPCELLS_SRC}/fragmentUtils/InsertionPileup.cpp
+)
+target_link_libraries(
+    fragmentUtils
+    fragmentIterators
+    Eigen3::Eigen
+)
+
+add_library(
+    matrixIterators
+    ${BPCELLS_SRC}/matrixIterators/ImportMatrixHDF5.cpp
+    ${BPCELLS_SRC}/matrixIterators/MatrixMarketImport.cpp
+    ${BPCELLS_SRC}/matrixIterators/MatrixStats.cpp
+    ${BPCELLS_SRC}/matrixIterators/PeakMatrix.cpp
+    ${BPCELLS_SRC}/matrixIterators/SVD.cpp
+    ${BPCELLS_SRC}/matrixIterators/TileMatrix.cpp
+    ${BPCELLS_SRC}/matrixIterators/WilcoxonRankSum.cpp
+)
+target_link_libraries(
+    matrixIterators
+    arrayIO
+    fragmentIterators
+    Eigen3::Eigen
+)
+
+add_library(
+    matrixTransforms
+    ${BPCELLS_SRC}/matrixTransforms/Binarize.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Log1p.cpp
+    ${BPCELLS_SRC}/matrixTransforms/MatrixTransform.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Min.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Pow.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Round.cpp
+    ${BPCELLS_SRC}/matrixTransforms/SCTransform.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Scale.cpp
+    ${BPCELLS_SRC}/matrixTransforms/Shift.cpp
+)
+target_link_libraries(
+    matrixTransforms
+    matrixIterators
+    Eigen3::Eigen
+)
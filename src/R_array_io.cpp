@@ -58,6 +58,14 @@ std::unique_ptr<StringReader> S4ReaderBuilder::openStringReader(std::string name
     return std::make_unique<RcppStringReader>(Rcpp::as<StringVector>(s4.slot(name)));
 }
 std::string S4ReaderBuilder::readVersion() { return s4.slot("version"); }
+std::vector<std::string> S4ReaderBuilder::listArrays() {
+    // S4 slots are stored as attributes of the object
+    std::vector<std::string> ret;
+    for (auto &name : s4.attributeNames()) {
+        if (name != "class" && name != "version") ret.push_back(name);
+    }
+    return ret;
+}
 
 ListWriterBuilder::ListWriterBuilder(uint32_t chunk_size)
     : VecReaderWriterBuilder(chunk_size) {}
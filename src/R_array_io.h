@@ -34,6 +34,7 @@ class S4ReaderBuilder : public BPCells::ReaderBuilder {
     BPCells::DoubleReader openDoubleReader(std::string name) override;
     std::unique_ptr<BPCells::StringReader> openStringReader(std::string name) override;
     std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
 };
 
 class ListWriterBuilder final : public BPCells::VecReaderWriterBuilder {
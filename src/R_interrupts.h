@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <chrono>
 #include <future>
+#include <thread>
 
 #define RCPP_NO_RTTI
 #define RCPP_NO_SUGAR
 #include <Rcpp.h>
 
+#include "utils/execution_context.h"
+
 namespace {
 inline void myCheckInterruptFn(void * /*dummy*/) { R_CheckUserInterrupt(); }
 } // anonymous namespace
@@ -15,16 +19,23 @@ inline bool hasUserInterrupt() { return (R_ToplevelExec(myCheckInterruptFn, NULL
 // Wrap a function call such that we will check for R user interrupts
 // The function itself is run in a background thread, and the main thread checks for an
 // R user interrupt every 100ms.
-// The function must take a pointer to as std::atomic<bool> as the last argument, and exit
-// early if the bool gets set to true
+// The function must take an ExecutionContext as the last argument, and exit early if
+// ctx.interrupted() becomes true.
+// `max_threads` caps the worker threads used by all parallel components of the call combined,
+// so nested parallel loaders (e.g. the chunks of a parallel_split() matrix that each decode
+// on multiple threads) share one budget rather than oversubscribing the machine. Pass 0 to
+// use the number of hardware threads.
 // NOTE: It is EXTREMELY IMPORTANT that no R objects are created/destroyed inside the spawned
 // thread, which includes destructors that mess with R's GC protection.
 template <class F, class... Args>
-std::invoke_result_t<F, Args..., std::atomic<bool> *>
-run_with_R_interrupt_check(F &&f, Args &&...args) {
+std::invoke_result_t<F, Args..., const BPCells::ExecutionContext &>
+run_with_R_interrupt_check_threads(uint32_t max_threads, F &&f, Args &&...args) {
     std::atomic<bool> interrupt(false);
-    auto job =
-        std::async(std::launch::async, std::forward<F>(f), std::forward<Args>(args)..., &interrupt);
+    if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+    BPCells::ExecutionContext ctx(&interrupt, max_threads, UINT64_MAX);
+    auto job = std::async(
+        std::launch::async, std::forward<F>(f), std::forward<Args>(args)..., std::cref(ctx)
+    );
     while (job.wait_for(std::chrono::milliseconds(100)) == std::future_status::timeout) {
         if (hasUserInterrupt()) {
             interrupt = true;
@@ -35,3 +46,11 @@ run_with_R_interrupt_check(F &&f, Args &&...args) {
     }
     return job.get();
 }
+
+// As above, for calls without an explicit thread count. The thread budget is the number of
+// hardware threads, which still keeps nested parallel loaders from oversubscribing
+template <class F, class... Args>
+std::invoke_result_t<F, Args..., const BPCells::ExecutionContext &>
+run_with_R_interrupt_check(F &&f, Args &&...args) {
+    return run_with_R_interrupt_check_threads(0, std::forward<F>(f), std::forward<Args>(args)...);
+}
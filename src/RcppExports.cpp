@@ -262,26 +262,30 @@ BEGIN_RCPP
 END_RCPP
 }
 // iterate_10x_fragments_cpp
-SEXP iterate_10x_fragments_cpp(std::string path, std::string comment);
-RcppExport SEXP _BPCells_iterate_10x_fragments_cpp(SEXP pathSEXP, SEXP commentSEXP) {
+SEXP iterate_10x_fragments_cpp(std::string path, std::string comment, std::vector<std::string> keep_cells, int min_fragments);
+RcppExport SEXP _BPCells_iterate_10x_fragments_cpp(SEXP pathSEXP, SEXP commentSEXP, SEXP keep_cellsSEXP, SEXP min_fragmentsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
     Rcpp::traits::input_parameter< std::string >::type comment(commentSEXP);
-    rcpp_result_gen = Rcpp::wrap(iterate_10x_fragments_cpp(path, comment));
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type keep_cells(keep_cellsSEXP);
+    Rcpp::traits::input_parameter< int >::type min_fragments(min_fragmentsSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_10x_fragments_cpp(path, comment, keep_cells, min_fragments));
     return rcpp_result_gen;
 END_RCPP
 }
 // write_10x_fragments_cpp
-void write_10x_fragments_cpp(std::string path, SEXP fragments, bool append_5th_column);
-RcppExport SEXP _BPCells_write_10x_fragments_cpp(SEXP pathSEXP, SEXP fragmentsSEXP, SEXP append_5th_columnSEXP) {
+void write_10x_fragments_cpp(std::string path, SEXP fragments, bool append_5th_column, int threads, bool index);
+RcppExport SEXP _BPCells_write_10x_fragments_cpp(SEXP pathSEXP, SEXP fragmentsSEXP, SEXP append_5th_columnSEXP, SEXP threadsSEXP, SEXP indexSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
     Rcpp::traits::input_parameter< SEXP >::type fragments(fragmentsSEXP);
     Rcpp::traits::input_parameter< bool >::type append_5th_column(append_5th_columnSEXP);
-    write_10x_fragments_cpp(path, fragments, append_5th_column);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type index(indexSEXP);
+    write_10x_fragments_cpp(path, fragments, append_5th_column, threads, index);
     return R_NilValue;
 END_RCPP
 }
@@ -368,15 +372,16 @@ BEGIN_RCPP
 END_RCPP
 }
 // write_unpacked_fragments_file_cpp
-void write_unpacked_fragments_file_cpp(SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite);
-RcppExport SEXP _BPCells_write_unpacked_fragments_file_cpp(SEXP fragmentsSEXP, SEXP dirSEXP, SEXP buffer_sizeSEXP, SEXP allow_overwriteSEXP) {
+void write_unpacked_fragments_file_cpp(SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite, bool sorted_ends);
+RcppExport SEXP _BPCells_write_unpacked_fragments_file_cpp(SEXP fragmentsSEXP, SEXP dirSEXP, SEXP buffer_sizeSEXP, SEXP allow_overwriteSEXP, SEXP sorted_endsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type fragments(fragmentsSEXP);
     Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type buffer_size(buffer_sizeSEXP);
     Rcpp::traits::input_parameter< bool >::type allow_overwrite(allow_overwriteSEXP);
-    write_unpacked_fragments_file_cpp(fragments, dir, buffer_size, allow_overwrite);
+    Rcpp::traits::input_parameter< bool >::type sorted_ends(sorted_endsSEXP);
+    write_unpacked_fragments_file_cpp(fragments, dir, buffer_size, allow_overwrite, sorted_ends);
     return R_NilValue;
 END_RCPP
 }
@@ -395,15 +400,17 @@ BEGIN_RCPP
 END_RCPP
 }
 // write_packed_fragments_file_cpp
-void write_packed_fragments_file_cpp(SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite);
-RcppExport SEXP _BPCells_write_packed_fragments_file_cpp(SEXP fragmentsSEXP, SEXP dirSEXP, SEXP buffer_sizeSEXP, SEXP allow_overwriteSEXP) {
+void write_packed_fragments_file_cpp(SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite, int threads, bool sorted_ends);
+RcppExport SEXP _BPCells_write_packed_fragments_file_cpp(SEXP fragmentsSEXP, SEXP dirSEXP, SEXP buffer_sizeSEXP, SEXP allow_overwriteSEXP, SEXP threadsSEXP, SEXP sorted_endsSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type fragments(fragmentsSEXP);
     Rcpp::traits::input_parameter< std::string >::type dir(dirSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type buffer_size(buffer_sizeSEXP);
     Rcpp::traits::input_parameter< bool >::type allow_overwrite(allow_overwriteSEXP);
-    write_packed_fragments_file_cpp(fragments, dir, buffer_size, allow_overwrite);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type sorted_ends(sorted_endsSEXP);
+    write_packed_fragments_file_cpp(fragments, dir, buffer_size, allow_overwrite, threads, sorted_ends);
     return R_NilValue;
 END_RCPP
 }
@@ -608,12 +615,12 @@ BEGIN_RCPP
 END_RCPP
 }
 // footprint_matrix_cpp
-Eigen::MatrixXd footprint_matrix_cpp(SEXP fragments, std::vector<uint32_t> chr, std::vector<uint32_t> center, std::vector<int32_t> strand, uint32_t flank_width, StringVector chr_levels, std::vector<uint32_t> cell_groups, std::vector<double> cell_weights);
-RcppExport SEXP _BPCells_footprint_matrix_cpp(SEXP fragmentsSEXP, SEXP chrSEXP, SEXP centerSEXP, SEXP strandSEXP, SEXP flank_widthSEXP, SEXP chr_levelsSEXP, SEXP cell_groupsSEXP, SEXP cell_weightsSEXP) {
+Eigen::MatrixXd footprint_matrix_cpp(List fragments, std::vector<uint32_t> chr, std::vector<uint32_t> center, std::vector<int32_t> strand, uint32_t flank_width, StringVector chr_levels, std::vector<uint32_t> cell_groups, std::vector<double> cell_weights, int threads);
+RcppExport SEXP _BPCells_footprint_matrix_cpp(SEXP fragmentsSEXP, SEXP chrSEXP, SEXP centerSEXP, SEXP strandSEXP, SEXP flank_widthSEXP, SEXP chr_levelsSEXP, SEXP cell_groupsSEXP, SEXP cell_weightsSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< SEXP >::type fragments(fragmentsSEXP);
+    Rcpp::traits::input_parameter< List >::type fragments(fragmentsSEXP);
     Rcpp::traits::input_parameter< std::vector<uint32_t> >::type chr(chrSEXP);
     Rcpp::traits::input_parameter< std::vector<uint32_t> >::type center(centerSEXP);
     Rcpp::traits::input_parameter< std::vector<int32_t> >::type strand(strandSEXP);
@@ -621,7 +628,25 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< StringVector >::type chr_levels(chr_levelsSEXP);
     Rcpp::traits::input_parameter< std::vector<uint32_t> >::type cell_groups(cell_groupsSEXP);
     Rcpp::traits::input_parameter< std::vector<double> >::type cell_weights(cell_weightsSEXP);
-    rcpp_result_gen = Rcpp::wrap(footprint_matrix_cpp(fragments, chr, center, strand, flank_width, chr_levels, cell_groups, cell_weights));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(footprint_matrix_cpp(fragments, chr, center, strand, flank_width, chr_levels, cell_groups, cell_weights, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// pileup_insertions_cpp
+Eigen::MatrixXd pileup_insertions_cpp(SEXP fragments, std::vector<uint32_t> chr, std::vector<uint32_t> start, std::vector<uint32_t> end, std::vector<uint32_t> bin_width, std::vector<int> cell_groups, uint32_t n_groups);
+RcppExport SEXP _BPCells_pileup_insertions_cpp(SEXP fragmentsSEXP, SEXP chrSEXP, SEXP startSEXP, SEXP endSEXP, SEXP bin_widthSEXP, SEXP cell_groupsSEXP, SEXP n_groupsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type fragments(fragmentsSEXP);
+    Rcpp::traits::input_parameter< std::vector<uint32_t> >::type chr(chrSEXP);
+    Rcpp::traits::input_parameter< std::vector<uint32_t> >::type start(startSEXP);
+    Rcpp::traits::input_parameter< std::vector<uint32_t> >::type end(endSEXP);
+    Rcpp::traits::input_parameter< std::vector<uint32_t> >::type bin_width(bin_widthSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type cell_groups(cell_groupsSEXP);
+    Rcpp::traits::input_parameter< uint32_t >::type n_groups(n_groupsSEXP);
+    rcpp_result_gen = Rcpp::wrap(pileup_insertions_cpp(fragments, chr, start, end, bin_width, cell_groups, n_groups));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -825,8 +850,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // iterate_packed_matrix_mem_uint32_t_cpp
-SEXP iterate_packed_matrix_mem_uint32_t_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count);
-RcppExport SEXP _BPCells_iterate_packed_matrix_mem_uint32_t_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP) {
+SEXP iterate_packed_matrix_mem_uint32_t_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count, int threads);
+RcppExport SEXP _BPCells_iterate_packed_matrix_mem_uint32_t_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -834,7 +859,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const StringVector >::type row_names(row_namesSEXP);
     Rcpp::traits::input_parameter< const StringVector >::type col_names(col_namesSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type row_count(row_countSEXP);
-    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_uint32_t_cpp(s4, row_names, col_names, row_count));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_uint32_t_cpp(s4, row_names, col_names, row_count, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -853,8 +879,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // iterate_packed_matrix_mem_float_cpp
-SEXP iterate_packed_matrix_mem_float_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count);
-RcppExport SEXP _BPCells_iterate_packed_matrix_mem_float_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP) {
+SEXP iterate_packed_matrix_mem_float_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count, int threads);
+RcppExport SEXP _BPCells_iterate_packed_matrix_mem_float_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -862,7 +888,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const StringVector >::type row_names(row_namesSEXP);
     Rcpp::traits::input_parameter< const StringVector >::type col_names(col_namesSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type row_count(row_countSEXP);
-    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_float_cpp(s4, row_names, col_names, row_count));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_float_cpp(s4, row_names, col_names, row_count, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -881,8 +908,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // iterate_packed_matrix_mem_double_cpp
-SEXP iterate_packed_matrix_mem_double_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count);
-RcppExport SEXP _BPCells_iterate_packed_matrix_mem_double_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP) {
+SEXP iterate_packed_matrix_mem_double_cpp(S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count, int threads);
+RcppExport SEXP _BPCells_iterate_packed_matrix_mem_double_cpp(SEXP s4SEXP, SEXP row_namesSEXP, SEXP col_namesSEXP, SEXP row_countSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -890,7 +917,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const StringVector >::type row_names(row_namesSEXP);
     Rcpp::traits::input_parameter< const StringVector >::type col_names(col_namesSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type row_count(row_countSEXP);
-    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_double_cpp(s4, row_names, col_names, row_count));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_packed_matrix_mem_double_cpp(s4, row_names, col_names, row_count, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1833,6 +1861,18 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// build_csparse_matrix_parallel_double_cpp
+SEXP build_csparse_matrix_parallel_double_cpp(SEXP matrix_list, int threads);
+RcppExport SEXP _BPCells_build_csparse_matrix_parallel_double_cpp(SEXP matrix_listSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type matrix_list(matrix_listSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(build_csparse_matrix_parallel_double_cpp(matrix_list, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // iterate_matrix_col_select_uint32_t_cpp
 SEXP iterate_matrix_col_select_uint32_t_cpp(SEXP matrix, std::vector<uint32_t> col_selection);
 RcppExport SEXP _BPCells_iterate_matrix_col_select_uint32_t_cpp(SEXP matrixSEXP, SEXP col_selectionSEXP) {
@@ -2130,6 +2170,21 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// iterate_matrix_downsample_cpp
+SEXP iterate_matrix_downsample_cpp(SEXP matrix, std::vector<double> col_totals, std::vector<double> targets, std::string method, double seed);
+RcppExport SEXP _BPCells_iterate_matrix_downsample_cpp(SEXP matrixSEXP, SEXP col_totalsSEXP, SEXP targetsSEXP, SEXP methodSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type matrix(matrixSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type col_totals(col_totalsSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type targets(targetsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(iterate_matrix_downsample_cpp(matrix, col_totals, targets, method, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
 // dense_multiply_right_cpp
 Eigen::MatrixXd dense_multiply_right_cpp(SEXP matrix, Eigen::Map<Eigen::MatrixXd> B);
 RcppExport SEXP _BPCells_dense_multiply_right_cpp(SEXP matrixSEXP, SEXP BSEXP) {
@@ -2249,15 +2304,16 @@ BEGIN_RCPP
 END_RCPP
 }
 // matrix_stats_cpp
-List matrix_stats_cpp(SEXP matrix, int row_stats, int col_stats);
-RcppExport SEXP _BPCells_matrix_stats_cpp(SEXP matrixSEXP, SEXP row_statsSEXP, SEXP col_statsSEXP) {
+List matrix_stats_cpp(SEXP matrix, int row_stats, int col_stats, int threads);
+RcppExport SEXP _BPCells_matrix_stats_cpp(SEXP matrixSEXP, SEXP row_statsSEXP, SEXP col_statsSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type matrix(matrixSEXP);
     Rcpp::traits::input_parameter< int >::type row_stats(row_statsSEXP);
     Rcpp::traits::input_parameter< int >::type col_stats(col_statsSEXP);
-    rcpp_result_gen = Rcpp::wrap(matrix_stats_cpp(matrix, row_stats, col_stats));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(matrix_stats_cpp(matrix, row_stats, col_stats, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -2298,8 +2354,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // svds_cpp
-SEXP svds_cpp(SEXP matrix, int k, int n_cv, int maxit, double tol);
-RcppExport SEXP _BPCells_svds_cpp(SEXP matrixSEXP, SEXP kSEXP, SEXP n_cvSEXP, SEXP maxitSEXP, SEXP tolSEXP) {
+SEXP svds_cpp(SEXP matrix, int k, int n_cv, int maxit, double tol, int threads);
+RcppExport SEXP _BPCells_svds_cpp(SEXP matrixSEXP, SEXP kSEXP, SEXP n_cvSEXP, SEXP maxitSEXP, SEXP tolSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -2308,7 +2364,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type n_cv(n_cvSEXP);
     Rcpp::traits::input_parameter< int >::type maxit(maxitSEXP);
     Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
-    rcpp_result_gen = Rcpp::wrap(svds_cpp(matrix, k, n_cv, maxit, tol));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(svds_cpp(matrix, k, n_cv, maxit, tol, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -2357,8 +2414,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_write_bp128_end", (DL_FUNC) &_BPCells_write_bp128_end, 5},
     {"_BPCells_read_bp128_end", (DL_FUNC) &_BPCells_read_bp128_end, 6},
     {"_BPCells_build_snn_graph_cpp", (DL_FUNC) &_BPCells_build_snn_graph_cpp, 2},
-    {"_BPCells_iterate_10x_fragments_cpp", (DL_FUNC) &_BPCells_iterate_10x_fragments_cpp, 2},
-    {"_BPCells_write_10x_fragments_cpp", (DL_FUNC) &_BPCells_write_10x_fragments_cpp, 3},
+    {"_BPCells_iterate_10x_fragments_cpp", (DL_FUNC) &_BPCells_iterate_10x_fragments_cpp, 4},
+    {"_BPCells_write_10x_fragments_cpp", (DL_FUNC) &_BPCells_write_10x_fragments_cpp, 5},
     {"_BPCells_iterate_packed_fragments_cpp", (DL_FUNC) &_BPCells_iterate_packed_fragments_cpp, 1},
     {"_BPCells_calculate_end_max_cpp", (DL_FUNC) &_BPCells_calculate_end_max_cpp, 2},
     {"_BPCells_write_packed_fragments_cpp", (DL_FUNC) &_BPCells_write_packed_fragments_cpp, 1},
@@ -2366,9 +2423,9 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_write_unpacked_fragments_cpp", (DL_FUNC) &_BPCells_write_unpacked_fragments_cpp, 1},
     {"_BPCells_info_fragments_file_cpp", (DL_FUNC) &_BPCells_info_fragments_file_cpp, 2},
     {"_BPCells_iterate_unpacked_fragments_file_cpp", (DL_FUNC) &_BPCells_iterate_unpacked_fragments_file_cpp, 4},
-    {"_BPCells_write_unpacked_fragments_file_cpp", (DL_FUNC) &_BPCells_write_unpacked_fragments_file_cpp, 4},
+    {"_BPCells_write_unpacked_fragments_file_cpp", (DL_FUNC) &_BPCells_write_unpacked_fragments_file_cpp, 5},
     {"_BPCells_iterate_packed_fragments_file_cpp", (DL_FUNC) &_BPCells_iterate_packed_fragments_file_cpp, 4},
-    {"_BPCells_write_packed_fragments_file_cpp", (DL_FUNC) &_BPCells_write_packed_fragments_file_cpp, 4},
+    {"_BPCells_write_packed_fragments_file_cpp", (DL_FUNC) &_BPCells_write_packed_fragments_file_cpp, 6},
     {"_BPCells_info_fragments_hdf5_cpp", (DL_FUNC) &_BPCells_info_fragments_hdf5_cpp, 3},
     {"_BPCells_iterate_unpacked_fragments_hdf5_cpp", (DL_FUNC) &_BPCells_iterate_unpacked_fragments_hdf5_cpp, 5},
     {"_BPCells_write_unpacked_fragments_hdf5_cpp", (DL_FUNC) &_BPCells_write_unpacked_fragments_hdf5_cpp, 7},
@@ -2383,7 +2440,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_subset_tiles_cpp", (DL_FUNC) &_BPCells_subset_tiles_cpp, 6},
     {"_BPCells_nucleosome_counts_cpp", (DL_FUNC) &_BPCells_nucleosome_counts_cpp, 2},
     {"_BPCells_fragment_lengths_cpp", (DL_FUNC) &_BPCells_fragment_lengths_cpp, 1},
-    {"_BPCells_footprint_matrix_cpp", (DL_FUNC) &_BPCells_footprint_matrix_cpp, 8},
+    {"_BPCells_footprint_matrix_cpp", (DL_FUNC) &_BPCells_footprint_matrix_cpp, 9},
+    {"_BPCells_pileup_insertions_cpp", (DL_FUNC) &_BPCells_pileup_insertions_cpp, 7},
     {"_BPCells_iterate_shift_cpp", (DL_FUNC) &_BPCells_iterate_shift_cpp, 3},
     {"_BPCells_iterate_length_select_cpp", (DL_FUNC) &_BPCells_iterate_length_select_cpp, 3},
     {"_BPCells_iterate_chr_index_select_cpp", (DL_FUNC) &_BPCells_iterate_chr_index_select_cpp, 2},
@@ -2399,11 +2457,11 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_write_matrix_transpose_uint32_t_cpp", (DL_FUNC) &_BPCells_write_matrix_transpose_uint32_t_cpp, 6},
     {"_BPCells_write_matrix_transpose_float_cpp", (DL_FUNC) &_BPCells_write_matrix_transpose_float_cpp, 6},
     {"_BPCells_write_matrix_transpose_double_cpp", (DL_FUNC) &_BPCells_write_matrix_transpose_double_cpp, 6},
-    {"_BPCells_iterate_packed_matrix_mem_uint32_t_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_uint32_t_cpp, 4},
+    {"_BPCells_iterate_packed_matrix_mem_uint32_t_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_uint32_t_cpp, 5},
     {"_BPCells_iterate_unpacked_matrix_mem_uint32_t_cpp", (DL_FUNC) &_BPCells_iterate_unpacked_matrix_mem_uint32_t_cpp, 4},
-    {"_BPCells_iterate_packed_matrix_mem_float_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_float_cpp, 4},
+    {"_BPCells_iterate_packed_matrix_mem_float_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_float_cpp, 5},
     {"_BPCells_iterate_unpacked_matrix_mem_float_cpp", (DL_FUNC) &_BPCells_iterate_unpacked_matrix_mem_float_cpp, 4},
-    {"_BPCells_iterate_packed_matrix_mem_double_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_double_cpp, 4},
+    {"_BPCells_iterate_packed_matrix_mem_double_cpp", (DL_FUNC) &_BPCells_iterate_packed_matrix_mem_double_cpp, 5},
     {"_BPCells_iterate_unpacked_matrix_mem_double_cpp", (DL_FUNC) &_BPCells_iterate_unpacked_matrix_mem_double_cpp, 4},
     {"_BPCells_write_packed_matrix_mem_uint32_t_cpp", (DL_FUNC) &_BPCells_write_packed_matrix_mem_uint32_t_cpp, 2},
     {"_BPCells_write_unpacked_matrix_mem_uint32_t_cpp", (DL_FUNC) &_BPCells_write_unpacked_matrix_mem_uint32_t_cpp, 2},
@@ -2473,6 +2531,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_convert_matrix_float_uint32_t_cpp", (DL_FUNC) &_BPCells_convert_matrix_float_uint32_t_cpp, 1},
     {"_BPCells_convert_matrix_float_double_cpp", (DL_FUNC) &_BPCells_convert_matrix_float_double_cpp, 1},
     {"_BPCells_build_csparse_matrix_double_cpp", (DL_FUNC) &_BPCells_build_csparse_matrix_double_cpp, 1},
+    {"_BPCells_build_csparse_matrix_parallel_double_cpp", (DL_FUNC) &_BPCells_build_csparse_matrix_parallel_double_cpp, 2},
     {"_BPCells_iterate_matrix_col_select_uint32_t_cpp", (DL_FUNC) &_BPCells_iterate_matrix_col_select_uint32_t_cpp, 2},
     {"_BPCells_iterate_matrix_col_select_float_cpp", (DL_FUNC) &_BPCells_iterate_matrix_col_select_float_cpp, 2},
     {"_BPCells_iterate_matrix_col_select_double_cpp", (DL_FUNC) &_BPCells_iterate_matrix_col_select_double_cpp, 2},
@@ -2497,6 +2556,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_iterate_matrix_rank_uint32_t_cpp", (DL_FUNC) &_BPCells_iterate_matrix_rank_uint32_t_cpp, 1},
     {"_BPCells_iterate_matrix_rank_float_cpp", (DL_FUNC) &_BPCells_iterate_matrix_rank_float_cpp, 1},
     {"_BPCells_iterate_matrix_rank_double_cpp", (DL_FUNC) &_BPCells_iterate_matrix_rank_double_cpp, 1},
+    {"_BPCells_iterate_matrix_downsample_cpp", (DL_FUNC) &_BPCells_iterate_matrix_downsample_cpp, 5},
     {"_BPCells_dense_multiply_right_cpp", (DL_FUNC) &_BPCells_dense_multiply_right_cpp, 2},
     {"_BPCells_dense_multiply_left_cpp", (DL_FUNC) &_BPCells_dense_multiply_left_cpp, 2},
     {"_BPCells_vec_multiply_right_cpp", (DL_FUNC) &_BPCells_vec_multiply_right_cpp, 2},
@@ -2507,11 +2567,11 @@ static const R_CallMethodDef CallEntries[] = {
     {"_BPCells_vec_multiply_left_preserve_loader_cpp", (DL_FUNC) &_BPCells_vec_multiply_left_preserve_loader_cpp, 2},
     {"_BPCells_row_sums_double_cpp", (DL_FUNC) &_BPCells_row_sums_double_cpp, 1},
     {"_BPCells_col_sums_double_cpp", (DL_FUNC) &_BPCells_col_sums_double_cpp, 1},
-    {"_BPCells_matrix_stats_cpp", (DL_FUNC) &_BPCells_matrix_stats_cpp, 3},
+    {"_BPCells_matrix_stats_cpp", (DL_FUNC) &_BPCells_matrix_stats_cpp, 4},
     {"_BPCells_wilcoxon_rank_sum_pval_uint32_t_cpp", (DL_FUNC) &_BPCells_wilcoxon_rank_sum_pval_uint32_t_cpp, 2},
     {"_BPCells_wilcoxon_rank_sum_pval_float_cpp", (DL_FUNC) &_BPCells_wilcoxon_rank_sum_pval_float_cpp, 2},
     {"_BPCells_wilcoxon_rank_sum_pval_double_cpp", (DL_FUNC) &_BPCells_wilcoxon_rank_sum_pval_double_cpp, 2},
-    {"_BPCells_svds_cpp", (DL_FUNC) &_BPCells_svds_cpp, 5},
+    {"_BPCells_svds_cpp", (DL_FUNC) &_BPCells_svds_cpp, 6},
     {"_BPCells_matrix_value_histogram_cpp", (DL_FUNC) &_BPCells_matrix_value_histogram_cpp, 2},
     {"_BPCells_matrix_identical_uint32_t_cpp", (DL_FUNC) &_BPCells_matrix_identical_uint32_t_cpp, 2},
     {NULL, NULL, 0}
@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "../utils/instrumentation.h"
+
 namespace BPCells {
 
 class StringReader {
@@ -55,6 +57,15 @@ template <class T> class BulkNumReader {
     // Note: It is the caller's responsibility to ensure there is no data overflow, i.e.
     // that a load does not try to read past size() total elements
     virtual uint64_t load(T *out, uint64_t count) = 0;
+
+    // If all size() elements are already in contiguous memory, return a pointer to them so
+    // NumReader can skip copying into its buffer. Otherwise return NULL (the default)
+    virtual const T *contiguousData() const { return NULL; }
+
+    // Record I/O statistics for any inner readers this reader decodes from, as children of
+    // `node`. Return true if loads are decoded from inner readers rather than read directly
+    // from storage. By default a no-op returning false
+    virtual bool instrument(InstrumentNode & /*node*/) { return false; }
 };
 
 template <class From, class To> class BulkNumReaderConverter : public BulkNumReader<To> {
@@ -67,6 +78,7 @@ template <class From, class To> class BulkNumReaderConverter : public BulkNumRea
         : reader(std::move(reader)) {}
     uint64_t size() const override { return reader->size(); }
     void seek(uint64_t pos) override { return reader->seek(pos); }
+    bool instrument(InstrumentNode &node) override { return reader->instrument(node); }
     uint64_t load(To *out, uint64_t count) override {
         if (buffer.size() < count) buffer.resize(count);
         uint64_t loaded = reader->load(buffer.data(), count);
@@ -127,7 +139,8 @@ using UIntBulkWriter = BulkNumWriter<uint32_t>;
 //    the first few elements as consumed.
 // Note: Users of the class are free to modify the memory between data() and capacity() as needed.
 // This is to support zero-copy transformers, where the loaded data is transformed or filtered
-// in-place.
+// in-place. The exception is zero-copy mode (see enableZeroCopy()), where data() points
+// directly into the source array and must be treated as read-only.
 template <class T> class NumReader {
   protected:
     std::vector<T> buffer;
@@ -142,6 +155,20 @@ template <class T> class NumReader {
 
     uint64_t read_size; // Amount to provide users by default
 
+    std::shared_ptr<InstrumentNode> instrumentation; // Optional, NULL when disabled
+    bool decoding = false; // True if reader decodes from instrumented inner readers
+
+    // Source array in zero-copy mode, otherwise NULL. In zero-copy mode, idx is the position
+    // of data() within the source array, and the buffer and `loaded` are unused
+    const T *direct = NULL;
+
+    inline void recordLoad(uint64_t count) {
+        if (!instrumentation) return;
+        instrumentation->entries += count;
+        instrumentation->chunks += 1;
+        if (!decoding) instrumentation->bytes_read += count * sizeof(T);
+    }
+
   public:
     NumReader() = default;
     NumReader(
@@ -160,10 +187,46 @@ template <class T> class NumReader {
         );
     }
 
+    // Take the underlying bulk reader, after which the current reader should not be used
+    std::unique_ptr<BulkNumReader<T>> release() { return std::move(reader); }
+
+    // Record bulk loads and seeks into `node`. Pass NULL to disable instrumentation.
+    // If the underlying reader decodes from inner readers (e.g. bitpacked arrays), those get
+    // child nodes that count the bytes read from storage, while `node` counts only the
+    // decoded entries
+    void instrument(std::shared_ptr<InstrumentNode> node) {
+        instrumentation = std::move(node);
+        decoding = instrumentation && reader && reader->instrument(*instrumentation);
+    }
+
+    // Read straight from the source array rather than copying through the internal buffer,
+    // if the underlying reader holds all its data in contiguous memory. Returns true if
+    // zero-copy mode was enabled. data() then points into the source array, so only enable
+    // this for readers whose loaded data is never modified in place (e.g. the compressed
+    // streams inside bitpacked readers)
+    bool enableZeroCopy() {
+        if (direct != NULL) return true;
+        if (!reader) return false;
+        const T *src = reader->contiguousData();
+        if (src == NULL) return false;
+        // Keep the current read position and any available data
+        idx = pos - (loaded - idx);
+        direct = src;
+        return true;
+    }
+
+    inline bool zeroCopy() const { return direct != NULL; }
+
     // Pointer to data in buffer start
-    inline T *data() { return buffer.data() + idx; }
+    inline T *data() {
+        if (direct != NULL) return const_cast<T *>(direct) + idx;
+        return buffer.data() + idx;
+    }
     // Number of available entries in data() buffer
     inline uint64_t capacity() const { return available; };
+    // Size of the internal buffer, and the amount of data loaded by default on each refill
+    inline uint64_t maxCapacity() const { return buffer.size(); }
+    inline uint64_t readSize() const { return read_size; }
 
     // Try to ensure there are at least `new_capacity` items available to read
     // (i.e. capacity() > new_capacity). Return false if there was not enough
@@ -173,6 +236,16 @@ template <class T> class NumReader {
     inline bool requestCapacity(uint64_t new_capacity) {
         if (new_capacity > read_size) return false;
 
+        if (direct != NULL) {
+            // Zero-copy: just widen the window over the source array
+            if (available < new_capacity) {
+                uint64_t prev = available;
+                available = std::min(read_size, total_size - idx);
+                if (available > prev) recordLoad(available - prev);
+            }
+            return available >= new_capacity;
+        }
+
         if (loaded - idx >= new_capacity) {
             // We already have the data loaded, so just expand capacity as required
             // We want -- if available >= new_capacity no change
@@ -187,6 +260,7 @@ template <class T> class NumReader {
             idx = 0;
         }
 
+        InstrumentTimer timer(instrumentation.get());
         while (loaded < read_size) {
             uint64_t load_size = std::min((uint64_t)buffer.size() - loaded, total_size - pos);
             if (load_size == 0) break;
@@ -194,6 +268,7 @@ template <class T> class NumReader {
             uint64_t newly_loaded = reader->load(buffer.data() + loaded, load_size);
             loaded += newly_loaded;
             pos += newly_loaded;
+            recordLoad(newly_loaded);
         }
         available = std::min(loaded, read_size);
         return available >= new_capacity;
@@ -223,6 +298,12 @@ template <class T> class NumReader {
         // the data buffer but expected clean data after seek+load. Look at file
         // history to see the old version
         new_pos = std::min(new_pos, total_size);
+        if (instrumentation) instrumentation->seeks += 1;
+        if (direct != NULL) {
+            idx = new_pos;
+            available = 0;
+            return;
+        }
         reader->seek(new_pos);
         pos = new_pos;
         loaded = 0;
@@ -230,6 +311,30 @@ template <class T> class NumReader {
         available = 0;
     }
 
+    // Load exactly the `count` values starting at `start`, making them available at data().
+    // Unlike seek() + requestCapacity(), this decodes no further than the requested range,
+    // which lets callers that only need scattered values skip the blocks in between.
+    // count must be no larger than the buffer size
+    inline void loadRange(uint64_t start, uint64_t count) {
+        if (count > buffer.size())
+            throw std::invalid_argument("loadRange: count can't be larger than buffer size");
+        if (start + count > total_size)
+            throw std::runtime_error("loadRange: requested range extends past end of data");
+        seek(start);
+        if (direct != NULL) {
+            available = count;
+            return;
+        }
+        InstrumentTimer timer(instrumentation.get());
+        while (loaded < count) {
+            uint64_t newly_loaded = reader->load(buffer.data() + loaded, count - loaded);
+            loaded += newly_loaded;
+            pos += newly_loaded;
+            recordLoad(newly_loaded);
+        }
+        available = loaded;
+    }
+
     // Read one element of the input stream, throwing an exception if there are
     // no more entries to read
     inline T read_one() {
@@ -267,6 +372,7 @@ template <typename T> class ConstNumReader : public BulkNumReader<T> {
         pos += i;
         return i;
     }
+    const T *contiguousData() const override { return data.data(); }
     static NumReader<T> create(std::vector<T> data) {
         return NumReader<T>(std::make_unique<ConstNumReader<T>>(data), data.size(), data.size());
     }
@@ -420,6 +526,9 @@ class ReaderBuilder {
 
     virtual std::unique_ptr<StringReader> openStringReader(std::string name) = 0;
     virtual std::string readVersion() = 0;
+
+    // Return the names of all arrays (numeric or string) available to open
+    virtual std::vector<std::string> listArrays() = 0;
 };
 
 } // end namespace BPCells
\ No newline at end of file
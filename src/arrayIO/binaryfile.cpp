@@ -133,6 +133,15 @@ std::string FileReaderBuilder::readVersion() {
     return version[0];
 }
 
+std::vector<std::string> FileReaderBuilder::listArrays() {
+    std::vector<std::string> ret;
+    for (auto &entry : std_fs::directory_iterator(dir)) {
+        std::string name = entry.path().filename().string();
+        if (name != "version") ret.push_back(name);
+    }
+    return ret;
+}
+
 std::vector<std::string> readLines(std_fs::path path) {
     std::ifstream in;
     std::string line;
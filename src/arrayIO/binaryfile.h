@@ -178,6 +178,7 @@ class FileReaderBuilder final : public ReaderBuilder {
     DoubleReader openDoubleReader(std::string name) override;
     std::unique_ptr<StringReader> openStringReader(std::string name) override;
     std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
 };
 
 } // end namespace BPCells
\ No newline at end of file
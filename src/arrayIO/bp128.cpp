@@ -1,5 +1,7 @@
 #include "bp128.h"
 
+#include <algorithm>
+
 #include "../bitpacking/bp128.h"
 
 namespace BPCells {
@@ -14,7 +16,12 @@ BP128UIntReader::BP128UIntReader(
     , count(count)
     , prev_idx(this->idx.read_one())
     , prev_offset_boundary(this->idx_offsets.read_one())
-    , next_offset_boundary(this->idx_offsets.read_one()) {}
+    , next_offset_boundary(this->idx_offsets.read_one()) {
+    // Packed streams are only ever read, so in-memory arrays needn't be copied
+    this->data.enableZeroCopy();
+    this->idx.enableZeroCopy();
+    this->idx_offsets.enableZeroCopy();
+}
 
 uint64_t BP128UIntReader::size() const { return count; }
 
@@ -67,6 +74,13 @@ uint64_t BP128UIntReader::load(uint32_t *out, uint64_t count) {
     return i;
 }
 
+bool BP128UIntReader::instrument(InstrumentNode &node) {
+    data.instrument(node.addChild("data"));
+    idx.instrument(node.addChild("idx"));
+    idx_offsets.instrument(node.addChild("idx_offsets"));
+    return true;
+}
+
 void BP128UIntReader::setOffsetIncrement(uint64_t val) {
     OFFSET_INCREMENT = val;
 }
@@ -137,12 +151,16 @@ void BP128UIntWriter::setOffsetIncrement(uint64_t val) {
 }
 
 void BP128UIntWriter::pack128(uint32_t *in) {
-    pos += 128;
     uint32_t bits = this->bits(in);
     data.ensureCapacity(bits * 4);
     pack128(in, data.data(), bits);
     data.advance(bits * 4);
-    cur_idx += bits * 4;
+    finishChunk(bits * 4);
+}
+
+void BP128UIntWriter::finishChunk(uint32_t words) {
+    pos += 128;
+    cur_idx += words;
     if (cur_idx >= OFFSET_INCREMENT) {
         cur_idx -= OFFSET_INCREMENT;
         idx_offsets.write_one(pos / 128);
@@ -150,6 +168,33 @@ void BP128UIntWriter::pack128(uint32_t *in) {
     idx.write_one(cur_idx);
 }
 
+void BP128UIntWriter::appendPacked(
+    const uint32_t *in,
+    const uint32_t *chunk_idx,
+    uint64_t n_chunks,
+    const std::vector<const uint32_t *> &side
+) {
+    if (buf_pos != 0) {
+        throw std::logic_error("BP128UIntWriter: appendPacked requires a multiple of 128 values");
+    }
+    appendSideStreams(side, n_chunks);
+    for (uint64_t i = 0; i < n_chunks; i++) {
+        // Differences stay correct across the 32-bit wraparound of idx values
+        uint32_t words = chunk_idx[i + 1] - chunk_idx[i];
+        data.ensureCapacity(words);
+        std::memmove(data.data(), in, words * sizeof(uint32_t));
+        data.advance(words);
+        in += words;
+        finishChunk(words);
+    }
+}
+
+void BP128UIntWriter::appendSideStreams(
+    const std::vector<const uint32_t *> &side, uint64_t /*n_chunks*/
+) {
+    if (!side.empty()) throw std::invalid_argument("BP128UIntWriter: unexpected side streams");
+}
+
 void BP128UIntWriter::pack128(uint32_t *in, uint32_t *out, uint32_t bits) {
     simdpack(in, out, bits);
 }
@@ -166,10 +211,18 @@ BP128_D1_UIntReader::BP128_D1_UIntReader(
     uint64_t count
 )
     : BP128UIntReader(std::move(data), std::move(idx), std::move(idx_offsets), count)
-    , starts(std::move(starts)) {}
+    , starts(std::move(starts)) {
+    this->starts.enableZeroCopy();
+}
 
 void BP128_D1_UIntReader::seekLoaders() { starts.seek(pos / 128); BP128UIntReader::seekLoaders(); }
 
+bool BP128_D1_UIntReader::instrument(InstrumentNode &node) {
+    BP128UIntReader::instrument(node);
+    starts.instrument(node.addChild("starts"));
+    return true;
+}
+
 void BP128_D1_UIntReader::load128(uint32_t *in, uint32_t *out, uint32_t bits) {
     uint32_t start = starts.read_one();
     simdunpackd1(start, in, out, bits);
@@ -191,6 +244,15 @@ uint32_t BP128_D1_UIntWriter::bits(const uint32_t *in) const {
     return simdmaxbitsd1(in[0], in);
 }
 
+void BP128_D1_UIntWriter::appendSideStreams(
+    const std::vector<const uint32_t *> &side, uint64_t n_chunks
+) {
+    if (side.size() != 1) throw std::invalid_argument("BP128_D1_UIntWriter: expected starts");
+    for (uint64_t i = 0; i < n_chunks; i++) {
+        starts.write_one(side[0][i]);
+    }
+}
+
 void BP128_D1_UIntWriter::finalize() {
     BP128UIntWriter::finalize();
     starts.finalize();
@@ -202,10 +264,18 @@ BP128_D1Z_UIntReader::BP128_D1Z_UIntReader(
     UIntReader &&data, UIntReader &&idx, ULongReader &&idx_offsets, UIntReader &&starts, uint64_t count
 )
     : BP128UIntReader(std::move(data), std::move(idx), std::move(idx_offsets), count)
-    , starts(std::move(starts)) {}
+    , starts(std::move(starts)) {
+    this->starts.enableZeroCopy();
+}
 
 void BP128_D1Z_UIntReader::seekLoaders() { starts.seek(pos / 128); BP128UIntReader::seekLoaders();}
 
+bool BP128_D1Z_UIntReader::instrument(InstrumentNode &node) {
+    BP128UIntReader::instrument(node);
+    starts.instrument(node.addChild("starts"));
+    return true;
+}
+
 void BP128_D1Z_UIntReader::load128(uint32_t *in, uint32_t *out, uint32_t bits) {
     uint32_t start = starts.read_one();
     simdunpackd1z(start, in, out, bits);
@@ -227,6 +297,15 @@ uint32_t BP128_D1Z_UIntWriter::bits(const uint32_t *in) const {
     return simdmaxbitsd1z(in[0], in);
 }
 
+void BP128_D1Z_UIntWriter::appendSideStreams(
+    const std::vector<const uint32_t *> &side, uint64_t n_chunks
+) {
+    if (side.size() != 1) throw std::invalid_argument("BP128_D1Z_UIntWriter: expected starts");
+    for (uint64_t i = 0; i < n_chunks; i++) {
+        starts.write_one(side[0][i]);
+    }
+}
+
 void BP128_D1Z_UIntWriter::finalize() {
     BP128UIntWriter::finalize();
     starts.finalize();
@@ -256,4 +335,361 @@ uint32_t BP128_FOR_UIntWriter::bits(const uint32_t *in) const {
     return simdmaxbitsFOR(1, in);
 }
 
+// ######################## BP128 (Adaptive) #########################################
+
+namespace {
+// Limits on the dictionary and run-length codecs. Beyond these sizes the plain bitpacked
+// codecs are nearly always smaller, and the limits keep encoder scans cheap
+constexpr uint32_t ADAPTIVE_MAX_DICT = 16;
+constexpr uint32_t ADAPTIVE_MAX_RUNS = 64;
+
+// Number of 4-word units needed to hold `words` words
+inline uint32_t words_to_units(uint32_t words) { return (words + 3) / 4; }
+
+inline uint32_t count_trailing_zeros(uint32_t v) {
+#ifdef _MSC_VER
+    unsigned long answer;
+    _BitScanForward(&answer, v);
+    return answer;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// Elias-Fano encoding for a block of 128 integers made of a few sorted runs, as found in
+// the row indices of very sparse matrices (each run is one column).
+// Values are first mapped to a non-decreasing sequence y[i] = r[i] * U + (x[i] - min), where
+// U = max - min + 1 and r[i] counts the descents in x before index i. Each y[i] is then split
+// into `low_bits` low bits, bitpacked as in BP128, and the remaining high bits, stored as a
+// unary-coded bitvector where y[i] sets bit (y[i] >> low_bits) + i.
+// Since each block is its own partition, seeks go through idx like the other BP128 codecs.
+// Layout (in 32-bit words):
+//   [U, low_bits, high_words, 0]
+//   [4 * low_bits words of bitpacked low bits]
+//   [high_words words of high bitvector, zero-padded to a multiple of 4 words]
+constexpr uint32_t EF_HEADER_WORDS = 4;
+
+inline uint32_t ef_high_words(uint64_t y_max, uint32_t low_bits) {
+    return (uint32_t)((128 + (y_max >> low_bits) + 31) / 32);
+}
+
+// Choose the low bit width giving the smallest block. The textbook choice of
+// floor(log2(y_max / 128)) is within one bit of optimal, but rounding to whole 4-word units
+// can make a neighboring width smaller
+inline uint32_t ef_low_bits(uint64_t y_max) {
+    uint64_t avg_gap = (y_max + 1) / 128;
+    uint32_t guess = 0;
+    while (guess < 32 && (avg_gap >> (guess + 1)) != 0)
+        guess++;
+    uint32_t best = guess;
+    for (uint32_t low_bits = guess == 0 ? 0 : guess - 1; low_bits <= std::min(guess + 1, 32u);
+         low_bits++) {
+        if (low_bits + words_to_units(ef_high_words(y_max, low_bits)) <
+            best + words_to_units(ef_high_words(y_max, best)))
+            best = low_bits;
+    }
+    return best;
+}
+
+// Size of an Elias-Fano block in 4-word units
+uint32_t ef_units(uint32_t min, uint32_t max, uint32_t descents, uint32_t last) {
+    uint64_t universe = (uint64_t)max - min + 1;
+    uint64_t y_max = descents * universe + (last - min);
+    uint32_t low_bits = ef_low_bits(y_max);
+    return 1 + low_bits + words_to_units(ef_high_words(y_max, low_bits));
+}
+
+void ef_pack(const uint32_t *in, uint32_t min, uint32_t *out, uint32_t units) {
+    uint32_t max = *std::max_element(in, in + 128);
+    uint64_t universe = (uint64_t)max - min + 1;
+    uint64_t y[128];
+    uint64_t base = 0;
+    for (uint32_t i = 0; i < 128; i++) {
+        if (i > 0 && in[i] < in[i - 1]) base += universe;
+        y[i] = base + (in[i] - min);
+    }
+    uint32_t low_bits = ef_low_bits(y[127]);
+    uint32_t high_words = ef_high_words(y[127], low_bits);
+
+    std::fill(out, out + units * 4, 0);
+    out[0] = (uint32_t)universe; // Wraps to 0 only if the block spans the full 32-bit range
+    out[1] = low_bits;
+    out[2] = high_words;
+
+    uint32_t lows[128];
+    uint64_t low_mask = (1ULL << low_bits) - 1;
+    for (uint32_t i = 0; i < 128; i++)
+        lows[i] = (uint32_t)(y[i] & low_mask);
+    if (low_bits > 0) simdpack(lows, out + EF_HEADER_WORDS, low_bits);
+
+    uint32_t *high = out + EF_HEADER_WORDS + 4 * low_bits;
+    for (uint32_t i = 0; i < 128; i++) {
+        uint64_t bit = (y[i] >> low_bits) + i;
+        high[bit / 32] |= 1U << (bit % 32);
+    }
+}
+
+void ef_unpack(const uint32_t *in, uint32_t min, uint32_t *out) {
+    uint64_t universe = in[0] == 0 ? (1ULL << 32) : in[0];
+    uint32_t low_bits = in[1];
+    uint32_t high_words = in[2];
+    if (low_bits > 32)
+        throw std::runtime_error("BP128_Adaptive_UIntReader: invalid Elias-Fano block");
+
+    // Low bits decode with the regular SIMD unpacker
+    simdunpack(in + EF_HEADER_WORDS, out, low_bits);
+
+    // High bits: the i-th set bit at position p gives a high part of p - i
+    const uint32_t *high = in + EF_HEADER_WORDS + 4 * low_bits;
+    uint64_t run_start = 0, run_end = universe;
+    uint32_t i = 0;
+    for (uint32_t w = 0; w < high_words && i < 128; w++) {
+        uint32_t word = high[w];
+        while (word != 0 && i < 128) {
+            uint64_t pos = (uint64_t)w * 32 + count_trailing_zeros(word);
+            uint64_t y = ((pos - i) << low_bits) | out[i];
+            while (y >= run_end) {
+                run_start = run_end;
+                run_end += universe;
+            }
+            out[i] = min + (uint32_t)(y - run_start);
+            word &= word - 1;
+            i++;
+        }
+    }
+    if (i != 128) throw std::runtime_error("BP128_Adaptive_UIntReader: invalid Elias-Fano block");
+}
+} // namespace
+
+BP128_Adaptive_UIntReader::BP128_Adaptive_UIntReader(
+    UIntReader &&data,
+    UIntReader &&idx,
+    ULongReader &&idx_offsets,
+    UIntReader &&tags,
+    UIntReader &&params,
+    uint64_t count
+)
+    : BP128UIntReader(std::move(data), std::move(idx), std::move(idx_offsets), count)
+    , tags(std::move(tags))
+    , params(std::move(params)) {
+    this->tags.enableZeroCopy();
+    this->params.enableZeroCopy();
+}
+
+void BP128_Adaptive_UIntReader::seekLoaders() {
+    tags.seek(pos / 128);
+    params.seek(pos / 128);
+    BP128UIntReader::seekLoaders();
+}
+
+bool BP128_Adaptive_UIntReader::instrument(InstrumentNode &node) {
+    BP128UIntReader::instrument(node);
+    tags.instrument(node.addChild("tags"));
+    params.instrument(node.addChild("params"));
+    return true;
+}
+
+void BP128_Adaptive_UIntReader::load128(uint32_t *in, uint32_t *out, uint32_t bits) {
+    uint32_t tag = tags.read_one();
+    uint32_t param = params.read_one();
+    uint32_t count = tag >> 8;
+    switch ((BP128Codec)(tag & 0xff)) {
+    case BP128Codec::Constant:
+        std::fill(out, out + 128, param);
+        break;
+    case BP128Codec::FOR:
+        simdunpackFOR(param, in, out, bits);
+        break;
+    case BP128Codec::D1:
+        simdunpackd1(param, in, out, bits);
+        break;
+    case BP128Codec::D1Z:
+        simdunpackd1z(param, in, out, bits);
+        break;
+    case BP128Codec::Dict: {
+        uint32_t dict_units = words_to_units(count);
+        if (count > ADAPTIVE_MAX_DICT || dict_units > bits)
+            throw std::runtime_error("BP128_Adaptive_UIntReader: invalid dictionary block");
+        uint32_t dict[ADAPTIVE_MAX_DICT] = {0};
+        std::memcpy(dict, in, count * sizeof(uint32_t));
+        simdunpack(in + dict_units * 4, out, bits - dict_units);
+        for (uint32_t i = 0; i < 128; i++) {
+            out[i] = dict[out[i] & (ADAPTIVE_MAX_DICT - 1)];
+        }
+        break;
+    }
+    case BP128Codec::RLE: {
+        if (words_to_units(2 * count) != bits)
+            throw std::runtime_error("BP128_Adaptive_UIntReader: invalid run-length block");
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t len = in[count + i];
+            if (len > 128 - written)
+                throw std::runtime_error("BP128_Adaptive_UIntReader: invalid run-length block");
+            std::fill(out + written, out + written + len, in[i]);
+            written += len;
+        }
+        break;
+    }
+    case BP128Codec::EliasFano:
+        ef_unpack(in, param, out);
+        break;
+    default:
+        throw std::runtime_error("BP128_Adaptive_UIntReader: unrecognized block codec");
+    }
+}
+
+BP128_Adaptive_UIntWriter::BP128_Adaptive_UIntWriter(
+    UIntWriter &&data,
+    UIntWriter &&idx,
+    ULongWriter &&idx_offsets,
+    UIntWriter &&tags,
+    UIntWriter &&params
+)
+    : BP128UIntWriter(std::move(data), std::move(idx), std::move(idx_offsets))
+    , tags(std::move(tags))
+    , params(std::move(params)) {}
+
+uint32_t BP128_Adaptive_UIntWriter::bits(const uint32_t *in) const {
+    // Count runs and distinct values in a single pass, giving up on each once past its limit
+    uint32_t dict[ADAPTIVE_MAX_DICT + 1];
+    uint32_t dict_size = 0;
+    uint32_t runs = 1, descents = 0;
+    uint32_t max_val = in[0];
+    for (uint32_t i = 0; i < 128; i++) {
+        if (i > 0 && in[i] != in[i - 1]) runs += 1;
+        if (i > 0 && in[i] < in[i - 1]) descents += 1;
+        max_val = std::max(max_val, in[i]);
+        if (dict_size <= ADAPTIVE_MAX_DICT &&
+            std::find(dict, dict + dict_size, in[i]) == dict + dict_size) {
+            dict[dict_size++] = in[i];
+        }
+    }
+
+    if (runs == 1) {
+        cur_codec = BP128Codec::Constant;
+        cur_param = in[0];
+        cur_count = 0;
+        return 0;
+    }
+
+    // Candidates are checked in order of decode speed, so ties go to the faster codec
+    uint32_t best_units, min_val;
+    simdmaxbitsFORwithmin(in, best_units, min_val);
+    cur_codec = BP128Codec::FOR;
+    cur_param = min_val;
+    cur_count = 0;
+
+    uint32_t d1_units = simdmaxbitsd1(in[0], in);
+    if (d1_units < best_units) {
+        best_units = d1_units;
+        cur_codec = BP128Codec::D1;
+        cur_param = in[0];
+    }
+    uint32_t d1z_units = simdmaxbitsd1z(in[0], in);
+    if (d1z_units < best_units) {
+        best_units = d1z_units;
+        cur_codec = BP128Codec::D1Z;
+        cur_param = in[0];
+    }
+    if (dict_size <= ADAPTIVE_MAX_DICT) {
+        uint32_t dict_units = words_to_units(dict_size) + BPCells::bits(dict_size - 1);
+        if (dict_units < best_units) {
+            best_units = dict_units;
+            cur_codec = BP128Codec::Dict;
+            cur_param = 0;
+            cur_count = dict_size;
+        }
+    }
+    if (runs <= ADAPTIVE_MAX_RUNS) {
+        uint32_t rle_units = words_to_units(2 * runs);
+        if (rle_units < best_units) {
+            best_units = rle_units;
+            cur_codec = BP128Codec::RLE;
+            cur_param = 0;
+            cur_count = runs;
+        }
+    }
+    uint32_t ef = ef_units(min_val, max_val, descents, in[127]);
+    if (ef < best_units) {
+        best_units = ef;
+        cur_codec = BP128Codec::EliasFano;
+        cur_param = min_val;
+        cur_count = 0;
+    }
+    return best_units;
+}
+
+void BP128_Adaptive_UIntWriter::pack128(uint32_t *in, uint32_t *out, uint32_t bits) {
+    tags.write_one((uint32_t)cur_codec | (cur_count << 8));
+    params.write_one(cur_param);
+    switch (cur_codec) {
+    case BP128Codec::Constant:
+        break;
+    case BP128Codec::FOR:
+        simdpackFOR(cur_param, in, out, bits);
+        break;
+    case BP128Codec::D1:
+        simdpackd1(cur_param, in, out, bits);
+        break;
+    case BP128Codec::D1Z:
+        simdpackd1z(cur_param, in, out, bits);
+        break;
+    case BP128Codec::Dict: {
+        // Sorted dictionary, followed by the bitpacked index of each value in the dictionary
+        uint32_t dict_units = words_to_units(cur_count);
+        uint32_t *dict = out;
+        std::fill(dict, dict + dict_units * 4, 0);
+        uint32_t dict_size = 0;
+        for (uint32_t i = 0; i < 128; i++) {
+            if (std::find(dict, dict + dict_size, in[i]) == dict + dict_size)
+                dict[dict_size++] = in[i];
+        }
+        std::sort(dict, dict + dict_size);
+        uint32_t indices[128];
+        for (uint32_t i = 0; i < 128; i++) {
+            indices[i] = std::lower_bound(dict, dict + dict_size, in[i]) - dict;
+        }
+        simdpack(indices, out + dict_units * 4, bits - dict_units);
+        break;
+    }
+    case BP128Codec::RLE: {
+        // Run values, then run lengths, then zero padding
+        std::fill(out, out + bits * 4, 0);
+        uint32_t run = 0;
+        out[0] = in[0];
+        out[cur_count] = 1;
+        for (uint32_t i = 1; i < 128; i++) {
+            if (in[i] != in[i - 1]) {
+                run += 1;
+                out[run] = in[i];
+            }
+            out[cur_count + run] += 1;
+        }
+        break;
+    }
+    case BP128Codec::EliasFano:
+        ef_pack(in, cur_param, out, bits);
+        break;
+    }
+}
+
+void BP128_Adaptive_UIntWriter::appendSideStreams(
+    const std::vector<const uint32_t *> &side, uint64_t n_chunks
+) {
+    if (side.size() != 2) {
+        throw std::invalid_argument("BP128_Adaptive_UIntWriter: expected tags and params");
+    }
+    for (uint64_t i = 0; i < n_chunks; i++) {
+        tags.write_one(side[0][i]);
+        params.write_one(side[1][i]);
+    }
+}
+
+void BP128_Adaptive_UIntWriter::finalize() {
+    BP128UIntWriter::finalize();
+    tags.finalize();
+    params.finalize();
+}
+
 } // end namespace BPCells
@@ -44,6 +44,10 @@ class BP128UIntReader : public UIntBulkReader {
     // that a load does not try to read past size() total elements
     uint64_t load(uint32_t *out, uint64_t count) final override;
 
+    // Record I/O statistics for the packed data, idx, and idx_offsets arrays (plus any
+    // side streams) as children of `node`
+    bool instrument(InstrumentNode &node) override;
+
     // For testing purposes only -- set the offset multiple so it can be smaller
     // than UINT32_MAX
     static void setOffsetIncrement(uint64_t val);
@@ -70,10 +74,24 @@ class BP128UIntWriter : public UIntBulkWriter {
     virtual void pack128(uint32_t *in, uint32_t *out, uint32_t bits);
     // Return the number of bits needed to pack new input data
     virtual uint32_t bits(const uint32_t *in) const;
+    // Write the per-chunk side streams for appendPacked (starts, tags, params, etc.)
+    virtual void appendSideStreams(const std::vector<const uint32_t *> &side, uint64_t n_chunks);
 
   public:
     BP128UIntWriter(UIntWriter &&data, UIntWriter &&idx, ULongWriter &&idx_offsets);
 
+    // Append `n_chunks` chunks that were packed by another writer of the same type, e.g. into
+    // memory on a worker thread, without re-packing them. `chunk_idx` is that writer's idx
+    // array (n_chunks + 1 word offsets into `data`), and `side` holds its per-chunk side
+    // streams in constructor order (starts for D1/D1Z; tags, params for Adaptive).
+    // Must be called after a multiple of 128 values have been written
+    void appendPacked(
+        const uint32_t *data,
+        const uint32_t *chunk_idx,
+        uint64_t n_chunks,
+        const std::vector<const uint32_t *> &side = {}
+    );
+
     // Write up to `count` integers from `in`, returning the actual number written.
     // Will always write >0, otherwise throwing an exception for an error
     // Note: The writer is allowed to modify the input data, so it might be
@@ -88,6 +106,8 @@ class BP128UIntWriter : public UIntBulkWriter {
 
   private:
     void pack128(uint32_t *in);
+    // Record a chunk of `words` packed words that was just written to data
+    void finishChunk(uint32_t words);
 
     static inline uint64_t OFFSET_INCREMENT = UINT32_MAX + 1ULL;
 };
@@ -135,6 +155,8 @@ class BP128_D1_UIntReader final : public BP128UIntReader {
         UIntReader &&starts,
         uint64_t count
     );
+
+    bool instrument(InstrumentNode &node) override;
 };
 
 class BP128_D1_UIntWriter final : public BP128UIntWriter {
@@ -145,6 +167,7 @@ class BP128_D1_UIntWriter final : public BP128UIntWriter {
     void pack128(uint32_t *in, uint32_t *out, uint32_t bits) override;
     // Return the number of bits needed to pack new input data
     uint32_t bits(const uint32_t *in) const override;
+    void appendSideStreams(const std::vector<const uint32_t *> &side, uint64_t n_chunks) override;
 
   public:
     BP128_D1_UIntWriter(
@@ -171,6 +194,8 @@ class BP128_D1Z_UIntReader final : public BP128UIntReader {
         UIntReader &&starts,
         uint64_t count
     );
+
+    bool instrument(InstrumentNode &node) override;
 };
 
 class BP128_D1Z_UIntWriter final : public BP128UIntWriter {
@@ -181,6 +206,7 @@ class BP128_D1Z_UIntWriter final : public BP128UIntWriter {
     void pack128(uint32_t *in, uint32_t *out, uint32_t bits) override;
     // Return the number of bits needed to pack new input data
     uint32_t bits(const uint32_t *in) const override;
+    void appendSideStreams(const std::vector<const uint32_t *> &side, uint64_t n_chunks) override;
 
   public:
     BP128_D1Z_UIntWriter(
@@ -210,4 +236,71 @@ class BP128_FOR_UIntWriter final : public BP128UIntWriter {
     BP128_FOR_UIntWriter(UIntWriter &&data, UIntWriter &&idx, ULongWriter &&idx_offsets);
 };
 
+// ######################## BP128 (Adaptive) ####################################
+// Chooses the encoding of each 128-value block independently at write time, picking
+// whichever codec gives the smallest output. Each block records its codec in a `tags`
+// stream, and a codec-specific 32-bit parameter (frame of reference, start value, or
+// constant) in a `params` stream, both indexed by block like `idx`.
+// Block data is always a multiple of 4 words, so the base class can keep deriving block
+// sizes from `idx`. Decoding dispatches once per block, keeping the SIMD loops branch-free.
+//
+// Tag layout: bits 0-7 hold the BP128Codec, bits 8-31 hold a codec-specific count
+// (number of dictionary entries for Dict, number of runs for RLE)
+enum class BP128Codec : uint32_t {
+    Constant = 0, // All 128 values equal param. No data words
+    FOR = 1,      // Bitpacked with param subtracted (param is the block minimum)
+    D1 = 2,       // Bitpacked differences, starting from param
+    D1Z = 3,      // Bitpacked zigzag-encoded differences, starting from param
+    Dict = 4,     // Dictionary (padded to a multiple of 4 words), then bitpacked dictionary indices
+    RLE = 5,      // Run values then run lengths, padded to a multiple of 4 words
+    EliasFano = 6 // Partitioned Elias-Fano over sorted runs, relative to param (see bp128.cpp)
+};
+
+class BP128_Adaptive_UIntReader final : public BP128UIntReader {
+  protected:
+    UIntReader tags, params;
+
+    void load128(uint32_t *in, uint32_t *out, uint32_t bits) override;
+    void seekLoaders() override;
+
+  public:
+    BP128_Adaptive_UIntReader(
+        UIntReader &&data,
+        UIntReader &&idx,
+        ULongReader &&idx_offsets,
+        UIntReader &&tags,
+        UIntReader &&params,
+        uint64_t count
+    );
+
+    bool instrument(InstrumentNode &node) override;
+};
+
+class BP128_Adaptive_UIntWriter final : public BP128UIntWriter {
+  protected:
+    UIntWriter tags, params;
+
+    // Encoding chosen by bits() for the current block, consumed by pack128()
+    mutable BP128Codec cur_codec;
+    mutable uint32_t cur_param, cur_count;
+
+    // Pack 128 values using the codec chosen in the preceding call to bits()
+    void pack128(uint32_t *in, uint32_t *out, uint32_t bits) override;
+    // Choose the smallest codec for the block, returning its size in units of 4 words
+    // (which matches the bit width for the plain bitpacked codecs)
+    uint32_t bits(const uint32_t *in) const override;
+    void appendSideStreams(const std::vector<const uint32_t *> &side, uint64_t n_chunks) override;
+
+  public:
+    BP128_Adaptive_UIntWriter(
+        UIntWriter &&data,
+        UIntWriter &&idx,
+        ULongWriter &&idx_offsets,
+        UIntWriter &&tags,
+        UIntWriter &&params
+    );
+
+    void finalize() override;
+};
+
 } // end namespace BPCells
\ No newline at end of file
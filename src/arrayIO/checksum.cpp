@@ -0,0 +1,213 @@
+#include "checksum.h"
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define BPCELLS_CRC32C_SSE42
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define BPCELLS_CRC32C_ARM
+#endif
+
+namespace BPCells {
+
+namespace {
+
+#if !defined(BPCELLS_CRC32C_SSE42) && !defined(BPCELLS_CRC32C_ARM)
+// Slicing-by-8 tables for the reflected Castagnoli polynomial
+struct CRC32CTables {
+    uint32_t t[8][256];
+    CRC32CTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+        }
+    }
+};
+const CRC32CTables crc_tables;
+#endif
+
+template <class T>
+void verifyArray(
+    NumReader<T> &&data,
+    UIntReader &crc,
+    uint64_t chunk_size,
+    const std::string &name,
+    ChecksumReport &report,
+    const ExecutionContext &ctx
+) {
+    uint64_t n_chunks = (data.size() + chunk_size - 1) / chunk_size;
+    if (crc.size() != n_chunks + checksum_header_size) {
+        report.failures.push_back(name + ": checksum array does not match data length");
+        return;
+    }
+    report.arrays += 1;
+    for (uint64_t chunk = 0; chunk < n_chunks; chunk++) {
+        if (ctx.interrupted()) return;
+        uint64_t len = std::min(chunk_size, data.size() - chunk * chunk_size);
+        uint32_t c = 0;
+        uint64_t done = 0;
+        while (done < len) {
+            data.ensureCapacity(1);
+            uint64_t n = std::min(len - done, data.capacity());
+            c = crc32c(data.data(), n * sizeof(T), c);
+            data.advance(n);
+            done += n;
+        }
+        if (c != crc.read_one()) {
+            report.failures.push_back(name + ": CRC32C mismatch in chunk " + std::to_string(chunk));
+        }
+        report.chunks += 1;
+        report.bytes += len * sizeof(T);
+    }
+}
+
+} // namespace
+
+uint32_t crc32c(const void *data, uint64_t bytes, uint32_t crc) {
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+#if defined(BPCELLS_CRC32C_SSE42) || defined(BPCELLS_CRC32C_ARM)
+    for (; bytes >= 8; bytes -= 8, p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+#if defined(BPCELLS_CRC32C_SSE42) && defined(__x86_64__)
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+#elif defined(BPCELLS_CRC32C_SSE42)
+        crc = _mm_crc32_u32(crc, (uint32_t)word);
+        crc = _mm_crc32_u32(crc, (uint32_t)(word >> 32));
+#else
+        crc = __crc32cd(crc, word);
+#endif
+    }
+    for (; bytes > 0; bytes--, p++) {
+#if defined(BPCELLS_CRC32C_SSE42)
+        crc = _mm_crc32_u8(crc, *p);
+#else
+        crc = __crc32cb(crc, *p);
+#endif
+    }
+#else
+    const auto &t = crc_tables.t;
+    for (; bytes >= 8; bytes -= 8, p += 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+              t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+              t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; bytes > 0; bytes--, p++) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    }
+#endif
+    return ~crc;
+}
+
+bool crc32cHardwareAccelerated() {
+#if defined(BPCELLS_CRC32C_SSE42) || defined(BPCELLS_CRC32C_ARM)
+    return true;
+#else
+    return false;
+#endif
+}
+
+ChecksumWriterBuilder::ChecksumWriterBuilder(WriterBuilder &inner, uint64_t chunk_size)
+    : inner(inner)
+    , chunk_size(chunk_size) {
+    if (chunk_size == 0 || chunk_size > UINT32_MAX)
+        throw std::invalid_argument("ChecksumWriterBuilder: chunk_size must be in [1, 2^32)");
+}
+
+UIntWriter ChecksumWriterBuilder::createUIntWriter(std::string name) {
+    return wrap(inner.createUIntWriter(name), name);
+}
+ULongWriter ChecksumWriterBuilder::createULongWriter(std::string name) {
+    return wrap(inner.createULongWriter(name), name);
+}
+FloatWriter ChecksumWriterBuilder::createFloatWriter(std::string name) {
+    return wrap(inner.createFloatWriter(name), name);
+}
+DoubleWriter ChecksumWriterBuilder::createDoubleWriter(std::string name) {
+    return wrap(inner.createDoubleWriter(name), name);
+}
+std::unique_ptr<StringWriter> ChecksumWriterBuilder::createStringWriter(std::string name) {
+    return inner.createStringWriter(name);
+}
+void ChecksumWriterBuilder::writeVersion(std::string version) { inner.writeVersion(version); }
+void ChecksumWriterBuilder::deleteWriter(std::string name) {
+    inner.deleteWriter(name);
+    inner.deleteWriter(checksumArrayName(name));
+}
+
+ChecksumReaderBuilder::ChecksumReaderBuilder(ReaderBuilder &inner) : inner(inner) {
+    std::vector<std::string> names = inner.listArrays();
+    std::set<std::string> all(names.begin(), names.end());
+    for (const auto &name : names) {
+        if (all.count(checksumArrayName(name))) checksummed.insert(name);
+    }
+}
+
+UIntReader ChecksumReaderBuilder::openUIntReader(std::string name) {
+    return wrap(inner.openUIntReader(name), name);
+}
+ULongReader ChecksumReaderBuilder::openULongReader(std::string name) {
+    return wrap(inner.openULongReader(name), name);
+}
+FloatReader ChecksumReaderBuilder::openFloatReader(std::string name) {
+    return wrap(inner.openFloatReader(name), name);
+}
+DoubleReader ChecksumReaderBuilder::openDoubleReader(std::string name) {
+    return wrap(inner.openDoubleReader(name), name);
+}
+std::unique_ptr<StringReader> ChecksumReaderBuilder::openStringReader(std::string name) {
+    return inner.openStringReader(name);
+}
+std::string ChecksumReaderBuilder::readVersion() { return inner.readVersion(); }
+std::vector<std::string> ChecksumReaderBuilder::listArrays() { return inner.listArrays(); }
+
+ChecksumReport verifyChecksums(ReaderBuilder &rb, const ExecutionContext &ctx) {
+    ChecksumReport report;
+    std::vector<std::string> names = rb.listArrays();
+    std::set<std::string> all(names.begin(), names.end());
+    for (const auto &name : names) {
+        if (!all.count(checksumArrayName(name))) continue;
+        UIntReader crc = rb.openUIntReader(checksumArrayName(name));
+        if (crc.size() < checksum_header_size) {
+            report.failures.push_back(name + ": malformed checksum array");
+            continue;
+        }
+        uint64_t chunk_size = crc.read_one();
+        uint32_t type = crc.read_one();
+        if (chunk_size == 0) {
+            report.failures.push_back(name + ": malformed checksum array");
+            continue;
+        }
+        switch ((ChecksumType)type) {
+        case ChecksumType::UInt:
+            verifyArray(rb.openUIntReader(name), crc, chunk_size, name, report, ctx);
+            break;
+        case ChecksumType::ULong:
+            verifyArray(rb.openULongReader(name), crc, chunk_size, name, report, ctx);
+            break;
+        case ChecksumType::Float:
+            verifyArray(rb.openFloatReader(name), crc, chunk_size, name, report, ctx);
+            break;
+        case ChecksumType::Double:
+            verifyArray(rb.openDoubleReader(name), crc, chunk_size, name, report, ctx);
+            break;
+        default:
+            report.failures.push_back(name + ": unknown checksum element type");
+        }
+        if (ctx.interrupted()) break;
+    }
+    return report;
+}
+
+} // end namespace BPCells
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <set>
+#include <type_traits>
+
+#include "../utils/execution_context.h"
+#include "array_interfaces.h"
+
+// Optional CRC32C integrity checks for stored arrays.
+//
+// Each numeric array `name` can have a companion uint32 array `name_crc32c` holding
+// [chunk_size, type, crc(chunk 0), crc(chunk 1), ...], where chunk i covers elements
+// [i*chunk_size, (i+1)*chunk_size) of `name`, and type is a ChecksumType code.
+// Checksums cover the little-endian bytes of the stored values, so they are independent of
+// the storage backend (files, HDF5, memory).
+//
+// Writing: wrap any WriterBuilder in a ChecksumWriterBuilder before creating a
+//   matrix or fragment writer to add checksums to every numeric array.
+// Reading: ChecksumReaderBuilder verifies each chunk the first time it is loaded, throwing
+//   a ChecksumError on mismatch. Arrays without a companion checksum array pass through
+//   unchanged, so files written without checksums remain readable.
+// Verification: verifyChecksums() scans all checksummed arrays without decoding them.
+
+namespace BPCells {
+
+// Compute the CRC32C (Castagnoli) checksum of `bytes` bytes starting at `data`,
+// continuing from a previous checksum `crc`. Uses the SSE4.2 or ARMv8 CRC instructions
+// when compiled with support for them, and a table-driven fallback otherwise
+uint32_t crc32c(const void *data, uint64_t bytes, uint32_t crc = 0);
+
+// Returns true if crc32c() uses hardware CRC instructions in this build
+bool crc32cHardwareAccelerated();
+
+class ChecksumError : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+inline std::string checksumArrayName(const std::string &name) { return name + "_crc32c"; }
+
+// Element type of a checksummed array, so it can be verified without knowing the format
+enum class ChecksumType : uint32_t { UInt = 0, ULong = 1, Float = 2, Double = 3 };
+
+template <class T> constexpr ChecksumType checksumType() {
+    if constexpr (std::is_same_v<T, uint32_t>) return ChecksumType::UInt;
+    if constexpr (std::is_same_v<T, uint64_t>) return ChecksumType::ULong;
+    if constexpr (std::is_same_v<T, float>) return ChecksumType::Float;
+    if constexpr (std::is_same_v<T, double>) return ChecksumType::Double;
+}
+
+// Number of header entries in a checksum array before the per-chunk CRCs
+constexpr uint64_t checksum_header_size = 2;
+
+// Pass-through writer that records a CRC32C for every chunk_size elements written
+template <class T> class CRC32CNumWriter : public BulkNumWriter<T> {
+  private:
+    NumWriter<T> data;
+    UIntWriter crc;
+    uint64_t chunk_size;
+    uint64_t chunk_filled = 0;
+    uint32_t chunk_crc = 0;
+
+  public:
+    CRC32CNumWriter(NumWriter<T> &&data, UIntWriter &&crc, uint64_t chunk_size)
+        : data(std::move(data))
+        , crc(std::move(crc))
+        , chunk_size(chunk_size) {
+        this->crc.write_one(chunk_size);
+        this->crc.write_one((uint32_t)checksumType<T>());
+    }
+
+    uint64_t write(T *in, uint64_t count) override {
+        uint64_t written = 0;
+        while (written < count) {
+            uint64_t n = std::min(count - written, chunk_size - chunk_filled);
+            chunk_crc = crc32c(in + written, n * sizeof(T), chunk_crc);
+            chunk_filled += n;
+            if (chunk_filled == chunk_size) {
+                crc.write_one(chunk_crc);
+                chunk_crc = 0;
+                chunk_filled = 0;
+            }
+            // Copy through to the underlying writer in buffer-sized pieces
+            uint64_t copied = 0;
+            while (copied < n) {
+                data.ensureCapacity(1);
+                uint64_t m = std::min(n - copied, data.capacity());
+                std::memmove(data.data(), in + written + copied, m * sizeof(T));
+                data.advance(m);
+                copied += m;
+            }
+            written += n;
+        }
+        return count;
+    }
+
+    void finalize() override {
+        if (chunk_filled != 0) crc.write_one(chunk_crc);
+        data.finalize();
+        crc.finalize();
+    }
+};
+
+// Pass-through reader that verifies each chunk against its stored CRC32C when it is first
+// loaded. Whole chunks are read from the underlying array, so seeks within a verified chunk
+// don't touch storage again
+template <class T> class CRC32CNumReader : public BulkNumReader<T> {
+  private:
+    NumReader<T> data;
+    UIntReader crc;
+    std::string name;
+    uint64_t chunk_size;
+    std::vector<T> chunk;
+    uint64_t current_chunk = UINT64_MAX;
+    uint64_t pos = 0;
+
+    void loadChunk(uint64_t chunk_idx) {
+        uint64_t start = chunk_idx * chunk_size;
+        uint64_t len = std::min(chunk_size, data.size() - start);
+        data.seek(start);
+        uint64_t filled = 0;
+        while (filled < len) {
+            data.ensureCapacity(1);
+            uint64_t n = std::min(len - filled, data.capacity());
+            std::memmove(chunk.data() + filled, data.data(), n * sizeof(T));
+            data.advance(n);
+            filled += n;
+        }
+        crc.seek(chunk_idx + checksum_header_size);
+        uint32_t expected = crc.read_one();
+        if (crc32c(chunk.data(), len * sizeof(T)) != expected) {
+            current_chunk = UINT64_MAX;
+            throw ChecksumError(
+                std::string("CRC32C mismatch in array \"") + name + "\", chunk " +
+                std::to_string(chunk_idx) + " (elements " + std::to_string(start) + "-" +
+                std::to_string(start + len) + ")"
+            );
+        }
+        current_chunk = chunk_idx;
+    }
+
+  public:
+    CRC32CNumReader(NumReader<T> &&data, UIntReader &&crc, std::string name)
+        : data(std::move(data))
+        , crc(std::move(crc))
+        , name(std::move(name)) {
+        if (this->crc.size() < checksum_header_size)
+            throw ChecksumError(std::string("Empty checksum array for \"") + this->name + "\"");
+        chunk_size = this->crc.read_one();
+        uint32_t type = this->crc.read_one();
+        uint64_t expected_chunks =
+            chunk_size == 0 ? 0 : (this->data.size() + chunk_size - 1) / chunk_size;
+        if (chunk_size == 0 || type != (uint32_t)checksumType<T>() ||
+            this->crc.size() != expected_chunks + checksum_header_size)
+            throw ChecksumError(
+                std::string("Checksum array does not match data length for \"") + this->name +
+                "\""
+            );
+        chunk.resize(chunk_size);
+    }
+
+    uint64_t size() const override { return data.size(); }
+    void seek(uint64_t new_pos) override { pos = new_pos; }
+    uint64_t load(T *out, uint64_t count) override {
+        uint64_t chunk_idx = pos / chunk_size;
+        if (chunk_idx != current_chunk) loadChunk(chunk_idx);
+        uint64_t offset = pos - chunk_idx * chunk_size;
+        uint64_t chunk_len = std::min(chunk_size, data.size() - chunk_idx * chunk_size);
+        uint64_t n = std::min(count, chunk_len - offset);
+        std::memmove(out, chunk.data() + offset, n * sizeof(T));
+        pos += n;
+        return n;
+    }
+};
+
+// Wraps a WriterBuilder so that every numeric array gets a companion CRC32C array.
+// The wrapped builder must outlive this object, but writers created from this builder
+// do not depend on it
+class ChecksumWriterBuilder final : public WriterBuilder {
+  private:
+    WriterBuilder &inner;
+    uint64_t chunk_size;
+
+    template <class T> NumWriter<T> wrap(NumWriter<T> &&writer, std::string name) {
+        uint64_t buffer_size = writer.maxCapacity();
+        return NumWriter<T>(
+            std::make_unique<CRC32CNumWriter<T>>(
+                std::move(writer), inner.createUIntWriter(checksumArrayName(name)), chunk_size
+            ),
+            buffer_size
+        );
+    }
+
+  public:
+    // chunk_size -- number of elements covered by each checksum
+    ChecksumWriterBuilder(WriterBuilder &inner, uint64_t chunk_size = 16384);
+
+    UIntWriter createUIntWriter(std::string name) override;
+    ULongWriter createULongWriter(std::string name) override;
+    FloatWriter createFloatWriter(std::string name) override;
+    DoubleWriter createDoubleWriter(std::string name) override;
+    std::unique_ptr<StringWriter> createStringWriter(std::string name) override;
+    void writeVersion(std::string version) override;
+    void deleteWriter(std::string name) override;
+};
+
+// Wraps a ReaderBuilder so that arrays with a companion CRC32C array are verified as
+// they are read. The wrapped builder must outlive this object, but readers opened from
+// this builder do not depend on it
+class ChecksumReaderBuilder final : public ReaderBuilder {
+  private:
+    ReaderBuilder &inner;
+    std::set<std::string> checksummed;
+
+    template <class T> NumReader<T> wrap(NumReader<T> &&reader, std::string name) {
+        if (!checksummed.count(name)) return std::move(reader);
+        uint64_t buffer_size = reader.maxCapacity();
+        uint64_t read_size = reader.readSize();
+        UIntReader crc = inner.openUIntReader(checksumArrayName(name));
+        return NumReader<T>(
+            std::make_unique<CRC32CNumReader<T>>(std::move(reader), std::move(crc), name),
+            buffer_size,
+            read_size
+        );
+    }
+
+  public:
+    ChecksumReaderBuilder(ReaderBuilder &inner);
+
+    // Returns true if any array in the underlying storage has checksums
+    bool hasChecksums() const { return !checksummed.empty(); }
+
+    UIntReader openUIntReader(std::string name) override;
+    ULongReader openULongReader(std::string name) override;
+    FloatReader openFloatReader(std::string name) override;
+    DoubleReader openDoubleReader(std::string name) override;
+    std::unique_ptr<StringReader> openStringReader(std::string name) override;
+    std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
+};
+
+struct ChecksumReport {
+    uint64_t arrays = 0; // Number of checksummed arrays checked
+    uint64_t chunks = 0; // Number of chunks checked
+    uint64_t bytes = 0;  // Number of data bytes checked
+    // One entry per array with a checksum mismatch or malformed checksum array
+    std::vector<std::string> failures;
+};
+
+// Check every checksummed array in `rb` against its stored CRC32Cs, streaming the raw
+// arrays without decoding. Arrays without checksums are ignored.
+ChecksumReport verifyChecksums(ReaderBuilder &rb, const ExecutionContext &ctx = {});
+
+} // end namespace BPCells
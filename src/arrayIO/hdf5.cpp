@@ -193,6 +193,8 @@ std::string H5ReaderBuilder::readVersion() {
     return version;
 }
 
+std::vector<std::string> H5ReaderBuilder::listArrays() { return group.listObjectNames(); }
+
 HighFive::Group &H5ReaderBuilder::getGroup() { return group; }
 
 } // end namespace BPCells
@@ -159,6 +159,7 @@ class H5ReaderBuilder final : public ReaderBuilder {
     DoubleReader openDoubleReader(std::string name) override;
     std::unique_ptr<StringReader> openStringReader(std::string name) override;
     std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
     HighFive::Group &getGroup();
 };
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "array_interfaces.h"
+
+namespace BPCells {
+
+// Pass-through writer that hands each filled buffer to a worker thread, which writes it to
+// the wrapped NumWriter (e.g. a BP128 packer writing to a file). The calling thread only copies
+// the buffer, so it can keep producing data while the previous buffer is packed and written.
+// One buffer can be queued while another is being written.
+// The wrapped writer is only used from the worker thread, so it must not share unsynchronized
+// state with writers used on other threads (files and memory are fine, HDF5 is not).
+// Errors on the worker are rethrown from the next write() or from finalize().
+template <class T> class PipelinedNumWriter : public BulkNumWriter<T> {
+  private:
+    NumWriter<T> inner;
+    std::vector<T> pending, working;
+    uint64_t pending_size = 0;
+    bool has_pending = false;
+    bool done = false, finalize_requested = false;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread worker;
+
+    void writeInner(const T *in, uint64_t count) {
+        uint64_t written = 0;
+        while (written < count) {
+            inner.ensureCapacity(1);
+            uint64_t n = std::min(count - written, inner.capacity());
+            std::memmove(inner.data(), in + written, n * sizeof(T));
+            inner.advance(n);
+            written += n;
+        }
+    }
+
+    void run() {
+        while (true) {
+            uint64_t count;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this] { return has_pending || done; });
+                if (!has_pending) break;
+                std::swap(pending, working);
+                count = pending_size;
+                has_pending = false;
+            }
+            cv.notify_all();
+            try {
+                writeInner(working.data(), count);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mtx);
+                error = std::current_exception();
+                done = true;
+                cv.notify_all();
+                return;
+            }
+        }
+        if (!finalize_requested) return;
+        try {
+            inner.finalize();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            error = std::current_exception();
+        }
+    }
+
+    void stop(bool finalize) {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            done = true;
+            finalize_requested = finalize;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+  public:
+    // buffer_size -- number of elements handed to the worker at a time. Larger buffers
+    //   mean fewer thread handoffs
+    PipelinedNumWriter(NumWriter<T> &&inner, uint64_t buffer_size)
+        : inner(std::move(inner))
+        , pending(buffer_size)
+        , working(buffer_size) {
+        worker = std::thread(&PipelinedNumWriter::run, this);
+    }
+
+    ~PipelinedNumWriter() { stop(false); }
+
+    uint64_t write(T *in, uint64_t count) override {
+        count = std::min<uint64_t>(count, pending.size());
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return !has_pending || error; });
+            if (error) std::rethrow_exception(error);
+        }
+        // The worker only touches `pending` while has_pending is set
+        std::memmove(pending.data(), in, count * sizeof(T));
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending_size = count;
+            has_pending = true;
+        }
+        cv.notify_all();
+        return count;
+    }
+
+    void finalize() override {
+        stop(true);
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+} // end namespace BPCells
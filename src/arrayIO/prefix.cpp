@@ -0,0 +1,72 @@
+#include "prefix.h"
+
+namespace BPCells {
+
+PrefixWriterBuilder::PrefixWriterBuilder(WriterBuilder &inner, std::string prefix)
+    : inner(inner)
+    , prefix(prefix) {}
+
+UIntWriter PrefixWriterBuilder::createUIntWriter(std::string name) {
+    return inner.createUIntWriter(prefix + name);
+}
+ULongWriter PrefixWriterBuilder::createULongWriter(std::string name) {
+    return inner.createULongWriter(prefix + name);
+}
+FloatWriter PrefixWriterBuilder::createFloatWriter(std::string name) {
+    return inner.createFloatWriter(prefix + name);
+}
+DoubleWriter PrefixWriterBuilder::createDoubleWriter(std::string name) {
+    return inner.createDoubleWriter(prefix + name);
+}
+std::unique_ptr<StringWriter> PrefixWriterBuilder::createStringWriter(std::string name) {
+    return inner.createStringWriter(prefix + name);
+}
+void PrefixWriterBuilder::writeVersion(std::string version) {
+    inner.createStringWriter(prefix + "version")->write(VecStringReader({version}));
+}
+void PrefixWriterBuilder::deleteWriter(std::string name) { inner.deleteWriter(prefix + name); }
+
+PrefixReaderBuilder::PrefixReaderBuilder(ReaderBuilder &inner, std::string prefix)
+    : inner(inner)
+    , prefix(prefix) {}
+
+bool PrefixReaderBuilder::hasPrefix(ReaderBuilder &rb, const std::string &prefix) {
+    for (const auto &name : rb.listArrays()) {
+        if (name == prefix + "version") return true;
+    }
+    return false;
+}
+
+UIntReader PrefixReaderBuilder::openUIntReader(std::string name) {
+    return inner.openUIntReader(prefix + name);
+}
+ULongReader PrefixReaderBuilder::openULongReader(std::string name) {
+    return inner.openULongReader(prefix + name);
+}
+FloatReader PrefixReaderBuilder::openFloatReader(std::string name) {
+    return inner.openFloatReader(prefix + name);
+}
+DoubleReader PrefixReaderBuilder::openDoubleReader(std::string name) {
+    return inner.openDoubleReader(prefix + name);
+}
+std::unique_ptr<StringReader> PrefixReaderBuilder::openStringReader(std::string name) {
+    return inner.openStringReader(prefix + name);
+}
+std::string PrefixReaderBuilder::readVersion() {
+    auto version = inner.openStringReader(prefix + "version");
+    if (version->size() != 1) {
+        throw std::runtime_error("Version array does not have exactly one entry: " + prefix);
+    }
+    return version->get(0);
+}
+std::vector<std::string> PrefixReaderBuilder::listArrays() {
+    std::vector<std::string> ret;
+    for (const auto &name : inner.listArrays()) {
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string stripped = name.substr(prefix.size());
+        if (stripped != "version") ret.push_back(stripped);
+    }
+    return ret;
+}
+
+} // end namespace BPCells
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "array_interfaces.h"
+
+// Store several independent objects (e.g. the two copies of a dual-orientation matrix) in one
+// WriterBuilder by prefixing each array name. The version of a prefixed object is stored as a
+// string array named `<prefix>version`, so this works for any storage backend.
+
+namespace BPCells {
+
+// Wraps a WriterBuilder so that every array name gets `prefix` prepended.
+// The wrapped builder must outlive this object, but writers created from this builder
+// do not depend on it
+class PrefixWriterBuilder final : public WriterBuilder {
+  private:
+    WriterBuilder &inner;
+    std::string prefix;
+
+  public:
+    PrefixWriterBuilder(WriterBuilder &inner, std::string prefix);
+
+    UIntWriter createUIntWriter(std::string name) override;
+    ULongWriter createULongWriter(std::string name) override;
+    FloatWriter createFloatWriter(std::string name) override;
+    DoubleWriter createDoubleWriter(std::string name) override;
+    std::unique_ptr<StringWriter> createStringWriter(std::string name) override;
+    void writeVersion(std::string version) override;
+    void deleteWriter(std::string name) override;
+};
+
+// Wraps a ReaderBuilder to read arrays written through a PrefixWriterBuilder with the same
+// prefix. listArrays() only returns the prefixed arrays, with the prefix removed.
+// The wrapped builder must outlive this object, but readers opened from this builder
+// do not depend on it
+class PrefixReaderBuilder final : public ReaderBuilder {
+  private:
+    ReaderBuilder &inner;
+    std::string prefix;
+
+  public:
+    PrefixReaderBuilder(ReaderBuilder &inner, std::string prefix);
+
+    // Returns true if `rb` holds an object written with the given prefix
+    static bool hasPrefix(ReaderBuilder &rb, const std::string &prefix);
+
+    UIntReader openUIntReader(std::string name) override;
+    ULongReader openULongReader(std::string name) override;
+    FloatReader openFloatReader(std::string name) override;
+    DoubleReader openDoubleReader(std::string name) override;
+    std::unique_ptr<StringReader> openStringReader(std::string name) override;
+    std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
+};
+
+} // end namespace BPCells
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include "array_interfaces.h"
+
+namespace BPCells {
+
+// View onto a reader shared between several views, each keeping its own read position.
+// This lets many streams read from one set of open arrays, e.g. one file handle per array
+// rather than one per stream. The source is re-positioned before a load only if another view
+// moved it, so views sharing a source must not be used from different threads at once.
+template <class T> class SharedNumReader : public BulkNumReader<T> {
+  public:
+    struct Source {
+        std::unique_ptr<BulkNumReader<T>> reader;
+        uint64_t pos = UINT64_MAX; // Position of the next load, or UINT64_MAX if unknown
+    };
+
+    // Take over the bulk reader inside `reader` so it can be shared by views
+    static std::shared_ptr<Source> share(NumReader<T> &&reader) {
+        auto source = std::make_shared<Source>();
+        source->reader = reader.release();
+        return source;
+    }
+
+  private:
+    std::shared_ptr<Source> source;
+    uint64_t pos = 0;
+
+  public:
+    SharedNumReader(std::shared_ptr<Source> source) : source(std::move(source)) {}
+
+    uint64_t size() const override { return source->reader->size(); }
+
+    void seek(uint64_t pos) override { this->pos = pos; }
+
+    uint64_t load(T *out, uint64_t count) override {
+        if (source->pos != pos) source->reader->seek(pos);
+        uint64_t loaded = source->reader->load(out, count);
+        pos += loaded;
+        source->pos = pos;
+        return loaded;
+    }
+
+    const T *contiguousData() const override { return source->reader->contiguousData(); }
+};
+
+} // end namespace BPCells
@@ -90,6 +90,21 @@ std::unique_ptr<StringReader> VecReaderWriterBuilder::openStringReader(std::stri
 }
 std::string VecReaderWriterBuilder::readVersion() { return version; }
 
+std::vector<std::string> VecReaderWriterBuilder::listArrays() {
+    std::vector<std::string> ret;
+    for (auto &kv : int_vecs)
+        ret.push_back(kv.first);
+    for (auto &kv : long_vecs)
+        ret.push_back(kv.first);
+    for (auto &kv : float_vecs)
+        ret.push_back(kv.first);
+    for (auto &kv : double_vecs)
+        ret.push_back(kv.first);
+    for (auto &kv : string_vecs)
+        ret.push_back(kv.first);
+    return ret;
+}
+
 std::map<std::string, std::vector<uint32_t>> &VecReaderWriterBuilder::getIntVecs() {
     return int_vecs;
 }
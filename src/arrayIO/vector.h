@@ -68,6 +68,7 @@ template <class T> class VecNumReader : public BulkNumReader<T> {
         pos += load_size;
         return load_size;
     }
+    const T *contiguousData() const override { return vec; }
 };
 
 using VecUIntReader = VecNumReader<uint32_t>;
@@ -110,6 +111,7 @@ class VecReaderWriterBuilder : public WriterBuilder, public ReaderBuilder {
 
     std::unique_ptr<StringReader> openStringReader(std::string name) override;
     std::string readVersion() override;
+    std::vector<std::string> listArrays() override;
 
     std::map<std::string, std::vector<uint32_t>> &getIntVecs();
     std::map<std::string, std::vector<float>> &getFloatVecs();
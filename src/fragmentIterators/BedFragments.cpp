@@ -1,22 +1,63 @@
 #include <atomic>
+#include <unordered_set>
 #include "BedFragments.h"
+#include "Bgzf.h"
 #include "../utils/filesystem_compat.h"
 
 namespace BPCells {
 
-BedFragments::BedFragments(const char *path, const char *comment_prefix)
+BedFragments::BedFragments(
+    const char *path,
+    const char *comment_prefix,
+    const std::vector<std::string> &keep_cells,
+    uint32_t min_fragments
+)
     : path(path)
     , f(NULL)
     , comment(comment_prefix) {
+    std::unordered_set<std::string> seen;
+    for (auto &cell : keep_cells) {
+        if (!seen.insert(cell).second)
+            throw std::invalid_argument("BedFragments: duplicate barcode in keep_cells: " + cell);
+    }
+    filter_cells = !keep_cells.empty() || min_fragments > 0;
+    kept_cells = keep_cells;
+    if (min_fragments > 0) countCells(keep_cells, min_fragments);
     restart();
 }
 
+void BedFragments::countCells(const std::vector<std::string> &keep_cells, uint32_t min_fragments) {
+    // Count fragments per barcode, in order of first appearance
+    std::unordered_map<std::string, uint32_t> counts;
+    std::vector<std::string> order;
+    restart();
+    while (line_buf[0] != '\0' && line_buf[0] != '\n') {
+        const char *field = &line_buf[0];
+        for (int i = 0; i < 3; i++) {
+            field = nextField(field);
+            if (*field != '\t') throw std::runtime_error("Invalid TSV file");
+            field += 1;
+        }
+        std::string barcode(field, nextField(field) - field);
+        auto res = counts.emplace(barcode, 0);
+        if (res.second && keep_cells.empty()) order.push_back(barcode);
+        res.first->second += 1;
+        if (!read_line()) break;
+    }
+
+    kept_cells.clear();
+    for (auto &cell : keep_cells.empty() ? order : keep_cells) {
+        auto it = counts.find(cell);
+        if (it != counts.end() && it->second >= min_fragments) kept_cells.push_back(cell);
+    }
+}
+
 BedFragments::~BedFragments() { gzclose(f); }
 
 // Return the number of cells/chromosomes, or return -1 if this number is
 // not known ahead of time
 int BedFragments::chrCount() const { return -1; }
-int BedFragments::cellCount() const { return -1; }
+int BedFragments::cellCount() const { return filter_cells ? (int)kept_cells.size() : -1; }
 
 const char *BedFragments::chrNames(uint32_t chr_id) {
     if (chr_id >= chr_names.size()) return NULL;
@@ -87,10 +128,16 @@ std::string_view BedFragments::parse_line(uint32_t &start, uint32_t &end, uint32
 
     cur_field = next_field + 1;
     next_field = nextField(cur_field);
-    auto cell_id_res =
-        cell_id_lookup.emplace(std::string(cur_field, next_field - cur_field), next_cell_id);
+    std::string barcode(cur_field, next_field - cur_field);
+    if (filter_cells) {
+        // The lookup already holds every kept barcode, and nothing else is added
+        auto it = cell_id_lookup.find(barcode);
+        cell_id = it == cell_id_lookup.end() ? UINT32_MAX : it->second;
+        return chr;
+    }
+    auto cell_id_res = cell_id_lookup.emplace(barcode, next_cell_id);
     if (cell_id_res.second) {
-        cell_names.push_back(std::string(cur_field, next_field - cur_field));
+        cell_names.push_back(std::move(barcode));
         next_cell_id++;
     }
     cell_id = cell_id_res.first->second;
@@ -122,6 +169,12 @@ void BedFragments::restart() {
     cell_id_lookup.clear();
     cell_names.clear();
     next_cell_id = 0;
+    if (filter_cells) {
+        for (auto &cell : kept_cells) {
+            cell_id_lookup.emplace(cell, next_cell_id++);
+        }
+        cell_names = kept_cells;
+    }
 
     cell.resize(0);
     start.resize(0);
@@ -181,7 +234,7 @@ bool BedFragments::load() {
     cell.resize(1024);
     start.resize(1024);
     end.resize(1024);
-    for (i = 0; i < 1024; i++) {
+    for (i = 0; i < 1024;) {
         // line_buf will contain the next line in file before start of loop
         chr = parse_line(start[i], end[i], cell[i]);
         if (chr == "" || chr != current_chr) {
@@ -191,7 +244,10 @@ bool BedFragments::load() {
             throw std::runtime_error("TSV not in sorted order by chr, start");
         last_start = start[i];
 
+        // Filtered cells get overwritten by the next line
+        bool keep = cell[i] != UINT32_MAX;
         if (!read_line()) break;
+        if (keep) i++;
     }
     cell.resize(i);
     start.resize(i);
@@ -206,11 +262,17 @@ uint32_t *BedFragments::startData() { return start.data(); }
 uint32_t *BedFragments::endData() { return end.data(); }
 
 BedFragmentsWriter::BedFragmentsWriter(
-    const char *path, bool append_5th_column, uint32_t buffer_size
+    const char *path,
+    bool append_5th_column,
+    uint32_t buffer_size,
+    uint32_t threads,
+    bool write_index
 )
-    : append_5th_column(append_5th_column) {
-
-    std::string str_path(path);
+    : path(path)
+    , append_5th_column(append_5th_column)
+    , buffer_size(buffer_size)
+    , threads(threads)
+    , write_index(write_index) {
 
     // Create directory if it doesn't already exist
     std_fs::path fpath(path);
@@ -218,58 +280,102 @@ BedFragmentsWriter::BedFragmentsWriter(
         std_fs::create_directories(fpath.parent_path());
     }
 
-    size_t extension_idx = str_path.rfind(".");
-    if (extension_idx != std::string::npos && str_path.substr(extension_idx) == ".gz") {
-        f = gzopen(path, "wb1");
-    } else {
-        f = gzopen(path, "wT");
+    size_t extension_idx = this->path.rfind(".");
+    bgzf = extension_idx != std::string::npos && this->path.substr(extension_idx) == ".gz";
+    if (write_index && !bgzf) {
+        throw std::invalid_argument("BedFragmentsWriter: an index requires a .gz output path");
+    }
+    if (!bgzf) {
+        plain_file.open(path, std::ios::binary);
+        if (!plain_file) {
+            throw std::runtime_error("Could not open file for writing: " + this->path);
+        }
     }
-
-    // Note default of large 1MB buffer to speed up reading
-    gzbuffer(f, buffer_size);
 }
 
-BedFragmentsWriter::~BedFragmentsWriter() {
-    if (f != NULL) gzclose(f);
+namespace {
+
+// Append the decimal digits of `val`, avoiding printf's format parsing
+inline void appendUInt(std::string &out, uint32_t val) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val != 0);
+    while (n > 0) {
+        out.push_back(digits[--n]);
+    }
 }
 
-void BedFragmentsWriter::write(FragmentLoader &loader, std::atomic<bool> *user_interrupt) {
+} // namespace
+
+void BedFragmentsWriter::write(FragmentLoader &loader, const ExecutionContext &ctx) {
     FragmentIterator fragments((std::unique_ptr<FragmentLoader>(&loader)));
     // Don't take ownership of the loader object
     fragments.preserve_input_loader();
-    uint32_t bytes_written;
-
-    size_t total_fragments = 0;
 
-    const char *output_format;
-    if (append_5th_column) {
-        output_format = "%s\t%d\t%d\t%s\t0\n";
-    } else {
-        output_format = "%s\t%d\t%d\t%s\n";
+    std::unique_ptr<BgzfWriter> out;
+    ResourceLease lease;
+    if (bgzf) {
+        lease = ctx.acquireThreads(threads > 1 ? threads : 0);
+        out = std::make_unique<BgzfWriter>(path, 1, lease.count());
     }
+    TabixIndexBuilder index;
+
+    // Lines are formatted into buf, whose first byte is at uncompressed offset buf_offset
+    std::string buf;
+    buf.reserve(buffer_size + 1024);
+    uint64_t buf_offset = 0;
+    auto flush = [&]() {
+        if (bgzf) {
+            out->write(buf.data(), buf.size());
+        } else if (!plain_file.write(buf.data(), buf.size())) {
+            throw std::runtime_error("Failed to write data in BedFragmentsWriter");
+        }
+        buf_offset += buf.size();
+        buf.clear();
+    };
+    const char *line_end = append_5th_column ? "\t0\n" : "\n";
 
+    size_t total_fragments = 0;
     fragments.restart();
     while (fragments.nextChr()) {
         const char *chr_name = fragments.chrNames(fragments.currentChr());
         while (fragments.nextFrag()) {
-            bytes_written = gzprintf(
-                f,
-                output_format,
-                chr_name,
-                fragments.start(),
-                fragments.end(),
-                fragments.cellNames(fragments.cell())
-            );
-
-            if (bytes_written <= 0) {
-                throw std::runtime_error("Failed to write data in BedFragmentsWriter");
+            uint64_t line_start = buf.size();
+            buf.append(chr_name);
+            buf.push_back('\t');
+            appendUInt(buf, fragments.start());
+            buf.push_back('\t');
+            appendUInt(buf, fragments.end());
+            buf.push_back('\t');
+            buf.append(fragments.cellNames(fragments.cell()));
+            buf.append(line_end);
+            if (write_index) {
+                index.addLine(
+                    chr_name,
+                    fragments.start(),
+                    fragments.end(),
+                    buf_offset + line_start,
+                    buf_offset + buf.size()
+                );
             }
+            if (buf.size() >= buffer_size) flush();
 
-            if (user_interrupt != NULL && total_fragments++ % 1024 == 0 && *user_interrupt) return;
+            if (total_fragments++ % 1024 == 0 && ctx.interrupted()) return;
+        }
+    }
+    flush();
+    if (bgzf) {
+        out->close();
+        if (write_index) index.write(path + ".tbi", *out);
+    } else {
+        plain_file.close();
+        if (plain_file.fail()) {
+            throw std::runtime_error("Failed to write data in BedFragmentsWriter");
         }
     }
-    gzclose(f);
-    f = NULL;
 }
 
 } // end namespace BPCells
@@ -2,6 +2,7 @@
 
 #include <array>
 #include <atomic>
+#include <fstream>
 #include <string>
 #include <unordered_map>
 
@@ -12,10 +13,22 @@
 namespace BPCells {
 
 // Read a fragment TSV with columns chr, start, end, cell_id [optional others] in that order.
-// cell and chromosme IDs are assigned in sequential order from the order they're seen
+// cell and chromosme IDs are assigned in sequential order from the order they're seen.
+// Barcodes can be filtered while parsing, so discarded barcodes are never assigned an ID or
+// stored:
+// - keep_cells: only keep these barcodes, with cell IDs in the given order. Empty keeps all
+// - min_fragments: only keep barcodes with at least this many fragments. This takes an extra
+//   counting pass over the file in the constructor. Cell IDs are in order of first appearance
+//   (or keep_cells order), and the counts are discarded once the kept barcodes are known
+// When filtering, cellCount() and cellNames() are known before any fragments are read.
 class BedFragments : public FragmentLoader {
   public:
-    BedFragments(const char *path, const char *comment_prefix = "");
+    BedFragments(
+        const char *path,
+        const char *comment_prefix = "",
+        const std::vector<std::string> &keep_cells = {},
+        uint32_t min_fragments = 0
+    );
 
     ~BedFragments();
 
@@ -54,6 +67,8 @@ class BedFragments : public FragmentLoader {
     std::vector<std::string> chr_names, cell_names;
     std::unordered_map<std::string, uint32_t> chr_lookup, cell_id_lookup;
     uint32_t next_chr_id, next_cell_id;
+    bool filter_cells = false;
+    std::vector<std::string> kept_cells; // Barcodes to keep when filter_cells is true
     bool eof = false;
     std::string current_chr;
     std::string comment;
@@ -68,24 +83,39 @@ class BedFragments : public FragmentLoader {
 
     // Parse the line in line_buf, returning the chromosome name as the actual
     // return value, with output parameters for start, end, cell_id.
-    // Will assign a cell_id if it sees a new cell name.
+    // Will assign a cell_id if it sees a new cell name, or set cell_id to UINT32_MAX if
+    // the cell is filtered out.
     // Returns empty string at eof
     std::string_view parse_line(uint32_t &start, uint32_t &end, uint32_t &cell_id);
 
+    // Counting pass for min_fragments: narrow kept_cells to barcodes with enough fragments
+    void countCells(const std::vector<std::string> &keep_cells, uint32_t min_fragments);
+
     bool validInt(const char *c);
 };
 
+// Write fragments as a TSV with columns chr, start, end, cell_id.
+// Paths ending in .gz are written as BGZF (blocked gzip, readable by any gzip reader), with
+// blocks compressed in parallel on up to `threads` threads taken from the ExecutionContext.
+// If write_index is true, a tabix index is written alongside as <path>.tbi during the same
+// pass, which requires a .gz path.
 class BedFragmentsWriter : public FragmentWriter {
   public:
     BedFragmentsWriter(
-        const char *path, bool append_5th_column = false, uint32_t buffer_size = 1 << 20
+        const char *path,
+        bool append_5th_column = false,
+        uint32_t buffer_size = 1 << 20,
+        uint32_t threads = 1,
+        bool write_index = false
     );
-    ~BedFragmentsWriter();
-    void write(FragmentLoader &fragments, std::atomic<bool> *user_interrupt = NULL) override;
+    void write(FragmentLoader &fragments, const ExecutionContext &ctx = {}) override;
 
   private:
-    gzFile f;
+    std::string path;
     bool append_5th_column;
+    uint32_t buffer_size, threads;
+    bool bgzf, write_index;
+    std::ofstream plain_file; // Output for uncompressed paths
 };
 
 } // end namespace BPCells
\ No newline at end of file
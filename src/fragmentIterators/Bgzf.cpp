@@ -0,0 +1,298 @@
+#include "Bgzf.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace BPCells {
+
+namespace {
+
+// Largest block BGZF allows, including header and footer
+constexpr uint64_t MAX_BLOCK_BYTES = 1 << 16;
+constexpr uint64_t HEADER_BYTES = 18, FOOTER_BYTES = 8;
+
+// Empty block marking the end of a BGZF file
+const unsigned char EOF_MARKER[28] = {0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+                                      0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00,
+                                      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+template <class T> void putLE(char *out, T val) {
+    for (uint32_t i = 0; i < sizeof(T); i++) {
+        out[i] = (char)((val >> (8 * i)) & 0xff);
+    }
+}
+
+template <class T> void appendLE(std::vector<char> &out, T val) {
+    char buf[sizeof(T)];
+    putLE(buf, val);
+    out.insert(out.end(), buf, buf + sizeof(T));
+}
+
+} // namespace
+
+BgzfWriter::Deflater::Deflater(int level) : level(level) {
+    std::memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("BgzfWriter: failed to initialize zlib");
+    }
+}
+
+BgzfWriter::Deflater::~Deflater() { deflateEnd(&zs); }
+
+void BgzfWriter::Deflater::compress(const std::vector<char> &in, std::vector<char> &out) {
+    out.resize(MAX_BLOCK_BYTES);
+    char *data = out.data() + HEADER_BYTES;
+    uint64_t max_data = MAX_BLOCK_BYTES - HEADER_BYTES - FOOTER_BYTES;
+
+    deflateReset(&zs);
+    zs.next_in = (Bytef *)in.data();
+    zs.avail_in = in.size();
+    zs.next_out = (Bytef *)data;
+    zs.avail_out = max_data;
+    uint64_t data_bytes;
+    if (deflate(&zs, Z_FINISH) == Z_STREAM_END) {
+        data_bytes = zs.total_out;
+    } else {
+        // Incompressible input can expand past the block limit, so fall back to a single
+        // stored (uncompressed) deflate block
+        uint16_t len = in.size();
+        data[0] = 1;
+        putLE<uint16_t>(data + 1, len);
+        putLE<uint16_t>(data + 3, ~len);
+        std::memcpy(data + 5, in.data(), in.size());
+        data_bytes = in.size() + 5;
+    }
+
+    uint64_t block_bytes = HEADER_BYTES + data_bytes + FOOTER_BYTES;
+    const unsigned char header[16] = {
+        0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0
+    };
+    std::memcpy(out.data(), header, sizeof(header));
+    putLE<uint16_t>(out.data() + 16, block_bytes - 1);
+    uint32_t crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef *)in.data(), in.size());
+    putLE<uint32_t>(data + data_bytes, crc);
+    putLE<uint32_t>(data + data_bytes + 4, in.size());
+    out.resize(block_bytes);
+}
+
+BgzfWriter::BgzfWriter(const std::string &path, int level, uint32_t threads)
+    : f(path, std::ios::binary)
+    , level(level)
+    , main_deflater(level) {
+    if (!f) throw std::runtime_error("Could not open file for writing: " + path);
+    current.reserve(BLOCK_SIZE);
+    if (threads > 1) {
+        // Enough queued blocks to keep every worker busy while the oldest is written
+        jobs.resize(2 * threads);
+        for (uint32_t i = 0; i < threads; i++) {
+            workers.emplace_back(&BgzfWriter::workerLoop, this);
+        }
+    }
+}
+
+BgzfWriter::~BgzfWriter() { stopWorkers(); }
+
+void BgzfWriter::write(const char *data, uint64_t size) {
+    if (closed) throw std::logic_error("BgzfWriter: write after close");
+    while (size > 0) {
+        uint64_t n = std::min(size, BLOCK_SIZE - current.size());
+        current.insert(current.end(), data, data + n);
+        data += n;
+        size -= n;
+        if (current.size() == BLOCK_SIZE) submitBlock();
+    }
+}
+
+void BgzfWriter::workerLoop() {
+    Deflater deflater(level);
+    while (true) {
+        uint64_t job_id;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return stop || next_job < submitted; });
+            if (next_job >= submitted) return;
+            job_id = next_job++;
+        }
+        Job &job = jobs[job_id % jobs.size()];
+        try {
+            deflater.compress(job.in, job.out);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job.done = true;
+        }
+        cv.notify_all();
+    }
+}
+
+void BgzfWriter::submitBlock() {
+    if (workers.empty()) {
+        std::vector<char> out;
+        main_deflater.compress(current, out);
+        block_offsets.push_back(compressed_bytes);
+        f.write(out.data(), out.size());
+        compressed_bytes += out.size();
+        submitted++;
+        written++;
+        current.clear();
+        return;
+    }
+
+    while (submitted - written == jobs.size()) {
+        writeOldest();
+    }
+    Job &job = jobs[submitted % jobs.size()];
+    std::swap(job.in, current);
+    current.clear();
+    current.reserve(BLOCK_SIZE);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job.done = false;
+        submitted++;
+    }
+    cv.notify_all();
+
+    // Write out any blocks that are already finished, without waiting
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (written == submitted || !jobs[written % jobs.size()].done) break;
+        }
+        writeOldest();
+    }
+}
+
+void BgzfWriter::writeOldest() {
+    Job &job = jobs[written % jobs.size()];
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&job] { return job.done; });
+        if (error) std::rethrow_exception(error);
+    }
+    block_offsets.push_back(compressed_bytes);
+    f.write(job.out.data(), job.out.size());
+    compressed_bytes += job.out.size();
+    written++;
+}
+
+void BgzfWriter::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers) {
+        w.join();
+    }
+    workers.clear();
+}
+
+void BgzfWriter::close() {
+    if (closed) return;
+    if (!current.empty()) submitBlock();
+    while (written < submitted) {
+        writeOldest();
+    }
+    stopWorkers();
+    block_offsets.push_back(compressed_bytes);
+    f.write((const char *)EOF_MARKER, sizeof(EOF_MARKER));
+    f.close();
+    if (f.fail()) throw std::runtime_error("BgzfWriter: failed to write data");
+    closed = true;
+}
+
+uint64_t BgzfWriter::virtualOffset(uint64_t uncompressed_offset) const {
+    uint64_t block = uncompressed_offset / BLOCK_SIZE;
+    if (!closed || block >= block_offsets.size()) {
+        throw std::logic_error("BgzfWriter: virtual offset not available");
+    }
+    return (block_offsets[block] << 16) | (uncompressed_offset % BLOCK_SIZE);
+}
+
+uint32_t TabixIndexBuilder::reg2bin(uint32_t start, uint32_t end) {
+    // Standard binning scheme from the SAM spec, with 16kb smallest bins and 5 levels
+    end -= 1;
+    if (start >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (start >> 14);
+    if (start >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (start >> 17);
+    if (start >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (start >> 20);
+    if (start >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (start >> 23);
+    if (start >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (start >> 26);
+    return 0;
+}
+
+void TabixIndexBuilder::addLine(
+    const char *chr_name, uint32_t start, uint32_t end, uint64_t line_start, uint64_t line_end
+) {
+    if (refs.empty() || refs.back().name != chr_name) {
+        refs.push_back(Reference());
+        refs.back().name = chr_name;
+    }
+    Reference &ref = refs.back();
+    if (end <= start) end = start + 1;
+
+    std::vector<Chunk> &chunks = ref.bins[reg2bin(start, end)];
+    if (!chunks.empty() && chunks.back().end == line_start) {
+        chunks.back().end = line_end;
+    } else {
+        chunks.push_back({line_start, line_end});
+    }
+
+    uint32_t last_window = (end - 1) >> 14;
+    if (ref.linear.size() <= last_window) ref.linear.resize(last_window + 1, UINT64_MAX);
+    for (uint32_t w = start >> 14; w <= last_window; w++) {
+        if (ref.linear[w] == UINT64_MAX) ref.linear[w] = line_start;
+    }
+}
+
+void TabixIndexBuilder::write(const std::string &path, const BgzfWriter &data) const {
+    std::vector<char> out;
+    out.insert(out.end(), {'T', 'B', 'I', 1});
+    appendLE<int32_t>(out, refs.size());
+    appendLE<int32_t>(out, 0x10000); // Generic format with 0-based, half-open coordinates
+    appendLE<int32_t>(out, 1);       // Sequence name column
+    appendLE<int32_t>(out, 2);       // Start column
+    appendLE<int32_t>(out, 3);       // End column
+    appendLE<int32_t>(out, '#');     // Comment character
+    appendLE<int32_t>(out, 0);       // Header lines to skip
+
+    uint64_t names_bytes = 0;
+    for (auto &ref : refs) {
+        names_bytes += ref.name.size() + 1;
+    }
+    appendLE<int32_t>(out, names_bytes);
+    for (auto &ref : refs) {
+        out.insert(out.end(), ref.name.c_str(), ref.name.c_str() + ref.name.size() + 1);
+    }
+
+    for (auto &ref : refs) {
+        appendLE<int32_t>(out, ref.bins.size());
+        for (auto &bin : ref.bins) {
+            appendLE<uint32_t>(out, bin.first);
+            appendLE<int32_t>(out, bin.second.size());
+            for (auto &chunk : bin.second) {
+                appendLE<uint64_t>(out, data.virtualOffset(chunk.begin));
+                appendLE<uint64_t>(out, data.virtualOffset(chunk.end));
+            }
+        }
+        // Windows with no lines take the offset of the previous window, or the first line
+        // of the chromosome for leading windows
+        uint64_t prev = ref.bins.empty() ? 0 : UINT64_MAX;
+        for (auto &bin : ref.bins) {
+            prev = std::min(prev, bin.second.front().begin);
+        }
+        appendLE<int32_t>(out, ref.linear.size());
+        for (auto offset : ref.linear) {
+            if (offset != UINT64_MAX) prev = offset;
+            appendLE<uint64_t>(out, data.virtualOffset(prev));
+        }
+    }
+
+    BgzfWriter index(path);
+    index.write(out.data(), out.size());
+    index.close();
+}
+
+} // end namespace BPCells
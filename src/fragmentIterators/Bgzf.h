@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+namespace BPCells {
+
+// Writer for BGZF files: gzip files made of independently compressed blocks of at most 64KB,
+// as used by bgzip/tabix. Any gzip reader can read them, and the block structure allows
+// random access through virtual file offsets.
+// Blocks are compressed on up to `threads` worker threads and written in order.
+class BgzfWriter {
+  public:
+    // Max uncompressed bytes per block, same as bgzip
+    static constexpr uint64_t BLOCK_SIZE = 0xff00;
+
+    BgzfWriter(const std::string &path, int level = 1, uint32_t threads = 1);
+    // Stops workers without writing the end-of-file marker. Call close() to finish the file
+    ~BgzfWriter();
+
+    BgzfWriter(const BgzfWriter &) = delete;
+    BgzfWriter &operator=(const BgzfWriter &) = delete;
+
+    void write(const char *data, uint64_t size);
+
+    // Number of uncompressed bytes written so far
+    uint64_t tell() const { return submitted * BLOCK_SIZE + current.size(); }
+
+    // Flush remaining data and write the end-of-file marker block
+    void close();
+
+    // Convert an uncompressed byte offset to a BGZF virtual offset (compressed block offset in
+    // the upper 48 bits, offset within the block in the lower 16). Only valid after close()
+    uint64_t virtualOffset(uint64_t uncompressed_offset) const;
+
+  private:
+    // Per-thread compression state
+    class Deflater {
+        z_stream zs;
+        int level;
+
+      public:
+        Deflater(int level);
+        ~Deflater();
+        Deflater(const Deflater &) = delete;
+        Deflater &operator=(const Deflater &) = delete;
+        // Compress `in` into a complete BGZF block in `out`
+        void compress(const std::vector<char> &in, std::vector<char> &out);
+    };
+
+    struct Job {
+        std::vector<char> in, out;
+        bool done = false;
+    };
+
+    std::ofstream f;
+    int level;
+    std::vector<char> current;
+    // Compressed offset of the start of each block written, plus the end of data once closed
+    std::vector<uint64_t> block_offsets;
+    uint64_t compressed_bytes = 0;
+    bool closed = false;
+
+    // Ring of jobs: submitted jobs not yet written are [written, submitted)
+    std::vector<Job> jobs;
+    uint64_t submitted = 0, written = 0, next_job = 0;
+    bool stop = false;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+    Deflater main_deflater;
+
+    void workerLoop();
+    void submitBlock();
+    // Write the oldest submitted block, waiting for it to be compressed if needed
+    void writeOldest();
+    void stopWorkers();
+};
+
+// Build a tabix (.tbi) index for a sorted, BGZF-compressed BED-like file while it is written.
+// Coordinates are 0-based and half-open, matching `tabix -p bed`
+class TabixIndexBuilder {
+  public:
+    // Record a line spanning uncompressed offsets [line_start, line_end) of the data file.
+    // Lines must be grouped by chromosome, and sorted by start within each chromosome
+    void addLine(
+        const char *chr_name,
+        uint32_t start,
+        uint32_t end,
+        uint64_t line_start,
+        uint64_t line_end
+    );
+
+    // Write the index to `path`, using `data` (already closed) to compute virtual offsets
+    void write(const std::string &path, const BgzfWriter &data) const;
+
+  private:
+    struct Chunk {
+        uint64_t begin, end; // Uncompressed offsets
+    };
+    struct Reference {
+        std::string name;
+        std::map<uint32_t, std::vector<Chunk>> bins;
+        std::vector<uint64_t> linear; // Uncompressed offset per 16kb window, or UINT64_MAX
+    };
+    std::vector<Reference> refs;
+
+    static uint32_t reg2bin(uint32_t start, uint32_t end);
+};
+
+} // end namespace BPCells
@@ -47,4 +47,38 @@ uint32_t *FragmentLoaderWrapper::cellData() { return loader->cellData(); }
 uint32_t *FragmentLoaderWrapper::startData() { return loader->startData(); }
 uint32_t *FragmentLoaderWrapper::endData() { return loader->endData(); }
 
+InstrumentedFragments::InstrumentedFragments(
+    std::unique_ptr<FragmentLoader> &&loader, std::shared_ptr<InstrumentNode> node
+)
+    : FragmentLoaderWrapper(std::move(loader))
+    , node(std::move(node)) {
+    if (!this->node) throw std::invalid_argument("InstrumentedFragments: node must not be NULL");
+}
+
+std::shared_ptr<InstrumentNode> InstrumentedFragments::instrumentation() { return node; }
+
+void InstrumentedFragments::seek(uint32_t chr_id, uint32_t base) {
+    InstrumentTimer timer(node.get());
+    node->seeks += 1;
+    loader->seek(chr_id, base);
+}
+
+void InstrumentedFragments::restart() {
+    InstrumentTimer timer(node.get());
+    loader->restart();
+}
+
+bool InstrumentedFragments::nextChr() {
+    InstrumentTimer timer(node.get());
+    return loader->nextChr();
+}
+
+bool InstrumentedFragments::load() {
+    InstrumentTimer timer(node.get());
+    if (!loader->load()) return false;
+    node->entries += loader->capacity();
+    node->chunks += 1;
+    return true;
+}
+
 } // end namespace BPCells
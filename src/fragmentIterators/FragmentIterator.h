@@ -6,6 +6,8 @@
 #include <string>
 #include <vector>
 
+#include "../utils/execution_context.h"
+
 namespace BPCells {
 
 // Interface for loading sorted fragments from files or memory.
@@ -75,12 +77,25 @@ class FragmentLoader {
     virtual uint32_t *cellData() = 0;
     virtual uint32_t *startData() = 0;
     virtual uint32_t *endData() = 0;
+
+    // Optional second stream holding each fragment's end coordinate and cell ID, with
+    // ends sorted within each chromosome. It has its own read position, which follows
+    // restart, nextChr, and seek on the fragment stream. A seek positions it close to the
+    // first end >= `base` without overshooting. Loaders without this stream (the default)
+    // return false from hasSortedEnds
+    virtual bool hasSortedEnds() const { return false; }
+    // Return false if there are no more sorted ends to load on the current chromosome
+    virtual bool loadSortedEnds() { return false; }
+    virtual uint32_t sortedEndCapacity() const { return 0; }
+    virtual uint32_t *sortedEndData() { return NULL; }
+    virtual uint32_t *sortedEndCellData() { return NULL; }
 };
 
 // Wrapper for a FragmentLoader, forwarding all to the inner loader object.
 // Typically, a child class will override load and/or other methods
 // Designed to allow easier writing of
-// loaders that perform transformations and filters on other loaders
+// loaders that perform transformations and filters on other loaders.
+// The sorted end stream is not forwarded, since wrappers may filter or modify fragments
 class FragmentLoaderWrapper : public FragmentLoader {
   protected:
     std::unique_ptr<FragmentLoader> loader;
@@ -122,6 +137,25 @@ class FragmentLoaderWrapper : public FragmentLoader {
     uint32_t *endData() override;
 };
 
+// Pass-through wrapper that records wall time, fragments, chunks, and seeks into an
+// InstrumentNode. Timings are inclusive of upstream stages; see InstrumentNode::selfSeconds()
+class InstrumentedFragments : public FragmentLoaderWrapper {
+  private:
+    std::shared_ptr<InstrumentNode> node;
+
+  public:
+    InstrumentedFragments(
+        std::unique_ptr<FragmentLoader> &&loader, std::shared_ptr<InstrumentNode> node
+    );
+
+    std::shared_ptr<InstrumentNode> instrumentation();
+
+    void seek(uint32_t chr_id, uint32_t base) override;
+    void restart() override;
+    bool nextChr() override;
+    bool load() override;
+};
+
 // Class to conveniently iterate over fragments from a FragmentLoader
 class FragmentIterator : public FragmentLoaderWrapper {
   private:
@@ -177,8 +211,8 @@ class FragmentIterator : public FragmentLoaderWrapper {
 class FragmentWriter {
   public:
     // Write fragments
-    // During progress, quit eraly if user_interrupt becomes true
-    virtual void write(FragmentLoader &fragments, std::atomic<bool> *user_interrupt = NULL) = 0;
+    // During progress, quit early if ctx.interrupted() becomes true
+    virtual void write(FragmentLoader &fragments, const ExecutionContext &ctx = {}) = 0;
 };
 
 } // end namespace BPCells
\ No newline at end of file
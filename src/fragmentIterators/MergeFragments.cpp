@@ -1,107 +1,68 @@
 #include "MergeFragments.h"
+#include <atomic>
 #include <cstring>
 #include <functional>
+#include <set>
+#include <thread>
 #include <unordered_map>
 
-#include "../lib/dary_heap.hpp"
-#include "../utils/radix_sort.h"
+#include "../arrayIO/binaryfile.h"
+#include "../utils/filesystem_compat.h"
+#include "StoredFragments.h"
 
 namespace BPCells {
 
-MergeFragments::ChunkedLoader::ChunkedLoader(
-    std::unique_ptr<FragmentLoader> &&loader, uint32_t cell_offset, uint32_t chunk_size
-)
+MergeFragments::Cursor::Cursor(std::unique_ptr<FragmentLoader> &&loader, uint32_t cell_offset)
     : frags(std::move(loader))
-    , cell_offset(cell_offset)
-    , chunk_size(chunk_size) {}
-
-uint32_t
-MergeFragments::ChunkedLoader::load_chunk(uint32_t *start, uint32_t *end, uint32_t *cell) {
-    uint32_t copied = 0;
-    // Use up any remaining loaded data
-    if (loaded > 0) {
-        uint32_t copy_amount = std::min<uint32_t>(chunk_size, loaded);
-        uint32_t offset = frags->capacity() - loaded;
-        std::memmove(start, frags->startData() + offset, sizeof(uint32_t) * copy_amount);
-        std::memmove(end, frags->endData() + offset, sizeof(uint32_t) * copy_amount);
-        std::memmove(cell, frags->cellData() + offset, sizeof(uint32_t) * copy_amount);
-        copied += copy_amount;
-        loaded -= copy_amount;
-    }
-
-    // Call load repeatedly until we fill the chunk or run out of data
-    while (copied < chunk_size) {
-        if (!frags->load()) break;
-        loaded = frags->capacity();
-        uint32_t copy_amount = std::min<uint32_t>(chunk_size - copied, loaded);
-        std::memmove(start + copied, frags->startData(), sizeof(uint32_t) * copy_amount);
-        std::memmove(end + copied, frags->endData(), sizeof(uint32_t) * copy_amount);
-        std::memmove(cell + copied, frags->cellData(), sizeof(uint32_t) * copy_amount);
-        copied += copy_amount;
-        loaded -= copy_amount;
-    }
-    for (uint32_t i = 0; i < copied; i++) {
-        cell[i] += cell_offset;
-    }
-    return copied;
-}
-
-uint32_t MergeFragments::ChunkedLoader::peek_start() {
-    if (loaded == 0) {
-        if (!frags->load()) return UINT32_MAX;
+    , cell_offset(cell_offset) {}
+
+uint32_t MergeFragments::Cursor::peek_start() {
+    if (!active) return UINT32_MAX;
+    while (offset >= loaded) {
+        if (!frags->load()) {
+            active = false;
+            return UINT32_MAX;
+        }
+        offset = 0;
         loaded = frags->capacity();
     }
-    uint32_t offset = frags->capacity() - loaded;
     return frags->startData()[offset];
 }
 
-void MergeFragments::ChunkedLoader::seek(uint32_t chr_id, uint32_t base) {
+void MergeFragments::Cursor::seek(uint32_t chr_id, uint32_t base) {
+    offset = 0;
     loaded = 0;
-    frags->seek(chr_id, base);
+    active = chr_id != UINT32_MAX;
+    if (active) frags->seek(chr_id, base);
 }
 
-void MergeFragments::ChunkedLoader::restart() {
+void MergeFragments::Cursor::restart() {
+    offset = 0;
     loaded = 0;
+    active = false;
     frags->restart();
 }
 
-int MergeFragments::ChunkedLoader::chrCount() const { return frags->chrCount(); }
-int MergeFragments::ChunkedLoader::cellCount() const { return frags->cellCount(); }
+int MergeFragments::Cursor::chrCount() const { return frags->chrCount(); }
+int MergeFragments::Cursor::cellCount() const { return frags->cellCount(); }
 
-const char *MergeFragments::ChunkedLoader::chrNames(uint32_t chr_id) {
-    return frags->chrNames(chr_id);
-}
-const char *MergeFragments::ChunkedLoader::cellNames(uint32_t cell_id) {
+const char *MergeFragments::Cursor::chrNames(uint32_t chr_id) { return frags->chrNames(chr_id); }
+const char *MergeFragments::Cursor::cellNames(uint32_t cell_id) {
     return frags->cellNames(cell_id);
 }
 
-bool MergeFragments::ChunkedLoader::nextChr() {
-    loaded = 0;
-    return frags->nextChr();
-}
-
-uint32_t MergeFragments::ChunkedLoader::currentChr() const { return frags->currentChr(); }
-
 MergeFragments::MergeFragments(
     std::vector<std::unique_ptr<FragmentLoader>> &&fragments,
     const std::vector<std::string> &chr_order,
-    uint32_t load_size,
-    uint32_t chunk_size
+    uint32_t load_size
 )
     : load_size(load_size)
-    , chunk_size(chunk_size)
-    // load_size <= chunk_size * (chunks_per_input - 1) * fragments.size()
-    , chunks_per_input(
-          1 + (load_size + chunk_size * fragments.size() - 1) / (chunk_size * fragments.size())
-      )
     , chr_order(chr_order)
-    , start((chunks_per_input + 1) * chunk_size * fragments.size())
-    , end((chunks_per_input + 1) * chunk_size * fragments.size())
-    , cell((chunks_per_input + 1) * chunk_size * fragments.size())
-    , start_buf((chunks_per_input + 1) * chunk_size * fragments.size())
-    , end_buf((chunks_per_input + 1) * chunk_size * fragments.size())
-    , cell_buf((chunks_per_input + 1) * chunk_size * fragments.size())
-    , heap(fragments.size()) {
+    , start(load_size)
+    , end(load_size)
+    , cell(load_size)
+    , tree(fragments.size())
+    , key(fragments.size()) {
 
     if (fragments.size() < 2) throw std::runtime_error("Must have >= 2 fragments to merge");
 
@@ -142,9 +103,9 @@ MergeFragments::MergeFragments(
         }
     }
 
-    // Wrap input fragments in ChunkedLoader
+    // Wrap input fragments in Cursor
     for (uint32_t i = 0; i < fragments.size(); i++) {
-        frags.push_back(ChunkedLoader(std::move(fragments[i]), cell_id_offset[i], chunk_size));
+        frags.push_back(Cursor(std::move(fragments[i]), cell_id_offset[i]));
     }
 }
 
@@ -160,7 +121,7 @@ void MergeFragments::seek(uint32_t chr_id, uint32_t base) {
     }
 
     loaded = 0;
-    available = 0;
+    tree_valid = false;
     current_chr = chr_id;
 }
 
@@ -169,7 +130,7 @@ void MergeFragments::restart() {
         f.restart();
     }
     loaded = 0;
-    available = 0;
+    tree_valid = false;
     current_chr = UINT32_MAX;
 }
 
@@ -193,7 +154,7 @@ const char *MergeFragments::cellNames(uint32_t cell_id) {
 
 bool MergeFragments::nextChr() {
     loaded = 0;
-    available = 0;
+    tree_valid = false;
     current_chr += 1;
     if ((int64_t)current_chr >= chrCount()) {
         current_chr -= 1;
@@ -201,72 +162,194 @@ bool MergeFragments::nextChr() {
     }
 
     for (uint32_t i = 0; i < frags.size(); i++) {
-        if (source_chr[i][current_chr] != UINT32_MAX) {
-            frags[i].seek(source_chr[i][current_chr], 0);
-        }
+        frags[i].seek(source_chr[i][current_chr], 0);
     }
     return true;
 }
 
 uint32_t MergeFragments::currentChr() const { return current_chr; }
 
+uint32_t MergeFragments::buildTree(uint32_t node) {
+    if (node >= frags.size()) return node - frags.size();
+    uint32_t left = buildTree(2 * node);
+    uint32_t right = buildTree(2 * node + 1);
+    if (beats(left, right)) {
+        tree[node] = right;
+        return left;
+    }
+    tree[node] = left;
+    return right;
+}
+
+void MergeFragments::replayTree(uint32_t input) {
+    uint32_t winner = input;
+    for (uint32_t node = (input + frags.size()) / 2; node > 0; node /= 2) {
+        if (beats(tree[node], winner)) std::swap(tree[node], winner);
+    }
+    tree[0] = winner;
+}
+
 bool MergeFragments::load() {
-    // Try loading data from our existing available set
-    cur_idx += capacity();
-
-    // If we've run out of data, load and sort some more
-    if (cur_idx >= available) {
-        // Move leftover data to start of buffer
-        uint32_t leftovers = loaded - available;
-        std::memmove(start.data(), start.data() + available, sizeof(uint32_t) * leftovers);
-        std::memmove(end.data(), end.data() + available, sizeof(uint32_t) * leftovers);
-        std::memmove(cell.data(), cell.data() + available, sizeof(uint32_t) * leftovers);
-
-        loaded = leftovers;
-        available = 0;
-        // Use min-heap of (start_coord, loader_idx) to load 2N chunks
+    if (!tree_valid) {
         for (uint32_t i = 0; i < frags.size(); i++) {
-            heap[i] = {frags[i].peek_start(), i};
+            key[i] = frags[i].peek_start();
         }
-        dary_heap::make_heap<4>(heap.begin(), heap.end(), std::greater<>{});
+        tree[0] = buildTree(1);
+        tree_valid = true;
+    }
 
-        for (uint32_t i = 0; i < chunks_per_input * frags.size(); i++) {
-            if (heap.front().first == UINT32_MAX) break; // No more data to load in this chromosome
-            uint32_t idx = heap.front().second;
-            if (loaded + chunk_size > start.size()) {
-                throw std::runtime_error("MergeFragments: Not enough space to load input chunk");
-            }
-            loaded += frags[idx].load_chunk(
-                start.data() + loaded, end.data() + loaded, cell.data() + loaded
-            );
-            // Update the chunk info and put back in heap
-            heap.front().first = frags[idx].peek_start();
-            dary_heap::pop_heap<4>(heap.begin(), heap.end(), std::greater<>{});
-            dary_heap::push_heap<4>(heap.begin(), heap.end(), std::greater<>{});
+    loaded = 0;
+    while (loaded < load_size) {
+        uint32_t winner = tree[0];
+        if (key[winner] == UINT32_MAX) break; // No more data to load in this chromosome
+
+        // The runner-up is the best of the inputs that lost to the winner on its path
+        uint32_t runner_up = tree[(winner + frags.size()) / 2];
+        for (uint32_t node = (winner + frags.size()) / 4; node > 0; node /= 2) {
+            if (beats(tree[node], runner_up)) runner_up = tree[node];
         }
-        // Sort the input data
-        lsdRadixSortArrays<uint32_t, uint32_t, uint32_t>(
-            loaded, start, end, cell, start_buf, end_buf, cell_buf
-        );
-
-        // Find how much of the data is guaranteed to be in the final output ordering
-        // We can use the heap rather than calling peek_start() again for each fragment
-        uint32_t max_sorted_start = UINT32_MAX;
-        for (uint32_t i = 0; i < frags.size(); i++) {
-            max_sorted_start = std::min(max_sorted_start, heap[i].first);
+
+        // Copy the winner's run of fragments that sort before the runner-up
+        Cursor &f = frags[winner];
+        const uint32_t *in_start = f.startData();
+        const uint32_t limit = key[runner_up];
+        const bool ties_win = winner < runner_up;
+        uint32_t max_run = std::min(f.available(), load_size - loaded);
+        uint32_t run = 1;
+        while (run < max_run && (in_start[run] < limit || (ties_win && in_start[run] == limit))) {
+            run++;
         }
-        available = std::upper_bound(start.begin(), start.begin() + loaded, max_sorted_start) -
-                    start.begin();
+        std::memmove(start.data() + loaded, in_start, sizeof(uint32_t) * run);
+        std::memmove(end.data() + loaded, f.endData(), sizeof(uint32_t) * run);
+        const uint32_t *in_cell = f.cellData();
+        for (uint32_t i = 0; i < run; i++) {
+            cell[loaded + i] = in_cell[i] + f.cell_offset;
+        }
+        loaded += run;
+        f.advance(run);
 
-        cur_idx = 0;
+        key[winner] = f.peek_start();
+        replayTree(winner);
     }
+    return loaded > 0;
+}
+
+uint32_t MergeFragments::capacity() const { return loaded; }
+
+uint32_t *MergeFragments::cellData() { return cell.data(); }
+uint32_t *MergeFragments::startData() { return start.data(); }
+uint32_t *MergeFragments::endData() { return end.data(); }
 
-    return cur_idx < available;
+namespace {
+
+// One source for a round of mergeFragmentsHierarchical: either an original input, or the
+// output directory of a merge from an earlier round
+struct MergeSource {
+    uint32_t input;
+    std::string dir;
+};
+
+std::unique_ptr<FragmentLoader> openMergeSource(
+    const MergeSource &src,
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_input
+) {
+    if (src.dir.empty()) return open_input(src.input);
+    FileReaderBuilder rb(src.dir);
+    return std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(rb));
 }
 
-uint32_t MergeFragments::capacity() const { return std::min(available - cur_idx, load_size); }
+} // namespace
+
+std::unique_ptr<FragmentLoader> mergeFragmentsHierarchical(
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_input,
+    uint32_t n_inputs,
+    const std::vector<std::string> &chr_order,
+    const std::string &tmp_dir,
+    uint32_t max_open,
+    uint32_t threads,
+    const ExecutionContext &ctx
+) {
+    if (max_open < 2)
+        throw std::invalid_argument("mergeFragmentsHierarchical: max_open must be >= 2");
+    if (n_inputs == 0)
+        throw std::invalid_argument("mergeFragmentsHierarchical: no inputs to merge");
+
+    std::vector<MergeSource> sources;
+    for (uint32_t i = 0; i < n_inputs; i++) {
+        sources.push_back({i, ""});
+    }
+
+    for (uint32_t round = 0; sources.size() > max_open; round++) {
+        // Split into consecutive groups of near-equal size, so cell IDs stay in input order
+        uint32_t n_groups = (sources.size() + max_open - 1) / max_open;
+        std::vector<MergeSource> next(n_groups);
+        std::vector<std::exception_ptr> errors(n_groups);
+        auto merge_group = [&](uint32_t g) {
+            size_t begin = sources.size() * g / n_groups;
+            size_t end = sources.size() * (g + 1) / n_groups;
+            if (end - begin == 1) {
+                next[g] = sources[begin];
+                return;
+            }
+            try {
+                std::vector<std::unique_ptr<FragmentLoader>> group;
+                for (size_t i = begin; i < end; i++) {
+                    group.push_back(openMergeSource(sources[i], open_input));
+                }
+                MergeFragments merged(std::move(group), chr_order);
+                std_fs::path dir = std_fs::path(tmp_dir) / ("round" + std::to_string(round)) /
+                                   ("group" + std::to_string(g));
+                FileWriterBuilder wb(dir.string());
+                StoredFragmentsWriter::createPacked(wb).write(merged, ctx);
+                next[g] = {0, dir.string()};
+            } catch (...) {
+                errors[g] = std::current_exception();
+            }
+        };
+
+        ResourceLease lease = ctx.acquireThreads(std::min(threads, n_groups));
+        if (lease.count() <= 1) {
+            for (uint32_t g = 0; g < n_groups; g++) {
+                merge_group(g);
+            }
+        } else {
+            std::atomic<uint32_t> task_id(0);
+            std::vector<std::thread> workers;
+            for (uint32_t i = 0; i < lease.count(); i++) {
+                workers.push_back(std::thread([&] {
+                    while (true) {
+                        uint32_t g = task_id.fetch_add(1);
+                        if (g >= n_groups) break;
+                        merge_group(g);
+                    }
+                }));
+            }
+            for (auto &w : workers) {
+                w.join();
+            }
+        }
+        for (auto &e : errors) {
+            if (e) std::rethrow_exception(e);
+        }
+        if (ctx.interrupted()) return nullptr;
+
+        // Intermediate results that were merged again are no longer needed
+        std::set<std::string> kept;
+        for (const auto &src : next) {
+            kept.insert(src.dir);
+        }
+        for (const auto &src : sources) {
+            if (!src.dir.empty() && !kept.count(src.dir)) std_fs::remove_all(src.dir);
+        }
+        sources = std::move(next);
+    }
+
+    if (sources.size() == 1) return openMergeSource(sources[0], open_input);
+    std::vector<std::unique_ptr<FragmentLoader>> final_inputs;
+    for (const auto &src : sources) {
+        final_inputs.push_back(openMergeSource(src, open_input));
+    }
+    return std::make_unique<MergeFragments>(std::move(final_inputs), chr_order);
+}
 
-uint32_t *MergeFragments::cellData() { return cell.data() + cur_idx; }
-uint32_t *MergeFragments::startData() { return start.data() + cur_idx; }
-uint32_t *MergeFragments::endData() { return end.data() + cur_idx; }
-} // namespace BPCells
\ No newline at end of file
+} // namespace BPCells
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <vector>
 
 #include "FragmentIterator.h"
@@ -12,23 +13,31 @@ namespace BPCells {
 // All inputs must have known cell counts, chr counts+names, and be seekable
 class MergeFragments : public FragmentLoader {
   private:
-    // Helper class to handle reading a fixed number of fragments at a time,
-    // but in bulk.
-    class ChunkedLoader {
+    // Read position within one input, reading directly from the input's loaded buffers
+    class Cursor {
         std::unique_ptr<FragmentLoader> frags;
-        uint32_t loaded = 0; // How many fragments are currently loaded and available to copy
-        const uint32_t cell_offset, chunk_size; 
+        uint32_t offset = 0, loaded = 0; // Next unread index and end of the input's buffers
+        bool active = false; // False if the input has no fragments on the current chromosome
 
       public:
-        ChunkedLoader(std::unique_ptr<FragmentLoader> &&loader, uint32_t cell_offset, uint32_t chunk_size);
-        // Copy fragments to the destinations (must have space for at least chunk_size elements)
-        // Return how many fragments were actually copied
-        uint32_t load_chunk(uint32_t *start, uint32_t *end, uint32_t *cell);
-        
-        // Return the next start coordinate without marking it loaded, or UINT32_MAX if no more available
-        uint32_t peek_start(); 
-
-        // Wrapper methods for internal fragments
+        const uint32_t cell_offset;
+
+        Cursor(std::unique_ptr<FragmentLoader> &&loader, uint32_t cell_offset);
+
+        // Return the next start coordinate without consuming it, or UINT32_MAX if there are
+        // no more fragments on the current chromosome
+        uint32_t peek_start();
+
+        // Pointers to the next unread fragments, and the number of them available.
+        // Only valid after peek_start() returns < UINT32_MAX
+        const uint32_t *startData() const { return frags->startData() + offset; }
+        const uint32_t *endData() const { return frags->endData() + offset; }
+        const uint32_t *cellData() const { return frags->cellData() + offset; }
+        uint32_t available() const { return loaded - offset; }
+        void advance(uint32_t count) { offset += count; }
+
+        // Wrapper methods for internal fragments. chr_id of UINT32_MAX marks the input
+        // as having no fragments on the current chromosome
         void seek(uint32_t chr_id, uint32_t base);
         void restart();
 
@@ -37,39 +46,40 @@ class MergeFragments : public FragmentLoader {
 
         const char *chrNames(uint32_t chr_id);
         const char *cellNames(uint32_t cell_id);
-
-        bool nextChr();
-
-        uint32_t currentChr() const;
     };
 
-    uint32_t const load_size, chunk_size, chunks_per_input;
+    uint32_t const load_size;
 
-    std::vector<ChunkedLoader> frags;
+    std::vector<Cursor> frags;
     std::vector<uint32_t> cell_id_offset;
 
     std::vector<std::string> chr_order; // Order of output chromosomes
     std::vector<std::vector<uint32_t>>
         source_chr; // source_chr[i][j] is the chr ID in frags[i] with name chr_order[j]
 
-    // Size these to 3 * chunk_size * frags.size() 
-    std::vector<uint32_t> start, end, cell, start_buf, end_buf, cell_buf;
-
-    // Heap of (start_coord, loader_idx) pairs to use in load() operation
-    std::vector<std::pair<uint32_t, uint32_t>> heap;
+    // Output buffers, sized to load_size
+    std::vector<uint32_t> start, end, cell;
+    uint32_t loaded = 0;
 
-    // Loaded is how many values are saved in the data buffers
-    // Available is how many of those are ready to output
-    // cur_idx is the current index that we are outputting
-    uint32_t loaded, available, cur_idx; 
+    // Loser tree over the inputs, keyed by (next start coordinate, input index).
+    // tree[0] is the current winner, and tree[1..N-1] hold the loser of each internal match,
+    // with input i sitting at implicit leaf N+i. Replacing the winner takes log2(N)
+    // comparisons, versus ~2*log2(N) for a binary heap.
+    std::vector<uint32_t> tree, key;
+    bool tree_valid = false;
     uint32_t current_chr = UINT32_MAX;
 
+    inline bool beats(uint32_t a, uint32_t b) const {
+        return key[a] < key[b] || (key[a] == key[b] && a < b);
+    }
+    uint32_t buildTree(uint32_t node);
+    void replayTree(uint32_t input);
+
   public:
     MergeFragments(
         std::vector<std::unique_ptr<FragmentLoader>> &&fragments,
         const std::vector<std::string> &chr_order,
-        uint32_t load_size = 1024, // Output load size
-        uint32_t chunk_size = 32 // Input load chunk size
+        uint32_t load_size = 1024 // Output load size
     );
 
     ~MergeFragments() = default;
@@ -89,15 +99,10 @@ class MergeFragments : public FragmentLoader {
     uint32_t currentChr() const override;
 
     // Load algorithm:
-    // 1. Add chunks_per_input * N chunks from the N input loaders into the cell, start, end vectors
-    //    - Always add the chunk with the smallest start coordinate
-    //    - Track what's the largest start coordinate added from any input loader.
-    //      The smallest of these coordinates well be the limit of our known-sorted data.
-    // 2. Sort all the fragments
-    // 3. Output fragments until we hit our start coordinate limit
-    //    - This is guaranteed to leave at most N chunks left over (at most 1 chunk for each input loader)
-    //    - This means if we have space for (chunks_per_input + 1)*N chunks, and add (chunks_per_input)*N chunks each time we can never overflow 
-    //      our buffers, and we'll never sort a fragment more than once
+    // Inputs are already sorted by start coordinate, so merge them with a loser tree rather
+    // than re-sorting. Each time an input wins, copy the whole run of its fragments that sort
+    // before the runner-up (the best loser on the winner's path to the root), then replay
+    // the winner's new key up the tree. Nothing is sorted or copied more than once.
     bool load() override;
 
     uint32_t capacity() const override;
@@ -107,4 +112,27 @@ class MergeFragments : public FragmentLoader {
     uint32_t *endData() override;
 };
 
+// Merge many fragment sources while keeping at most `max_open` of them open at once, to stay
+// under file handle limits when merging hundreds of samples.
+// Inputs are merged in consecutive groups of up to max_open, each written as packed fragments
+// to a subdirectory of `tmp_dir`. The results are merged again in further rounds until at
+// most max_open sources remain, which are returned as a MergeFragments (or the sole remaining
+// source). Groups within a round are merged in parallel on up to `threads` threads taken from
+// ctx, so up to threads * max_open inputs can be open at a time.
+// Cell IDs and names match a flat MergeFragments over all inputs.
+// - open_input(i) must return a new seekable loader for input i. It is called from worker
+//   threads when threads > 1
+// - tmp_dir must outlive the returned loader. Intermediate rounds are deleted as soon as they
+//   have been merged, but the caller must remove tmp_dir when done
+// Returns NULL if interrupted through ctx
+std::unique_ptr<FragmentLoader> mergeFragmentsHierarchical(
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_input,
+    uint32_t n_inputs,
+    const std::vector<std::string> &chr_order,
+    const std::string &tmp_dir,
+    uint32_t max_open = 64,
+    uint32_t threads = 1,
+    const ExecutionContext &ctx = {}
+);
+
 } // end namespace BPCells
\ No newline at end of file
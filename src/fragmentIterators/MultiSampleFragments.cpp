@@ -0,0 +1,323 @@
+#include "MultiSampleFragments.h"
+#include <numeric>
+#include <unordered_map>
+
+#include "../arrayIO/bp128.h"
+#include "../arrayIO/checksum.h"
+#include "MergeFragments.h"
+#include "StoredFragments.h"
+
+namespace BPCells {
+
+namespace {
+
+// Presents a sequence of samples as one loader for StoredFragmentsWriter. Chromosome c of
+// sample s becomes chromosome s * chr_order.size() + c, and cell IDs are offset by the number
+// of cells in earlier samples. Samples are opened one at a time as the writer reaches them.
+class SampleConcat : public FragmentLoader {
+  private:
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_sample;
+    const uint32_t n_samples;
+    const std::vector<std::string> &chr_order;
+    std::unordered_map<std::string, uint32_t> chr_lookup;
+
+    std::unique_ptr<FragmentLoader> sample;
+    uint32_t sample_id = 0;
+    uint32_t current_chr = UINT32_MAX;
+    uint32_t cell_offset = 0;
+
+    // Record the cell names of the current sample and close it
+    void finishSample() {
+        int cell_count = sample->cellCount();
+        for (uint32_t i = 0; cell_count < 0 || i < (uint32_t)cell_count; i++) {
+            const char *name = sample->cellNames(i);
+            if (name == NULL) break;
+            cell_names.push_back(name);
+        }
+        sample_cell_ptr.push_back(cell_names.size());
+        sample.reset();
+        sample_id += 1;
+    }
+
+  public:
+    std::vector<std::string> cell_names;
+    std::vector<uint64_t> sample_cell_ptr = {0};
+
+    SampleConcat(
+        const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_sample,
+        uint32_t n_samples,
+        const std::vector<std::string> &chr_order
+    )
+        : open_sample(open_sample)
+        , n_samples(n_samples)
+        , chr_order(chr_order) {
+        for (uint32_t i = 0; i < chr_order.size(); i++) {
+            chr_lookup[chr_order[i]] = i;
+        }
+    }
+
+    bool isSeekable() const override { return false; }
+    void seek(uint32_t chr_id, uint32_t base) override {
+        throw std::logic_error("SampleConcat: can't seek");
+    }
+
+    void restart() override {
+        sample.reset();
+        sample_id = 0;
+        current_chr = UINT32_MAX;
+        cell_names.clear();
+        sample_cell_ptr = {0};
+    }
+
+    int chrCount() const override { return n_samples * chr_order.size(); }
+    int cellCount() const override { return -1; }
+
+    // Only the shared chromosome list is named, so the writer stores chr_names once rather
+    // than once per sample
+    const char *chrNames(uint32_t chr_id) override {
+        if (chr_id >= chr_order.size()) return NULL;
+        return chr_order[chr_id].c_str();
+    }
+    const char *cellNames(uint32_t cell_id) override {
+        if (cell_id >= cell_names.size()) return NULL;
+        return cell_names[cell_id].c_str();
+    }
+
+    bool nextChr() override {
+        while (true) {
+            if (!sample) {
+                if (sample_id >= n_samples) return false;
+                sample = open_sample(sample_id);
+                cell_offset = cell_names.size();
+            }
+            if (sample->nextChr()) {
+                const char *name = sample->chrNames(sample->currentChr());
+                auto it = name == NULL ? chr_lookup.end() : chr_lookup.find(name);
+                if (it == chr_lookup.end()) {
+                    throw std::runtime_error(
+                        "writeMultiSampleFragments: Sample index " + std::to_string(sample_id) +
+                        " has chromosome " + std::string(name == NULL ? "NULL" : name) +
+                        " which is not included in the chromosome ordering."
+                    );
+                }
+                current_chr = sample_id * chr_order.size() + it->second;
+                return true;
+            }
+            finishSample();
+        }
+    }
+    uint32_t currentChr() const override { return current_chr; }
+
+    bool load() override {
+        if (!sample->load()) return false;
+        uint32_t *cell = sample->cellData();
+        uint32_t capacity = sample->capacity();
+        for (uint32_t i = 0; i < capacity; i++) {
+            cell[i] += cell_offset;
+        }
+        return true;
+    }
+    uint32_t capacity() const override { return sample->capacity(); }
+
+    uint32_t *cellData() override { return sample->cellData(); }
+    uint32_t *startData() override { return sample->startData(); }
+    uint32_t *endData() override { return sample->endData(); }
+};
+
+// Shifts cell IDs from container-wide numbering to numbering within one sample
+class SampleCells : public FragmentLoaderWrapper {
+  private:
+    uint32_t cell_offset;
+
+  public:
+    SampleCells(std::unique_ptr<FragmentLoader> &&loader, uint32_t cell_offset)
+        : FragmentLoaderWrapper(std::move(loader))
+        , cell_offset(cell_offset) {}
+
+    bool load() override {
+        if (!loader->load()) return false;
+        uint32_t *cell = loader->cellData();
+        uint32_t capacity = loader->capacity();
+        for (uint32_t i = 0; i < capacity; i++) {
+            cell[i] -= cell_offset;
+        }
+        return true;
+    }
+};
+
+std::vector<std::string> readStrings(StringReader &reader) {
+    std::vector<std::string> ret;
+    for (uint64_t i = 0; i < reader.size(); i++) {
+        ret.push_back(reader.get(i));
+    }
+    return ret;
+}
+
+std::vector<uint64_t> readULongs(ULongReader &&reader) {
+    std::vector<uint64_t> ret(reader.size());
+    for (auto &x : ret) {
+        x = reader.read_one();
+    }
+    return ret;
+}
+
+} // namespace
+
+void writeMultiSampleFragments(
+    WriterBuilder &wb,
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_sample,
+    const std::vector<std::string> &sample_names,
+    const std::vector<std::string> &chr_order,
+    uint32_t buffer_size,
+    const ExecutionContext &ctx
+) {
+    SampleConcat samples(open_sample, sample_names.size(), chr_order);
+    StoredFragmentsWriter::createPacked(wb, buffer_size).write(samples, ctx);
+    if (ctx.interrupted()) return;
+
+    wb.createStringWriter("sample_names")->write(VecStringReader(sample_names));
+    ULongWriter sample_cell_ptr = wb.createULongWriter("sample_cell_ptr");
+    for (auto ptr : samples.sample_cell_ptr) {
+        sample_cell_ptr.write_one(ptr);
+    }
+    sample_cell_ptr.finalize();
+
+    // Written last, replacing the version from createPacked
+    wb.writeVersion("packed-fragments-multi-v1");
+}
+
+MultiSampleFragments::MultiSampleFragments(
+    ReaderBuilder &rb_in, uint32_t load_size, uint32_t view_buffer_size
+)
+    : load_size(load_size)
+    , view_buffer_size(view_buffer_size) {
+    // Verify CRC32C checksums lazily as data is read, for arrays that have them
+    ChecksumReaderBuilder rb(rb_in);
+    if (rb.readVersion() != "packed-fragments-multi-v1") {
+        throw std::runtime_error(
+            std::string("Version does not match packed-fragments-multi-v1: ") + rb.readVersion()
+        );
+    }
+
+    chr_names = readStrings(*rb.openStringReader("chr_names"));
+    cell_names = readStrings(*rb.openStringReader("cell_names"));
+    sample_names = readStrings(*rb.openStringReader("sample_names"));
+    chr_ptr = readULongs(rb.openULongReader("chr_ptr"));
+    sample_cell_ptr = readULongs(rb.openULongReader("sample_cell_ptr"));
+
+    if (chr_ptr.size() != 2 * sample_names.size() * chr_names.size() ||
+        sample_cell_ptr.size() != sample_names.size() + 1 ||
+        sample_cell_ptr.back() != cell_names.size()) {
+        throw std::runtime_error("MultiSampleFragments: sample table does not match contents");
+    }
+    for (auto ptr : chr_ptr) {
+        fragment_count = std::max(fragment_count, ptr);
+    }
+
+    cell_data = SharedNumReader<uint32_t>::share(rb.openUIntReader("cell_data"));
+    cell_idx = SharedNumReader<uint32_t>::share(rb.openUIntReader("cell_idx"));
+    cell_idx_offsets = SharedNumReader<uint64_t>::share(rb.openULongReader("cell_idx_offsets"));
+    start_data = SharedNumReader<uint32_t>::share(rb.openUIntReader("start_data"));
+    start_idx = SharedNumReader<uint32_t>::share(rb.openUIntReader("start_idx"));
+    start_idx_offsets =
+        SharedNumReader<uint64_t>::share(rb.openULongReader("start_idx_offsets"));
+    start_starts = SharedNumReader<uint32_t>::share(rb.openUIntReader("start_starts"));
+    end_data = SharedNumReader<uint32_t>::share(rb.openUIntReader("end_data"));
+    end_idx = SharedNumReader<uint32_t>::share(rb.openUIntReader("end_idx"));
+    end_idx_offsets = SharedNumReader<uint64_t>::share(rb.openULongReader("end_idx_offsets"));
+    end_max = SharedNumReader<uint32_t>::share(rb.openUIntReader("end_max"));
+}
+
+template <class T>
+NumReader<T>
+MultiSampleFragments::view(const std::shared_ptr<typename SharedNumReader<T>::Source> &source) {
+    return NumReader<T>(
+        std::make_unique<SharedNumReader<T>>(source), view_buffer_size, view_buffer_size
+    );
+}
+
+uint32_t MultiSampleFragments::sampleCount() const { return sample_names.size(); }
+const std::vector<std::string> &MultiSampleFragments::sampleNames() const {
+    return sample_names;
+}
+const std::vector<std::string> &MultiSampleFragments::chrNames() const { return chr_names; }
+uint32_t MultiSampleFragments::sampleCellCount(uint32_t sample) const {
+    return sample_cell_ptr.at(sample + 1) - sample_cell_ptr.at(sample);
+}
+
+std::unique_ptr<FragmentLoader> MultiSampleFragments::openSample(uint32_t sample) {
+    if (sample >= sampleCount()) {
+        throw std::invalid_argument(
+            "MultiSampleFragments: sample index " + std::to_string(sample) + " out of range"
+        );
+    }
+    uint64_t n_chr = chr_names.size();
+    std::vector<uint64_t> sample_chr_ptr(
+        chr_ptr.begin() + 2 * sample * n_chr, chr_ptr.begin() + 2 * (sample + 1) * n_chr
+    );
+    std::vector<std::string> sample_cells(
+        cell_names.begin() + sample_cell_ptr[sample],
+        cell_names.begin() + sample_cell_ptr[sample + 1]
+    );
+
+    auto frags = std::make_unique<StoredFragmentsPacked>(
+        UIntReader(
+            std::make_unique<BP128UIntReader>(
+                view<uint32_t>(cell_data),
+                view<uint32_t>(cell_idx),
+                view<uint64_t>(cell_idx_offsets),
+                fragment_count
+            ),
+            load_size,
+            load_size
+        ),
+        UIntReader(
+            std::make_unique<BP128_D1_UIntReader>(
+                view<uint32_t>(start_data),
+                view<uint32_t>(start_idx),
+                view<uint64_t>(start_idx_offsets),
+                view<uint32_t>(start_starts),
+                fragment_count
+            ),
+            load_size,
+            load_size
+        ),
+        UIntReader(
+            std::make_unique<BP128UIntReader>(
+                view<uint32_t>(end_data),
+                view<uint32_t>(end_idx),
+                view<uint64_t>(end_idx_offsets),
+                fragment_count
+            ),
+            load_size,
+            load_size
+        ),
+        view<uint32_t>(end_max),
+        ConstNumReader<uint64_t>::create(sample_chr_ptr),
+        std::make_unique<VecStringReader>(chr_names),
+        std::make_unique<VecStringReader>(sample_cells)
+    );
+    return std::make_unique<SampleCells>(std::move(frags), sample_cell_ptr[sample]);
+}
+
+std::unique_ptr<FragmentLoader>
+MultiSampleFragments::openSamples(const std::vector<uint32_t> &samples) {
+    if (samples.empty()) {
+        throw std::invalid_argument("MultiSampleFragments: must open at least one sample");
+    }
+    if (samples.size() == 1) return openSample(samples[0]);
+
+    std::vector<std::unique_ptr<FragmentLoader>> loaders;
+    for (auto s : samples) {
+        loaders.push_back(openSample(s));
+    }
+    return std::make_unique<MergeFragments>(std::move(loaders), chr_names, load_size);
+}
+
+std::unique_ptr<FragmentLoader> MultiSampleFragments::openAll() {
+    std::vector<uint32_t> samples(sampleCount());
+    std::iota(samples.begin(), samples.end(), 0);
+    return openSamples(samples);
+}
+
+} // end namespace BPCells
@@ -0,0 +1,82 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../arrayIO/array_interfaces.h"
+#include "../arrayIO/shared_reader.h"
+#include "FragmentIterator.h"
+
+namespace BPCells {
+
+// Container holding many samples' packed fragments in one set of arrays (one directory or
+// HDF5 group), so opening hundreds of samples doesn't mean opening hundreds of directories.
+// Layout: the packed fragment arrays of each sample are concatenated in sample order, with
+// cell IDs numbered across all samples. Alongside the usual packed fragment arrays:
+// - chr_ptr: per-sample chromosome pointers, with sample s, chromosome c at
+//   2 * (s * chr_names.size() + c)
+// - chr_names: chromosome names shared by all samples
+// - cell_names: cell names of all samples, concatenated in sample order
+// - sample_names: one name per sample
+// - sample_cell_ptr: sample s has cells sample_cell_ptr[s] to sample_cell_ptr[s+1]-1
+// Version is packed-fragments-multi-v1
+
+// Write samples to a container.
+// - open_sample(i) must return a new loader for sample i. Samples are read one at a time
+//   and closed when done.
+// - chr_order gives the shared chromosome names. It is an error if a sample has chromosomes
+//   not in chr_order
+void writeMultiSampleFragments(
+    WriterBuilder &wb,
+    const std::function<std::unique_ptr<FragmentLoader>(uint32_t)> &open_sample,
+    const std::vector<std::string> &sample_names,
+    const std::vector<std::string> &chr_order,
+    uint32_t buffer_size = 1024,
+    const ExecutionContext &ctx = {}
+);
+
+// Read samples from a container. Every loader opened from this object reads through the same
+// open arrays, so any number of samples costs one file handle per array. For the same reason,
+// loaders from one container must not be used from different threads at once.
+// Loaders hold on to the shared arrays, so they may outlive this object but not `rb`
+class MultiSampleFragments {
+  private:
+    uint32_t load_size, view_buffer_size;
+    std::vector<std::string> chr_names, cell_names, sample_names;
+    std::vector<uint64_t> chr_ptr, sample_cell_ptr;
+    uint64_t fragment_count = 0;
+
+    std::shared_ptr<SharedNumReader<uint32_t>::Source> cell_data, cell_idx, start_data,
+        start_idx, start_starts, end_data, end_idx, end_max;
+    std::shared_ptr<SharedNumReader<uint64_t>::Source> cell_idx_offsets, start_idx_offsets,
+        end_idx_offsets;
+
+    template <class T>
+    NumReader<T> view(const std::shared_ptr<typename SharedNumReader<T>::Source> &source);
+
+  public:
+    // load_size -- number of fragments returned per load
+    // view_buffer_size -- buffer size for each sample's reads from the shared arrays
+    MultiSampleFragments(
+        ReaderBuilder &rb, uint32_t load_size = 1024, uint32_t view_buffer_size = 1024
+    );
+
+    uint32_t sampleCount() const;
+    const std::vector<std::string> &sampleNames() const;
+    const std::vector<std::string> &chrNames() const;
+    // Number of cells in a sample
+    uint32_t sampleCellCount(uint32_t sample) const;
+
+    // Open one sample, with cell IDs numbered from 0 within the sample
+    std::unique_ptr<FragmentLoader> openSample(uint32_t sample);
+
+    // Open a merged view of several samples. Cell IDs are numbered consecutively in the order
+    // of `samples`, same as a MergeFragments over the individual samples
+    std::unique_ptr<FragmentLoader> openSamples(const std::vector<uint32_t> &samples);
+
+    // Open a merged view of all samples
+    std::unique_ptr<FragmentLoader> openAll();
+};
+
+} // end namespace BPCells
@@ -1,7 +1,10 @@
 #include <atomic>
 
 #include "StoredFragments.h"
+#include "../arrayIO/checksum.h"
+#include "../arrayIO/pipelined_writer.h"
 #include "../bitpacking/bp128.h"
+#include "../utils/radix_sort.h"
 
 namespace BPCells {
 
@@ -22,26 +25,50 @@ StoredFragmentsBase::StoredFragmentsBase(
     , chr_names(std::move(chr_names))
     , cell_names(std::move(cell_names)) {}
 
-// Read end_max_buf from end_max iterator, making it equal to the values between
-// start_idx and end_idx
-void StoredFragmentsBase::readEndMaxBuf(uint64_t start_idx, uint64_t end_idx) {
+void StoredFragmentsBase::instrument(InstrumentNode &node) {
+    cell.instrument(node.addChild("cell"));
+    start.instrument(node.addChild("start"));
+    end.instrument(node.addChild("end"));
+    end_max.instrument(node.addChild("end_max"));
+    if (has_sorted_ends) {
+        sorted_end.instrument(node.addChild("sorted_end"));
+        sorted_end_cell.instrument(node.addChild("sorted_end_cell"));
+    }
+}
+
+void StoredFragmentsBase::setSortedEnds(UIntReader &&end, UIntReader &&cell, UIntReader &&end_min) {
+    sorted_end = std::move(end);
+    sorted_end_cell = std::move(cell);
+    sorted_end_min = std::move(end_min);
+    has_sorted_ends = true;
+}
+
+// Read the values of `reader` for the blocks of 128 covering start_idx to end_idx
+static void readBlockBuf(
+    UIntReader &reader, uint64_t start_idx, uint64_t end_idx, std::vector<uint32_t> &buf
+) {
     if (start_idx == end_idx) {
-        end_max_buf.resize(0);
+        buf.resize(0);
         return;
     }
-    // Read the end_max buffer
-    end_max_buf.resize((end_idx - 1) / 128 - start_idx / 128 + 1);
-    end_max.seek(start_idx / 128);
+    buf.resize((end_idx - 1) / 128 - start_idx / 128 + 1);
+    reader.seek(start_idx / 128);
     uint64_t i = 0;
     while (true) {
-        end_max.ensureCapacity(1);
-        uint64_t load_amount = std::min(end_max.capacity(), (uint64_t) end_max_buf.size() - i);
+        reader.ensureCapacity(1);
+        uint64_t load_amount = std::min(reader.capacity(), (uint64_t) buf.size() - i);
 
-        std::memmove(&end_max_buf[i], end_max.data(), load_amount * sizeof(uint32_t));
+        std::memmove(&buf[i], reader.data(), load_amount * sizeof(uint32_t));
         i += load_amount;
-        if (i >= end_max_buf.size()) break;
-        end_max.advance(load_amount);
+        if (i >= buf.size()) break;
+        reader.advance(load_amount);
     }
+}
+
+// Read end_max_buf from end_max iterator, making it equal to the values between
+// start_idx and end_idx
+void StoredFragmentsBase::readEndMaxBuf(uint64_t start_idx, uint64_t end_idx) {
+    readBlockBuf(end_max, start_idx, end_idx, end_max_buf);
     // Handle starting a chromosome on a non-multiple of 128, such end_max[0]
     // may be the max of the prior chromosome rather than max of the new one
     if (start_idx % 128 != 0 && end_max_buf.size() > 1) {
@@ -49,24 +76,48 @@ void StoredFragmentsBase::readEndMaxBuf(uint64_t start_idx, uint64_t end_idx) {
     }
 }
 
+void StoredFragmentsBase::readSortedMinBuf(uint64_t start_idx, uint64_t end_idx) {
+    readBlockBuf(sorted_end_min, start_idx, end_idx, sorted_min_buf);
+    // The first block may start with ends from the prior chromosome
+    if (start_idx % 128 != 0 && !sorted_min_buf.empty()) sorted_min_buf[0] = 0;
+}
+
+void StoredFragmentsBase::seekSortedEnds(uint64_t idx) {
+    sorted_end.seek(idx);
+    sorted_end_cell.seek(idx);
+    sorted_idx = idx;
+    sorted_capacity = 0;
+}
+
 bool StoredFragmentsBase::isSeekable() const { return true; }
 void StoredFragmentsBase::seek(uint32_t chr_id, uint32_t base) {
+    if ((int64_t)chr_id >= chrCount()) {
+        // Seeking to a chromosome larger than exists in the fragments.
+        // Make it so next load and nextChr calls will return false.
+        // (Checked first, since current_chr is also UINT32_MAX right after restart)
+        current_chr = chr_id;
+        current_idx = UINT64_MAX;
+        sorted_idx = UINT64_MAX;
+        chr_start_ptr = 0;
+        chr_end_ptr = 0;
+        return;
+    }
     if (chr_id != current_chr) {
-        if ((int64_t)chr_id >= chrCount()) {
-            // Seeking to a chromosome larger than exists in the fragments.
-            // Make it so next load and nextChr calls will return false
-            current_chr = chr_id;
-            current_idx = UINT64_MAX;
-            chr_start_ptr = 0;
-            chr_end_ptr = 0;
-            return;
-        }
         current_chr = chr_id;
         chr_ptr.seek(chr_id * 2);
         chr_start_ptr = chr_ptr.read_one();
         chr_end_ptr = chr_ptr.read_one();
 
         readEndMaxBuf(chr_start_ptr, chr_end_ptr);
+        if (has_sorted_ends) readSortedMinBuf(chr_start_ptr, chr_end_ptr);
+    }
+
+    if (has_sorted_ends) {
+        // Start from the last block whose first end is < base
+        uint64_t block = std::lower_bound(sorted_min_buf.begin(), sorted_min_buf.end(), base) -
+                         sorted_min_buf.begin();
+        if (block > 0) block -= 1;
+        seekSortedEnds(std::max(chr_start_ptr, (chr_start_ptr / 128 + block) * 128));
     }
 
     // Binary search for base in end_max
@@ -87,6 +138,7 @@ void StoredFragmentsBase::seek(uint32_t chr_id, uint32_t base) {
 void StoredFragmentsBase::restart() {
     current_chr = UINT32_MAX;
     current_idx = UINT64_MAX;
+    sorted_idx = UINT64_MAX;
     chr_ptr.seek(0);
 }
 
@@ -101,6 +153,7 @@ bool StoredFragmentsBase::nextChr() {
     if ((int64_t)current_chr >= chrCount()) {
         current_chr -= 1;
         current_idx = UINT64_MAX;
+        sorted_idx = UINT64_MAX;
         return false;
     }
 
@@ -118,6 +171,10 @@ bool StoredFragmentsBase::nextChr() {
     }
     current_idx = chr_start_ptr;
     readEndMaxBuf(chr_start_ptr, chr_end_ptr);
+    if (has_sorted_ends) {
+        if (sorted_idx != chr_start_ptr) seekSortedEnds(chr_start_ptr);
+        readSortedMinBuf(chr_start_ptr, chr_end_ptr);
+    }
     return true;
 }
 uint32_t StoredFragmentsBase::currentChr() const { return current_chr; }
@@ -128,6 +185,33 @@ uint32_t *StoredFragmentsBase::cellData() { return cell.data(); }
 uint32_t *StoredFragmentsBase::startData() { return start.data(); }
 uint32_t *StoredFragmentsBase::endData() { return end.data(); }
 
+bool StoredFragmentsBase::hasSortedEnds() const { return has_sorted_ends; }
+
+bool StoredFragmentsBase::loadSortedEnds() {
+    if (!has_sorted_ends || sorted_idx >= chr_end_ptr) {
+        return false;
+    }
+    sorted_end.advance(sorted_capacity);
+    sorted_end_cell.advance(sorted_capacity);
+
+    if (sorted_end.capacity() == 0) sorted_end.ensureCapacity(1);
+    if (sorted_end_cell.capacity() == 0) sorted_end_cell.ensureCapacity(1);
+
+    sorted_capacity =
+        std::min({sorted_end.capacity(), sorted_end_cell.capacity(), chr_end_ptr - sorted_idx});
+    sorted_idx += sorted_capacity;
+    return true;
+}
+
+uint32_t StoredFragmentsBase::sortedEndCapacity() const { return sorted_capacity; }
+uint32_t *StoredFragmentsBase::sortedEndData() { return sorted_end.data(); }
+uint32_t *StoredFragmentsBase::sortedEndCellData() { return sorted_end_cell.data(); }
+
+static bool hasArray(ReaderBuilder &rb, const std::string &name) {
+    std::vector<std::string> names = rb.listArrays();
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
 StoredFragments StoredFragments::openUnpacked(
     ReaderBuilder &rb,
     std::unique_ptr<StringReader> &&chr_names,
@@ -148,7 +232,7 @@ StoredFragments StoredFragments::openUnpacked(
     if (!chr_names) chr_names = rb.openStringReader("chr_names");
     if (!cell_names) cell_names = rb.openStringReader("cell_names");
 
-    return StoredFragments(
+    StoredFragments frags(
         rb.openUIntReader("cell"),
         rb.openUIntReader("start"),
         rb.openUIntReader("end"),
@@ -157,6 +241,14 @@ StoredFragments StoredFragments::openUnpacked(
         std::move(chr_names),
         std::move(cell_names)
     );
+    if (hasArray(rb, "sorted_end_min")) {
+        frags.setSortedEnds(
+            rb.openUIntReader("sorted_end"),
+            rb.openUIntReader("sorted_end_cell"),
+            rb.openUIntReader("sorted_end_min")
+        );
+    }
+    return frags;
 }
 
 bool StoredFragments::load() {
@@ -180,11 +272,13 @@ bool StoredFragments::load() {
 }
 
 StoredFragmentsPacked StoredFragmentsPacked::openPacked(
-    ReaderBuilder &rb,
+    ReaderBuilder &rb_in,
     uint32_t load_size,
     std::unique_ptr<StringReader> &&chr_names,
     std::unique_ptr<StringReader> &&cell_names
 ) {
+    // Verify CRC32C checksums lazily as data is read, for arrays that have them
+    ChecksumReaderBuilder rb(rb_in);
     ULongReader chr_ptr, start_idx_offsets, end_idx_offsets, cell_idx_offsets;
     if (rb.readVersion() == "packed-fragments-v1") {
         chr_ptr = rb.openUIntReader("chr_ptr").convert<uint64_t>();
@@ -211,7 +305,7 @@ StoredFragmentsPacked StoredFragmentsPacked::openPacked(
     if (!chr_names) chr_names = rb.openStringReader("chr_names");
     if (!cell_names) cell_names = rb.openStringReader("cell_names");
 
-    return StoredFragmentsPacked(
+    StoredFragmentsPacked frags(
         UIntReader(
             std::make_unique<BP128UIntReader>(
                 rb.openUIntReader("cell_data"),
@@ -248,6 +342,33 @@ StoredFragmentsPacked StoredFragmentsPacked::openPacked(
         std::move(chr_names),
         std::move(cell_names)
     );
+    if (hasArray(rb, "sorted_end_min")) {
+        frags.setSortedEnds(
+            UIntReader(
+                std::make_unique<BP128_D1_UIntReader>(
+                    rb.openUIntReader("sorted_end_data"),
+                    rb.openUIntReader("sorted_end_idx"),
+                    rb.openULongReader("sorted_end_idx_offsets"),
+                    rb.openUIntReader("sorted_end_starts"),
+                    count
+                ),
+                load_size,
+                load_size
+            ),
+            UIntReader(
+                std::make_unique<BP128UIntReader>(
+                    rb.openUIntReader("sorted_end_cell_data"),
+                    rb.openUIntReader("sorted_end_cell_idx"),
+                    rb.openULongReader("sorted_end_cell_idx_offsets"),
+                    count
+                ),
+                load_size,
+                load_size
+            ),
+            rb.openUIntReader("sorted_end_min")
+        );
+    }
+    return frags;
 }
 
 bool StoredFragmentsPacked::load() {
@@ -299,9 +420,18 @@ StoredFragmentsWriter::StoredFragmentsWriter(
     , cell_names(std::move(cell_names))
     , subtract_start_from_end(subtract_start_from_end) {}
 
-StoredFragmentsWriter StoredFragmentsWriter::createUnpacked(WriterBuilder &wb) {
+void StoredFragmentsWriter::setSortedEnds(
+    UIntWriter &&end, UIntWriter &&cell, UIntWriter &&end_min
+) {
+    sorted_end = std::move(end);
+    sorted_end_cell = std::move(cell);
+    sorted_end_min = std::move(end_min);
+    write_sorted_ends = true;
+}
+
+StoredFragmentsWriter StoredFragmentsWriter::createUnpacked(WriterBuilder &wb, bool sorted_ends) {
     wb.writeVersion("unpacked-fragments-v2");
-    return StoredFragmentsWriter(
+    StoredFragmentsWriter w(
         wb.createUIntWriter("cell"),
         wb.createUIntWriter("start"),
         wb.createUIntWriter("end"),
@@ -311,46 +441,142 @@ StoredFragmentsWriter StoredFragmentsWriter::createUnpacked(WriterBuilder &wb) {
         wb.createStringWriter("cell_names"),
         false
     );
+    if (sorted_ends) {
+        w.setSortedEnds(
+            wb.createUIntWriter("sorted_end"),
+            wb.createUIntWriter("sorted_end_cell"),
+            wb.createUIntWriter("sorted_end_min")
+        );
+    }
+    return w;
 }
 
-StoredFragmentsWriter StoredFragmentsWriter::createPacked(WriterBuilder &wb, uint32_t buffer_size) {
+StoredFragmentsWriter StoredFragmentsWriter::createPacked(
+    WriterBuilder &wb, uint32_t buffer_size, bool pipelined, bool sorted_ends
+) {
     wb.writeVersion("packed-fragments-v2");
 
-    return StoredFragmentsWriter(
-        UIntWriter(
-            std::make_unique<BP128UIntWriter>(
-                wb.createUIntWriter("cell_data"),
-                wb.createUIntWriter("cell_idx"),
-                wb.createULongWriter("cell_idx_offsets")
-            ),
-            buffer_size
+    UIntWriter cell(
+        std::make_unique<BP128UIntWriter>(
+            wb.createUIntWriter("cell_data"),
+            wb.createUIntWriter("cell_idx"),
+            wb.createULongWriter("cell_idx_offsets")
         ),
-        UIntWriter(
+        buffer_size
+    );
+    UIntWriter start(
+        std::make_unique<BP128_D1_UIntWriter>(
+            wb.createUIntWriter("start_data"),
+            wb.createUIntWriter("start_idx"),
+            wb.createULongWriter("start_idx_offsets"),
+            wb.createUIntWriter("start_starts")
+        ),
+        buffer_size
+    );
+    UIntWriter end(
+        std::make_unique<BP128UIntWriter>(
+            wb.createUIntWriter("end_data"),
+            wb.createUIntWriter("end_idx"),
+            wb.createULongWriter("end_idx_offsets")
+        ),
+        buffer_size
+    );
+
+    UIntWriter sorted_end, sorted_end_cell;
+    if (sorted_ends) {
+        sorted_end = UIntWriter(
             std::make_unique<BP128_D1_UIntWriter>(
-                wb.createUIntWriter("start_data"),
-                wb.createUIntWriter("start_idx"),
-                wb.createULongWriter("start_idx_offsets"),
-                wb.createUIntWriter("start_starts")
+                wb.createUIntWriter("sorted_end_data"),
+                wb.createUIntWriter("sorted_end_idx"),
+                wb.createULongWriter("sorted_end_idx_offsets"),
+                wb.createUIntWriter("sorted_end_starts")
             ),
             buffer_size
-        ),
-        UIntWriter(
+        );
+        sorted_end_cell = UIntWriter(
             std::make_unique<BP128UIntWriter>(
-                wb.createUIntWriter("end_data"),
-                wb.createUIntWriter("end_idx"),
-                wb.createULongWriter("end_idx_offsets")
+                wb.createUIntWriter("sorted_end_cell_data"),
+                wb.createUIntWriter("sorted_end_cell_idx"),
+                wb.createULongWriter("sorted_end_cell_idx_offsets")
             ),
             buffer_size
-        ),
+        );
+    }
+
+    if (pipelined) {
+        // Hand off large batches so thread synchronization is negligible next to packing
+        uint64_t batch_size = std::max<uint64_t>(buffer_size, 1 << 16);
+        auto pipeline = [batch_size](UIntWriter &&w) {
+            return UIntWriter(
+                std::make_unique<PipelinedNumWriter<uint32_t>>(std::move(w), batch_size),
+                batch_size
+            );
+        };
+        cell = pipeline(std::move(cell));
+        start = pipeline(std::move(start));
+        end = pipeline(std::move(end));
+        if (sorted_ends) {
+            sorted_end = pipeline(std::move(sorted_end));
+            sorted_end_cell = pipeline(std::move(sorted_end_cell));
+        }
+    }
+
+    StoredFragmentsWriter w(
+        std::move(cell),
+        std::move(start),
+        std::move(end),
         wb.createUIntWriter("end_max"),
         wb.createULongWriter("chr_ptr"),
         wb.createStringWriter("chr_names"),
         wb.createStringWriter("cell_names"),
         true
     );
+    if (sorted_ends) {
+        w.setSortedEnds(
+            std::move(sorted_end), std::move(sorted_end_cell), wb.createUIntWriter("sorted_end_min")
+        );
+    }
+    return w;
+}
+
+void StoredFragmentsWriter::flushSortedEnds(uint32_t max_end) {
+    uint32_t n = pending_end.size();
+    if (n == 0) return;
+    pending_end_buf.resize(n);
+    pending_cell_buf.resize(n);
+    lsdRadixSortArrays<uint32_t, uint32_t>(
+        n, pending_end, pending_cell, pending_end_buf, pending_cell_buf
+    );
+    uint32_t count =
+        std::upper_bound(pending_end.begin(), pending_end.end(), max_end) - pending_end.begin();
+
+    // Record the first end of each block of 128
+    for (uint64_t i = (128 - sorted_idx % 128) % 128; i < count; i += 128) {
+        sorted_end_min.write_one(pending_end[i]);
+    }
+
+    uint64_t write_capacity = std::min(sorted_end.maxCapacity(), sorted_end_cell.maxCapacity());
+    for (uint64_t written = 0; written < count;) {
+        uint64_t write_amount = std::min<uint64_t>(write_capacity, count - written);
+        sorted_end.ensureCapacity(write_amount);
+        sorted_end_cell.ensureCapacity(write_amount);
+        std::memmove(
+            sorted_end.data(), pending_end.data() + written, write_amount * sizeof(uint32_t)
+        );
+        std::memmove(
+            sorted_end_cell.data(), pending_cell.data() + written, write_amount * sizeof(uint32_t)
+        );
+        sorted_end.advance(write_amount);
+        sorted_end_cell.advance(write_amount);
+        written += write_amount;
+    }
+    sorted_idx += count;
+    pending_end.erase(pending_end.begin(), pending_end.begin() + count);
+    pending_cell.erase(pending_cell.begin(), pending_cell.begin() + count);
 }
 
-void StoredFragmentsWriter::write(FragmentLoader &fragments, std::atomic<bool> *user_interrupt) {
+void StoredFragmentsWriter::write(FragmentLoader &fragments, const ExecutionContext &ctx) {
+    InstrumentTimer timer(ctx.instrumentation.get());
     uint32_t cur_end_max = 0;
     uint32_t prev_end_max = 0;
     uint64_t idx = 0;
@@ -404,6 +630,14 @@ void StoredFragmentsWriter::write(FragmentLoader &fragments, std::atomic<bool> *
                 cur_end_max = std::max(cur_end_max, in_end_data[i]);
             }
 
+            if (write_sorted_ends) {
+                // Later fragments start at or after the last start here, so they all end
+                // after it and any pending end <= that start is final
+                pending_end.insert(pending_end.end(), in_end_data, in_end_data + capacity);
+                pending_cell.insert(pending_cell.end(), in_cell_data, in_cell_data + capacity);
+                flushSortedEnds(in_start_data[capacity - 1]);
+            }
+
             if (subtract_start_from_end) {
                 uint64_t j;
                 for (j = 0; j + 128 <= capacity; j += 128) {
@@ -435,9 +669,14 @@ void StoredFragmentsWriter::write(FragmentLoader &fragments, std::atomic<bool> *
             }
 
             idx += capacity;
+            if (ctx.instrumentation) {
+                ctx.instrumentation->entries += capacity;
+                ctx.instrumentation->chunks += 1;
+            }
 
-            if (user_interrupt != NULL && *user_interrupt) return;
+            if (ctx.interrupted()) return;
         }
+        if (write_sorted_ends) flushSortedEnds(UINT32_MAX);
         chr_ptr_buf[chr_id * 2 + 1] = idx;
     }
     if (idx % 128 != 0) {
@@ -457,6 +696,11 @@ void StoredFragmentsWriter::write(FragmentLoader &fragments, std::atomic<bool> *
     end.finalize();
     end_max.finalize();
     chr_ptr.finalize();
+    if (write_sorted_ends) {
+        sorted_end.finalize();
+        sorted_end_cell.finalize();
+        sorted_end_min.finalize();
+    }
 
     // Get cell and chromosome names. This probably incurs a few extra copies,
     // but it shouldn't matter since writing the actual fragments should dominate cost
@@ -31,9 +31,23 @@ class StoredFragmentsBase : public FragmentLoader {
     uint32_t current_capacity = 0;
     uint64_t chr_start_ptr, chr_end_ptr;
 
+    // Optional sorted end stream. sorted_end_min[i] = sorted_end[i*128], and
+    // sorted_min_buf holds those values for the current chromosome
+    bool has_sorted_ends = false;
+    UIntReader sorted_end, sorted_end_cell, sorted_end_min;
+    std::vector<uint32_t> sorted_min_buf;
+    uint64_t sorted_idx = UINT64_MAX;
+    uint32_t sorted_capacity = 0;
+
     // Read end_max_buf from end_max iterator, making it equal to the values between
     // start_idx and end_idx
     void readEndMaxBuf(uint64_t start_idx, uint64_t end_idx);
+    // Read sorted_min_buf for the values between start_idx and end_idx
+    void readSortedMinBuf(uint64_t start_idx, uint64_t end_idx);
+    // Move the sorted end stream to idx
+    void seekSortedEnds(uint64_t idx);
+
+    void setSortedEnds(UIntReader &&end, UIntReader &&cell, UIntReader &&end_min);
 
   public:
     StoredFragmentsBase(
@@ -48,6 +62,10 @@ class StoredFragmentsBase : public FragmentLoader {
 
     StoredFragmentsBase(StoredFragmentsBase&&) = default;
 
+    // Record I/O statistics for the underlying cell, start, end, and end_max arrays as
+    // children of `node`
+    void instrument(InstrumentNode &node);
+
     bool isSeekable() const override;
     void seek(uint32_t chr_id, uint32_t base) override;
 
@@ -66,6 +84,12 @@ class StoredFragmentsBase : public FragmentLoader {
     uint32_t *cellData() override;
     uint32_t *startData() override;
     uint32_t *endData() override;
+
+    bool hasSortedEnds() const override;
+    bool loadSortedEnds() override;
+    uint32_t sortedEndCapacity() const override;
+    uint32_t *sortedEndData() override;
+    uint32_t *sortedEndCellData() override;
 };
 
 class StoredFragments : public StoredFragmentsBase {
@@ -102,9 +126,30 @@ class StoredFragmentsWriter : public FragmentWriter {
     bool subtract_start_from_end; // Set to true if writing packed
     void subStartEnd();
 
+    // Optional sorted end stream. Ends that might still be preceded by a later fragment's
+    // end wait in pending_end until the input start coordinates pass them
+    bool write_sorted_ends = false;
+    UIntWriter sorted_end, sorted_end_cell, sorted_end_min;
+    uint64_t sorted_idx = 0;
+    std::vector<uint32_t> pending_end, pending_cell, pending_end_buf, pending_cell_buf;
+    void setSortedEnds(UIntWriter &&end, UIntWriter &&cell, UIntWriter &&end_min);
+    // Sort pending ends, then write out those <= max_end
+    void flushSortedEnds(uint32_t max_end);
+
   public:
-    static StoredFragmentsWriter createUnpacked(WriterBuilder &wb);
-    static StoredFragmentsWriter createPacked(WriterBuilder &wb, uint32_t buffer_size = 1024);
+    // If sorted_ends is true, also write each chromosome's end coordinates in sorted order
+    // with their cell IDs, so InsertionIterator can read insertions without re-sorting
+    static StoredFragmentsWriter createUnpacked(WriterBuilder &wb, bool sorted_ends = false);
+    // If pipelined is true, the cell, start, and end streams are each packed and written on
+    // their own worker thread, so the calling thread only has to read the input fragments.
+    // This needs a WriterBuilder whose writers can be used from different threads at once
+    // (files or memory, not HDF5)
+    static StoredFragmentsWriter createPacked(
+        WriterBuilder &wb,
+        uint32_t buffer_size = 1024,
+        bool pipelined = false,
+        bool sorted_ends = false
+    );
     StoredFragmentsWriter(
         UIntWriter &&cell,
         UIntWriter &&start,
@@ -116,7 +161,7 @@ class StoredFragmentsWriter : public FragmentWriter {
         bool subtract_start_from_end
     );
 
-    void write(FragmentLoader &fragments, std::atomic<bool> *user_interrupt = NULL) override;
+    void write(FragmentLoader &fragments, const ExecutionContext &ctx = {}) override;
 };
 
 } // end namespace BPCells
\ No newline at end of file
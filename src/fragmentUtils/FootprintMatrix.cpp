@@ -1,97 +1,186 @@
 #include "FootprintMatrix.h"
+#include <atomic>
+#include <thread>
+
 #include "../bitpacking/simd_vec.h"
 
 namespace BPCells {
 
-Eigen::MatrixXd footprintMatrix(
+namespace {
+
+class Region {
+  public:
+    uint32_t chr, start, end;
+    bool pos_strand;
+    uint32_t set; // Index of the output matrix for this region
+};
+
+// Number of sites handled per task when footprinting on multiple threads
+constexpr uint32_t REGIONS_PER_TASK = 4096;
+
+std::vector<std::string> readChrLevels(StringReader &chr_levels) {
+    std::vector<std::string> ret;
+    for (uint32_t i = 0; i < chr_levels.size(); i++) {
+        ret.push_back(chr_levels.get(i));
+    }
+    return ret;
+}
+
+void checkInputs(
     FragmentLoader &frags,
-    const std::vector<uint32_t> &chr,
-    const std::vector<uint32_t> &center,
-    const std::vector<int32_t> &strand,
-    uint32_t flank_width,
-    std::unique_ptr<StringReader> &&chr_levels,
+    const std::vector<std::string> &chr_levels,
     const std::vector<uint32_t> &cell_groups,
     const std::vector<double> &cell_weights
 ) {
-    class Region {
-      public:
-        uint32_t chr, start, end;
-        bool pos_strand;
-    };
-
-    std::vector<Region> sorted_regions;
-    std::vector<Region> active_regions;
-    uint32_t next_active_region = 0;
-
-    // **********************
-    // Check input arguments
-    // **********************
     if (frags.cellCount() < 0)
         throw std::invalid_argument(
             "frags must have a known cell count. Consider using a cell selection to define the "
             "number of cells."
         );
-    if (frags.cellCount() != (int64_t) cell_groups.size() || frags.cellCount() != (int64_t) cell_weights.size()) {
+    if (frags.cellCount() != (int64_t)cell_groups.size() ||
+        frags.cellCount() != (int64_t)cell_weights.size()) {
         throw std::invalid_argument(
             "frags must have same cell count as cell_groups and cell_weights"
         );
     }
 
-    if (chr.size() != center.size() || chr.size() != strand.size())
-        throw std::invalid_argument("chr, center, and strand must all be same length");
-
     // Check that chr name matches for all the available chrNames in frags
-    for (uint32_t i = 0; i < chr_levels->size(); i++) {
+    for (uint32_t i = 0; i < chr_levels.size(); i++) {
         const char *chr_name_frag = frags.chrNames(i);
-        const char *chr_name_args = chr_levels->get(i);
-        if (chr_name_frag != NULL &&
-            (chr_name_args == NULL || strcmp(chr_name_frag, chr_name_args) != 0)) {
+        if (chr_name_frag != NULL && strcmp(chr_name_frag, chr_levels[i].c_str()) != 0) {
             throw std::runtime_error(
                 std::string("FootprintMatrix encountered fragment with incorrect chrLevel: ") +
-                std::string(chr_name_frag) + std::string(" expected: ") + std::string(chr_name_args)
+                std::string(chr_name_frag) + std::string(" expected: ") + chr_levels[i]
             );
         }
     }
+}
 
-    for (size_t i = 0; i < chr.size(); i++) {
-        if (chr[i] >= chr_levels->size())
-            throw std::invalid_argument(
-                "FootprintMatrix: chr has values higher than length of chr_levels"
-            );
-        Region r;
-        if (center[i] < flank_width)
-            throw std::invalid_argument("FootprintMatrix: flank_width expands to negative bases");
-        r.start = center[i] - flank_width;
-        r.end = center[i] + flank_width + 1;
-        r.chr = chr[i];
-        r.pos_strand = strand[i] == 1;
-        if (strand[i] != 1 && strand[i] != -1)
-            throw std::invalid_argument("strand must have values of only +/- 1");
-        sorted_regions.push_back(r);
-    }
-
-    uint32_t max_group = 0;
-    for (auto g : cell_groups)
-        max_group = std::max(max_group, g);
+// Return the regions for all site sets, sorted by (chr, start, end)
+std::vector<Region> sortedRegions(
+    const std::vector<FootprintSites> &site_sets, uint32_t flank_width, uint32_t n_chr_levels
+) {
+    std::vector<Region> sorted_regions;
+    for (uint32_t s = 0; s < site_sets.size(); s++) {
+        const FootprintSites &sites = site_sets[s];
+        if (sites.chr.size() != sites.center.size() || sites.chr.size() != sites.strand.size())
+            throw std::invalid_argument("chr, center, and strand must all be same length");
 
-    // Sentinel value at end of sorted_peaks
-    sorted_regions.push_back({UINT32_MAX, UINT32_MAX, UINT32_MAX, 0});
+        for (size_t i = 0; i < sites.chr.size(); i++) {
+            if (sites.chr[i] >= n_chr_levels)
+                throw std::invalid_argument(
+                    "FootprintMatrix: chr has values higher than length of chr_levels"
+                );
+            Region r;
+            if (sites.center[i] < flank_width)
+                throw std::invalid_argument(
+                    "FootprintMatrix: flank_width expands to negative bases"
+                );
+            r.start = sites.center[i] - flank_width;
+            r.end = sites.center[i] + flank_width + 1;
+            r.chr = sites.chr[i];
+            r.pos_strand = sites.strand[i] == 1;
+            r.set = s;
+            if (sites.strand[i] != 1 && sites.strand[i] != -1)
+                throw std::invalid_argument("strand must have values of only +/- 1");
+            sorted_regions.push_back(r);
+        }
+    }
 
     std::sort(sorted_regions.begin(), sorted_regions.end(), [](Region a, Region b) {
         if (a.chr != b.chr) return a.chr < b.chr;
         else if (a.start != b.start) return a.start < b.start;
         else return a.end < b.end;
     });
+    return sorted_regions;
+}
+
+// Tally insertions into the regions [begin, end), which must all be on the loader's current
+// chromosome. Reads fragments from the loader's current position, and stops once every region
+// is complete
+void tallyRegions(
+    FragmentLoader &frags,
+    const Region *begin,
+    const Region *end,
+    const std::vector<uint32_t> &cell_groups,
+    const std::vector<double> &cell_weights,
+    std::vector<Eigen::MatrixXd> &out
+) {
+    std::vector<Region> active_regions;
+    const Region *next_active_region = begin;
+    while ((next_active_region != end || !active_regions.empty()) && frags.load()) {
+        uint32_t capacity = frags.capacity();
+        const uint32_t *start_data = frags.startData();
+        const uint32_t *end_data = frags.endData();
+        const uint32_t *cell_data = frags.cellData();
+        uint32_t i = 0;
+        uint32_t end_max = 0;
+        // Loop through reads in blocks of 128 at a time
+        while (i < capacity) {
+            uint32_t items = std::min(128U, capacity - i);
+            if (items == 128) end_max = std::max(simdmax(end_data + i), end_max);
+            else {
+                for (uint32_t k = i; k < capacity; k++)
+                    end_max = std::max(end_max, end_data[k]);
+            }
 
-    Eigen::MatrixXd out(max_group + 1, 2 * flank_width + 1);
-    out.setZero();
+            // Check for new peaks to activate
+            while (next_active_region != end && next_active_region->start < end_max) {
+                active_regions.push_back(*next_active_region);
+                next_active_region += 1;
+            }
+
+            // For each active peak, iterate through the fragments & tally overlaps
+            for (uint32_t j = 0; j < active_regions.size(); j++) {
+                Region r = active_regions[j];
+                Eigen::MatrixXd &mat = out[r.set];
+
+                uint32_t k = 0;
+
+                for (; k < items && start_data[i + k] < r.end; k++) {
+                    if (start_data[i + k] >= r.start && start_data[i + k] < r.end) {
+                        uint32_t cell_group = cell_groups[cell_data[i + k]];
+                        uint32_t base;
+                        if (r.pos_strand) base = start_data[i + k] - r.start;
+                        else base = r.end - 1 - start_data[i + k];
+                        mat(cell_group, base) += cell_weights[cell_data[i + k]];
+                    }
+                    if (end_data[i + k] > r.start && end_data[i + k] <= r.end) {
+                        uint32_t cell_group = cell_groups[cell_data[i + k]];
+                        uint32_t base;
+                        if (r.pos_strand) base = end_data[i + k] - 1 - r.start;
+                        else base = r.end - end_data[i + k];
+                        mat(cell_group, base) += cell_weights[cell_data[i + k]];
+                    }
+                }
+
+                // Remove the peak from active_regions if we're done, and mark the
+                // next completed peak on our list
+                if (k < items) {
+                    std::swap(active_regions.back(), active_regions[j]);
+                    active_regions.pop_back();
+                    j -= 1;
+                }
+            }
+            i += items;
+        }
+    }
+}
 
-    // **********************
-    // Loop through fragments
-    // **********************
+// Read through all fragments in order, tallying regions for each chromosome as it comes
+void footprintSerial(
+    FragmentLoader &frags,
+    const std::vector<Region> &sorted_regions,
+    const std::vector<std::string> &chr_levels,
+    const std::vector<uint32_t> &cell_groups,
+    const std::vector<double> &cell_weights,
+    std::vector<Eigen::MatrixXd> &out,
+    const ExecutionContext &ctx
+) {
     uint32_t prev_chr_id = 0;
     frags.restart();
     while (frags.nextChr()) {
+        if (ctx.interrupted()) return;
         if (frags.currentChr() < prev_chr_id) {
             throw std::runtime_error(
                 "FootprintMatrix encountered fragments with out of order chromosome IDs. Please "
@@ -101,75 +190,147 @@ Eigen::MatrixXd footprintMatrix(
         prev_chr_id = frags.currentChr();
         // Check that chr name matches
         const char *chr_name_frag = frags.chrNames(frags.currentChr());
-        const char *chr_name_args = chr_levels->get(frags.currentChr());
-        if (chr_name_frag == NULL || chr_name_args == NULL ||
-            strcmp(chr_name_frag, chr_name_args) != 0) {
+        if (chr_name_frag == NULL || frags.currentChr() >= chr_levels.size() ||
+            strcmp(chr_name_frag, chr_levels[frags.currentChr()].c_str()) != 0) {
             throw std::runtime_error(
                 std::string("FootprintMatrix encountered fragment with incorrect chrLevel: ") +
-                std::string(chr_name_frag) + std::string(" expected: ") + std::string(chr_name_args)
+                std::string(chr_name_frag == NULL ? "NULL" : chr_name_frag) +
+                std::string(" expected: ") +
+                (frags.currentChr() < chr_levels.size() ? chr_levels[frags.currentChr()]
+                                                        : std::string("NULL"))
             );
         }
-        while (sorted_regions[next_active_region].chr < frags.currentChr()) {
-            next_active_region++;
-        }
-        active_regions.clear();
-        while (frags.load()) {
-            uint32_t capacity = frags.capacity();
-            const uint32_t *start_data = frags.startData();
-            const uint32_t *end_data = frags.endData();
-            const uint32_t *cell_data = frags.cellData();
-            uint32_t i = 0;
-            uint32_t end_max = 0;
-            // Loop through reads in blocks of 128 at a time
-            while (i < capacity) {
-                uint32_t items = std::min(128U, capacity - i);
-                if (items == 128) end_max = std::max(simdmax(end_data + i), end_max);
-                else {
-                    for (uint32_t k = i; k < capacity; k++)
-                        end_max = std::max(end_max, end_data[k]);
-                }
+        auto chr_begin = std::lower_bound(
+            sorted_regions.begin(),
+            sorted_regions.end(),
+            frags.currentChr(),
+            [](const Region &r, uint32_t chr) { return r.chr < chr; }
+        );
+        auto chr_end = std::lower_bound(
+            chr_begin,
+            sorted_regions.end(),
+            frags.currentChr() + 1,
+            [](const Region &r, uint32_t chr) { return r.chr < chr; }
+        );
+        const Region *data = sorted_regions.data();
+        tallyRegions(
+            frags,
+            data + (chr_begin - sorted_regions.begin()),
+            data + (chr_end - sorted_regions.begin()),
+            cell_groups,
+            cell_weights,
+            out
+        );
+    }
+}
 
-                // Check for new peaks to activate
-                while (sorted_regions[next_active_region].chr == frags.currentChr() &&
-                       sorted_regions[next_active_region].start < end_max) {
+} // namespace
 
-                    active_regions.push_back(sorted_regions[next_active_region]);
-                    next_active_region += 1;
-                }
+Eigen::MatrixXd footprintMatrix(
+    FragmentLoader &frags,
+    const std::vector<uint32_t> &chr,
+    const std::vector<uint32_t> &center,
+    const std::vector<int32_t> &strand,
+    uint32_t flank_width,
+    std::unique_ptr<StringReader> &&chr_levels,
+    const std::vector<uint32_t> &cell_groups,
+    const std::vector<double> &cell_weights
+) {
+    std::vector<std::string> levels = readChrLevels(*chr_levels);
+    checkInputs(frags, levels, cell_groups, cell_weights);
+    std::vector<Region> sorted_regions =
+        sortedRegions({FootprintSites{chr, center, strand}}, flank_width, levels.size());
 
-                // For each active peak, iterate through the fragments & tally overlaps
-                for (uint32_t j = 0; j < active_regions.size(); j++) {
-                    Region r = active_regions[j];
-
-                    uint32_t k = 0;
-
-                    for (; k < items && start_data[i + k] < r.end; k++) {
-                        if (start_data[i + k] >= r.start && start_data[i + k] < r.end) {
-                            uint32_t cell_group = cell_groups[cell_data[i + k]];
-                            uint32_t base;
-                            if (r.pos_strand) base = start_data[i + k] - r.start;
-                            else base = r.end - 1 - start_data[i + k];
-                            out(cell_group, base) += cell_weights[cell_data[i + k]];
-                        }
-                        if (end_data[i + k] > r.start && end_data[i + k] <= r.end) {
-                            uint32_t cell_group = cell_groups[cell_data[i + k]];
-                            uint32_t base;
-                            if (r.pos_strand) base = end_data[i + k] - 1 - r.start;
-                            else base = r.end - end_data[i + k];
-                            out(cell_group, base) += cell_weights[cell_data[i + k]];
-                        }
-                    }
+    uint32_t max_group = 0;
+    for (auto g : cell_groups)
+        max_group = std::max(max_group, g);
 
-                    // Remove the peak from active_regions if we're done, and mark the
-                    // next completed peak on our list
-                    if (k < items) {
-                        std::swap(active_regions.back(), active_regions[j]);
-                        active_regions.pop_back();
-                        j -= 1;
-                    }
+    std::vector<Eigen::MatrixXd> out(1, Eigen::MatrixXd::Zero(max_group + 1, 2 * flank_width + 1));
+    footprintSerial(frags, sorted_regions, levels, cell_groups, cell_weights, out, {});
+    return out[0];
+}
+
+std::vector<Eigen::MatrixXd> footprintMatrices(
+    const std::function<std::unique_ptr<FragmentLoader>()> &open_frags,
+    const std::vector<FootprintSites> &site_sets,
+    uint32_t flank_width,
+    std::unique_ptr<StringReader> &&chr_levels,
+    const std::vector<uint32_t> &cell_groups,
+    const std::vector<double> &cell_weights,
+    uint32_t threads,
+    const ExecutionContext &ctx
+) {
+    std::vector<std::string> levels = readChrLevels(*chr_levels);
+    std::unique_ptr<FragmentLoader> frags = open_frags();
+    checkInputs(*frags, levels, cell_groups, cell_weights);
+    std::vector<Region> sorted_regions = sortedRegions(site_sets, flank_width, levels.size());
+
+    uint32_t max_group = 0;
+    for (auto g : cell_groups)
+        max_group = std::max(max_group, g);
+    const std::vector<Eigen::MatrixXd> zero(
+        site_sets.size(), Eigen::MatrixXd::Zero(max_group + 1, 2 * flank_width + 1)
+    );
+
+    // Split the sites into tasks of up to REGIONS_PER_TASK sites, never crossing chromosomes.
+    // Chromosomes the fragments don't have are skipped
+    std::vector<std::pair<size_t, size_t>> tasks;
+    for (size_t i = 0; i < sorted_regions.size();) {
+        size_t j = i;
+        while (j < sorted_regions.size() && j - i < REGIONS_PER_TASK &&
+               sorted_regions[j].chr == sorted_regions[i].chr) {
+            j++;
+        }
+        uint32_t chr = sorted_regions[i].chr;
+        if (chr < (uint32_t)std::max(frags->chrCount(), 0) && frags->chrNames(chr) != NULL) {
+            tasks.push_back({i, j});
+        }
+        i = j;
+    }
+
+    ResourceLease lease =
+        ctx.acquireThreads(frags->isSeekable() ? std::min<size_t>(threads, tasks.size()) : 0);
+    if (lease.count() <= 1) {
+        std::vector<Eigen::MatrixXd> out = zero;
+        footprintSerial(*frags, sorted_regions, levels, cell_groups, cell_weights, out, ctx);
+        return out;
+    }
+    frags.reset();
+
+    // Each worker reads with its own loader into its own partial matrices, and the partial
+    // results are summed at the end
+    std::vector<std::vector<Eigen::MatrixXd>> partial(lease.count(), zero);
+    std::vector<std::exception_ptr> errors(lease.count());
+    std::atomic<size_t> task_id(0);
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < lease.count(); w++) {
+        workers.push_back(std::thread([&, w] {
+            try {
+                std::unique_ptr<FragmentLoader> loader = open_frags();
+                while (!ctx.interrupted()) {
+                    size_t t = task_id.fetch_add(1);
+                    if (t >= tasks.size()) break;
+                    const Region *begin = &sorted_regions[tasks[t].first];
+                    const Region *end = begin + (tasks[t].second - tasks[t].first);
+                    loader->seek(begin->chr, begin->start);
+                    tallyRegions(*loader, begin, end, cell_groups, cell_weights, partial[w]);
                 }
-                i += items;
+            } catch (...) {
+                errors[w] = std::current_exception();
             }
+        }));
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    for (auto &e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+
+    std::vector<Eigen::MatrixXd> out = std::move(partial[0]);
+    for (uint32_t w = 1; w < partial.size(); w++) {
+        for (uint32_t s = 0; s < out.size(); s++) {
+            out[s] += partial[w][s];
         }
     }
     return out;
@@ -8,8 +8,12 @@
 #include <RcppEigen.h>
 #endif
 
+#include <functional>
+#include <memory>
+
 #include "../arrayIO/array_interfaces.h"
 #include "../fragmentIterators/FragmentIterator.h"
+#include "../utils/execution_context.h"
 
 namespace BPCells {
 
@@ -40,4 +44,31 @@ Eigen::MatrixXd footprintMatrix(
     const std::vector<double> &cell_weights
 );
 
-} // namespace BPCells
\ No newline at end of file
+// One set of footprint sites, e.g. the motif instances of one TF
+struct FootprintSites {
+    std::vector<uint32_t> chr, center;
+    std::vector<int32_t> strand;
+};
+
+// Make one footprint matrix per set of sites from a single pass over the fragments.
+// Arguments are as in footprintMatrix, except:
+//    open_frags: Returns a new loader over the input fragments. With threads > 1 and seekable
+//        fragments, each worker opens its own loader and handles blocks of sites at a time,
+//        seeking to each block. Otherwise one loader is read in order
+//    site_sets: Sites for each output matrix
+//    threads: Number of worker threads
+// Return:
+//   One matrix per entry of site_sets, with the same layout as footprintMatrix. With multiple
+//   threads, floating point sums may differ in the last bits from a single-threaded run
+std::vector<Eigen::MatrixXd> footprintMatrices(
+    const std::function<std::unique_ptr<FragmentLoader>()> &open_frags,
+    const std::vector<FootprintSites> &site_sets,
+    uint32_t flank_width,
+    std::unique_ptr<StringReader> &&chr_levels,
+    const std::vector<uint32_t> &cell_groups,
+    const std::vector<double> &cell_weights,
+    uint32_t threads = 1,
+    const ExecutionContext &ctx = {}
+);
+
+} // namespace BPCells
@@ -3,6 +3,8 @@
 namespace BPCells {
 
 // I made literally everything else inline, but here we are...
-InsertionIterator::InsertionIterator(FragmentLoader &loader) : frags(loader) {}
+InsertionIterator::InsertionIterator(FragmentLoader &loader)
+    : frags(loader)
+    , presorted(loader.hasSortedEnds()) {}
 
 } // end namespace BPCells
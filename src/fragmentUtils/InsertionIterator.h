@@ -12,7 +12,9 @@ namespace BPCells {
 // Transform sorted fragments into sorted insertions -- i.e. merge
 // the starts + ends into a sorted stream of insertions. Note that since
 // fragments store end coordinates non-inclusive, end coordinates will be shifted
-// down by 1bp
+// down by 1bp.
+// If the loader provides a sorted end stream (see FragmentLoader::hasSortedEnds), the
+// starts and ends are merged directly from the loader buffers without any sorting
 class InsertionIterator {
   private:
     FragmentLoader &frags;
@@ -33,6 +35,58 @@ class InsertionIterator {
     uint32_t current_chr;
     bool use_start;
 
+    // State for merging with the loader's sorted end stream
+    const bool presorted;
+    uint32_t *start_ptr, *start_cell_ptr, *end_ptr, *end_cell_ptr;
+    uint32_t start_count = 0, end_count = 0;
+    bool starts_done = false, ends_done = false;
+
+    inline void resetPresorted() {
+        start_count = 0;
+        end_count = 0;
+        starts_done = false;
+        ends_done = false;
+    }
+
+    inline void loadPresortedStarts() {
+        start_idx = 0;
+        start_count = 0;
+        starts_done = !frags.load();
+        if (starts_done) return;
+        start_count = frags.capacity();
+        start_ptr = frags.startData();
+        start_cell_ptr = frags.cellData();
+    }
+
+    inline void loadPresortedEnds() {
+        end_idx = 0;
+        end_count = 0;
+        ends_done = !frags.loadSortedEnds();
+        if (ends_done) return;
+        end_count = frags.sortedEndCapacity();
+        end_ptr = frags.sortedEndData();
+        end_cell_ptr = frags.sortedEndCellData();
+        vec one = splat(1);
+        uint32_t i;
+        for (i = 0; i + 4 <= end_count; i += 4) {
+            store((vec *)(end_ptr + i), sub(load((vec *)(end_ptr + i)), one));
+        }
+        for (; i < end_count; i++)
+            end_ptr[i] = end_ptr[i] - 1;
+    }
+
+    inline bool nextPresortedInsertion() {
+        if (start_idx >= start_count && !starts_done) loadPresortedStarts();
+        if (end_idx >= end_count && !ends_done) loadPresortedEnds();
+        if (starts_done && ends_done) return false;
+        use_start = ends_done || (!starts_done && end_ptr[end_idx] >= start_ptr[start_idx]);
+        next_coord = use_start ? start_ptr[start_idx] : end_ptr[end_idx];
+        next_cell = use_start ? start_cell_ptr[start_idx] : end_cell_ptr[end_idx];
+        start_idx += use_start;
+        end_idx += !use_start;
+        return true;
+    }
+
     // Load new fragments, shift end coordinates, and add to the sorted end_data buf
     // Pre-condition:
     // - We've iterated through all the insertions in start_data + start_cell, and
@@ -123,6 +177,7 @@ class InsertionIterator {
         end_idx = 0;
         start_data.resize(0);
         end_capacity = 0;
+        resetPresorted();
     }
     inline bool nextChr() {
         start_idx = 0;
@@ -131,9 +186,11 @@ class InsertionIterator {
         if (ret) current_chr = frags.currentChr();
         start_data.resize(0);
         end_capacity = 0;
+        resetPresorted();
         return ret;
     }
     inline bool nextInsertion() {
+        if (presorted) return nextPresortedInsertion();
         if (start_idx >= start_data.size()) loadFragments();
         if (end_idx >= end_capacity) return false;
         use_start = end_data[end_idx] >= start_data[start_idx];
@@ -151,6 +208,7 @@ class InsertionIterator {
         end_idx = 0;
         start_data.resize(0);
         end_capacity = 0;
+        resetPresorted();
     }
 
     inline uint32_t chr() const { return current_chr; };
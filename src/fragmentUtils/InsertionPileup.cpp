@@ -0,0 +1,77 @@
+#include "InsertionPileup.h"
+#include "InsertionIterator.h"
+
+namespace BPCells {
+
+Eigen::MatrixXd insertionPileup(
+    FragmentLoader &frags,
+    const std::vector<uint32_t> &chr,
+    const std::vector<uint32_t> &start,
+    const std::vector<uint32_t> &end,
+    const std::vector<uint32_t> &bin_width,
+    const std::vector<uint32_t> &cell_groups,
+    uint32_t n_groups,
+    const std::vector<double> &group_scale
+) {
+    if (chr.size() != start.size() || chr.size() != end.size() || chr.size() != bin_width.size())
+        throw std::invalid_argument("chr, start, end, and bin_width must all be same length");
+    if (frags.cellCount() >= 0 && (int64_t)cell_groups.size() < frags.cellCount())
+        throw std::invalid_argument("insertionPileup: cell_groups must have one entry per cell");
+    if (!group_scale.empty() && group_scale.size() != n_groups)
+        throw std::invalid_argument("insertionPileup: group_scale must have one entry per group");
+    for (auto g : cell_groups) {
+        if (g != UINT32_MAX && g >= n_groups)
+            throw std::invalid_argument("insertionPileup: cell_groups has values >= n_groups");
+    }
+
+    std::vector<uint64_t> bin_offset = {0};
+    for (size_t i = 0; i < chr.size(); i++) {
+        if (end[i] <= start[i] || bin_width[i] == 0)
+            throw std::invalid_argument("insertionPileup: regions and bins must be non-empty");
+        uint64_t bins = (end[i] - start[i] + bin_width[i] - 1) / bin_width[i];
+        bin_offset.push_back(bin_offset.back() + bins);
+    }
+
+    // Count into integers, which is faster and exact, then convert at the end
+    std::vector<uint32_t> counts((uint64_t)n_groups * bin_offset.back());
+    InsertionIterator it(frags);
+    for (size_t i = 0; i < chr.size(); i++) {
+        // Position at the start of the region's chromosome
+        if (frags.isSeekable()) {
+            if (frags.chrCount() >= 0 && chr[i] >= (uint32_t)frags.chrCount()) continue;
+            it.seek(chr[i], start[i]);
+        } else {
+            it.restart();
+            bool found = false;
+            while (it.nextChr()) {
+                if (it.chr() == chr[i]) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) continue;
+        }
+
+        // Insertions come out sorted by coordinate, so stop at the first one past the region
+        uint32_t *region_counts = counts.data() + n_groups * bin_offset[i];
+        while (it.nextInsertion()) {
+            uint32_t coord = it.coord();
+            if (coord >= end[i]) break;
+            if (coord < start[i]) continue;
+            uint32_t group = cell_groups[it.cell()];
+            if (group == UINT32_MAX) continue;
+            region_counts[(uint64_t)n_groups * ((coord - start[i]) / bin_width[i]) + group] += 1;
+        }
+    }
+
+    Eigen::MatrixXd out(n_groups, bin_offset.back());
+    for (uint64_t bin = 0; bin < bin_offset.back(); bin++) {
+        for (uint32_t g = 0; g < n_groups; g++) {
+            double scale = group_scale.empty() ? 1.0 : group_scale[g];
+            out(g, bin) = counts[(uint64_t)n_groups * bin + g] * scale;
+        }
+    }
+    return out;
+}
+
+} // end namespace BPCells
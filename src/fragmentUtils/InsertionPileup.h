@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef RCPP_EIGEN
+#include <Eigen/Dense>
+#else
+#define RCPP_NO_RTTI
+#define RCPP_NO_SUGAR
+#include <RcppEigen.h>
+#endif
+
+#include "../fragmentIterators/FragmentIterator.h"
+
+namespace BPCells {
+
+// Count insertions per cell group in fixed-width bins across genomic regions, e.g. for
+// pseudobulk genome tracks. Seeks directly to each region when the fragments are seekable, so
+// the cost depends on the fragments within the regions rather than the whole input.
+// Arguments:
+//    frags: Input fragment loader object
+//    chr, start, end: regions to count (chr IDs following frags, 0-based half-open coords)
+//    bin_width: bin width for each region. The last bin is truncated if the region is not an
+//        even multiple of the bin width
+//    cell_groups: output row for each cell, or UINT32_MAX to skip a cell
+//    n_groups: number of output rows
+//    group_scale: (optional) factor to multiply each group's counts by, e.g. to normalize for
+//        read depth. Empty for raw counts
+// Return:
+//   Eigen matrix of dimensions n_groups x total bins. Bins are in order of region, then
+//   position, with region i taking ceil((end[i] - start[i]) / bin_width[i]) columns
+Eigen::MatrixXd insertionPileup(
+    FragmentLoader &frags,
+    const std::vector<uint32_t> &chr,
+    const std::vector<uint32_t> &start,
+    const std::vector<uint32_t> &end,
+    const std::vector<uint32_t> &bin_width,
+    const std::vector<uint32_t> &cell_groups,
+    uint32_t n_groups,
+    const std::vector<double> &group_scale = {}
+);
+
+} // namespace BPCells
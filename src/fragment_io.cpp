@@ -29,16 +29,29 @@ class RFragmentWrapper : public BPCells::FragmentLoaderWrapper {
 };
 
 // [[Rcpp::export]]
-SEXP iterate_10x_fragments_cpp(std::string path, std::string comment) {
-    return make_unique_xptr<BedFragments>(path.c_str(), comment.c_str());
+SEXP iterate_10x_fragments_cpp(
+    std::string path,
+    std::string comment,
+    std::vector<std::string> keep_cells,
+    int min_fragments
+) {
+    return make_unique_xptr<BedFragments>(path.c_str(), comment.c_str(), keep_cells, min_fragments);
 }
 
 // [[Rcpp::export]]
-void write_10x_fragments_cpp(std::string path, SEXP fragments, bool append_5th_column = false) {
-    BedFragmentsWriter writer(path.c_str(), append_5th_column);
+void write_10x_fragments_cpp(
+    std::string path,
+    SEXP fragments,
+    bool append_5th_column = false,
+    int threads = 1,
+    bool index = false
+) {
+    BedFragmentsWriter writer(path.c_str(), append_5th_column, 1 << 20, threads, index);
 
     auto frags = take_unique_xptr<FragmentLoader>(fragments);
-    run_with_R_interrupt_check(&BedFragmentsWriter::write, &writer, std::ref(*frags));
+    run_with_R_interrupt_check_threads(
+        std::max(threads, 1), &BedFragmentsWriter::write, &writer, std::ref(*frags)
+    );
 }
 
 // [[Rcpp::export]]
@@ -166,12 +179,14 @@ SEXP iterate_unpacked_fragments_file_cpp(
 
 // [[Rcpp::export]]
 void write_unpacked_fragments_file_cpp(
-    SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite
+    SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite, bool sorted_ends
 ) {
     FileWriterBuilder wb(dir, buffer_size, allow_overwrite);
     auto frags = take_unique_xptr<FragmentLoader>(fragments);
     run_with_R_interrupt_check(
-        &StoredFragmentsWriter::write, StoredFragmentsWriter::createUnpacked(wb), std::ref(*frags)
+        &StoredFragmentsWriter::write,
+        StoredFragmentsWriter::createUnpacked(wb, sorted_ends),
+        std::ref(*frags)
     );
 }
 
@@ -190,12 +205,19 @@ SEXP iterate_packed_fragments_file_cpp(
 
 // [[Rcpp::export]]
 void write_packed_fragments_file_cpp(
-    SEXP fragments, std::string dir, uint32_t buffer_size, bool allow_overwrite
+    SEXP fragments,
+    std::string dir,
+    uint32_t buffer_size,
+    bool allow_overwrite,
+    int threads,
+    bool sorted_ends
 ) {
     FileWriterBuilder wb(dir, buffer_size, allow_overwrite);
     auto frags = take_unique_xptr<FragmentLoader>(fragments);
     run_with_R_interrupt_check(
-        &StoredFragmentsWriter::write, StoredFragmentsWriter::createPacked(wb), std::ref(*frags)
+        &StoredFragmentsWriter::write,
+        StoredFragmentsWriter::createPacked(wb, 1024, threads > 1, sorted_ends),
+        std::ref(*frags)
     );
 }
 
@@ -1,3 +1,4 @@
+#include <mutex>
 #include <sstream>
 
 #define RCPP_NO_RTTI
@@ -6,6 +7,7 @@
 #include <RcppEigen.h>
 
 #include "R_array_io.h"
+#include "R_interrupts.h"
 #include "R_xptr_wrapper.h"
 
 #include "fragmentIterators/CellSelect.h"
@@ -18,6 +20,7 @@
 #include "fragmentIterators/ShiftCoords.h"
 // #include "fragmentIterators/InsertionsIterator2.h"
 #include "fragmentUtils/FootprintMatrix.h"
+#include "fragmentUtils/InsertionPileup.h"
 
 #include "matrixIterators/PeakMatrix.h"
 #include "matrixIterators/TileMatrix.h"
@@ -269,28 +272,79 @@ std::vector<int> fragment_lengths_cpp(SEXP fragments) {
     return lengths;
 }
 
+// Footprint with up to `threads` workers. `fragments` is a list of at least threads + 1
+// independent iterators over the same fragments: one to check inputs and run serially, plus
+// one per worker when the fragments are seekable
 // [[Rcpp::export]]
 Eigen::MatrixXd footprint_matrix_cpp(
-    SEXP fragments,
+    List fragments,
     std::vector<uint32_t> chr,
     std::vector<uint32_t> center,
     std::vector<int32_t> strand,
     uint32_t flank_width,
     StringVector chr_levels,
     std::vector<uint32_t> cell_groups,
-    std::vector<double> cell_weights
+    std::vector<double> cell_weights,
+    int threads
 ) {
-    auto frags = take_unique_xptr<FragmentLoader>(fragments);
-    return footprintMatrix(
-        *frags,
-        chr,
-        center,
-        strand,
-        flank_width,
-        std::make_unique<RcppStringReader>(chr_levels),
-        cell_groups,
-        cell_weights
+    // Take ownership of every loader here so that any R-backed loaders are destroyed on the
+    // main thread. Workers receive non-owning wrappers
+    std::vector<std::unique_ptr<FragmentLoader>> loaders;
+    for (R_xlen_t i = 0; i < fragments.size(); i++) {
+        SEXP frags = fragments[i];
+        loaders.push_back(take_unique_xptr<FragmentLoader>(frags));
+    }
+    std::mutex loaders_mutex;
+    size_t next_loader = 0;
+    std::function<std::unique_ptr<FragmentLoader>()> open_frags = [&]() {
+        std::lock_guard<std::mutex> lock(loaders_mutex);
+        if (next_loader >= loaders.size())
+            throw std::runtime_error("footprint_matrix_cpp: too few fragment iterators for threads");
+        auto wrapper = std::make_unique<FragmentLoaderWrapper>(
+            std::unique_ptr<FragmentLoader>(loaders[next_loader++].get())
+        );
+        wrapper->preserve_input_loader();
+        return std::unique_ptr<FragmentLoader>(std::move(wrapper));
+    };
+
+    std::vector<std::string> levels(chr_levels.begin(), chr_levels.end());
+    std::vector<FootprintSites> sites{{chr, center, strand}};
+    threads = std::max(threads, 1);
+    std::vector<Eigen::MatrixXd> res = run_with_R_interrupt_check_threads(
+        threads,
+        [&](const ExecutionContext &ctx) {
+            return footprintMatrices(
+                open_frags,
+                sites,
+                flank_width,
+                std::make_unique<VecStringReader>(levels),
+                cell_groups,
+                cell_weights,
+                threads,
+                ctx
+            );
+        }
     );
+    return res[0];
+}
+
+// [[Rcpp::export]]
+Eigen::MatrixXd pileup_insertions_cpp(
+    SEXP fragments,
+    std::vector<uint32_t> chr,
+    std::vector<uint32_t> start,
+    std::vector<uint32_t> end,
+    std::vector<uint32_t> bin_width,
+    std::vector<int> cell_groups,
+    uint32_t n_groups
+) {
+    // Negative groups mark cells to skip
+    std::vector<uint32_t> groups(cell_groups.size());
+    for (size_t i = 0; i < cell_groups.size(); i++) {
+        groups[i] = cell_groups[i] < 0 ? UINT32_MAX : cell_groups[i];
+    }
+    auto frags = take_unique_xptr<FragmentLoader>(fragments);
+    return insertionPileup(*frags, chr, start, end, bin_width, groups, n_groups);
 }
 
 // [[Rcpp::export]]
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <atomic>
+#include <numeric>
+#include <thread>
 
 #include "../arrayIO/array_interfaces.h"
 #include "MatrixIterator.h"
@@ -102,6 +105,14 @@ class CSparseMatrix : public MatrixLoader<double> {
 
     uint32_t *rowData() override { return row_buf.data(); }
     double *valData() override { return val_buf.data(); }
+
+    bool colEntryCounts(std::vector<uint64_t> &counts) override {
+        counts.resize(mat.cols());
+        for (uint32_t i = 0; i < mat.cols(); i++) {
+            counts[i] = mat.outerIndexPtr()[i + 1] - mat.outerIndexPtr()[i];
+        }
+        return true;
+    }
 };
 
 class CSparseMatrixWriter : public MatrixWriter<double> {
@@ -109,7 +120,7 @@ class CSparseMatrixWriter : public MatrixWriter<double> {
     Eigen::SparseMatrix<double> eigen_mat;
 
   public:
-    void write(MatrixLoader<double> &loader, std::atomic<bool> *user_interrupt = NULL) override {
+    void write(MatrixLoader<double> &loader, const ExecutionContext &ctx = {}) override {
         MatrixIterator<double> mat((std::unique_ptr<MatrixLoader<double>>(&loader)));
         // Don't take ownership of our input loader
         mat.preserve_input_loader();
@@ -120,7 +131,7 @@ class CSparseMatrixWriter : public MatrixWriter<double> {
         while (mat.nextCol()) {
             while (mat.nextValue()) {
                 triplets.push_back(Eigen::Triplet<double>(mat.row(), mat.col(), mat.val()));
-                if (count++ % 8192 == 0 && user_interrupt != NULL && *user_interrupt) return;
+                if (count++ % 8192 == 0 && ctx.interrupted()) return;
             }
         }
 
@@ -136,7 +147,7 @@ class CSparseTransposeMatrixWriter : public MatrixWriter<double> {
     Eigen::SparseMatrix<double> eigen_mat;
 
   public:
-    void write(MatrixLoader<double> &loader, std::atomic<bool> *user_interrupt = NULL) override {
+    void write(MatrixLoader<double> &loader, const ExecutionContext &ctx = {}) override {
         MatrixIterator<double> mat((std::unique_ptr<MatrixLoader<double>>(&loader)));
         // Don't take ownership of our input loader
         mat.preserve_input_loader();
@@ -146,7 +157,7 @@ class CSparseTransposeMatrixWriter : public MatrixWriter<double> {
         while (mat.nextCol()) {
             while (mat.nextValue()) {
                 triplets.push_back(Eigen::Triplet<double>(mat.col(), mat.row(), mat.val()));
-                if (count++ % 8192 == 0 && user_interrupt != NULL && *user_interrupt) return;
+                if (count++ % 8192 == 0 && ctx.interrupted()) return;
             }
         }
 
@@ -157,4 +168,141 @@ class CSparseTransposeMatrixWriter : public MatrixWriter<double> {
     const Eigen::SparseMatrix<double> getMat() { return eigen_mat; }
 };
 
-} // end namespace BPCells
\ No newline at end of file
+// Two-phase export of a matrix into caller-allocated compressed sparse column arrays, such as
+// the i/x/p slots of an R dgCMatrix. The matrix is given as `chunks` that load consecutive
+// column ranges, and each chunk is read by one thread at a time.
+// 1. csparseColPtr() calculates the exact column pointers, so the outputs can be allocated
+// 2. fillCSparseEntries() has each thread decode its chunks directly into the outputs
+namespace detail {
+
+// Call f(i) for each chunk i < n, spread over up to `threads` worker threads
+template <typename F>
+void forEachChunk(size_t n, uint32_t threads, const ExecutionContext &ctx, F &&f) {
+    ResourceLease lease = ctx.acquireThreads(std::min<size_t>(threads, n));
+    if (lease.count() <= 1) {
+        for (size_t i = 0; i < n && !ctx.interrupted(); i++) {
+            f(i);
+        }
+        return;
+    }
+    std::vector<std::exception_ptr> errors(lease.count());
+    std::atomic<size_t> task_id(0);
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < lease.count(); w++) {
+        workers.push_back(std::thread([&, w] {
+            try {
+                while (!ctx.interrupted()) {
+                    size_t t = task_id.fetch_add(1);
+                    if (t >= n) break;
+                    f(t);
+                }
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        }));
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    for (auto &e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
+} // namespace detail
+
+// Return the column pointers (length cols + 1) of the matrix formed by concatenating the columns
+// of `chunks`. Chunks that report colEntryCounts() are not decoded, and the rest are counted
+// in parallel
+template <typename T>
+std::vector<uint64_t> csparseColPtr(
+    std::vector<std::unique_ptr<MatrixLoader<T>>> &chunks,
+    uint32_t threads,
+    const ExecutionContext &ctx = {}
+) {
+    std::vector<std::vector<uint64_t>> counts(chunks.size());
+    std::vector<size_t> unknown;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!chunks[i]->colEntryCounts(counts[i])) unknown.push_back(i);
+    }
+    detail::forEachChunk(unknown.size(), threads, ctx, [&](size_t t) {
+        MatrixLoader<T> &mat = *chunks[unknown[t]];
+        std::vector<uint64_t> &c = counts[unknown[t]];
+        c.assign(mat.cols(), 0);
+        mat.restart();
+        while (mat.nextCol()) {
+            while (mat.load()) {
+                c[mat.currentCol()] += mat.capacity();
+            }
+        }
+    });
+
+    std::vector<uint64_t> col_ptr = {0};
+    for (auto &c : counts) {
+        for (uint64_t x : c) {
+            col_ptr.push_back(col_ptr.back() + x);
+        }
+    }
+    return col_ptr;
+}
+
+// Write the entries of `chunks` into row_idx and val, at the offsets given by `col_ptr` from
+// csparseColPtr(). Row indices are sorted within each column
+template <typename T, typename Index, typename Val>
+void fillCSparseEntries(
+    std::vector<std::unique_ptr<MatrixLoader<T>>> &chunks,
+    const std::vector<uint64_t> &col_ptr,
+    Index *row_idx,
+    Val *val,
+    uint32_t threads,
+    const ExecutionContext &ctx = {}
+) {
+    std::vector<uint64_t> col_start = {0};
+    for (auto &m : chunks) {
+        col_start.push_back(col_start.back() + m->cols());
+    }
+    if (col_start.back() + 1 != col_ptr.size())
+        throw std::runtime_error("fillCSparseEntries: column pointers do not match input");
+
+    detail::forEachChunk(chunks.size(), threads, ctx, [&](size_t t) {
+        MatrixLoader<T> &mat = *chunks[t];
+        const uint64_t *ptr = col_ptr.data() + col_start[t];
+        std::vector<size_t> order;
+        std::vector<Index> sorted_idx;
+        std::vector<Val> sorted_val;
+        mat.restart();
+        while (mat.nextCol()) {
+            uint32_t col = mat.currentCol();
+            uint64_t pos = ptr[col];
+            while (mat.load()) {
+                uint32_t cap = mat.capacity();
+                if (pos + cap > ptr[col + 1])
+                    throw std::runtime_error("fillCSparseEntries: column has too many entries");
+                std::copy(mat.rowData(), mat.rowData() + cap, row_idx + pos);
+                std::copy(mat.valData(), mat.valData() + cap, val + pos);
+                pos += cap;
+            }
+            if (pos != ptr[col + 1])
+                throw std::runtime_error("fillCSparseEntries: column has too few entries");
+
+            Index *idx_begin = row_idx + ptr[col];
+            Index *idx_end = row_idx + ptr[col + 1];
+            if (std::is_sorted(idx_begin, idx_end)) continue;
+            order.resize(idx_end - idx_begin);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return idx_begin[a] < idx_begin[b];
+            });
+            sorted_idx.resize(order.size());
+            sorted_val.resize(order.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                sorted_idx[i] = idx_begin[order[i]];
+                sorted_val[i] = val[ptr[col] + order[i]];
+            }
+            std::copy(sorted_idx.begin(), sorted_idx.end(), idx_begin);
+            std::copy(sorted_val.begin(), sorted_val.end(), val + ptr[col]);
+        }
+    });
+}
+
+} // end namespace BPCells
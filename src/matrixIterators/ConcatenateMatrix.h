@@ -9,10 +9,18 @@ namespace BPCells {
 
 namespace {
 
+// Run futures using up to `threads` worker threads, taken from the context's thread budget.
+// If the budget is exhausted (e.g. by an enclosing parallel loader), fall back to running
+// on the calling thread
 template <typename T>
-std::vector<T> parallel_map_helper(std::vector<std::future<T>> &futures, size_t threads) {
+std::vector<T> parallel_map_helper(
+    std::vector<std::future<T>> &futures, size_t threads, const ExecutionContext &ctx
+) {
     std::vector<T> result(futures.size());
 
+    ResourceLease lease = ctx.acquireThreads(threads);
+    threads = lease.count();
+
     // Non-threaded fallback
     if (threads == 0) {
         for (size_t i = 0; i < futures.size(); i++) {
@@ -60,6 +68,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     std::vector<std::unique_ptr<MatrixLoader<T>>> mats;
     std::vector<uint32_t> row_offset;
     uint32_t cur_mat = 0;
+    // Worker threads to request from the ExecutionContext thread budget (0 for single-threaded)
     uint32_t threads = 0;
 
   public:
@@ -149,7 +158,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     T *valData() override { return mats[cur_mat]->valData(); }
 
     Eigen::MatrixXd
-    denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) override {
+    denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) override {
         if (cols() != B.rows()) throw std::runtime_error("Incompatible dimensions for matrix multiply");
         std::vector<std::future<Eigen::MatrixXd>> task_vec;
         // Multiply separately, and concatenate chunks
@@ -159,12 +168,12 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
                 &MatrixLoader<T>::denseMultiplyRight,
                 mats[i].get(),
                 B,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::MatrixXd res(B.cols(), rows());
-        if (user_interrupt != NULL && *user_interrupt) return res.transpose();
+        if (ctx.interrupted()) return res.transpose();
         for (size_t i = 0; i < mats.size(); i++) {
             res.middleCols(row_offset[i], mats[i]->rows()) = sub_results[i].transpose();
         }
@@ -172,7 +181,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     }
 
     Eigen::VectorXd
-    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) override {
+    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) override {
         if (cols() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
         std::vector<std::future<Eigen::VectorXd>> task_vec;
         // Multiply separately, and concatenate chunks
@@ -182,12 +191,12 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
                 &MatrixLoader<T>::vecMultiplyRight,
                 mats[i].get(),
                 v,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::VectorXd res(rows());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t i = 0; i < mats.size(); i++) {
             res.middleRows(row_offset[i], mats[i]->rows()) = sub_results[i];
         }
@@ -195,7 +204,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     }
 
     Eigen::MatrixXd
-    denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) override {
+    denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) override {
         if (rows() != B.cols()) throw std::runtime_error("Incompatible dimensions for matrix multiply");
         std::vector<std::future<Eigen::MatrixXd>> task_vec;
         // Multiply chunks, and add outputs
@@ -205,12 +214,12 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
                 &MatrixLoader<T>::denseMultiplyLeft,
                 mats[i].get(),
                 subset_map_cols(B, row_offset[i], mats[i]->rows()),
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::MatrixXd res(B.rows(), cols());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         res.setZero();
         for (size_t i = 0; i < mats.size(); i++) {
             res += sub_results[i];
@@ -219,7 +228,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     }
 
     Eigen::VectorXd
-    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) override {
+    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) override {
         if (rows() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
         std::vector<std::future<Eigen::VectorXd>> task_vec;
         // Multiply chunks, and add outputs
@@ -229,12 +238,12 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
                 &MatrixLoader<T>::vecMultiplyLeft,
                 mats[i].get(),
                 subset_map_vec(v, row_offset[i], mats[i]->rows()),
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::VectorXd res(cols());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         res.setZero();
         for (size_t i = 0; i < mats.size(); i++) {
             res += sub_results[i];
@@ -242,16 +251,16 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
         return res;
     }
 
-    std::vector<T> colSums(std::atomic<bool> *user_interrupt) override {
+    std::vector<T> colSums(const ExecutionContext &ctx) override {
         std::vector<std::future<std::vector<T>>> task_vec;
         for (size_t i = 0; i < mats.size(); i++) {
             task_vec.push_back(std::async(
-                std::launch::deferred, &MatrixLoader<T>::colSums, mats[i].get(), user_interrupt
+                std::launch::deferred, &MatrixLoader<T>::colSums, mats[i].get(), ctx
             ));
         }
-        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads, ctx);
         std::vector<T> res(cols(), 0);
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t col = 0; col < cols(); col++) {
             for (size_t i = 0; i < mats.size(); i++) {
                 res[col] += sub_results[i][col];
@@ -260,16 +269,16 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
         return res;
     }
 
-    std::vector<T> rowSums(std::atomic<bool> *user_interrupt) override {
+    std::vector<T> rowSums(const ExecutionContext &ctx) override {
         std::vector<std::future<std::vector<T>>> task_vec;
         for (size_t i = 0; i < mats.size(); i++) {
             task_vec.push_back(std::async(
-                std::launch::deferred, &MatrixLoader<T>::rowSums, mats[i].get(), user_interrupt
+                std::launch::deferred, &MatrixLoader<T>::rowSums, mats[i].get(), ctx
             ));
         }
-        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads, ctx);
         std::vector<T> res;
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t i = 0; i < mats.size(); i++) {
             res.insert(res.end(), sub_results[i].begin(), sub_results[i].end());
         }
@@ -277,7 +286,7 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
     }
 
     StatsResult
-    computeMatrixStats(Stats row_stats, Stats col_stats, std::atomic<bool> *user_interrupt) override {
+    computeMatrixStats(Stats row_stats, Stats col_stats, const ExecutionContext &ctx) override {
         std::vector<std::future<StatsResult>> task_vec;
         // Multiply chunks, and add outputs
         for (size_t i = 0; i < mats.size(); i++) {
@@ -287,10 +296,10 @@ template <typename T> class ConcatRows : public MatrixLoader<T> {
                 mats[i].get(),
                 row_stats,
                 col_stats,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<StatsResult> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<StatsResult> sub_results = parallel_map_helper(task_vec, threads, ctx);
         StatsResult res{
             Eigen::ArrayXXd((int)row_stats, rows()), Eigen::ArrayXXd((int)col_stats, cols())};
         res.row_stats.setZero();
@@ -338,6 +347,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     std::vector<std::unique_ptr<MatrixLoader<T>>> mats;
     std::vector<uint32_t> col_offset;
     uint32_t cur_mat = 0;
+    // Worker threads to request from the ExecutionContext thread budget (0 for single-threaded)
     uint32_t threads = 0;
   public:
     ConcatCols(std::vector<std::unique_ptr<MatrixLoader<T>>> &&mats, uint32_t threads) : mats(std::move(mats)), threads(threads) {
@@ -407,6 +417,17 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
         return mats[cur_mat]->currentCol() + col_offset[cur_mat];
     }
 
+    bool colEntryCounts(std::vector<uint64_t> &counts) override {
+        counts.clear();
+        std::vector<uint64_t> mat_counts;
+        for (auto &m : mats) {
+            if (!m->colEntryCounts(mat_counts)) return false;
+            counts.insert(counts.end(), mat_counts.begin(), mat_counts.end());
+        }
+        restart();
+        return true;
+    }
+
     // Return false if there are no more entries to load
     bool load() override { return mats[cur_mat]->load(); }
 
@@ -418,7 +439,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     T *valData() override { return mats[cur_mat]->valData(); }
 
     Eigen::MatrixXd
-    denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) override {
+    denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) override {
         if (rows() != B.cols()) throw std::runtime_error("Incompatible dimensions for matrix multiply");
         std::vector<std::future<Eigen::MatrixXd>> task_vec;
         // Multiply separately, and concatenate chunks
@@ -428,12 +449,12 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
                 &MatrixLoader<T>::denseMultiplyLeft,
                 mats[i].get(),
                 B,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::MatrixXd res(B.rows(), cols());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t i = 0; i < mats.size(); i++) {
             res.middleCols(col_offset[i], mats[i]->cols()) = sub_results[i];
         }
@@ -441,7 +462,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     }
 
     Eigen::VectorXd
-    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) override {
+    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) override {
         if (rows() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
         std::vector<std::future<Eigen::VectorXd>> task_vec;
         // Multiply separately, and concatenate chunks
@@ -451,12 +472,12 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
                 &MatrixLoader<T>::vecMultiplyLeft,
                 mats[i].get(),
                 v,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::VectorXd res(cols());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t i = 0; i < mats.size(); i++) {
             res.middleRows(col_offset[i], mats[i]->cols()) = sub_results[i];
         }
@@ -464,7 +485,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     }
 
     Eigen::MatrixXd
-    denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) override {
+    denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) override {
         if (cols() != B.rows()) throw std::runtime_error("Incompatible dimensions for matrix multiply");
         std::vector<std::future<Eigen::MatrixXd>> task_vec;
         std::vector<Eigen::MatrixXd> B_chunks;
@@ -476,12 +497,12 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
                 &MatrixLoader<T>::denseMultiplyRight,
                 mats[i].get(),
                 Eigen::Map<Eigen::MatrixXd>(B_chunks[i].data(), B_chunks[i].rows(), B_chunks[i].cols()),
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::MatrixXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::MatrixXd res(rows(), B.cols());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         res.setZero();
         for (size_t i = 0; i < mats.size(); i++) {
             res += sub_results[i];
@@ -490,7 +511,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     }
 
     Eigen::VectorXd
-    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) override {
+    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) override {
         if (cols() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
         std::vector<std::future<Eigen::VectorXd>> task_vec;
         // Multiply chunks, and add outputs
@@ -500,12 +521,12 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
                 &MatrixLoader<T>::vecMultiplyRight,
                 mats[i].get(),
                 subset_map_vec(v, col_offset[i], mats[i]->cols()),
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<Eigen::VectorXd> sub_results = parallel_map_helper(task_vec, threads, ctx);
         Eigen::VectorXd res(rows());
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         res.setZero();
         for (size_t i = 0; i < mats.size(); i++) {
             res += sub_results[i];
@@ -513,16 +534,16 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
         return res;
     }
 
-    std::vector<T> rowSums(std::atomic<bool> *user_interrupt) override {
+    std::vector<T> rowSums(const ExecutionContext &ctx) override {
         std::vector<std::future<std::vector<T>>> task_vec;
         for (size_t i = 0; i < mats.size(); i++) {
             task_vec.push_back(std::async(
-                std::launch::deferred, &MatrixLoader<T>::rowSums, mats[i].get(), user_interrupt
+                std::launch::deferred, &MatrixLoader<T>::rowSums, mats[i].get(), ctx
             ));
         }
-        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads, ctx);
         std::vector<T> res(rows(), 0);
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t row = 0; row < rows(); row++) {
             for (size_t i = 0; i < mats.size(); i++) {
                 res[row] += sub_results[i][row];
@@ -531,16 +552,16 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
         return res;
     }
 
-    std::vector<T> colSums(std::atomic<bool> *user_interrupt) override {
+    std::vector<T> colSums(const ExecutionContext &ctx) override {
         std::vector<std::future<std::vector<T>>> task_vec;
         for (size_t i = 0; i < mats.size(); i++) {
             task_vec.push_back(std::async(
-                std::launch::deferred, &MatrixLoader<T>::colSums, mats[i].get(), user_interrupt
+                std::launch::deferred, &MatrixLoader<T>::colSums, mats[i].get(), ctx
             ));
         }
-        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<std::vector<T>> sub_results = parallel_map_helper(task_vec, threads, ctx);
         std::vector<T> res;
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         for (size_t i = 0; i < mats.size(); i++) {
             res.insert(res.end(), sub_results[i].begin(), sub_results[i].end());
         }
@@ -548,7 +569,7 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
     }
 
     StatsResult
-    computeMatrixStats(Stats row_stats, Stats col_stats, std::atomic<bool> *user_interrupt) override {
+    computeMatrixStats(Stats row_stats, Stats col_stats, const ExecutionContext &ctx) override {
         std::vector<std::future<StatsResult>> task_vec;
         // Multiply chunks, and add outputs
         for (size_t i = 0; i < mats.size(); i++) {
@@ -558,10 +579,10 @@ template <typename T> class ConcatCols : public MatrixLoader<T> {
                 mats[i].get(),
                 row_stats,
                 col_stats,
-                user_interrupt
+                ctx
             ));
         }
-        std::vector<StatsResult> sub_results = parallel_map_helper(task_vec, threads);
+        std::vector<StatsResult> sub_results = parallel_map_helper(task_vec, threads, ctx);
         StatsResult res{
             Eigen::ArrayXXd((int)row_stats, rows()), Eigen::ArrayXXd((int)col_stats, cols())};
         res.row_stats.setZero();
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cmath>
+
+#include "MatrixIterator.h"
+
+namespace BPCells {
+
+// Downsample the counts in each column of a matrix towards a target total, e.g. to normalize
+// sequencing depth per cell. Entries that drop to zero are removed from the output.
+// - Binomial: each count is kept independently with probability target / total for its column
+// - Hypergeometric: exactly min(target, total) counts are kept in each column, sampling without
+//   replacement
+//
+// Random draws come from a counter-based generator keyed by (seed, row, col), where row and col
+// are the coordinates seen by this loader. Output is identical across restarts, seeks, and
+// splitting the columns into ranges read by separate threads.
+// Hypergeometric draws for an entry depend on the entries loaded before it in the same column,
+// so input columns must load in a deterministic order
+class DownsampleCounts : public MatrixLoaderWrapper<uint32_t> {
+  public:
+    enum class Method { Binomial, Hypergeometric };
+
+  private:
+    std::vector<uint64_t> col_totals;
+    std::vector<uint64_t> targets;
+    Method method;
+    uint64_t seed;
+
+    std::vector<uint32_t> row_buf, val_buf;
+    uint32_t loaded = 0;
+
+    // Hypergeometric sampling state for the column currently being loaded
+    uint32_t state_col = UINT32_MAX;
+    uint64_t pool_left, draws_left;
+
+    static uint64_t mix64(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // Stateless stream of uniform doubles in [0, 1) for a single matrix entry
+    class EntryRandom {
+        uint64_t key;
+        uint64_t counter = 0;
+
+      public:
+        EntryRandom(uint64_t seed, uint32_t row, uint32_t col)
+            : key(mix64(seed ^ mix64(((uint64_t)col << 32) | row))) {}
+
+        double next() {
+            counter += 0x9e3779b97f4a7c15ULL;
+            return (mix64(key + counter) >> 11) * 0x1.0p-53;
+        }
+    };
+
+    static uint32_t binomial(uint32_t n, double p, EntryRandom &rng) {
+        if (p >= 1) return n;
+        if (p <= 0 || n == 0) return 0;
+        bool flip = p > 0.5;
+        double prob = flip ? 1 - p : p;
+        uint32_t x = 0;
+        if (n * prob < 30) {
+            // Inversion from the lower tail, which takes O(n * prob) steps
+            double q = 1 - prob;
+            double s = prob / q;
+            double a = (n + 1) * s;
+            double r = std::pow(q, (double)n);
+            double u = rng.next();
+            while (u > r && x < n) {
+                u -= r;
+                x++;
+                r *= a / x - s;
+            }
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                x += rng.next() < prob;
+            }
+        }
+        return flip ? n - x : x;
+    }
+
+    // Select from the n counts of an entry, given the remaining counts and draws in its column.
+    // Each count is kept with probability draws_left / pool_left (selection sampling)
+    uint32_t hypergeometric(uint32_t n, EntryRandom &rng) {
+        if (n > pool_left)
+            throw std::runtime_error("DownsampleCounts: column has more counts than its total");
+        uint32_t x = 0;
+        for (uint32_t i = 0; i < n && draws_left > 0; i++) {
+            if (rng.next() * (pool_left - i) < draws_left) {
+                x++;
+                draws_left--;
+            }
+        }
+        pool_left -= n;
+        return x;
+    }
+
+  public:
+    // col_totals -- sum of the counts in each column of the input
+    // targets -- total number of counts to keep in each column
+    DownsampleCounts(
+        std::unique_ptr<MatrixLoader<uint32_t>> &&loader,
+        std::vector<uint64_t> col_totals,
+        std::vector<uint64_t> targets,
+        Method method,
+        uint64_t seed
+    )
+        : MatrixLoaderWrapper<uint32_t>(std::move(loader))
+        , col_totals(std::move(col_totals))
+        , targets(std::move(targets))
+        , method(method)
+        , seed(seed) {
+        if (this->col_totals.size() != this->loader->cols() ||
+            this->targets.size() != this->loader->cols()) {
+            throw std::runtime_error(
+                "DownsampleCounts: column totals and targets must have one entry per column"
+            );
+        }
+    }
+
+    void restart() override {
+        state_col = UINT32_MAX;
+        this->loader->restart();
+    }
+    void seekCol(uint32_t col) override {
+        state_col = UINT32_MAX;
+        this->loader->seekCol(col);
+    }
+    bool nextCol() override {
+        state_col = UINT32_MAX;
+        return this->loader->nextCol();
+    }
+
+    bool load() override {
+        loaded = 0;
+        while (loaded == 0) {
+            if (!this->loader->load()) return false;
+            uint32_t col = this->loader->currentCol();
+            if (col != state_col) {
+                state_col = col;
+                pool_left = col_totals[col];
+                draws_left = std::min(targets[col], col_totals[col]);
+            }
+            double p = col_totals[col] == 0 ? 1 : (double)targets[col] / col_totals[col];
+
+            uint32_t cap = this->loader->capacity();
+            uint32_t *row_in = this->loader->rowData();
+            uint32_t *val_in = this->loader->valData();
+            row_buf.resize(std::max<size_t>(row_buf.size(), cap));
+            val_buf.resize(std::max<size_t>(val_buf.size(), cap));
+            for (uint32_t i = 0; i < cap; i++) {
+                EntryRandom rng(seed, row_in[i], col);
+                uint32_t val = method == Method::Binomial ? binomial(val_in[i], p, rng)
+                                                          : hypergeometric(val_in[i], rng);
+                row_buf[loaded] = row_in[i];
+                val_buf[loaded] = val;
+                loaded += val != 0;
+            }
+        }
+        return true;
+    }
+
+    uint32_t capacity() const override { return loaded; }
+    uint32_t *rowData() override { return row_buf.data(); }
+    uint32_t *valData() override { return val_buf.data(); }
+};
+
+} // end namespace BPCells
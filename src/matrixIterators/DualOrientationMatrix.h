@@ -0,0 +1,248 @@
+#pragma once
+
+#include "../arrayIO/prefix.h"
+#include "../arrayIO/vector.h"
+#include "MatrixIterator.h"
+#include "StoredMatrix.h"
+#include "StoredMatrixTransposeWriter.h"
+#include "StoredMatrixWriter.h"
+
+namespace BPCells {
+
+// Dual-orientation matrices hold a packed matrix plus a second packed copy in the opposite
+// storage order, written alongside it with this array name prefix. The first copy is a
+// regular matrix, so readers unaware of the transposed copy can still load it
+inline const std::string dual_orientation_prefix = "transpose_";
+
+// Write `mat` as a dual-orientation matrix. The primary copy is written as by
+// StoredMatrixWriter<T>::createPacked(wb, row_major), and the transposed copy as by
+// StoredMatrixTransposeWriter, using `tmpdir` for sorting. `mat` is read twice
+template <typename T>
+void writeDualOrientationMatrix(
+    MatrixLoader<T> &mat,
+    WriterBuilder &wb,
+    const char *tmpdir,
+    bool row_major = false,
+    uint64_t load_bytes = 4 << 20,
+    uint64_t sort_buffer_bytes = 1 << 30,
+    const ExecutionContext &ctx = {}
+) {
+    mat.restart();
+    StoredMatrixWriter<T>::createPacked(wb, row_major).write(mat, ctx);
+    if (ctx.interrupted()) return;
+
+    PrefixWriterBuilder transpose_wb(wb, dual_orientation_prefix);
+    StoredMatrixTransposeWriter<T> transpose(
+        transpose_wb, tmpdir, load_bytes, sort_buffer_bytes, !row_major
+    );
+    transpose.write(mat, ctx);
+}
+
+// Loads the primary copy of a dual-orientation matrix, answering each operation from the copy
+// that streams for it: row sums and stats, right multiplies, and small row selections read the
+// transposed copy, whose columns are the rows of this matrix
+template <typename T> class DualOrientationMatrix : public MatrixLoaderWrapper<T> {
+  private:
+    std::unique_ptr<StoredMatrix<T>> transposed;
+    std::vector<uint64_t> transposed_ptr;
+    // Once rows are selected the two copies no longer match, so everything uses the loader
+    bool row_filter = false;
+    // Holds a row selection read from the transposed copy
+    std::unique_ptr<VecReaderWriterBuilder> selection;
+    uint64_t max_selection_bytes = default_max_selection_bytes;
+
+    template <typename V> static void writeVec(NumWriter<V> &&w, const std::vector<V> &data) {
+        for (uint64_t i = 0; i < data.size();) {
+            uint64_t amount = std::min<uint64_t>(w.maxCapacity(), data.size() - i);
+            w.ensureCapacity(amount);
+            std::memmove(w.data(), data.data() + i, amount * sizeof(V));
+            w.advance(amount);
+            i += amount;
+        }
+        w.finalize();
+    }
+
+    // Read the selected rows as columns of the transposed copy, and counting sort them into
+    // an in-memory column-major matrix that replaces the primary copy
+    void selectFromTransposed(const std::vector<uint32_t> &row_indices) {
+        uint32_t n_cols = this->loader->cols();
+        std::vector<uint32_t> entry_col;
+        std::vector<T> entry_val;
+        std::vector<uint64_t> row_start = {0};
+        for (uint32_t r : row_indices) {
+            transposed->seekCol(r);
+            while (transposed->load()) {
+                uint32_t cap = transposed->capacity();
+                entry_col.insert(
+                    entry_col.end(), transposed->rowData(), transposed->rowData() + cap
+                );
+                entry_val.insert(
+                    entry_val.end(), transposed->valData(), transposed->valData() + cap
+                );
+            }
+            row_start.push_back(entry_col.size());
+        }
+
+        std::vector<uint64_t> col_ptr(n_cols + 1, 0);
+        for (uint32_t c : entry_col) {
+            col_ptr[c + 1] += 1;
+        }
+        for (uint32_t c = 0; c < n_cols; c++) {
+            col_ptr[c + 1] += col_ptr[c];
+        }
+        std::vector<uint64_t> pos(col_ptr.begin(), col_ptr.end() - 1);
+        std::vector<uint32_t> index(entry_col.size());
+        std::vector<T> val(entry_col.size());
+        for (uint32_t i = 0; i < row_indices.size(); i++) {
+            for (uint64_t j = row_start[i]; j < row_start[i + 1]; j++) {
+                uint64_t out = pos[entry_col[j]]++;
+                index[out] = i;
+                val[out] = entry_val[j];
+            }
+        }
+
+        std::vector<std::string> row_names, col_names;
+        for (uint32_t r : row_indices) {
+            const char *name = this->loader->rowNames(r);
+            if (name == NULL) break;
+            row_names.push_back(name);
+        }
+        for (uint32_t c = 0;; c++) {
+            const char *name = this->loader->colNames(c);
+            if (name == NULL) break;
+            col_names.push_back(name);
+        }
+
+        selection = std::make_unique<VecReaderWriterBuilder>();
+        selection->writeVersion(StoredMatrix<T>::versionString(false, 2));
+        writeVec(selection->createUIntWriter("index"), index);
+        writeVec(selection->create<T>("val"), val);
+        writeVec(selection->createULongWriter("idxptr"), col_ptr);
+        this->loader = std::make_unique<StoredMatrix<T>>(StoredMatrix<T>::openUnpacked(
+            *selection,
+            std::make_unique<VecStringReader>(row_names),
+            std::make_unique<VecStringReader>(col_names),
+            row_indices.size()
+        ));
+    }
+
+    // Peak memory of selectFromTransposed: the gathered entries and their sorted copy, plus the
+    // column pointers and insert positions
+    uint64_t selectionBytes(uint64_t entries) const {
+        return 2 * entries * (sizeof(uint32_t) + sizeof(T)) +
+               2 * ((uint64_t)this->loader->cols() + 1) * sizeof(uint64_t);
+    }
+
+  public:
+    // Row selections with at most 1/selection_ratio of the entries are read from the
+    // transposed copy, so long as they fit in max_selection_bytes of memory. Other selections
+    // filter the primary copy, which decodes every row index but streams
+    static constexpr uint64_t selection_ratio = 16;
+    static constexpr uint64_t default_max_selection_bytes = 256 << 20;
+
+    DualOrientationMatrix(StoredMatrix<T> &&primary, StoredMatrix<T> &&transposed)
+        : MatrixLoaderWrapper<T>(std::make_unique<StoredMatrix<T>>(std::move(primary)))
+        , transposed(std::make_unique<StoredMatrix<T>>(std::move(transposed))) {
+        if (this->transposed->rows() != this->loader->cols() ||
+            this->transposed->cols() != this->loader->rows()) {
+            throw std::runtime_error("DualOrientationMatrix: transposed copy has wrong shape");
+        }
+        transposed_ptr = this->transposed->colPtr();
+    }
+
+    // Returns true if `rb` holds a transposed copy written by writeDualOrientationMatrix
+    static bool isDualOrientation(ReaderBuilder &rb) {
+        return PrefixReaderBuilder::hasPrefix(rb, dual_orientation_prefix);
+    }
+
+    // Open the transposed copy on its own, e.g. to split its columns across threads
+    static StoredMatrix<T> openTransposed(ReaderBuilder &rb, uint32_t load_size = 1024) {
+        PrefixReaderBuilder transpose_rb(rb, dual_orientation_prefix);
+        return StoredMatrix<T>::openPacked(transpose_rb, load_size);
+    }
+
+    static DualOrientationMatrix<T> openPacked(ReaderBuilder &rb, uint32_t load_size = 1024) {
+        return DualOrientationMatrix<T>(
+            StoredMatrix<T>::openPacked(rb, load_size), openTransposed(rb, load_size)
+        );
+    }
+
+    // As above, but with the primary copy's names and row count given as for
+    // StoredMatrix<T>::openPacked
+    static DualOrientationMatrix<T> openPacked(
+        ReaderBuilder &rb,
+        uint32_t load_size,
+        std::unique_ptr<StringReader> &&row_names,
+        std::unique_ptr<StringReader> &&col_names,
+        uint32_t row_count
+    ) {
+        return DualOrientationMatrix<T>(
+            StoredMatrix<T>::openPacked(
+                rb, load_size, std::move(row_names), std::move(col_names), row_count
+            ),
+            openTransposed(rb, load_size)
+        );
+    }
+
+    // Set the memory limit for row selections read from the transposed copy
+    void setMaxSelectionBytes(uint64_t bytes) { max_selection_bytes = bytes; }
+
+    bool pushdownRowSelect(const std::vector<uint32_t> &row_indices) override {
+        if (row_filter) return false;
+        uint64_t selected_entries = 0;
+        for (uint32_t r : row_indices) {
+            if (r >= this->loader->rows())
+                throw std::runtime_error("Row selection index is greater than number of rows");
+            selected_entries += transposed_ptr[r + 1] - transposed_ptr[r];
+        }
+        uint64_t total_entries = transposed_ptr.back() - transposed_ptr.front();
+        if (selected_entries * selection_ratio <= total_entries &&
+            selectionBytes(selected_entries) <= max_selection_bytes) {
+            selectFromTransposed(row_indices);
+        } else if (!this->loader->pushdownRowSelect(row_indices)) {
+            return false;
+        }
+        row_filter = true;
+        return true;
+    }
+
+    Eigen::MatrixXd denseMultiplyRight(
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
+    ) override {
+        if (row_filter) return MatrixLoader<T>::denseMultiplyRight(B, ctx);
+        if (this->cols() != B.rows())
+            throw std::runtime_error("Incompatible dimensions for matrix multiply");
+        // A*B = (B^T * A^T)^T
+        Eigen::MatrixXd Bt = B.transpose();
+        return transposed
+            ->denseMultiplyLeft(Eigen::Map<Eigen::MatrixXd>(Bt.data(), Bt.rows(), Bt.cols()), ctx)
+            .transpose();
+    }
+
+    Eigen::VectorXd vecMultiplyRight(
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
+    ) override {
+        if (row_filter) return MatrixLoader<T>::vecMultiplyRight(v, ctx);
+        return transposed->vecMultiplyLeft(v, ctx);
+    }
+
+    std::vector<T> rowSums(const ExecutionContext &ctx = {}) override {
+        if (row_filter) return MatrixLoader<T>::rowSums(ctx);
+        return transposed->colSums(ctx);
+    }
+
+    // Row-only stats stream over the transposed copy. When column stats are also needed, a
+    // single pass over the primary copy reads less than two streaming passes
+    StatsResult computeMatrixStats(
+        Stats row_stats, Stats col_stats, const ExecutionContext &ctx = {}
+    ) override {
+        if (row_filter || row_stats == Stats::None || col_stats != Stats::None) {
+            return MatrixLoader<T>::computeMatrixStats(row_stats, col_stats, ctx);
+        }
+        StatsResult res = transposed->computeMatrixStats(Stats::None, row_stats, ctx);
+        std::swap(res.row_stats, res.col_stats);
+        return res;
+    }
+};
+
+} // end namespace BPCells
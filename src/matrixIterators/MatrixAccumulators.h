@@ -25,6 +25,13 @@
 //    (empirically about 10 on my 10k PBMC dataset). This makes it likely unsuitable for
 //    calculating tile matrices
 //  - time is about 1.6 seconds to calculate peak matrix on 10k PBMCs
+//  - add_one scans the active columns linearly, so it slows down as more columns are active
+// MatrixAccumulator_adaptive
+//  - Holds one of each accumulator above, and picks which one receives entries each time the
+//    caller starts a new chromosome. The dense strategy is picked when the expected number of
+//    active columns is small and its memory bound (active columns * rows) fits in a budget.
+//  - Columns from later chromosomes are always higher than from earlier chromosomes, so any
+//    given column lives entirely in one of the two accumulators.
 
 namespace BPCells {
 
@@ -283,4 +290,119 @@ template <typename T> class MatrixAccumulator_vec {
     T *valData() { return val_data.data() + output_idx; }
 };
 
+enum class AccumulatorStrategy { Auto, Sort, Dense };
+
+// Estimate the most columns an accumulator holds at once while streaming start-sorted fragments
+// over one chromosome, as the most columns touched by any `window` bp span of the features.
+// Features are given sorted by start, and feature i is split into columns `width[i]` bp wide.
+// Overlapping features are all counted, so this errs on the high side.
+inline uint32_t estimateActiveCols(
+    const std::vector<uint32_t> &start,
+    const std::vector<uint32_t> &end,
+    const std::vector<uint32_t> &width,
+    uint32_t window
+) {
+    uint32_t max_len = 0;
+    for (size_t i = 0; i < start.size(); i++) {
+        max_len = std::max(max_len, end[i] - start[i]);
+    }
+    auto cols_in_window = [&](size_t i) {
+        uint64_t total = (end[i] - start[i] + width[i] - 1) / width[i];
+        return std::min<uint64_t>(total, window / width[i] + 2);
+    };
+    // Sum over features starting within [start[lo], start[lo] + max_len + window)
+    uint64_t cur = 0, best = 0;
+    size_t hi = 0;
+    for (size_t lo = 0; lo < start.size(); lo++) {
+        uint64_t limit = (uint64_t)start[lo] + max_len + window;
+        while (hi < start.size() && start[hi] < limit) {
+            cur += cols_in_window(hi);
+            hi++;
+        }
+        best = std::max(best, cur);
+        cur -= cols_in_window(lo);
+    }
+    return std::min<uint64_t>(best, UINT32_MAX);
+}
+
+template <typename T> class MatrixAccumulator_adaptive {
+  public:
+    // Beyond this many active columns, the linear scan in MatrixAccumulator_vec::add_one makes
+    // it slower than sorting
+    static constexpr uint32_t MAX_DENSE_ACTIVE_COLS = 16;
+
+  private:
+    MatrixAccumulator<T> sorted;
+    MatrixAccumulator_vec<T> dense;
+    uint32_t n_rows;
+    AccumulatorStrategy strategy;
+    uint64_t max_dense_bytes;
+    bool use_dense = false;
+    bool loading_dense = false;
+
+  public:
+    // n_rows -- number of matrix rows, which bounds the size of each dense column
+    // strategy -- Sort or Dense to always use one accumulator, or Auto to choose per chromosome
+    // max_dense_bytes -- memory budget for the dense accumulator under Auto
+    MatrixAccumulator_adaptive(
+        uint32_t n_rows = 0,
+        AccumulatorStrategy strategy = AccumulatorStrategy::Auto,
+        uint64_t max_dense_bytes = 1 << 28
+    )
+        : n_rows(n_rows)
+        , strategy(strategy)
+        , max_dense_bytes(max_dense_bytes)
+        , use_dense(strategy == AccumulatorStrategy::Dense) {
+        sorted.clear();
+    }
+
+    // Pick the accumulator for the entries of a new chromosome, given an estimate of how many
+    // columns will be active at once (e.g. from estimateActiveCols)
+    void start_chr(uint32_t expected_active_cols) {
+        if (strategy != AccumulatorStrategy::Auto) return;
+        use_dense = expected_active_cols <= MAX_DENSE_ACTIVE_COLS &&
+                    (uint64_t)expected_active_cols * n_rows * sizeof(T) <= max_dense_bytes;
+    }
+
+    // Whether new entries currently go to the dense accumulator
+    bool using_dense() const { return use_dense; }
+
+    void clear() {
+        sorted.clear();
+        dense.clear();
+        loading_dense = false;
+    }
+
+    inline void add_one(uint32_t col, uint32_t row, T val) {
+        if (use_dense) dense.add_one(col, row, val);
+        else sorted.add_one(col, row, val);
+    }
+
+    bool ready_for_loading() const {
+        return use_dense ? dense.ready_for_loading() : sorted.ready_for_loading();
+    }
+
+    bool discard_until(uint32_t min_col) {
+        bool has_sorted = sorted.discard_until(min_col);
+        bool has_dense = dense.discard_until(min_col);
+        return has_sorted || has_dense;
+    }
+
+    // A column's entries are all in one accumulator, and the other one reports no entries up
+    // to max_col without changing state, so we can just try both
+    bool load(uint32_t max_col, uint32_t max_entries) {
+        loading_dense = false;
+        if (sorted.load(max_col, max_entries)) return true;
+        loading_dense = true;
+        return dense.load(max_col, max_entries);
+    }
+
+    uint32_t capacity() const { return loading_dense ? dense.capacity() : sorted.capacity(); }
+    uint32_t currentCol() const {
+        return loading_dense ? dense.currentCol() : sorted.currentCol();
+    }
+    uint32_t *rowData() { return loading_dense ? dense.rowData() : sorted.rowData(); }
+    T *valData() { return loading_dense ? dense.valData() : sorted.valData(); }
+};
+
 } // end namespace BPCells
\ No newline at end of file
@@ -50,6 +50,16 @@ template <class T> class MatrixColSelect : public MatrixLoaderWrapper<T> {
         }
     }
     uint32_t currentCol() const override { return current_col; }
+
+    bool colEntryCounts(std::vector<uint64_t> &counts) override {
+        std::vector<uint64_t> inner_counts;
+        if (!this->loader->colEntryCounts(inner_counts)) return false;
+        counts.resize(col_indices.size());
+        for (uint32_t i = 0; i < col_indices.size(); i++) {
+            counts[i] = inner_counts[col_indices[i]];
+        }
+        return true;
+    }
 };
 
 // Select specific rows from a dataset
@@ -58,6 +68,8 @@ template <class T> class MatrixColSelect : public MatrixLoaderWrapper<T> {
 template <class T> class MatrixRowSelect : public MatrixLoaderWrapper<T> {
   private:
     uint32_t loaded = 0;
+    // True if the inner loader applies the selection itself
+    bool pushed_down = false;
 
     // Reverse lookup for row indices -- reverse_indices[i] gives the output row_id
     // for input row_id i
@@ -79,12 +91,14 @@ template <class T> class MatrixRowSelect : public MatrixLoaderWrapper<T> {
                 throw std::runtime_error("Cannot duplicate rows using MatrixRowSelect");
             reverse_indices[row_indices[i]] = i;
         }
+        pushed_down = this->loader->pushdownRowSelect(row_indices);
     }
 
     ~MatrixRowSelect() = default;
 
     uint32_t rows() const override { return row_indices.size(); }
     const char *rowNames(uint32_t row) override {
+        if (pushed_down) return this->loader->rowNames(row);
         if (row < row_indices.size()) return this->loader->rowNames(row_indices[row]);
         return NULL;
     }
@@ -104,6 +118,11 @@ template <class T> class MatrixRowSelect : public MatrixLoaderWrapper<T> {
     }
 
     bool load() override {
+        if (pushed_down) {
+            if (!this->loader->load()) return false;
+            loaded = this->loader->capacity();
+            return true;
+        }
         // Just perform a straight filter and load incrementally
         loaded = 0;
         while (loaded == 0) {
@@ -15,6 +15,7 @@
 #endif
 // [[Rcpp::depends(RcppEigen)]]
 
+#include "../utils/execution_context.h"
 #include "MatrixStats.h"
 
 namespace BPCells {
@@ -75,25 +76,35 @@ template <typename T> class MatrixLoader {
     virtual uint32_t *rowData() = 0;
     virtual T *valData() = 0;
 
+    // Restrict output to the given rows, renumbered by their position in row_indices.
+    // Loaders that can skip decoding work for unselected rows override this and return true.
+    // The default returns false, in which case MatrixRowSelect filters entries after loading
+    virtual bool pushdownRowSelect(const std::vector<uint32_t> &row_indices) { return false; }
+
+    // Set counts to the number of entries that will be loaded from each column.
+    // Loaders that know this without decoding (e.g. from stored column pointers) override this
+    // and return true. May reset the iterator.
+    virtual bool colEntryCounts(std::vector<uint64_t> &counts) { return false; }
+
     // Matrix math operations (implemented in MatrixOps.cpp and MatrixStats.cpp)
     // These operations can be overloaded by matrix transform operations
 
     // Calculate matrix-matrix product A*B where A (this) is sparse and B is a dense matrix.
     virtual Eigen::MatrixXd denseMultiplyRight(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     );
     virtual Eigen::MatrixXd denseMultiplyLeft(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     );
     // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
     virtual Eigen::VectorXd
-    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL);
+    vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {});
     virtual Eigen::VectorXd
-    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL);
+    vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {});
 
     // Calculate row/column sums of the matrix
-    virtual std::vector<T> colSums(std::atomic<bool> *user_interrupt = NULL);
-    virtual std::vector<T> rowSums(std::atomic<bool> *user_interrupt = NULL);
+    virtual std::vector<T> colSums(const ExecutionContext &ctx = {});
+    virtual std::vector<T> rowSums(const ExecutionContext &ctx = {});
 
     // Calculate stats on the rows or columns of a matrix in a single pass.
     // For each of rows and columns, the user can choose to from the following
@@ -106,7 +117,7 @@ template <typename T> class MatrixLoader {
     // Outputs results to matrices row_output and col_output, which are col-major matrices,
     // with one column per # rows or # columns as appropriate, and one row per output statistic
     virtual StatsResult
-    computeMatrixStats(Stats row_stats, Stats col_stats, std::atomic<bool> *user_interrupt = NULL);
+    computeMatrixStats(Stats row_stats, Stats col_stats, const ExecutionContext &ctx = {});
 };
 
 // Usually downstream users will want MatrixLoaderWrapper.
@@ -169,6 +180,47 @@ template <typename T> class MatrixLoaderWrapper : public MatrixConverterLoaderWr
     T *valData() override { return this->loader->valData(); }
 };
 
+// Pass-through wrapper that records wall time, entries, chunks, and seeks into an
+// InstrumentNode. Wrap each pipeline stage of interest, giving each node its upstream
+// stages as children, then inspect the tree once an operation completes.
+// Timings are inclusive of upstream stages; see InstrumentNode::selfSeconds()
+template <typename T> class InstrumentedMatrix : public MatrixLoaderWrapper<T> {
+  private:
+    std::shared_ptr<InstrumentNode> node;
+
+  public:
+    InstrumentedMatrix(
+        std::unique_ptr<MatrixLoader<T>> &&loader, std::shared_ptr<InstrumentNode> node
+    )
+        : MatrixLoaderWrapper<T>(std::move(loader))
+        , node(std::move(node)) {
+        if (!this->node) throw std::invalid_argument("InstrumentedMatrix: node must not be NULL");
+    }
+
+    std::shared_ptr<InstrumentNode> instrumentation() { return node; }
+
+    void restart() override {
+        InstrumentTimer timer(node.get());
+        this->loader->restart();
+    }
+    void seekCol(uint32_t col) override {
+        InstrumentTimer timer(node.get());
+        node->seeks += 1;
+        this->loader->seekCol(col);
+    }
+    bool nextCol() override {
+        InstrumentTimer timer(node.get());
+        return this->loader->nextCol();
+    }
+    bool load() override {
+        InstrumentTimer timer(node.get());
+        if (!this->loader->load()) return false;
+        node->entries += this->loader->capacity();
+        node->chunks += 1;
+        return true;
+    }
+};
+
 template <typename T> class MatrixIterator : public MatrixLoaderWrapper<T> {
   private:
     uint32_t idx = UINT32_MAX;
@@ -234,7 +286,7 @@ template <typename T> class MatrixIterator : public MatrixLoaderWrapper<T> {
 template <typename T> class MatrixWriter {
   public:
     virtual ~MatrixWriter(){};
-    virtual void write(MatrixLoader<T> &mat, std::atomic<bool> *user_interrupt = NULL) = 0;
+    virtual void write(MatrixLoader<T> &mat, const ExecutionContext &ctx = {}) = 0;
 };
 
 template <typename Tin, typename Tout> class MatrixConverterLoader : public MatrixLoader<Tout> {
@@ -258,6 +310,10 @@ template <typename Tin, typename Tout> class MatrixConverterLoader : public Matr
     bool nextCol() override { return loader->nextCol(); }
     uint32_t currentCol() const override { return loader->currentCol(); }
 
+    bool colEntryCounts(std::vector<uint64_t> &counts) override {
+        return loader->colEntryCounts(counts);
+    }
+
     bool load() override {
         if (!loader->load()) return false;
 
@@ -12,7 +12,7 @@ void importMtx(
     uint64_t load_bytes,
     uint64_t sort_buffer_bytes,
     bool row_major,
-    std::atomic<bool> *user_interrupt
+    const ExecutionContext &ctx
 ) {
     MatrixMarketHeader h;
     h = MatrixMarketImport<uint32_t>::parse_header(input_path);
@@ -27,7 +27,7 @@ void importMtx(
             input_path, output, tmpdir, load_bytes, sort_buffer_bytes, row_major
         );
         importer.writeValues(
-            std::move(row_names), std::move(col_names), h.rows, h.cols, user_interrupt
+            std::move(row_names), std::move(col_names), h.rows, h.cols, ctx
         );
         if (importer.remaining_entries != 0) {
             throw std::runtime_error("importMtx: Detected truncated mtx input");
@@ -37,7 +37,7 @@ void importMtx(
             input_path, output, tmpdir, load_bytes, sort_buffer_bytes, row_major
         );
         importer.writeValues(
-            std::move(row_names), std::move(col_names), h.rows, h.cols, user_interrupt
+            std::move(row_names), std::move(col_names), h.rows, h.cols, ctx
         );
         if (importer.remaining_entries != 0) {
             throw std::runtime_error("importMtx: Detected truncated mtx input");
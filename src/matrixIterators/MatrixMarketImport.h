@@ -82,13 +82,13 @@ template <typename T> class MatrixMarketImport : public StoredMatrixSorter<T> {
         std::vector<uint32_t> &row,
         std::vector<uint32_t> &col,
         std::vector<T> &val,
-        std::atomic<bool> *user_interrupt
+        const ExecutionContext &ctx
     ) override {
         if (row_major) std::swap(row, col);
 
         size_t i;
         for (i = 0; i < row.size(); i++) {
-            if (i % 512 == 0 && user_interrupt != NULL && *user_interrupt) break;
+            if (i % 512 == 0 && ctx.interrupted()) break;
             if (!parse_line(row[i], col[i], val[i])) break;
         }
         if (row_major) std::swap(row, col);
@@ -133,7 +133,7 @@ template <typename T> class MatrixMarketImport : public StoredMatrixSorter<T> {
         uint64_t load_bytes,
         uint64_t sort_buffer_bytes,
         bool row_major,
-        std::atomic<bool> *user_interrupt
+        const ExecutionContext &ctx
     );
 };
 
@@ -147,7 +147,7 @@ void importMtx(
     uint64_t load_bytes,
     uint64_t sort_buffer_bytes,
     bool row_major,
-    std::atomic<bool> *user_interrupt
+    const ExecutionContext &ctx
 );
 
 } // end namespace BPCells
\ No newline at end of file
@@ -106,51 +106,51 @@ template <typename T> class SparseMultiply : public MatrixLoader<T> {
     // MATH OPERATIONS: utilize associative property that A*B*C = (A*B)*C = A*(B*C)
     // Calculate matrix-matrix product A*B where A (this) is sparse and B is a dense matrix.
     Eigen::MatrixXd denseMultiplyRight(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override {
-        auto tmp = right->denseMultiplyRight(B, user_interrupt);
+        auto tmp = right->denseMultiplyRight(B, ctx);
         Eigen::Map<Eigen::MatrixXd> map(tmp.data(), tmp.rows(), tmp.cols());
-        return left->denseMultiplyRight(map, user_interrupt);
+        return left->denseMultiplyRight(map, ctx);
     }
     Eigen::MatrixXd denseMultiplyLeft(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override {
-        auto tmp = left->denseMultiplyLeft(B, user_interrupt);
+        auto tmp = left->denseMultiplyLeft(B, ctx);
         Eigen::Map<Eigen::MatrixXd> map(tmp.data(), tmp.rows(), tmp.cols());
-        return right->denseMultiplyLeft(map, user_interrupt);
+        return right->denseMultiplyLeft(map, ctx);
     }
     // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
     Eigen::VectorXd vecMultiplyRight(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override {
-        auto tmp = right->vecMultiplyRight(v, user_interrupt);
+        auto tmp = right->vecMultiplyRight(v, ctx);
         Eigen::Map<Eigen::VectorXd> map(tmp.data(), tmp.rows(), tmp.cols());
-        return left->vecMultiplyRight(map, user_interrupt);
+        return left->vecMultiplyRight(map, ctx);
     }
     Eigen::VectorXd vecMultiplyLeft(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override {
-        auto tmp = left->vecMultiplyLeft(v, user_interrupt);
+        auto tmp = left->vecMultiplyLeft(v, ctx);
         Eigen::Map<Eigen::VectorXd> map(tmp.data(), tmp.rows(), tmp.cols());
-        return right->vecMultiplyLeft(map, user_interrupt);
+        return right->vecMultiplyLeft(map, ctx);
     }
     // Calculate row/column sums of the matrix
-    std::vector<T> colSums(std::atomic<bool> *user_interrupt = NULL) override {
+    std::vector<T> colSums(const ExecutionContext &ctx = {}) override {
         Eigen::VectorXd v;
         v.setOnes(rows());
         Eigen::Map<Eigen::VectorXd> map(v.data(), v.rows(), v.cols());
-        auto res = vecMultiplyLeft(map, user_interrupt);
+        auto res = vecMultiplyLeft(map, ctx);
         std::vector<T> ret(cols());
         for (uint32_t i = 0; i < cols(); i++) {
             ret[i] = res[i];
         }
         return ret;
     }
-    std::vector<T> rowSums(std::atomic<bool> *user_interrupt = NULL) override {
+    std::vector<T> rowSums(const ExecutionContext &ctx = {}) override {
         Eigen::VectorXd v;
         v.setOnes(cols());
         Eigen::Map<Eigen::VectorXd> map(v.data(), v.rows(), v.cols());
-        auto res = vecMultiplyRight(map, user_interrupt);
+        auto res = vecMultiplyRight(map, ctx);
         std::vector<T> ret(rows());
         for (uint32_t i = 0; i < rows(); i++) {
             ret[i] = res[i];
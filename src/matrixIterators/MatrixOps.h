@@ -10,7 +10,7 @@ namespace BPCells {
 // Calculate matrix-matrix product A*B where A (this) is sparse and B is a dense matrix.
 template <typename T>
 Eigen::MatrixXd MatrixLoader<T>::denseMultiplyRight(
-    const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     // Use transposed output so that results write contiguously in memory.
     // Note that left multiply will have better performance properties due
@@ -23,7 +23,7 @@ Eigen::MatrixXd MatrixLoader<T>::denseMultiplyRight(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         while (load()) {
             const T *val_data = valData();
             const uint32_t *row_data = rowData();
@@ -37,7 +37,7 @@ Eigen::MatrixXd MatrixLoader<T>::denseMultiplyRight(
 }
 template <typename T>
 Eigen::MatrixXd MatrixLoader<T>::denseMultiplyLeft(
-    const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     if (rows() != B.cols()) throw std::runtime_error("Incompatible dimensions for matrix multiply");
     Eigen::MatrixXd res(B.rows(), cols());
@@ -45,7 +45,7 @@ Eigen::MatrixXd MatrixLoader<T>::denseMultiplyLeft(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         while (load()) {
             const T *val_data = valData();
             const uint32_t *row_data = rowData();
@@ -60,7 +60,7 @@ Eigen::MatrixXd MatrixLoader<T>::denseMultiplyLeft(
 // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
 template <typename T>
 Eigen::VectorXd MatrixLoader<T>::vecMultiplyRight(
-    const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     if (cols() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
     Eigen::VectorXd res(rows());
@@ -69,7 +69,7 @@ Eigen::VectorXd MatrixLoader<T>::vecMultiplyRight(
     while (nextCol()) {
         const uint32_t col = currentCol();
         double v_col = v(col);
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         while (load()) {
             const T *val_data = valData();
             const uint32_t *row_data = rowData();
@@ -85,7 +85,7 @@ Eigen::VectorXd MatrixLoader<T>::vecMultiplyRight(
 }
 template <typename T>
 Eigen::VectorXd MatrixLoader<T>::vecMultiplyLeft(
-    const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     if (rows() != v.rows()) throw std::runtime_error("Incompatible dimensions for vector multiply");
     Eigen::VectorXd res(cols());
@@ -93,7 +93,7 @@ Eigen::VectorXd MatrixLoader<T>::vecMultiplyLeft(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         while (load()) {
             const T *val_data = valData();
             const uint32_t *row_data = rowData();
@@ -118,12 +118,12 @@ Eigen::VectorXd MatrixLoader<T>::vecMultiplyLeft(
 }
 
 // Calculate row/column sums of the matrix
-template <typename T> std::vector<T> MatrixLoader<T>::colSums(std::atomic<bool> *user_interrupt) {
+template <typename T> std::vector<T> MatrixLoader<T>::colSums(const ExecutionContext &ctx) {
     std::vector<T> sums(cols());
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return sums;
+        if (ctx.interrupted()) return sums;
         while (load()) {
             const T *val_data = valData();
             const uint32_t count = capacity();
@@ -134,11 +134,11 @@ template <typename T> std::vector<T> MatrixLoader<T>::colSums(std::atomic<bool>
     }
     return sums;
 }
-template <typename T> std::vector<T> MatrixLoader<T>::rowSums(std::atomic<bool> *user_interrupt) {
+template <typename T> std::vector<T> MatrixLoader<T>::rowSums(const ExecutionContext &ctx) {
     std::vector<T> sums(rows());
     restart();
     while (nextCol()) {
-        if (user_interrupt != NULL && *user_interrupt) return sums;
+        if (ctx.interrupted()) return sums;
         while (load()) {
             const uint32_t *row_data = rowData();
             const T *val_data = valData();
@@ -179,7 +179,7 @@ inline void update_mean_and_variance(
 // with one column per # rows or # columns as appropriate, and one row per output statistic
 template <typename T>
 StatsResult MatrixLoader<T>::computeMatrixStats(
-    Stats row_stats, Stats col_stats, std::atomic<bool> *user_interrupt
+    Stats row_stats, Stats col_stats, const ExecutionContext &ctx
 ) {
     restart();
     StatsResult res{
@@ -189,7 +189,7 @@ StatsResult MatrixLoader<T>::computeMatrixStats(
 
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         while (load()) {
             const uint32_t *row_data = rowData();
             const T *val_data = valData();
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "MatrixIterator.h"
+#include "MatrixStats.h"
+
+namespace BPCells {
+
+// An axis of a matrix in its logical orientation, regardless of how the matrix is stored
+enum class Axis { Row, Col };
+
+// How a per-row or per-column operation runs on a stored matrix.
+// MatrixLoaders iterate the stored major axis (columns of a column-major matrix, rows of a
+// row-major matrix, which is loaded as its transpose), so:
+// - Streaming: each output only depends on one loaded column. Memory is O(1) per output, and
+//   column ranges can be split across threads without a merge step
+// - Scatter: every loaded column updates a dense accumulator covering the whole axis
+enum class AxisKernel { Streaming, Scatter };
+
+// The logical axis that a loader iterates over as its columns
+inline Axis majorAxis(bool row_major) { return row_major ? Axis::Row : Axis::Col; }
+
+inline AxisKernel planAxisKernel(Axis axis, bool row_major) {
+    return axis == majorAxis(row_major) ? AxisKernel::Streaming : AxisKernel::Scatter;
+}
+
+// Calculate `stats` for each entry along the logical `axis` of a matrix stored with the given
+// orientation, where `mat` loads the stored orientation. Only the requested axis is computed,
+// using the streaming kernel when the storage order allows it.
+// Output has one column per entry of `axis` and one row per statistic, as in StatsResult
+template <typename T>
+Eigen::ArrayXXd computeAxisStats(
+    MatrixLoader<T> &mat,
+    Axis axis,
+    bool row_major,
+    Stats stats,
+    const ExecutionContext &ctx = {}
+) {
+    if (planAxisKernel(axis, row_major) == AxisKernel::Streaming) {
+        return mat.computeMatrixStats(Stats::None, stats, ctx).col_stats;
+    }
+    return mat.computeMatrixStats(stats, Stats::None, ctx).row_stats;
+}
+
+// Calculate sums along the logical `axis` of a matrix stored with the given orientation
+template <typename T>
+std::vector<T>
+axisSums(MatrixLoader<T> &mat, Axis axis, bool row_major, const ExecutionContext &ctx = {}) {
+    if (planAxisKernel(axis, row_major) == AxisKernel::Streaming) return mat.colSums(ctx);
+    return mat.rowSums(ctx);
+}
+
+} // end namespace BPCells
@@ -1,4 +1,5 @@
 #include "PeakMatrix.h"
+#include <queue>
 
 namespace BPCells {
 
@@ -8,10 +9,13 @@ PeakMatrixBase<MODE>::PeakMatrixBase(
     const std::vector<uint32_t> &chr,
     const std::vector<uint32_t> &start,
     const std::vector<uint32_t> &end,
-    std::unique_ptr<StringReader> &&chr_levels
+    std::unique_ptr<StringReader> &&chr_levels,
+    AccumulatorStrategy strategy,
+    PeakOverlapEngine engine
 )
     : frags(std::move(frags))
     , chr_levels(std::move(chr_levels))
+    , accumulator(std::max(this->frags->cellCount(), 0), strategy)
     , end_sorted_lookup(start.size())
     , n_peaks(start.size()) {
     if (this->frags->cellCount() < 0)
@@ -83,6 +87,54 @@ PeakMatrixBase<MODE>::PeakMatrixBase(
         else return a.end < b.end;
     });
 
+    // With overlapping peaks the start and end orders differ, so a peak that starts earlier
+    // than the seek target may still need to be counted
+    start_sorted_lookup.resize(n_peaks);
+    for (uint32_t i = 0; i < n_peaks; i++) {
+        start_sorted_lookup[end_sorted_lookup[i]] = i;
+    }
+    seek_peak.resize(n_peaks);
+    uint32_t min_peak = UINT32_MAX;
+    for (uint32_t col = n_peaks; col > 0; col--) {
+        min_peak = std::min(min_peak, start_sorted_lookup[col - 1]);
+        seek_peak[col - 1] = min_peak;
+    }
+
+    // Measure the most peaks covering any one base, to choose between overlap engines
+    uint32_t max_depth = 0;
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> open_ends;
+    for (auto p : sorted_peaks) {
+        uint64_t start = ((uint64_t)p.chr << 32) | p.start;
+        while (!open_ends.empty() && open_ends.top() <= start)
+            open_ends.pop();
+        open_ends.push(((uint64_t)p.chr << 32) | p.end);
+        max_depth = std::max(max_depth, (uint32_t)open_ends.size());
+    }
+    use_tree = engine == PeakOverlapEngine::IntervalTree ||
+               (engine == PeakOverlapEngine::Auto && max_depth >= TREE_MIN_DEPTH);
+    if (use_tree) {
+        // Put chromosome in the upper bits so one tree covers all chromosomes
+        std::vector<uint64_t> tree_start, tree_end;
+        for (auto p : sorted_peaks) {
+            tree_start.push_back(((uint64_t)p.chr << 32) | p.start);
+            tree_end.push_back(((uint64_t)p.chr << 32) | p.end);
+        }
+        tree = IntervalTree(std::move(tree_start), std::move(tree_end));
+    }
+
+    // Estimate how many peaks are in the accumulator at once on each chromosome
+    chr_active_cols.resize(this->chr_levels->size());
+    for (size_t i = 0; i < sorted_peaks.size();) {
+        std::vector<uint32_t> starts, ends, widths;
+        uint32_t c = sorted_peaks[i].chr;
+        for (; i < sorted_peaks.size() && sorted_peaks[i].chr == c; i++) {
+            starts.push_back(sorted_peaks[i].start);
+            ends.push_back(std::max(sorted_peaks[i].end, sorted_peaks[i].start + 1));
+            widths.push_back(ends.back() - starts.back());
+        }
+        chr_active_cols[c] = estimateActiveCols(starts, ends, widths, 1 << 16);
+    }
+
     // Sentinel value at end of sorted_peaks
     sorted_peaks.push_back({UINT32_MAX, UINT32_MAX, UINT32_MAX});
 
@@ -106,6 +158,12 @@ PeakMatrixBase<MODE>::PeakMatrixBase(
         next_completed_peak++;
     }
     next_active_peak = next_completed_peak;
+    tree_floor = next_active_peak;
+    startChr(this->frags->currentChr());
+}
+
+template <int MODE> void PeakMatrixBase<MODE>::startChr(uint32_t chr) {
+    if (chr < chr_active_cols.size()) accumulator.start_chr(chr_active_cols[chr]);
 }
 
 template <int MODE> uint32_t PeakMatrixBase<MODE>::rows() const { return frags->cellCount(); }
@@ -116,7 +174,7 @@ template <int MODE> const char *PeakMatrixBase<MODE>::rowNames(uint32_t row) {
 }
 template <int MODE> const char *PeakMatrixBase<MODE>::colNames(uint32_t col) {
     if (col >= n_peaks) return NULL;
-    auto peak = sorted_peaks[end_sorted_lookup[col]];
+    auto peak = sorted_peaks[start_sorted_lookup[col]];
     peak_name.clear();
     peak_name += frags->chrNames(peak.chr);
     peak_name += ":";
@@ -131,12 +189,14 @@ template <int MODE> void PeakMatrixBase<MODE>::restart() {
     active_peaks.clear();
     next_completed_peak = 0;
     next_active_peak = 0;
+    tree_floor = 0;
     current_output_peak = UINT32_MAX;
 }
 template <int MODE> void PeakMatrixBase<MODE>::seekCol(uint32_t col) {
     if (!frags->isSeekable())
         throw std::runtime_error("Can't seek a PeakMatrix if the fragments aren't seekable");
-    next_active_peak = end_sorted_lookup[col];
+    next_active_peak = seek_peak[col];
+    tree_floor = next_active_peak;
     next_completed_peak = 0;
     current_output_peak = col - 1;
     active_peaks.clear();
@@ -194,6 +254,7 @@ template <int MODE> void PeakMatrixBase<MODE>::loadFragments() {
 
     if (active_peaks.size() == 0 && frags->isSeekable()) {
         frags->seek(sorted_peaks[next_active_peak].chr, sorted_peaks[next_active_peak].start);
+        startChr(sorted_peaks[next_active_peak].chr);
     }
 
     while (true) {
@@ -226,7 +287,9 @@ template <int MODE> void PeakMatrixBase<MODE>::loadFragments() {
                 next_completed_peak++;
             }
             next_active_peak = next_completed_peak;
+            tree_floor = next_active_peak;
             active_peaks.clear();
+            startChr(frags->currentChr());
         }
         uint32_t capacity = frags->capacity();
         const uint32_t *start_data = frags->startData();
@@ -255,6 +318,20 @@ template <int MODE> void PeakMatrixBase<MODE>::loadFragments() {
                 next_active_peak += 1;
             }
 
+            if (use_tree) {
+                tallyTree(start_data + i, end_data + i, cell_data + i, items);
+                // Fragments are sorted by start, so the last one tells which peaks are done
+                uint32_t last_start = start_data[i + items - 1];
+                for (uint32_t j = 0; j < active_peaks.size(); j++) {
+                    if (last_start >= active_peaks[j].end) {
+                        completePeak(j);
+                        j -= 1;
+                    }
+                }
+                i += items;
+                continue;
+            }
+
             // For each active peak, iterate through the fragments & tally overlaps
             for (uint32_t j = 0; j < active_peaks.size(); j++) {
                 Peak p = active_peaks[j];
@@ -343,13 +420,7 @@ template <int MODE> void PeakMatrixBase<MODE>::loadFragments() {
                 // Remove the peak from active_peaks if we're done, and mark the
                 // next completed peak on our list
                 if (k < items) {
-                    while (sorted_peaks[next_completed_peak].chr == frags->currentChr() &&
-                           sorted_peaks[next_completed_peak].end <= p.end &&
-                           sorted_peaks[next_completed_peak].start <= p.start) {
-                        next_completed_peak += 1;
-                    }
-                    std::swap(active_peaks.back(), active_peaks[j]);
-                    active_peaks.pop_back();
+                    completePeak(j);
                     j -= 1;
                 }
             }
@@ -363,6 +434,48 @@ template <int MODE> void PeakMatrixBase<MODE>::loadFragments() {
     }
 }
 
+template <int MODE> void PeakMatrixBase<MODE>::completePeak(uint32_t j) {
+    Peak p = active_peaks[j];
+    while (sorted_peaks[next_completed_peak].chr == frags->currentChr() &&
+           sorted_peaks[next_completed_peak].end <= p.end &&
+           sorted_peaks[next_completed_peak].start <= p.start) {
+        next_completed_peak += 1;
+    }
+    std::swap(active_peaks.back(), active_peaks[j]);
+    active_peaks.pop_back();
+}
+
+template <int MODE>
+void PeakMatrixBase<MODE>::tallyTree(
+    const uint32_t *start, const uint32_t *end, const uint32_t *cell, uint32_t n
+) {
+    uint64_t chr = (uint64_t)frags->currentChr() << 32;
+    for (uint32_t i = 0; i < n; i++) {
+        tree_hits.clear();
+        uint32_t start_hits = 0;
+        if constexpr (MODE == 2) {
+            tree.overlaps(chr | start[i], chr | end[i], tree_hits);
+        } else {
+            // Peaks containing the start insertion, then peaks containing the end insertion
+            tree.overlaps(chr | start[i], (chr | start[i]) + 1, tree_hits);
+            start_hits = tree_hits.size();
+            if (end[i] > 0) tree.overlaps(chr | (end[i] - 1), chr | end[i], tree_hits);
+        }
+        for (uint32_t h = 0; h < tree_hits.size(); h++) {
+            uint32_t j = tree_hits[h];
+            // Skip peaks that the scan engine would not have activated yet
+            if (j < tree_floor || j >= next_active_peak) continue;
+            if constexpr (MODE == 1) {
+                // Count a fragment once if both insertions land in the peak
+                if (h >= start_hits && sorted_peaks[j].start <= start[i] &&
+                    start[i] < sorted_peaks[j].end)
+                    continue;
+            }
+            accumulator.add_one(end_sorted_lookup[j], cell[i], 1);
+        }
+    }
+}
+
 template class PeakMatrixBase<0>;
 template class PeakMatrixBase<1>;
 template class PeakMatrixBase<2>;
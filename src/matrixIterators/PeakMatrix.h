@@ -5,6 +5,7 @@
 #include "../arrayIO/array_interfaces.h"
 #include "../bitpacking/simd_vec.h"
 #include "../fragmentIterators/FragmentIterator.h"
+#include "../utils/interval_tree.h"
 #include "MatrixAccumulators.h"
 #include "MatrixIterator.h"
 
@@ -26,6 +27,15 @@ namespace BPCells {
 //      twice per peak
 //    - 2: Count fragment overlaps. Same as MODE == 1 but fragments that fully
 //      surround a peak will also be counted in that peak
+
+// How overlaps between fragments and active peaks are found:
+// - Scan: compare each active peak against every fragment in a block. Fastest when few peaks
+//   overlap each other
+// - IntervalTree: query an interval tree over the peaks for each fragment, so cost doesn't grow
+//   with the number of active peaks (e.g. for motif-centered windows or multi-resolution peaks)
+// - Auto: use IntervalTree when some base is covered by at least TREE_MIN_DEPTH peaks
+enum class PeakOverlapEngine { Auto, Scan, IntervalTree };
+
 template <int MODE> class PeakMatrixBase : public MatrixLoader<uint32_t> {
     static_assert(MODE == 0 || MODE == 1 || MODE == 2, "PeakMatrixBase: MODE must be 0, 1, or 2");
 
@@ -37,9 +47,14 @@ template <int MODE> class PeakMatrixBase : public MatrixLoader<uint32_t> {
 
     std::unique_ptr<FragmentLoader> frags;
     std::unique_ptr<StringReader> chr_levels;
-    MatrixAccumulator<uint32_t> accumulator;
-    std::vector<uint32_t> end_sorted_lookup; // end_sorted_lookup[i] gives the index of end-sorted
-                                             // peak i in the start-sorted list
+    MatrixAccumulator_adaptive<uint32_t> accumulator;
+    std::vector<uint32_t> chr_active_cols; // Estimated active columns per chromosome
+    std::vector<uint32_t> end_sorted_lookup; // end_sorted_lookup[i] gives the output index of
+                                             // start-sorted peak i
+    std::vector<uint32_t> start_sorted_lookup; // Inverse of end_sorted_lookup
+    // seek_peak[col] gives the first start-sorted peak with output index >= col, which is where
+    // to start activating peaks after seeking to col
+    std::vector<uint32_t> seek_peak;
     std::vector<Peak> sorted_peaks;
     std::vector<Peak> active_peaks;
     uint32_t next_completed_peak = 0;
@@ -47,9 +62,21 @@ template <int MODE> class PeakMatrixBase : public MatrixLoader<uint32_t> {
     uint32_t next_active_peak = 0;
     uint32_t n_peaks;
 
+    // Interval tree state. tree_floor is the first start-sorted peak activated since the last
+    // reset of active_peaks, so tree hits in [tree_floor, next_active_peak) are the active peaks
+    bool use_tree = false;
+    IntervalTree tree;
+    uint32_t tree_floor = 0;
+    std::vector<uint32_t> tree_hits;
+
     std::string peak_name; // buffer to use to store the peak name
 
     void loadFragments();
+    void startChr(uint32_t chr);
+    // Remove active_peaks[j] once all its fragments have been seen
+    void completePeak(uint32_t j);
+    // Tally overlaps for a block of fragments using the interval tree
+    void tallyTree(const uint32_t *start, const uint32_t *end, const uint32_t *cell, uint32_t n);
 
   public:
     // Note: It's the caller's responsibility to make sure that
@@ -60,14 +87,25 @@ template <int MODE> class PeakMatrixBase : public MatrixLoader<uint32_t> {
     // start, end - list of start + end coordinates for the peaks (start inclusive, end exclusive)
     // chr_levels - list of expected chr levels, for safety checking that peaks are coming from the
     //    correct chromosomes
+    // strategy - accumulator used to sum overlaps (see MatrixAccumulators.h). Auto picks
+    //    per chromosome based on peak density and cell count
+    // engine - method to find overlapping peaks for each fragment (see PeakOverlapEngine)
     PeakMatrixBase(
         std::unique_ptr<FragmentLoader> &&frags,
         const std::vector<uint32_t> &chr,
         const std::vector<uint32_t> &start,
         const std::vector<uint32_t> &end,
-        std::unique_ptr<StringReader> &&chr_levels
+        std::unique_ptr<StringReader> &&chr_levels,
+        AccumulatorStrategy strategy = AccumulatorStrategy::Auto,
+        PeakOverlapEngine engine = PeakOverlapEngine::Auto
     );
 
+    // Minimum peak overlap depth for PeakOverlapEngine::Auto to pick the interval tree
+    static constexpr uint32_t TREE_MIN_DEPTH = 8;
+
+    // Whether overlaps are found with the interval tree
+    bool usesIntervalTree() const { return use_tree; }
+
     uint32_t rows() const override;
     uint32_t cols() const override;
 
@@ -4,9 +4,9 @@
 #include <Eigen/Core>
 namespace BPCells {
 
-SpectraMatOp::SpectraMatOp(MatrixLoader<double> *mat, std::atomic<bool> *user_interrupt)
+SpectraMatOp::SpectraMatOp(MatrixLoader<double> *mat, const ExecutionContext &ctx)
     : mat(mat)
-    , user_interrupt(user_interrupt) 
+    , ctx(ctx) 
     , tall(mat->rows() > mat->cols()) {}
 
 Eigen::Index SpectraMatOp::rows() const {
@@ -20,15 +20,15 @@ void SpectraMatOp::perform_op(const double *x_in, double *y_out) const {
     Eigen::Map<Eigen::VectorXd> x_map((double *) x_in, cols());
 
     Eigen::VectorXd x2;
-    if (tall) x2 = mat->vecMultiplyRight(x_map, user_interrupt);
-    else x2 = mat->vecMultiplyLeft(x_map, user_interrupt);
+    if (tall) x2 = mat->vecMultiplyRight(x_map, ctx);
+    else x2 = mat->vecMultiplyLeft(x_map, ctx);
     Eigen::Map<Eigen::VectorXd> x2_map(x2.data(), x2.size());
 
     Eigen::Map<Eigen::VectorXd> out(y_out, rows());
-    if (tall) out = mat->vecMultiplyLeft(x2_map, user_interrupt);
-    else out = mat->vecMultiplyRight(x2_map, user_interrupt);
+    if (tall) out = mat->vecMultiplyLeft(x2_map, ctx);
+    else out = mat->vecMultiplyRight(x2_map, ctx);
 
-    if (user_interrupt != NULL && *user_interrupt) {
+    if (ctx.interrupted()) {
         throw SVD::UserInterruptException();
     }
 }
@@ -46,11 +46,11 @@ svd(MatrixLoader<double> *mat,
     int n_cv,
     int maxit,
     double tol,
-    std::atomic<bool> *user_interrupt) {
+    const ExecutionContext &ctx) {
 
     SVDResult res;
 
-    SpectraMatOp op(mat, user_interrupt);
+    SpectraMatOp op(mat, ctx);
     Spectra::SymEigsSolver<SpectraMatOp> eigs(op, k, n_cv);
     try {
         eigs.init();
@@ -77,13 +77,13 @@ svd(MatrixLoader<double> *mat,
         // Calculate D^-1 * Ut * M = Vt
         Eigen::MatrixXd tmp = d_inv * res.u.transpose();
         Eigen::Map<Eigen::MatrixXd> tmp_map(tmp.data(), tmp.rows(), tmp.cols());
-        res.v = mat->denseMultiplyLeft(tmp_map, user_interrupt).transpose();
+        res.v = mat->denseMultiplyLeft(tmp_map, ctx).transpose();
     } else {
         res.v = eigs.eigenvectors();
         // Calculate M * V * D^-1 = U
         Eigen::MatrixXd tmp = res.v * d_inv;
         Eigen::Map<Eigen::MatrixXd> tmp_map(tmp.data(), tmp.rows(), tmp.cols());
-        res.u = mat->denseMultiplyRight(tmp_map, user_interrupt);
+        res.u = mat->denseMultiplyRight(tmp_map, ctx);
     }
     res.num_operations += k;
 
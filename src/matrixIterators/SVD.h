@@ -16,11 +16,11 @@ class UserInterruptException : std::exception {
 class SpectraMatOp {
   private:
     MatrixLoader<double> *mat;
-    std::atomic<bool> *user_interrupt;
+    ExecutionContext ctx;
     const bool tall; // If true, calculate t(A)*A; else calculate A*t(A)
 
   public:
-    SpectraMatOp(MatrixLoader<double> *mat, std::atomic<bool> *user_interrupt);
+    SpectraMatOp(MatrixLoader<double> *mat, const ExecutionContext &ctx);
     using Scalar = double;
     Eigen::Index rows() const;
     Eigen::Index cols() const;
@@ -49,6 +49,6 @@ svd(MatrixLoader<double> *mat,
     int n_cv,
     int maxit,
     double tol,
-    std::atomic<bool> *user_interrupt);
+    const ExecutionContext &ctx);
 
 } // end namespace BPCells
\ No newline at end of file
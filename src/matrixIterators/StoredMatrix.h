@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+
 #include "../arrayIO/array_interfaces.h"
 #include "../arrayIO/bp128.h"
+#include "../arrayIO/checksum.h"
 #include "MatrixIterator.h"
 
 namespace BPCells {
@@ -23,6 +26,83 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
     uint64_t next_col_ptr;
     uint64_t current_capacity = 0;
 
+    // Row filter state (only used after pushdownRowSelect)
+    bool row_filter = false;
+    std::vector<uint32_t> selected_rows;   // Output row i comes from input row selected_rows[i]
+    std::vector<uint32_t> reverse_rows;    // Output row for each input row, or UINT32_MAX
+    std::vector<uint32_t> surviving_pos;   // Offsets of surviving entries within a row chunk
+    std::vector<T> filtered_val;           // Values of surviving entries for the current chunk
+    uint64_t row_consumed = 0;             // Row entries read for the current chunk
+    uint64_t val_window_start = 0, val_window_end = 0; // Range of values loaded in val
+    static constexpr uint64_t val_block_size = 128;
+    // Selections covering more than this fraction of rows aren't pushed down, since nearly
+    // every value block would hold a selected entry and decoding everything is cheaper
+    static constexpr double max_pushdown_fraction = 0.125;
+
+    // Load the values in the block holding surviving entry i of the current chunk, along with
+    // any immediately following blocks that also hold surviving entries, in a single
+    // loadRange() so runs of surviving blocks don't pay a seek per block
+    void loadValWindow(uint64_t chunk_start, uint64_t i, uint64_t loaded) {
+        uint64_t max_window =
+            std::max(val.maxCapacity() - val.maxCapacity() % val_block_size, val_block_size);
+        uint64_t pos = chunk_start + surviving_pos[i];
+        val_window_start = pos - pos % val_block_size;
+        val_window_end = std::min(val_window_start + val_block_size, val.size());
+        for (uint64_t j = i + 1; j < loaded; j++) {
+            uint64_t next = chunk_start + surviving_pos[j];
+            if (next < val_window_end) continue;
+            uint64_t block_start = next - next % val_block_size;
+            if (block_start != val_window_end) break;
+            if (block_start + val_block_size - val_window_start > max_window) break;
+            val_window_end = std::min(block_start + val_block_size, val.size());
+        }
+        val.loadRange(val_window_start, val_window_end - val_window_start);
+    }
+
+    // Load the next chunk of surviving entries when a row filter is active.
+    // Row indices are decoded in full, but values are only decoded for the 128-entry
+    // blocks that contain at least one surviving entry
+    bool loadFiltered() {
+        row.advance(row_consumed);
+        row_consumed = 0;
+
+        while (current_idx < next_col_ptr) {
+            if (row.capacity() == 0) row.ensureCapacity(1);
+            uint64_t cap = std::min(row.capacity(), next_col_ptr - current_idx);
+            uint32_t *row_data = row.data();
+
+            surviving_pos.resize(std::max(surviving_pos.size(), (size_t)cap));
+            uint64_t loaded = 0;
+            for (uint64_t i = 0; i < cap; i++) {
+                uint32_t new_row = reverse_rows[row_data[i]];
+                row_data[loaded] = new_row;
+                surviving_pos[loaded] = i;
+                loaded += new_row != UINT32_MAX;
+            }
+
+            uint64_t chunk_start = current_idx;
+            current_idx += cap;
+            row_consumed = cap;
+            if (loaded == 0) {
+                row.advance(row_consumed);
+                row_consumed = 0;
+                continue;
+            }
+
+            filtered_val.resize(std::max(filtered_val.size(), (size_t)loaded));
+            for (uint64_t i = 0; i < loaded; i++) {
+                uint64_t pos = chunk_start + surviving_pos[i];
+                if (pos < val_window_start || pos >= val_window_end)
+                    loadValWindow(chunk_start, i, loaded);
+                filtered_val[i] = val.data()[pos - val_window_start];
+            }
+            current_capacity = loaded;
+            return true;
+        }
+        current_capacity = 0;
+        return false;
+    }
+
   public:
     StoredMatrix() = default;
     StoredMatrix(StoredMatrix &&other) = default;
@@ -42,7 +122,11 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
         , col_names(std::move(col_names))
         , n_rows(row_count)
         , n_cols(this->col_ptr.size() - 1)
-        , next_col_ptr(this->col_ptr.read_one()) {}
+        , next_col_ptr(this->col_ptr.read_one()) {
+        // col_ptr is only read through read_one(). row and val keep their copying buffers,
+        // since downstream loaders are allowed to modify rowData() and valData() in place
+        this->col_ptr.enableZeroCopy();
+    }
 
     static std::string versionString(bool packed, uint32_t version) {
         std::string ret = packed ? "packed-" : "unpacked-";
@@ -64,6 +148,20 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
         return ret;
     }
 
+    // Read the storage_order of a matrix, returning true if it is stored row-major (and so is
+    // loaded as its transpose)
+    static bool isRowMajor(ReaderBuilder &rb) {
+        auto storage_order_reader = rb.openStringReader("storage_order");
+        auto storage_order = storage_order_reader->get(0);
+
+        if (std::string_view("row") == storage_order) return true;
+        if (std::string_view("col") == storage_order) return false;
+        throw std::runtime_error(
+            std::string("storage_order must be either \"row\" or \"col\", found: \"") +
+            storage_order + "\""
+        );
+    }
+
     // Open an unpacked StoredMatrix from a ReaderBuilder in a column-major orientation
     static StoredMatrix<T> openUnpacked(
         ReaderBuilder &rb,
@@ -96,17 +194,7 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
     // Open an unpacked StoredMatrix from a ReaderBuilder, converting row-major orientation to
     // column-major as needed
     static StoredMatrix<T> openUnpacked(ReaderBuilder &rb) {
-        auto storage_order_reader = rb.openStringReader("storage_order");
-        auto storage_order = storage_order_reader->get(0);
-
-        bool row_major = false;
-        if (std::string_view("row") == storage_order) row_major = true;
-        else if (std::string("col") == storage_order) row_major = false;
-        else
-            throw std::runtime_error(
-                std::string("storage_order must be either \"row\" or \"col\", found: \"") +
-                storage_order + "\""
-            );
+        bool row_major = isRowMajor(rb);
 
         auto row_names = rb.openStringReader("row_names");
         auto col_names = rb.openStringReader("col_names");
@@ -123,24 +211,27 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
         );
     }
 
-    // Open a packed StoredMatrix from a ReaderBuilder in a column-major orientation
+    // Open a packed StoredMatrix from a ReaderBuilder in a column-major orientation.
+    // Arrays written with CRC32C checksums are verified lazily as they are read
     static StoredMatrix<T> openPacked(
-        ReaderBuilder &rb,
+        ReaderBuilder &rb_in,
         uint32_t load_size,
         std::unique_ptr<StringReader> &&row_names,
         std::unique_ptr<StringReader> &&col_names,
         uint32_t row_count
     ) {
+        ChecksumReaderBuilder rb(rb_in);
         ULongReader col_ptr, index_idx_offsets;
+        bool adaptive = rb.readVersion() == versionString(true, 3);
         if (rb.readVersion() == versionString(true, 1)) {
             col_ptr = rb.openUIntReader("idxptr").convert<uint64_t>();
             index_idx_offsets = ConstNumReader<uint64_t>::create({0, UINT64_MAX});
-        } else if (rb.readVersion() == versionString(true, 2)) {
+        } else if (rb.readVersion() == versionString(true, 2) || adaptive) {
             col_ptr = rb.openULongReader("idxptr");
             index_idx_offsets = rb.openULongReader("index_idx_offsets");
         } else {
             throw std::runtime_error(
-                std::string("Version does not match ") + versionString(true, 2) + ": " +
+                std::string("Version does not match ") + versionString(true, 3) + ": " +
                 rb.readVersion()
             );
         }
@@ -154,35 +245,54 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
             ULongReader val_idx_offsets;
             if (rb.readVersion() == versionString(true, 1)) {
                 val_idx_offsets = ConstNumReader<uint64_t>::create({0, UINT64_MAX});
-            } else if (rb.readVersion() == versionString(true, 2)) {
+            } else {
                 val_idx_offsets = rb.openULongReader("val_idx_offsets");
             }
-            val = UIntReader(
-                std::make_unique<BP128_FOR_UIntReader>(
+            std::unique_ptr<UIntBulkReader> val_reader;
+            if (adaptive) {
+                val_reader = std::make_unique<BP128_Adaptive_UIntReader>(
                     rb.openUIntReader("val_data"),
                     rb.openUIntReader("val_idx"),
                     std::move(val_idx_offsets),
+                    rb.openUIntReader("val_tags"),
+                    rb.openUIntReader("val_params"),
                     count
-                ),
-                load_size,
-                load_size
-            );
+                );
+            } else {
+                val_reader = std::make_unique<BP128_FOR_UIntReader>(
+                    rb.openUIntReader("val_data"),
+                    rb.openUIntReader("val_idx"),
+                    std::move(val_idx_offsets),
+                    count
+                );
+            }
+            val = UIntReader(std::move(val_reader), load_size, load_size);
         } else {
             val = rb.open<T>("val");
         }
 
+        std::unique_ptr<UIntBulkReader> index_reader;
+        if (adaptive) {
+            index_reader = std::make_unique<BP128_Adaptive_UIntReader>(
+                rb.openUIntReader("index_data"),
+                rb.openUIntReader("index_idx"),
+                std::move(index_idx_offsets),
+                rb.openUIntReader("index_tags"),
+                rb.openUIntReader("index_params"),
+                count
+            );
+        } else {
+            index_reader = std::make_unique<BP128_D1Z_UIntReader>(
+                rb.openUIntReader("index_data"),
+                rb.openUIntReader("index_idx"),
+                std::move(index_idx_offsets),
+                rb.openUIntReader("index_starts"),
+                count
+            );
+        }
+
         return StoredMatrix(
-            UIntReader(
-                std::make_unique<BP128_D1Z_UIntReader>(
-                    rb.openUIntReader("index_data"),
-                    rb.openUIntReader("index_idx"),
-                    std::move(index_idx_offsets),
-                    rb.openUIntReader("index_starts"),
-                    count
-                ),
-                load_size,
-                load_size
-            ),
+            UIntReader(std::move(index_reader), load_size, load_size),
             std::move(val),
             std::move(col_ptr),
             row_count,
@@ -194,17 +304,7 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
     // Open a packed StoredMatrix from a ReaderBuilder, converting row-major orientation to
     // column-major as needed
     static StoredMatrix<T> openPacked(ReaderBuilder &rb, uint32_t load_size = 1024) {
-        auto storage_order_reader = rb.openStringReader("storage_order");
-        auto storage_order = storage_order_reader->get(0);
-
-        bool row_major = false;
-        if (std::string_view("row") == storage_order) row_major = true;
-        else if (std::string("col") == storage_order) row_major = false;
-        else
-            throw std::runtime_error(
-                std::string("storage_order must be either \"row\" or \"col\", found: \"") +
-                storage_order + "\""
-            );
+        bool row_major = isRowMajor(rb);
 
         auto row_names = rb.openStringReader("row_names");
         auto col_names = rb.openStringReader("col_names");
@@ -221,11 +321,60 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
         );
     }
 
+    // Record I/O statistics for the underlying index, value, and column pointer arrays as
+    // children of `node`
+    void instrument(InstrumentNode &node) {
+        row.instrument(node.addChild("index"));
+        val.instrument(node.addChild("val"));
+        col_ptr.instrument(node.addChild("idxptr"));
+    }
+
+    // Read the full column pointer array (n_cols + 1 entries), then restart the iterator
+    std::vector<uint64_t> colPtr() {
+        std::vector<uint64_t> ptr(n_cols + 1);
+        col_ptr.seek(0);
+        for (auto &p : ptr)
+            p = col_ptr.read_one();
+        restart();
+        return ptr;
+    }
+
+    bool colEntryCounts(std::vector<uint64_t> &counts) override {
+        if (row_filter) return false;
+        std::vector<uint64_t> ptr = colPtr();
+        counts.resize(n_cols);
+        for (uint32_t i = 0; i < n_cols; i++) {
+            counts[i] = ptr[i + 1] - ptr[i];
+        }
+        return true;
+    }
+
+    // Return boundaries [0, c_1, ..., n_cols] that split the columns into at most `chunks`
+    // contiguous ranges with roughly equal numbers of non-zeros. Each range has at least
+    // 2 columns (unless the matrix has fewer). Resets the iterator to the start
+    std::vector<uint32_t> balancedColumnSplits(uint32_t chunks) {
+        std::vector<uint64_t> ptr = colPtr();
+
+        std::vector<uint32_t> splits = {0};
+        uint64_t total = ptr.back() - ptr.front();
+        for (uint32_t i = 1; i < chunks; i++) {
+            uint64_t target = ptr.front() + total * i / chunks;
+            uint32_t col = std::upper_bound(ptr.begin(), ptr.end(), target) - ptr.begin() - 1;
+            if (col >= splits.back() + 2 && col + 2 <= n_cols) splits.push_back(col);
+        }
+        splits.push_back(n_cols);
+        return splits;
+    }
+
     // Return the count of rows and columns
-    uint32_t rows() const override { return n_rows; }
+    uint32_t rows() const override { return row_filter ? selected_rows.size() : n_rows; }
     uint32_t cols() const override { return n_cols; }
 
-    const char *rowNames(uint32_t row) override { return row_names->get(row); }
+    const char *rowNames(uint32_t row) override {
+        if (!row_filter) return row_names->get(row);
+        if (row < selected_rows.size()) return row_names->get(selected_rows[row]);
+        return NULL;
+    }
     const char *colNames(uint32_t col) override { return col_names->get(col); }
 
     // Reset the iterator to start from the beginning
@@ -233,6 +382,7 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
         current_col = UINT32_MAX;
         // Don't change current_idx so we will correctly seek when nextCol iscalled
         current_capacity = 0;
+        row_consumed = 0;
         col_ptr.seek(0);
         next_col_ptr = col_ptr.read_one();
     }
@@ -260,12 +410,13 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
             // We need to perform seeks to get to the right data
             // reading location
             current_idx = next_col_ptr;
-            val.seek(current_idx);
+            if (!row_filter) val.seek(current_idx);
             row.seek(current_idx);
         }
 
         next_col_ptr = col_ptr.read_one();
         current_capacity = 0;
+        row_consumed = 0;
         return true;
     }
 
@@ -274,6 +425,8 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
 
     // Return false if there are no more entries to load
     bool load() override {
+        if (row_filter) return loadFiltered();
+
         val.advance(current_capacity);
         row.advance(current_capacity);
 
@@ -296,7 +449,30 @@ template <class T> class StoredMatrix : public MatrixLoader<T> {
 
     // Pointers to the loaded entries
     uint32_t *rowData() override { return row.data(); }
-    T *valData() override { return val.data(); }
+    T *valData() override { return row_filter ? filtered_val.data() : val.data(); }
+
+    // Restrict output to the rows in row_indices, renumbered by their position in row_indices.
+    // Values are decoded only for blocks containing a selected entry, which can skip most of
+    // the value decoding for small selections. Returns false for selections larger than
+    // max_pushdown_fraction of the rows. Must be called before iteration begins
+    bool pushdownRowSelect(const std::vector<uint32_t> &row_indices) override {
+        if (row_filter) return false;
+        if (row_indices.size() > max_pushdown_fraction * n_rows) return false;
+        std::vector<uint32_t> reverse(n_rows, UINT32_MAX);
+        for (uint32_t i = 0; i < row_indices.size(); i++) {
+            if (row_indices[i] >= n_rows)
+                throw std::runtime_error("Row selection index is greater than number of rows");
+            if (reverse[row_indices[i]] != UINT32_MAX)
+                throw std::runtime_error("Cannot duplicate rows using MatrixRowSelect");
+            reverse[row_indices[i]] = i;
+        }
+        row_filter = true;
+        selected_rows = row_indices;
+        reverse_rows = std::move(reverse);
+        val_window_start = val_window_end = 0;
+        restart();
+        return true;
+    }
 };
 
 } // end namespace BPCells
\ No newline at end of file
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "../arrayIO/vector.h"
+#include "ConcatenateMatrix.h"
+#include "MatrixIndexSelect.h"
+#include "OrderRows.h"
+#include "StoredMatrix.h"
+#include "StoredMatrixWriter.h"
+
+namespace BPCells {
+
+// Open a StoredMatrix as contiguous column ranges with balanced non-zero counts, each read by an
+// independent StoredMatrix, and concatenate them with ConcatCols so multiplies and stats run
+// on up to `threads` threads.
+// This is intended for matrices whose arrays are already in memory, where opening extra
+// readers costs no I/O and every reader points into the same shared buffers.
+// `open` must return a new, independent StoredMatrix for the full matrix on each call.
+// Falls back to a single StoredMatrix if threads <= 1 or there are too few columns to split
+template <typename T>
+std::unique_ptr<MatrixLoader<T>>
+openStoredMatrixParallel(const std::function<StoredMatrix<T>()> &open, uint32_t threads) {
+    auto first = std::make_unique<StoredMatrix<T>>(open());
+    if (threads <= 1) return first;
+
+    std::vector<uint32_t> splits = first->balancedColumnSplits(threads);
+    if (splits.size() <= 2) return first;
+
+    std::vector<std::unique_ptr<MatrixLoader<T>>> ranges;
+    for (size_t i = 0; i + 1 < splits.size(); i++) {
+        std::unique_ptr<MatrixLoader<T>> mat;
+        if (i == 0) mat = std::move(first);
+        else mat = std::make_unique<StoredMatrix<T>>(open());
+
+        std::vector<uint32_t> cols(splits[i + 1] - splits[i]);
+        for (uint32_t j = 0; j < cols.size(); j++)
+            cols[j] = splits[i] + j;
+        ranges.push_back(std::make_unique<MatrixColSelect<T>>(std::move(mat), cols));
+    }
+    return std::make_unique<ConcatCols<T>>(std::move(ranges), threads);
+}
+
+// Pass-through wrapper that holds `mtx` for every call on the inner loader, including its
+// destruction. Used to share non-thread-safe readers (i.e. HDF5) between threads
+template <typename T> class SerializedMatrix : public MatrixLoaderWrapper<T> {
+  private:
+    std::mutex &mtx;
+
+  public:
+    SerializedMatrix(std::unique_ptr<MatrixLoader<T>> &&loader, std::mutex &mtx)
+        : MatrixLoaderWrapper<T>(std::move(loader))
+        , mtx(mtx) {}
+
+    ~SerializedMatrix() {
+        std::lock_guard<std::mutex> lock(mtx);
+        this->loader.reset();
+    }
+
+    const char *rowNames(uint32_t row) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return this->loader->rowNames(row);
+    }
+    const char *colNames(uint32_t col) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return this->loader->colNames(col);
+    }
+    void restart() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        this->loader->restart();
+    }
+    void seekCol(uint32_t col) override {
+        std::lock_guard<std::mutex> lock(mtx);
+        this->loader->seekCol(col);
+    }
+    bool nextCol() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return this->loader->nextCol();
+    }
+    bool load() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        return this->loader->load();
+    }
+};
+
+namespace detail {
+
+// Create a bitpacked writer over the arrays `<prefix>_data`, `<prefix>_idx`, etc., using the
+// same encodings as StoredMatrixWriter::createPacked. `index` picks D1Z (for row indices)
+// rather than FOR (for values) when not adaptive
+inline std::unique_ptr<BP128UIntWriter>
+createPackedStream(WriterBuilder &wb, const std::string &prefix, bool index, bool adaptive) {
+    if (adaptive) {
+        return std::make_unique<BP128_Adaptive_UIntWriter>(
+            wb.createUIntWriter(prefix + "_data"),
+            wb.createUIntWriter(prefix + "_idx"),
+            wb.createULongWriter(prefix + "_idx_offsets"),
+            wb.createUIntWriter(prefix + "_tags"),
+            wb.createUIntWriter(prefix + "_params")
+        );
+    }
+    if (index) {
+        return std::make_unique<BP128_D1Z_UIntWriter>(
+            wb.createUIntWriter(prefix + "_data"),
+            wb.createUIntWriter(prefix + "_idx"),
+            wb.createULongWriter(prefix + "_idx_offsets"),
+            wb.createUIntWriter(prefix + "_starts")
+        );
+    }
+    return std::make_unique<BP128_FOR_UIntWriter>(
+        wb.createUIntWriter(prefix + "_data"),
+        wb.createUIntWriter(prefix + "_idx"),
+        wb.createULongWriter(prefix + "_idx_offsets")
+    );
+}
+
+// Pack `count` values into an in-memory stream made by createPackedStream
+inline void packStream(
+    VecReaderWriterBuilder &vb,
+    const std::string &prefix,
+    bool index,
+    bool adaptive,
+    uint32_t *in,
+    uint64_t count
+) {
+    auto w = createPackedStream(vb, prefix, index, adaptive);
+    for (uint64_t i = 0; i < count;) {
+        i += w->write(in + i, count - i);
+    }
+    w->finalize();
+}
+
+// Append a stream packed by packStream onto `out`
+inline void appendStream(
+    BP128UIntWriter &out, VecReaderWriterBuilder &vb, const std::string &prefix, bool adaptive
+) {
+    auto &vecs = vb.getIntVecs();
+    const std::vector<uint32_t> &chunk_idx = vecs[prefix + "_idx"];
+    std::vector<const uint32_t *> side;
+    if (adaptive) {
+        side = {vecs[prefix + "_tags"].data(), vecs[prefix + "_params"].data()};
+    } else if (vecs.count(prefix + "_starts")) {
+        side = {vecs[prefix + "_starts"].data()};
+    }
+    out.appendPacked(vecs[prefix + "_data"].data(), chunk_idx.data(), chunk_idx.size() - 1, side);
+}
+
+} // namespace detail
+
+// Write a StoredMatrix (e.g. from open10xFeatureMatrix or openAnnDataMatrix) in packed
+// format, reading and packing runs of `run_entries` non-zeros on up to `threads` threads.
+// `open` must return a new, independent StoredMatrix for the full matrix on each call.
+// Each worker reads the columns covering its run (sorted by row, like StoredMatrixWriter)
+// and packs them into memory. Runs start at multiples of 128 entries, so the calling thread
+// appends the packed chunks to `wb` in order without re-packing, and the output is
+// identical to StoredMatrixWriter<T>::createPacked(wb, row_major, 1024, adaptive).
+// HDF5 is not thread-safe, so if serialize_reads is true every call on the input matrices
+// holds a shared lock, and only the packing and output writes run in parallel
+template <typename T>
+void writePackedMatrixParallel(
+    const std::function<StoredMatrix<T>()> &open,
+    WriterBuilder &wb,
+    bool row_major,
+    uint32_t threads,
+    bool adaptive = false,
+    const ExecutionContext &ctx = {},
+    bool serialize_reads = true,
+    uint64_t run_entries = 1 << 20
+) {
+    std::mutex read_mtx;
+    auto open_input = [&]() -> std::unique_ptr<MatrixLoader<T>> {
+        std::unique_lock<std::mutex> lock(read_mtx, std::defer_lock);
+        if (serialize_reads) lock.lock();
+        auto mat = std::make_unique<StoredMatrix<T>>(open());
+        if (!serialize_reads) return mat;
+        return std::make_unique<SerializedMatrix<T>>(std::move(mat), read_mtx);
+    };
+
+    std::vector<uint64_t> ptr;
+    {
+        std::unique_lock<std::mutex> lock(read_mtx, std::defer_lock);
+        if (serialize_reads) lock.lock();
+        ptr = open().colPtr();
+    }
+    run_entries = std::max<uint64_t>(128, run_entries - run_entries % 128);
+    uint64_t n_runs = (ptr.back() - ptr.front() + run_entries - 1) / run_entries;
+
+    ResourceLease lease = ctx.acquireThreads(std::min<uint64_t>(threads, n_runs));
+    if (lease.count() <= 1) {
+        auto mat = open_input();
+        StoredMatrixWriter<T>::createPacked(wb, row_major, 1024, adaptive).write(*mat, ctx);
+        return;
+    }
+
+    wb.writeVersion(StoredMatrix<T>::versionString(true, adaptive ? 3 : 2));
+    constexpr bool packed_val = std::is_same_v<T, uint32_t>;
+    auto index_out = detail::createPackedStream(wb, "index", true, adaptive);
+    std::unique_ptr<BP128UIntWriter> packed_val_out;
+    NumWriter<T> val_out;
+    if constexpr (packed_val) {
+        packed_val_out = detail::createPackedStream(wb, "val", false, adaptive);
+    } else {
+        val_out = wb.create<T>("val");
+    }
+
+    // Ring of runs: those in [written, written + slots.size()) may be in progress
+    struct Slot {
+        VecReaderWriterBuilder packed;
+        std::vector<T> val;
+        bool done = false;
+    };
+    std::vector<Slot> slots(2 * lease.count());
+    uint64_t written = 0;
+    bool stop = false;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic<uint64_t> next_run(0);
+
+    auto work = [&]() {
+        std::vector<uint32_t> rows;
+        std::vector<T> vals;
+        std::unique_ptr<MatrixLoader<T>> mat;
+        try {
+            mat = std::make_unique<OrderRows<T>>(open_input());
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!error) error = std::current_exception();
+            stop = true;
+            cv.notify_all();
+            return;
+        }
+        while (true) {
+            uint64_t run = next_run.fetch_add(1);
+            if (run >= n_runs) return;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return stop || run < written + slots.size(); });
+                if (stop) return;
+            }
+            Slot &slot = slots[run % slots.size()];
+            try {
+                uint64_t begin = ptr.front() + run * run_entries;
+                uint64_t end = std::min(begin + run_entries, ptr.back());
+                rows.clear();
+                vals.clear();
+                uint32_t col = std::upper_bound(ptr.begin(), ptr.end(), begin) - ptr.begin() - 1;
+                uint64_t pos = ptr[col];
+                mat->seekCol(col);
+                while (pos < end) {
+                    while (mat->load()) {
+                        uint64_t cap = mat->capacity();
+                        uint64_t lo = std::max(pos, begin), hi = std::min(pos + cap, end);
+                        if (lo < hi) {
+                            rows.insert(
+                                rows.end(), mat->rowData() + lo - pos, mat->rowData() + hi - pos
+                            );
+                            vals.insert(
+                                vals.end(), mat->valData() + lo - pos, mat->valData() + hi - pos
+                            );
+                        }
+                        pos += cap;
+                    }
+                    if (pos < end && !mat->nextCol()) break;
+                }
+                if (rows.size() != end - begin) {
+                    throw std::runtime_error(
+                        "writePackedMatrixParallel: column pointers do not match the entries read"
+                    );
+                }
+
+                slot.packed = VecReaderWriterBuilder();
+                detail::packStream(slot.packed, "index", true, adaptive, rows.data(), rows.size());
+                if constexpr (packed_val) {
+                    detail::packStream(
+                        slot.packed, "val", false, adaptive, vals.data(), vals.size()
+                    );
+                } else {
+                    std::swap(slot.val, vals);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!error) error = std::current_exception();
+                stop = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                slot.done = true;
+            }
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < lease.count(); i++) {
+        workers.push_back(std::thread(work));
+    }
+    auto stop_workers = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+    };
+
+    try {
+        uint64_t max_val_capacity = val_out.maxCapacity();
+        for (; written < n_runs;) {
+            Slot &slot = slots[written % slots.size()];
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return slot.done || stop; });
+                if (error) std::rethrow_exception(error);
+            }
+            if (ctx.interrupted()) break;
+            detail::appendStream(*index_out, slot.packed, "index", adaptive);
+            if constexpr (packed_val) {
+                detail::appendStream(*packed_val_out, slot.packed, "val", adaptive);
+            } else {
+                for (uint64_t i = 0; i < slot.val.size();) {
+                    uint64_t amount = std::min<uint64_t>(max_val_capacity, slot.val.size() - i);
+                    val_out.ensureCapacity(amount);
+                    std::memmove(val_out.data(), slot.val.data() + i, amount * sizeof(T));
+                    val_out.advance(amount);
+                    i += amount;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                slot.done = false;
+                written++;
+            }
+            cv.notify_all();
+        }
+    } catch (...) {
+        stop_workers();
+        throw;
+    }
+    stop_workers();
+    if (error) std::rethrow_exception(error);
+    if (written < n_runs) return; // Interrupted
+
+    index_out->finalize();
+    if constexpr (packed_val) packed_val_out->finalize();
+    else val_out.finalize();
+
+    // Remaining arrays match StoredMatrixWriter::write
+    std::unique_ptr<MatrixLoader<T>> mat = open_input();
+    ULongWriter col_ptr = wb.createULongWriter("idxptr");
+    for (uint64_t p : ptr) {
+        col_ptr.write_one(p - ptr.front());
+    }
+    col_ptr.finalize();
+
+    UIntWriter shape = wb.createUIntWriter("shape");
+    shape.write_one(row_major ? mat->cols() : mat->rows());
+    shape.write_one(row_major ? mat->rows() : mat->cols());
+    shape.finalize();
+
+    std::vector<std::string> row_names, col_names;
+    for (uint32_t i = 0;; i++) {
+        const char *name = mat->colNames(i);
+        if (name == NULL) break;
+        col_names.push_back(name);
+    }
+    for (uint32_t i = 0;; i++) {
+        const char *name = mat->rowNames(i);
+        if (name == NULL) break;
+        row_names.push_back(name);
+    }
+    if (row_major) std::swap(row_names, col_names);
+    wb.createStringWriter("col_names")->write(VecStringReader(col_names));
+    wb.createStringWriter("row_names")->write(VecStringReader(row_names));
+    wb.createStringWriter("storage_order")->write(VecStringReader({row_major ? "row" : "col"}));
+}
+
+} // end namespace BPCells
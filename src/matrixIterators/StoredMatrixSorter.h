@@ -27,7 +27,7 @@ template <typename T> class StoredMatrixSorter {
         std::vector<uint32_t> &row,
         std::vector<uint32_t> &col,
         std::vector<T> &val,
-        std::atomic<bool> *user_interrupt
+        const ExecutionContext &ctx
     ) = 0;
     // Return if the data compes pre-sorted by row
     virtual bool row_sorted() const = 0;
@@ -123,12 +123,20 @@ template <typename T> class StoredMatrixSorter {
         std::vector<std::string> &&col_names,
         uint32_t rows,
         uint32_t cols,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     ) {
         if (round != 0)
             throw std::runtime_error(
                 "StoredMatrixSorter: can't write more than once to same temporary location"
             );
+        InstrumentTimer timer(ctx.instrumentation.get());
+        // Take the sort buffers from the context's memory budget. If the budget is short, sort in
+        // smaller chunks, but keep enough space to merge at least two loaded chunks at a time
+        ResourceLease memory_lease = ctx.acquireMemory(
+            sort_buffer_elements * bytesPerElement(), 2 * load_elements * bytesPerElement()
+        );
+        const uint64_t buffer_elements = memory_lease.count() / bytesPerElement();
+
         std::vector<uint64_t> output_chunk_sizes;
         std::vector<uint64_t> input_chunk_sizes;
 
@@ -137,14 +145,14 @@ template <typename T> class StoredMatrixSorter {
             openWriters(round);
 
             // Scope to allocate + free these sorting buffers
-            std::vector<uint32_t> row_data(sort_buffer_elements / 2),
-                row_buf(sort_buffer_elements / 2), col_data(sort_buffer_elements / 2),
-                col_buf(sort_buffer_elements / 2);
-            std::vector<T> val_data(sort_buffer_elements / 2), val_buf(sort_buffer_elements / 2);
+            std::vector<uint32_t> row_data(buffer_elements / 2),
+                row_buf(buffer_elements / 2), col_data(buffer_elements / 2),
+                col_buf(buffer_elements / 2);
+            std::vector<T> val_data(buffer_elements / 2), val_buf(buffer_elements / 2);
 
             // Load input data and write out in sorted chunks
             while (true) {
-                size_t loaded = load_entries(row_data, col_data, val_data, user_interrupt);
+                size_t loaded = load_entries(row_data, col_data, val_data, ctx);
                 if (loaded == 0) break;
                 if (!row_sorted()) {
                     lsdRadixSortArrays<uint32_t, uint32_t, T>(
@@ -169,8 +177,9 @@ template <typename T> class StoredMatrixSorter {
         } // row_data, row_buf etc. get freed here
         for (auto &x : input_chunk_sizes)
             total_elements += x;
+        if (ctx.instrumentation) ctx.instrumentation->entries += total_elements;
 
-        // 2. Merge up to (sort_buffer_elements / load_elements) chunks at once into a single sorted
+        // 2. Merge up to (buffer_elements / load_elements) chunks at once into a single sorted
         // chunk
         //    until we have just one sorted chunk encompassing all the data entries
         std::vector<SliceReader<uint32_t>> row_chunks, col_chunks;
@@ -219,7 +228,7 @@ template <typename T> class StoredMatrixSorter {
             round += 1;
             if (round >= 2) deleteWriters(round - 2);
             openReaders(round - 1);
-            if (input_chunk_sizes.size() <= sort_buffer_elements / load_elements) {
+            if (input_chunk_sizes.size() <= buffer_elements / load_elements) {
                 openWriters(round, true); // Open last-round writers with no numeric prefix
             } else {
                 openWriters(round);
@@ -231,7 +240,7 @@ template <typename T> class StoredMatrixSorter {
 
             // Merge up to `row_chunks` sorted chunks at a time, starting at index `chunk`
             for (uint64_t chunk = 0; chunk < input_chunk_sizes.size();
-                 chunk += sort_buffer_elements / load_elements) {
+                 chunk += buffer_elements / load_elements) {
                 output_chunk_sizes.push_back(0);
                 // Set up heap
                 heap.clear();
@@ -239,7 +248,7 @@ template <typename T> class StoredMatrixSorter {
                 col_chunks.clear();
                 val_chunks.clear();
                 for (uint64_t i = 0; chunk + i < input_chunk_sizes.size() &&
-                                     i < sort_buffer_elements / load_elements;
+                                     i < buffer_elements / load_elements;
                      i++) {
                     row_chunks.push_back(SliceReader<uint32_t>(
                         row_reader, reader_offset, input_chunk_sizes[chunk + i], load_elements
@@ -274,8 +283,7 @@ template <typename T> class StoredMatrixSorter {
                     };
                 auto second_to_top = get_second_to_top(heap);
                 while (heap.size() > 0) {
-                    if (output_chunk_sizes.back() % (1 << 14) == 0 && user_interrupt != NULL &&
-                        *user_interrupt)
+                    if (output_chunk_sizes.back() % (1 << 14) == 0 && ctx.interrupted())
                         return;
                     // Output element
                     uint32_t idx = std::get<2>(heap.front());
@@ -23,11 +23,11 @@ template <typename T> class StoredMatrixTransposeWriter : public StoredMatrixSor
     MatrixLoader<T> *mat = NULL;
 
     size_t load_entries(
-        std::vector<uint32_t> &row, std::vector<uint32_t> &col, std::vector<T> &val, std::atomic<bool> *user_interrupt
+        std::vector<uint32_t> &row, std::vector<uint32_t> &col, std::vector<T> &val, const ExecutionContext &ctx
     ) override {
         uint64_t loaded = 0;
         while (loaded < row.size()) {
-            if (user_interrupt != NULL && *user_interrupt) return loaded;
+            if (ctx.interrupted()) return loaded;
             // Load data (or re-use leftover data)
             if (previously_loaded == 0 && !mat->load()) {
                 if (!mat->nextCol()) break;
@@ -61,7 +61,7 @@ template <typename T> class StoredMatrixTransposeWriter : public StoredMatrixSor
   public:
     using StoredMatrixSorter<T>::StoredMatrixSorter;
 
-    void write(MatrixLoader<T> &mat, std::atomic<bool> *user_interrupt = NULL) override {
+    void write(MatrixLoader<T> &mat, const ExecutionContext &ctx = {}) override {
         this->mat = &mat;
         mat.restart();
         // Store row and col names. This probably incurs a few extra copies,
@@ -81,7 +81,7 @@ template <typename T> class StoredMatrixTransposeWriter : public StoredMatrixSor
         }
 
         mat.nextCol();
-        this->writeValues(std::move(row_names), std::move(col_names), mat.cols(), mat.rows(), user_interrupt);
+        this->writeValues(std::move(row_names), std::move(col_names), mat.cols(), mat.rows(), ctx);
     }
 };
 
@@ -55,34 +55,61 @@ template <typename T> class StoredMatrixWriter : public MatrixWriter<T> {
         );
     }
 
-    static StoredMatrixWriter
-    createPacked(WriterBuilder &wb, bool row_major = false, uint32_t buffer_size = 1024) {
-        wb.writeVersion(StoredMatrix<T>::versionString(true, 2));
+    // Create a packed matrix writer. If adaptive is true, the index and (for uint32_t) value
+    // arrays choose the smallest encoding for each 128-value block, written as format version 3.
+    // Otherwise, write version 2 with fixed D1Z/FOR encodings for compatibility with older readers.
+    static StoredMatrixWriter createPacked(
+        WriterBuilder &wb, bool row_major = false, uint32_t buffer_size = 1024, bool adaptive = false
+    ) {
+        wb.writeVersion(StoredMatrix<T>::versionString(true, adaptive ? 3 : 2));
         NumWriter<T> val;
 
         if constexpr (std::is_same_v<T, uint32_t>) {
-            val = UIntWriter(
-                std::make_unique<BP128_FOR_UIntWriter>(
-                    wb.createUIntWriter("val_data"),
-                    wb.createUIntWriter("val_idx"),
-                    wb.createULongWriter("val_idx_offsets")
-                ),
-                buffer_size
-            );
+            if (adaptive) {
+                val = UIntWriter(
+                    std::make_unique<BP128_Adaptive_UIntWriter>(
+                        wb.createUIntWriter("val_data"),
+                        wb.createUIntWriter("val_idx"),
+                        wb.createULongWriter("val_idx_offsets"),
+                        wb.createUIntWriter("val_tags"),
+                        wb.createUIntWriter("val_params")
+                    ),
+                    buffer_size
+                );
+            } else {
+                val = UIntWriter(
+                    std::make_unique<BP128_FOR_UIntWriter>(
+                        wb.createUIntWriter("val_data"),
+                        wb.createUIntWriter("val_idx"),
+                        wb.createULongWriter("val_idx_offsets")
+                    ),
+                    buffer_size
+                );
+            }
         } else {
             val = wb.create<T>("val");
         }
 
+        std::unique_ptr<UIntBulkWriter> index;
+        if (adaptive) {
+            index = std::make_unique<BP128_Adaptive_UIntWriter>(
+                wb.createUIntWriter("index_data"),
+                wb.createUIntWriter("index_idx"),
+                wb.createULongWriter("index_idx_offsets"),
+                wb.createUIntWriter("index_tags"),
+                wb.createUIntWriter("index_params")
+            );
+        } else {
+            index = std::make_unique<BP128_D1Z_UIntWriter>(
+                wb.createUIntWriter("index_data"),
+                wb.createUIntWriter("index_idx"),
+                wb.createULongWriter("index_idx_offsets"),
+                wb.createUIntWriter("index_starts")
+            );
+        }
+
         return StoredMatrixWriter(
-            UIntWriter(
-                std::make_unique<BP128_D1Z_UIntWriter>(
-                    wb.createUIntWriter("index_data"),
-                    wb.createUIntWriter("index_idx"),
-                    wb.createULongWriter("index_idx_offsets"),
-                    wb.createUIntWriter("index_starts")
-                ),
-                buffer_size
-            ),
+            UIntWriter(std::move(index), buffer_size),
             std::move(val),
             wb.createULongWriter("idxptr"),
             wb.createUIntWriter("shape"),
@@ -93,7 +120,7 @@ template <typename T> class StoredMatrixWriter : public MatrixWriter<T> {
         );
     }
 
-    void write(MatrixLoader<T> &mat_in, std::atomic<bool> *user_interrupt = NULL) override {
+    void write(MatrixLoader<T> &mat_in, const ExecutionContext &ctx = {}) override {
         // Ensure that we write matrices sorted by row
         OrderRows<T> mat((std::unique_ptr<MatrixLoader<T>>(&mat_in)));
         // Don't delete our original matrix
@@ -106,7 +133,7 @@ template <typename T> class StoredMatrixWriter : public MatrixWriter<T> {
         col_ptr.write_one(idx);
 
         while (mat.nextCol()) {
-            if (user_interrupt != NULL && *user_interrupt) return;
+            if (ctx.interrupted()) return;
             if (mat.currentCol() < col)
                 throw std::runtime_error("StoredMatrixWriter encountered out-of-order columns");
             while (col < mat.currentCol()) {
@@ -130,7 +157,7 @@ template <typename T> class StoredMatrixWriter : public MatrixWriter<T> {
                     i += capacity;
                 }
 
-                if (user_interrupt != NULL && *user_interrupt) return;
+                if (ctx.interrupted()) return;
             }
         }
         if (row_major) {
@@ -7,7 +7,7 @@ namespace BPCells {
 
 template <typename T> class TSparseMatrixWriter : public MatrixWriter<T> {
   public:
-    bool write(MatrixLoader<T> &mat, std::atomic<bool> *user_interrupt = NULL) override {
+    bool write(MatrixLoader<T> &mat, const ExecutionContext &ctx = {}) override {
         MatrixIterator<T> it(mat);
         uint32_t count = 0;
         while (it.nextCol()) {
@@ -15,7 +15,7 @@ template <typename T> class TSparseMatrixWriter : public MatrixWriter<T> {
                 rows.push_back(it.row());
                 cols.push_back(it.col());
                 vals.push_back(it.val());
-                if (count++ % 8192 == 0 && user_interrupt != NULL && *user_interrupt) return false;
+                if (count++ % 8192 == 0 && ctx.interrupted()) return false;
             }
         }
         return true;
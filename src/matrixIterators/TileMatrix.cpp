@@ -7,10 +7,12 @@ TileMatrix::TileMatrix(
     const std::vector<uint32_t> &start,
     const std::vector<uint32_t> &end,
     const std::vector<uint32_t> &width,
-    std::unique_ptr<StringReader> &&chr_levels
+    std::unique_ptr<StringReader> &&chr_levels,
+    AccumulatorStrategy strategy
 )
     : frags(std::move(frags))
-    , chr_levels(std::move(chr_levels)) {
+    , chr_levels(std::move(chr_levels))
+    , accumulator(std::max(this->frags->cellCount(), 0), strategy) {
     if (this->frags->cellCount() < 0)
         throw std::invalid_argument(
             "frags must have a known cell count. Consider using a cell selection to define the "
@@ -59,6 +61,19 @@ TileMatrix::TileMatrix(
         prev = t;
     }
 
+    // Estimate how many tiles are in the accumulator at once on each chromosome
+    chr_active_cols.resize(this->chr_levels->size());
+    for (size_t i = 0; i < chr.size();) {
+        std::vector<uint32_t> starts, ends, widths;
+        uint32_t c = chr[i];
+        for (; i < chr.size() && chr[i] == c; i++) {
+            starts.push_back(start[i]);
+            ends.push_back(std::max(end[i], start[i] + 1));
+            widths.push_back(width[i]);
+        }
+        chr_active_cols[c] = estimateActiveCols(starts, ends, widths, 1 << 16);
+    }
+
     // Sentinel value at end of sorted_tiles
     sorted_tiles.push_back(
         {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, libdivide::libdivide_u32_gen(1)}
@@ -84,6 +99,11 @@ TileMatrix::TileMatrix(
         next_active_tile++;
     }
     next_completed_tile = sorted_tiles[next_active_tile].output_idx;
+    startChr(this->frags->currentChr());
+}
+
+void TileMatrix::startChr(uint32_t chr) {
+    if (chr < chr_active_cols.size()) accumulator.start_chr(chr_active_cols[chr]);
 }
 
 uint32_t TileMatrix::rows() const { return frags->cellCount(); }
@@ -189,6 +209,7 @@ void TileMatrix::loadFragments() {
         }
 
         frags->seek(sorted_tiles[next_active_tile].chr, seek_bp);
+        startChr(sorted_tiles[next_active_tile].chr);
     }
 
     while (true) {
@@ -223,6 +244,7 @@ void TileMatrix::loadFragments() {
             }
             next_completed_tile = sorted_tiles[next_active_tile].output_idx;
             active_tiles.clear();
+            startChr(frags->currentChr());
         }
         uint32_t capacity = frags->capacity();
         uint32_t *start_data = frags->startData();
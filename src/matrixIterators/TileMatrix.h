@@ -25,7 +25,8 @@ class TileMatrix : public MatrixLoader<uint32_t> {
 
     std::unique_ptr<FragmentLoader> frags;
     std::unique_ptr<StringReader> chr_levels;
-    MatrixAccumulator<uint32_t> accumulator;
+    MatrixAccumulator_adaptive<uint32_t> accumulator;
+    std::vector<uint32_t> chr_active_cols; // Estimated active columns per chromosome
     std::vector<Tile> sorted_tiles;
     std::vector<Tile> active_tiles;
     uint32_t next_completed_tile = 0; // All columns below this number are ready for output
@@ -38,17 +39,21 @@ class TileMatrix : public MatrixLoader<uint32_t> {
     std::string tile_name; // buffer to use to store the tile name
 
     void loadFragments();
+    void startChr(uint32_t chr);
 
   public:
     // Note: It's the caller's responsibility to make sure that
     // the FragmentLoader will not be deleted while this TileMatrix is still alive
+    // strategy - accumulator used to sum overlaps (see MatrixAccumulators.h). Auto picks
+    //    per chromosome based on tile density and cell count
     TileMatrix(
         std::unique_ptr<FragmentLoader> &&frags,
         const std::vector<uint32_t> &chr,
         const std::vector<uint32_t> &start,
         const std::vector<uint32_t> &end,
         const std::vector<uint32_t> &width,
-        std::unique_ptr<StringReader> &&chr_levels
+        std::unique_ptr<StringReader> &&chr_levels,
+        AccumulatorStrategy strategy = AccumulatorStrategy::Auto
     );
 
     uint32_t rows() const override;
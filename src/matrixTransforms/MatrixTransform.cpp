@@ -101,7 +101,7 @@ uint32_t *MatrixTransformDense::rowData() { return row_data.data(); }
 double *MatrixTransformDense::valData() { return val_data.data(); }
 
 Eigen::MatrixXd MatrixTransformDense::denseMultiplyRight(
-    const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     // Perform the denseMultiplyRight operation like in MatrixOps.h, but using
     // loadZeroSubtracted in place of load
@@ -112,7 +112,7 @@ Eigen::MatrixXd MatrixTransformDense::denseMultiplyRight(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         // Don't need ordered loads here
         while (loadZeroSubtracted(unordered_loader)) {
             const double *val_data = unordered_loader.valData();
@@ -126,12 +126,12 @@ Eigen::MatrixXd MatrixTransformDense::denseMultiplyRight(
 
     // Make adjustments for the zero entries
     res.transposeInPlace();
-    denseMultiplyRightZero(res, B, user_interrupt);
+    denseMultiplyRightZero(res, B, ctx);
     return res;
 }
 
 Eigen::MatrixXd MatrixTransformDense::denseMultiplyLeft(
-    const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     // Perform the denseMultiplyRight operation like in MatrixOps.h, but using
     // loadZeroSubtracted in place of load
@@ -142,7 +142,7 @@ Eigen::MatrixXd MatrixTransformDense::denseMultiplyLeft(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         // Don't need ordered loads here
         while (loadZeroSubtracted(unordered_loader)) {
             const double *val_data = unordered_loader.valData();
@@ -155,13 +155,13 @@ Eigen::MatrixXd MatrixTransformDense::denseMultiplyLeft(
     }
 
     // Make adjustments for the zero entries
-    denseMultiplyLeftZero(res, B, user_interrupt);
+    denseMultiplyLeftZero(res, B, ctx);
     return res;
 }
 
 // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
 Eigen::VectorXd MatrixTransformDense::vecMultiplyRight(
-    const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     // Perform the vecMultiplyRight operation like in MatrixOps.h, but using
     // loadZeroSubtracted in place of load
@@ -172,7 +172,7 @@ Eigen::VectorXd MatrixTransformDense::vecMultiplyRight(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         // Don't need ordered loads here
         while (loadZeroSubtracted(unordered_loader)) {
             const double *val_data = unordered_loader.valData();
@@ -185,12 +185,12 @@ Eigen::VectorXd MatrixTransformDense::vecMultiplyRight(
     }
 
     // Make adjustments for the zero entries
-    vecMultiplyRightZero(res, v, user_interrupt);
+    vecMultiplyRightZero(res, v, ctx);
     return res;
 }
 
 Eigen::VectorXd MatrixTransformDense::vecMultiplyLeft(
-    const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     // Perform the vecMultiplyLeft operation like in MatrixOps.h, but using
     // loadZeroSubtracted in place of load
@@ -201,7 +201,7 @@ Eigen::VectorXd MatrixTransformDense::vecMultiplyLeft(
     restart();
     while (nextCol()) {
         const uint32_t col = currentCol();
-        if (user_interrupt != NULL && *user_interrupt) return res;
+        if (ctx.interrupted()) return res;
         // Don't need ordered loads here
         while (loadZeroSubtracted(unordered_loader)) {
             const double *val_data = unordered_loader.valData();
@@ -213,12 +213,12 @@ Eigen::VectorXd MatrixTransformDense::vecMultiplyLeft(
         }
     }
 
-    vecMultiplyLeftZero(res, v, user_interrupt);
+    vecMultiplyLeftZero(res, v, ctx);
     return res;
 }
 
 void MatrixTransformDense::denseMultiplyRightZero(
-    Eigen::MatrixXd &out, const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    Eigen::MatrixXd &out, const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     // Key invariants for this block processing: for L*R = O: colL=rowR, rowO=rowL, colO=colR
     Eigen::Matrix<double, buf_size, 1> values;
@@ -227,7 +227,7 @@ void MatrixTransformDense::denseMultiplyRightZero(
     restart();
 
     for (uint32_t col = 0; col < ncols; col++) {
-        if (user_interrupt != NULL && *user_interrupt) return;
+        if (ctx.interrupted()) return;
         uint32_t row;
         for (row = 0; row + buf_size <= nrows; row += buf_size) {
             loadZero(values.data(), buf_size, row, col);
@@ -241,7 +241,7 @@ void MatrixTransformDense::denseMultiplyRightZero(
 }
 
 void MatrixTransformDense::denseMultiplyLeftZero(
-    Eigen::MatrixXd &out, const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt
+    Eigen::MatrixXd &out, const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx
 ) {
     // Key invariants for this block processing: for L*R = O: colL=rowR, rowO=rowL, colO=colR
     Eigen::Matrix<double, buf_size, 1> values;
@@ -250,7 +250,7 @@ void MatrixTransformDense::denseMultiplyLeftZero(
     restart();
 
     for (uint32_t col = 0; col < ncols; col++) {
-        if (user_interrupt != NULL && *user_interrupt) return;
+        if (ctx.interrupted()) return;
         uint32_t row;
         for (row = 0; row + buf_size <= nrows; row += buf_size) {
             loadZero(values.data(), buf_size, row, col);
@@ -264,7 +264,7 @@ void MatrixTransformDense::denseMultiplyLeftZero(
 }
 
 void MatrixTransformDense::vecMultiplyRightZero(
-    Eigen::VectorXd &out, const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    Eigen::VectorXd &out, const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     // Key invariants for this block processing: for L*R = O: colL=rowR, rowO=rowL, colO=colR
     Eigen::Matrix<double, buf_size, 1> values;
@@ -273,7 +273,7 @@ void MatrixTransformDense::vecMultiplyRightZero(
     restart();
 
     for (uint32_t col = 0; col < ncols; col++) {
-        if (user_interrupt != NULL && *user_interrupt) return;
+        if (ctx.interrupted()) return;
         uint32_t row;
         for (row = 0; row + buf_size <= nrows; row += buf_size) {
             loadZero(values.data(), buf_size, row, col);
@@ -287,7 +287,7 @@ void MatrixTransformDense::vecMultiplyRightZero(
 }
 
 void MatrixTransformDense::vecMultiplyLeftZero(
-    Eigen::VectorXd &out, const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt
+    Eigen::VectorXd &out, const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx
 ) {
     Eigen::Matrix<double, buf_size, 1> values;
     uint32_t nrows = rows();
@@ -295,7 +295,7 @@ void MatrixTransformDense::vecMultiplyLeftZero(
     restart();
 
     for (uint32_t col = 0; col < ncols; col++) {
-        if (user_interrupt != NULL && *user_interrupt) return;
+        if (ctx.interrupted()) return;
         uint32_t row;
         for (row = 0; row + buf_size <= nrows; row += buf_size) {
             loadZero(values.data(), buf_size, row, col);
@@ -308,25 +308,25 @@ void MatrixTransformDense::vecMultiplyLeftZero(
     }
 }
 
-std::vector<double> MatrixTransformDense::colSums(std::atomic<bool> *user_interrupt) {
+std::vector<double> MatrixTransformDense::colSums(const ExecutionContext &ctx) {
     std::vector<double> out(cols());
 
     Eigen::VectorXd v(rows());
     v.setOnes();
     Eigen::VectorXd res =
-        vecMultiplyLeft(Eigen::Map<Eigen::VectorXd>(v.data(), v.rows(), v.cols()), user_interrupt);
+        vecMultiplyLeft(Eigen::Map<Eigen::VectorXd>(v.data(), v.rows(), v.cols()), ctx);
     for (uint32_t i = 0; i < out.size(); i++) {
         out[i] = res(i);
     }
     return out;
 }
-std::vector<double> MatrixTransformDense::rowSums(std::atomic<bool> *user_interrupt) {
+std::vector<double> MatrixTransformDense::rowSums(const ExecutionContext &ctx) {
     std::vector<double> out(rows());
 
     Eigen::VectorXd v(cols());
     v.setOnes();
     Eigen::VectorXd res =
-        vecMultiplyRight(Eigen::Map<Eigen::VectorXd>(v.data(), v.rows(), v.cols()), user_interrupt);
+        vecMultiplyRight(Eigen::Map<Eigen::VectorXd>(v.data(), v.rows(), v.cols()), ctx);
     for (uint32_t i = 0; i < out.size(); i++) {
         out[i] = res(i);
     }
@@ -86,22 +86,22 @@ class MatrixTransformDense : public MatrixTransform {
     double *valData() override;
 
     Eigen::MatrixXd denseMultiplyRight(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     Eigen::MatrixXd denseMultiplyLeft(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
     Eigen::VectorXd vecMultiplyRight(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
     Eigen::VectorXd vecMultiplyLeft(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
 
     // Calculate row/column sums of the matrix
-    std::vector<double> colSums(std::atomic<bool> *user_interrupt = NULL) override;
-    std::vector<double> rowSums(std::atomic<bool> *user_interrupt = NULL) override;
+    std::vector<double> colSums(const ExecutionContext &ctx = {}) override;
+    std::vector<double> rowSums(const ExecutionContext &ctx = {}) override;
 
   protected:
     // Perform a normal load from the underlying matrix, then subtract transform(0)
@@ -119,23 +119,23 @@ class MatrixTransformDense : public MatrixTransform {
     virtual void denseMultiplyRightZero(
         Eigen::MatrixXd &out,
         const Eigen::Map<Eigen::MatrixXd> B,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     );
     virtual void denseMultiplyLeftZero(
         Eigen::MatrixXd &out,
         const Eigen::Map<Eigen::MatrixXd> B,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     );
 
     virtual void vecMultiplyRightZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     );
     virtual void vecMultiplyLeftZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     );
 };
 
@@ -43,13 +43,13 @@ class SCTransformPearsonSIMD : public MatrixTransformDense {
     void vecMultiplyRightZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     ) override;
 
     void vecMultiplyLeftZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     ) override;
 };
 
@@ -72,13 +72,13 @@ class SCTransformPearsonTransposeSIMD : public MatrixTransformDense {
     void vecMultiplyRightZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     ) override;
 
     void vecMultiplyLeftZero(
         Eigen::VectorXd &out,
         const Eigen::Map<Eigen::VectorXd> v,
-        std::atomic<bool> *user_interrupt = NULL
+        const ExecutionContext &ctx = {}
     ) override;
 };
 
@@ -30,17 +30,17 @@ bool Scale::load() {
 }
 
 Eigen::MatrixXd
-Scale::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
+Scale::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
     Eigen::MatrixXd res;
 
     // Scale input by col scale
     if (fit.col_params.size() > 0) {
         Eigen::MatrixXd B2(B.array().colwise() * fit.col_params.row(0).transpose());
         res = loader->denseMultiplyRight(
-            Eigen::Map<Eigen::MatrixXd>(B2.data(), B2.rows(), B2.cols()), user_interrupt
+            Eigen::Map<Eigen::MatrixXd>(B2.data(), B2.rows(), B2.cols()), ctx
         );
     } else {
-        res = loader->denseMultiplyRight(B, user_interrupt);
+        res = loader->denseMultiplyRight(B, ctx);
     }
 
     // Scale output by row scale
@@ -51,17 +51,17 @@ Scale::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool>
 }
 
 Eigen::MatrixXd
-Scale::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
+Scale::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
     Eigen::MatrixXd res;
 
     // Scale input by row scale
     if (fit.row_params.size() > 0) {
         Eigen::MatrixXd B2(B.array().rowwise() * fit.row_params.row(0));
         res = loader->denseMultiplyLeft(
-            Eigen::Map<Eigen::MatrixXd>(B2.data(), B2.rows(), B2.cols()), user_interrupt
+            Eigen::Map<Eigen::MatrixXd>(B2.data(), B2.rows(), B2.cols()), ctx
         );
     } else {
-        res = loader->denseMultiplyLeft(B, user_interrupt);
+        res = loader->denseMultiplyLeft(B, ctx);
     }
 
     // Scale output by col scale
@@ -72,17 +72,17 @@ Scale::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool>
 }
 // Calculate matrix-vector product A*v where A (this) is sparse and B is a dense matrix.
 Eigen::VectorXd
-Scale::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
+Scale::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
     Eigen::VectorXd res;
 
     // Scale input by col scale
     if (fit.col_params.size() > 0) {
         Eigen::VectorXd v2(v.array() * fit.col_params.row(0).transpose());
         res = loader->vecMultiplyRight(
-            Eigen::Map<Eigen::VectorXd>(v2.data(), v2.size()), user_interrupt
+            Eigen::Map<Eigen::VectorXd>(v2.data(), v2.size()), ctx
         );
     } else {
-        res = loader->vecMultiplyRight(v, user_interrupt);
+        res = loader->vecMultiplyRight(v, ctx);
     }
 
     // Scale output by row scale
@@ -93,17 +93,17 @@ Scale::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *
 }
 
 Eigen::VectorXd
-Scale::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
+Scale::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
     Eigen::VectorXd res;
 
     // Scale input by row scale
     if (fit.row_params.size() > 0) {
         Eigen::VectorXd v2(v.array() * fit.row_params.row(0).transpose());
         res = loader->vecMultiplyLeft(
-            Eigen::Map<Eigen::VectorXd>(v2.data(), v2.size()), user_interrupt
+            Eigen::Map<Eigen::VectorXd>(v2.data(), v2.size()), ctx
         );
     } else {
-        res = loader->vecMultiplyLeft(v, user_interrupt);
+        res = loader->vecMultiplyLeft(v, ctx);
     }
 
     // Scale output by col scale
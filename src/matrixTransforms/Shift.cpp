@@ -20,27 +20,27 @@ void ShiftRows::loadZero(double *values, uint32_t count, uint32_t start_row, uin
 // Math tip: if A=untransformed matrix, and s = shift params as a column vector, ones = ones in a
 // row vector then transform = A + s * (ones).
 Eigen::MatrixXd
-ShiftRows::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
-    Eigen::MatrixXd res = loader->denseMultiplyRight(B, user_interrupt);
+ShiftRows::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
+    Eigen::MatrixXd res = loader->denseMultiplyRight(B, ctx);
     res += fit.row_params.row(0).transpose().matrix() * B.colwise().sum();
     return res;
 }
 Eigen::MatrixXd
-ShiftRows::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
-    Eigen::MatrixXd res = loader->denseMultiplyLeft(B, user_interrupt);
+ShiftRows::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
+    Eigen::MatrixXd res = loader->denseMultiplyLeft(B, ctx);
     res.colwise() += B * fit.row_params.row(0).transpose().matrix();
     return res;
 }
 // Calculate matrix-vector product A*v where A=this and B is a dense matrix.
 Eigen::VectorXd
-ShiftRows::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
-    Eigen::VectorXd res = loader->vecMultiplyRight(v, user_interrupt);
+ShiftRows::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
+    Eigen::VectorXd res = loader->vecMultiplyRight(v, ctx);
     res += fit.row_params.row(0).transpose().matrix() * v.sum();
     return res;
 }
 Eigen::VectorXd
-ShiftRows::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
-    Eigen::VectorXd res = loader->vecMultiplyLeft(v, user_interrupt);
+ShiftRows::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
+    Eigen::VectorXd res = loader->vecMultiplyLeft(v, ctx);
     res.rowwise() += fit.row_params.row(0).matrix() * v;
     return res;
 }
@@ -62,27 +62,27 @@ void ShiftCols::loadZero(double *values, uint32_t count, uint32_t start_row, uin
 // Math tip: if A=untransformed matrix, and s = shift params as a row vector, ones = ones in a col
 // vector then transform = A + ones * s.
 Eigen::MatrixXd
-ShiftCols::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
-    Eigen::MatrixXd res = loader->denseMultiplyRight(B, user_interrupt);
+ShiftCols::denseMultiplyRight(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
+    Eigen::MatrixXd res = loader->denseMultiplyRight(B, ctx);
     res.rowwise() += fit.col_params.row(0).matrix() * B;
     return res;
 }
 Eigen::MatrixXd
-ShiftCols::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt) {
-    Eigen::MatrixXd res = loader->denseMultiplyLeft(B, user_interrupt);
+ShiftCols::denseMultiplyLeft(const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx) {
+    Eigen::MatrixXd res = loader->denseMultiplyLeft(B, ctx);
     res += B.rowwise().sum() * fit.col_params.row(0).matrix();
     return res;
 }
 // Calculate matrix-vector product A*v where A=this and B is a dense matrix.
 Eigen::VectorXd
-ShiftCols::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
-    Eigen::VectorXd res = loader->vecMultiplyRight(v, user_interrupt);
+ShiftCols::vecMultiplyRight(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
+    Eigen::VectorXd res = loader->vecMultiplyRight(v, ctx);
     res.rowwise() += fit.col_params.row(0).matrix() * v;
     return res;
 }
 Eigen::VectorXd
-ShiftCols::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt) {
-    Eigen::VectorXd res = loader->vecMultiplyLeft(v, user_interrupt);
+ShiftCols::vecMultiplyLeft(const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx) {
+    Eigen::VectorXd res = loader->vecMultiplyLeft(v, ctx);
     res += fit.col_params.row(0).transpose().matrix() * v.sum();
     return res;
 }
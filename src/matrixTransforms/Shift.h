@@ -15,17 +15,17 @@ class ShiftRows : public MatrixTransformDense {
     void loadZero(double *values, uint32_t count, uint32_t start_row, uint32_t col) override;
 
     Eigen::MatrixXd denseMultiplyRight(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     Eigen::MatrixXd denseMultiplyLeft(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     // Calculate matrix-vector product A*v where A=this and B is a dense matrix.
     Eigen::VectorXd vecMultiplyRight(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
     Eigen::VectorXd vecMultiplyLeft(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
 };
 
@@ -37,17 +37,17 @@ class ShiftCols : public MatrixTransformDense {
     void loadZero(double *values, uint32_t count, uint32_t start_row, uint32_t col) override;
 
     Eigen::MatrixXd denseMultiplyRight(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     Eigen::MatrixXd denseMultiplyLeft(
-        const Eigen::Map<Eigen::MatrixXd> B, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::MatrixXd> B, const ExecutionContext &ctx = {}
     ) override;
     // Calculate matrix-vector product A*v where A=this and B is a dense matrix.
     Eigen::VectorXd vecMultiplyRight(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
     Eigen::VectorXd vecMultiplyLeft(
-        const Eigen::Map<Eigen::VectorXd> v, std::atomic<bool> *user_interrupt = NULL
+        const Eigen::Map<Eigen::VectorXd> v, const ExecutionContext &ctx = {}
     ) override;
 };
 
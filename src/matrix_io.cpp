@@ -2,10 +2,12 @@
 #define RCPP_NO_SUGAR
 #include <Rcpp.h>
 
+#include "matrixIterators/DualOrientationMatrix.h"
 #include "matrixIterators/ImportMatrixHDF5.h"
 #include "matrixIterators/MatrixIterator.h"
 #include "matrixIterators/MatrixMarketImport.h"
 #include "matrixIterators/StoredMatrix.h"
+#include "matrixIterators/StoredMatrixParallel.h"
 #include "matrixIterators/StoredMatrixTransposeWriter.h"
 #include "matrixIterators/StoredMatrixWriter.h"
 
@@ -71,7 +73,8 @@ List dims_matrix_reader_builder(ReaderBuilder &rb) {
         l["compressed"] = false;
         l["type"] = "uint32_t";
         return l;
-    } else if (version == "packed-uint-matrix-v1" || version == "packed-uint-matrix-v2") {
+    } else if (version == "packed-uint-matrix-v1" || version == "packed-uint-matrix-v2" ||
+               version == "packed-uint-matrix-v3") {
         List l = dims_matrix(StoredMatrix<uint32_t>::openPacked(rb), row_major);
         l["compressed"] = true;
         l["type"] = "uint32_t";
@@ -81,7 +84,8 @@ List dims_matrix_reader_builder(ReaderBuilder &rb) {
         l["compressed"] = false;
         l["type"] = "float";
         return l;
-    } else if (version == "packed-float-matrix-v1" || version == "packed-float-matrix-v2") {
+    } else if (version == "packed-float-matrix-v1" || version == "packed-float-matrix-v2" ||
+               version == "packed-float-matrix-v3") {
         List l = dims_matrix(StoredMatrix<float>::openPacked(rb), row_major);
         l["compressed"] = true;
         l["type"] = "float";
@@ -91,7 +95,8 @@ List dims_matrix_reader_builder(ReaderBuilder &rb) {
         l["compressed"] = false;
         l["type"] = "double";
         return l;
-    } else if (version == "packed-double-matrix-v1" || version == "packed-double-matrix-v2") {
+    } else if (version == "packed-double-matrix-v1" || version == "packed-double-matrix-v2" ||
+               version == "packed-double-matrix-v3") {
         List l = dims_matrix(StoredMatrix<double>::openPacked(rb), row_major);
         l["compressed"] = true;
         l["type"] = "double";
@@ -173,6 +178,17 @@ SEXP iterate_packed_matrix(
     const StringVector col_names,
     uint32_t row_count
 ) {
+    // Dual-orientation matrices answer row sums, row stats, and small row selections from
+    // their transposed copy
+    if (DualOrientationMatrix<T>::isDualOrientation(rb)) {
+        return make_unique_xptr<DualOrientationMatrix<T>>(DualOrientationMatrix<T>::openPacked(
+            rb,
+            1024,
+            std::make_unique<RcppStringReader>(row_names),
+            std::make_unique<RcppStringReader>(col_names),
+            row_count
+        ));
+    }
     return make_unique_xptr<StoredMatrix<T>>(StoredMatrix<T>::openPacked(
         rb,
         1024,
@@ -182,6 +198,31 @@ SEXP iterate_packed_matrix(
     ));
 }
 
+// In-memory packed matrices are split into column ranges that can be decoded in parallel,
+// since each range gets its own zero-copy readers into the same R vectors
+template <typename T>
+SEXP iterate_packed_matrix_mem(
+    S4 s4,
+    const StringVector row_names,
+    const StringVector col_names,
+    uint32_t row_count,
+    int threads
+) {
+    S4ReaderBuilder rb(s4);
+    std::function<StoredMatrix<T>()> open = [&]() {
+        return StoredMatrix<T>::openPacked(
+            rb,
+            1024,
+            std::make_unique<RcppStringReader>(row_names),
+            std::make_unique<RcppStringReader>(col_names),
+            row_count
+        );
+    };
+    return wrap_unique_xptr<MatrixLoader<T>>(
+        openStoredMatrixParallel<T>(open, std::max(threads, 0))
+    );
+}
+
 template <typename T>
 SEXP iterate_unpacked_matrix(
     ReaderBuilder &rb,
@@ -199,10 +240,13 @@ SEXP iterate_unpacked_matrix(
 
 // [[Rcpp::export]]
 SEXP iterate_packed_matrix_mem_uint32_t_cpp(
-    S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count
+    S4 s4,
+    const StringVector row_names,
+    const StringVector col_names,
+    uint32_t row_count,
+    int threads
 ) {
-    S4ReaderBuilder rb(s4);
-    return iterate_packed_matrix<uint32_t>(rb, row_names, col_names, row_count);
+    return iterate_packed_matrix_mem<uint32_t>(s4, row_names, col_names, row_count, threads);
 }
 // [[Rcpp::export]]
 SEXP iterate_unpacked_matrix_mem_uint32_t_cpp(
@@ -213,10 +257,13 @@ SEXP iterate_unpacked_matrix_mem_uint32_t_cpp(
 }
 // [[Rcpp::export]]
 SEXP iterate_packed_matrix_mem_float_cpp(
-    S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count
+    S4 s4,
+    const StringVector row_names,
+    const StringVector col_names,
+    uint32_t row_count,
+    int threads
 ) {
-    S4ReaderBuilder rb(s4);
-    return iterate_packed_matrix<float>(rb, row_names, col_names, row_count);
+    return iterate_packed_matrix_mem<float>(s4, row_names, col_names, row_count, threads);
 }
 // [[Rcpp::export]]
 SEXP iterate_unpacked_matrix_mem_float_cpp(
@@ -227,10 +274,13 @@ SEXP iterate_unpacked_matrix_mem_float_cpp(
 }
 // [[Rcpp::export]]
 SEXP iterate_packed_matrix_mem_double_cpp(
-    S4 s4, const StringVector row_names, const StringVector col_names, uint32_t row_count
+    S4 s4,
+    const StringVector row_names,
+    const StringVector col_names,
+    uint32_t row_count,
+    int threads
 ) {
-    S4ReaderBuilder rb(s4);
-    return iterate_packed_matrix<double>(rb, row_names, col_names, row_count);
+    return iterate_packed_matrix_mem<double>(s4, row_names, col_names, row_count, threads);
 }
 // [[Rcpp::export]]
 SEXP iterate_unpacked_matrix_mem_double_cpp(
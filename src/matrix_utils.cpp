@@ -6,6 +6,7 @@
 #include "matrixIterators/CSparseMatrix.h"
 #include "matrixIterators/ColwiseRank.h"
 #include "matrixIterators/ConcatenateMatrix.h"
+#include "matrixIterators/DownsampleCounts.h"
 #include "matrixIterators/Mask.h"
 #include "matrixIterators/MatrixIndexSelect.h"
 #include "matrixIterators/MatrixIterator.h"
@@ -87,6 +88,52 @@ SEXP build_csparse_matrix_double_cpp(SEXP matrix) {
     return Rcpp::wrap(writer.getMat());
 }
 
+// Build a dgCMatrix from iterators over consecutive column ranges. Column entry counts are
+// calculated first, then up to `threads` threads decode the ranges straight into the slots
+// of the output
+// [[Rcpp::export]]
+SEXP build_csparse_matrix_parallel_double_cpp(SEXP matrix_list, int threads) {
+    std::vector<std::unique_ptr<MatrixLoader<double>>> chunks;
+    List l = matrix_list;
+    for (uint32_t i = 0; i < l.size(); i++) {
+        SEXP elem = l[i];
+        chunks.push_back(take_unique_xptr<MatrixLoader<double>>(elem));
+    }
+    if (chunks.empty()) throw std::runtime_error("Must have >= 1 matrix to export");
+    uint32_t rows = chunks.front()->rows();
+    for (auto &m : chunks) {
+        if (m->rows() != rows)
+            throw std::runtime_error("Matrices must have equal numbers of rows");
+    }
+
+    std::vector<uint64_t> col_ptr = run_with_R_interrupt_check_threads(
+        std::max(threads, 0), &csparseColPtr<double>, std::ref(chunks), (uint32_t)threads
+    );
+    if (col_ptr.back() > (uint64_t)INT32_MAX)
+        throw std::runtime_error("Matrix has too many non-zero entries to store in a dgCMatrix");
+
+    IntegerVector p(col_ptr.size());
+    std::copy(col_ptr.begin(), col_ptr.end(), p.begin());
+    IntegerVector i(col_ptr.back());
+    NumericVector x(col_ptr.back());
+    run_with_R_interrupt_check_threads(
+        std::max(threads, 0),
+        &fillCSparseEntries<double, int, double>,
+        std::ref(chunks),
+        std::cref(col_ptr),
+        i.begin(),
+        x.begin(),
+        (uint32_t)threads
+    );
+
+    S4 res("dgCMatrix");
+    res.slot("Dim") = IntegerVector::create((int)rows, (int)(col_ptr.size() - 1));
+    res.slot("p") = p;
+    res.slot("i") = i;
+    res.slot("x") = x;
+    return res;
+}
+
 // [[Rcpp::export]]
 SEXP iterate_matrix_col_select_uint32_t_cpp(SEXP matrix, std::vector<uint32_t> col_selection) {
     return make_unique_xptr<MatrixColSelect<uint32_t>>(
@@ -332,6 +379,27 @@ SEXP iterate_matrix_rank_double_cpp(SEXP matrix) {
     return make_unique_xptr<ColwiseRank<double>>(take_unique_xptr<MatrixLoader<double>>(matrix));
 }
 
+// [[Rcpp::export]]
+SEXP iterate_matrix_downsample_cpp(
+    SEXP matrix,
+    std::vector<double> col_totals,
+    std::vector<double> targets,
+    std::string method,
+    double seed
+) {
+    DownsampleCounts::Method m;
+    if (method == "binomial") m = DownsampleCounts::Method::Binomial;
+    else if (method == "hypergeometric") m = DownsampleCounts::Method::Hypergeometric;
+    else throw std::invalid_argument("Unknown downsampling method: " + method);
+    return make_unique_xptr<DownsampleCounts>(
+        take_unique_xptr<MatrixLoader<uint32_t>>(matrix),
+        std::vector<uint64_t>(col_totals.begin(), col_totals.end()),
+        std::vector<uint64_t>(targets.begin(), targets.end()),
+        m,
+        (uint64_t)seed
+    );
+}
+
 // [[Rcpp::export]]
 Eigen::MatrixXd dense_multiply_right_cpp(SEXP matrix, Eigen::Map<Eigen::MatrixXd> B) {
     auto mat = take_unique_xptr<MatrixLoader<double>>(matrix);
@@ -399,10 +467,14 @@ std::vector<double> col_sums_double_cpp(SEXP matrix) {
 }
 
 // [[Rcpp::export]]
-List matrix_stats_cpp(SEXP matrix, int row_stats, int col_stats) {
+List matrix_stats_cpp(SEXP matrix, int row_stats, int col_stats, int threads) {
     auto mat = take_unique_xptr<MatrixLoader<double>>(matrix);
-    StatsResult res = run_with_R_interrupt_check(
-        &MatrixLoader<double>::computeMatrixStats, mat.get(), (Stats)row_stats, (Stats)col_stats
+    StatsResult res = run_with_R_interrupt_check_threads(
+        std::max(threads, 0),
+        &MatrixLoader<double>::computeMatrixStats,
+        mat.get(),
+        (Stats)row_stats,
+        (Stats)col_stats
     );
 
     return List::create(Named("row_stats") = res.row_stats, Named("col_stats") = res.col_stats);
@@ -430,10 +502,10 @@ Eigen::MatrixXd wilcoxon_rank_sum_pval_double_cpp(SEXP matrix, std::vector<uint3
 }
 
 // [[Rcpp::export]]
-SEXP svds_cpp(SEXP matrix, int k, int n_cv, int maxit, double tol) { 
+SEXP svds_cpp(SEXP matrix, int k, int n_cv, int maxit, double tol, int threads) { 
     auto mat = take_unique_xptr<MatrixLoader<double>>(matrix);
-    SVDResult res = run_with_R_interrupt_check(
-        svd, mat.get(), k, n_cv, maxit, tol
+    SVDResult res = run_with_R_interrupt_check_threads(
+        std::max(threads, 0), svd, mat.get(), k, n_cv, maxit, tol
     );
     if (!res.success) warning("SVD calculation did not converge");
     return List::create(
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "instrumentation.h"
+
+// Shared execution resources for long-running operations.
+// An ExecutionContext is passed by const reference through MatrixLoader operations,
+// MatrixWriters, FragmentWriters and the sorters. It carries:
+//  - The user interrupt flag (previously passed as a bare std::atomic<bool> *)
+//  - An optional thread budget shared by all parallel components of an operation, so
+//    nested parallel loaders (e.g. ConcatRows of ConcatCols) don't oversubscribe the machine
+//  - An optional memory budget shared by sort buffers and caches
+//  - An optional instrumentation node for writers and sorters to record their progress
+//
+// A default-constructed context has no interrupt flag and unlimited budgets, which matches
+// the previous behavior of passing user_interrupt = NULL.
+// Contexts are cheap to copy, and copies share the same underlying budgets.
+
+namespace BPCells {
+
+// Thread-safe counter of available units of a resource (threads or bytes)
+class ResourceBudget {
+  private:
+    std::mutex mtx;
+    const uint64_t total;
+    uint64_t available;
+
+  public:
+    ResourceBudget(uint64_t total) : total(total), available(total) {}
+
+    // Take up to `requested` units from the budget, returning the amount granted.
+    // At least `minimum` units are always granted, even if that exceeds the budget, so that
+    // callers with a hard lower bound can still make progress.
+    uint64_t acquire(uint64_t requested, uint64_t minimum = 0) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t granted = std::max(std::min(requested, available), std::min(minimum, requested));
+        available -= std::min(granted, available);
+        return granted;
+    }
+
+    void release(uint64_t amount) {
+        std::lock_guard<std::mutex> lock(mtx);
+        available = std::min(total, available + amount);
+    }
+
+    uint64_t capacity() const { return total; }
+};
+
+// RAII handle for resources taken from a ResourceBudget. Returns them on destruction.
+class ResourceLease {
+  private:
+    std::shared_ptr<ResourceBudget> budget;
+    uint64_t amount = 0;
+
+  public:
+    ResourceLease() = default;
+    ResourceLease(std::shared_ptr<ResourceBudget> budget, uint64_t amount)
+        : budget(std::move(budget))
+        , amount(amount) {}
+    ~ResourceLease() {
+        if (budget) budget->release(amount);
+    }
+    ResourceLease(ResourceLease &&other) : budget(std::move(other.budget)), amount(other.amount) {
+        other.amount = 0;
+    }
+    ResourceLease &operator=(ResourceLease &&other) {
+        if (this != &other) {
+            if (budget) budget->release(amount);
+            budget = std::move(other.budget);
+            amount = other.amount;
+            other.amount = 0;
+        }
+        return *this;
+    }
+    ResourceLease(const ResourceLease &) = delete;
+    ResourceLease &operator=(const ResourceLease &) = delete;
+
+    uint64_t count() const { return amount; }
+};
+
+class ExecutionContext {
+  public:
+    std::atomic<bool> *user_interrupt = NULL;
+    // Maximum number of worker threads to run at once. NULL for no limit
+    std::shared_ptr<ResourceBudget> thread_budget;
+    // Maximum bytes to use for sort buffers and caches. NULL for no limit
+    std::shared_ptr<ResourceBudget> memory_budget;
+    // Node to record progress into. NULL to disable instrumentation
+    std::shared_ptr<InstrumentNode> instrumentation;
+
+    ExecutionContext() = default;
+    // Implicit conversion allows existing callers that pass a bare interrupt flag
+    // (including run_with_R_interrupt_check) to keep working unchanged
+    ExecutionContext(std::atomic<bool> *user_interrupt) : user_interrupt(user_interrupt) {}
+    ExecutionContext(
+        std::atomic<bool> *user_interrupt, uint32_t max_threads, uint64_t max_memory_bytes
+    )
+        : user_interrupt(user_interrupt)
+        , thread_budget(std::make_shared<ResourceBudget>(max_threads))
+        , memory_budget(std::make_shared<ResourceBudget>(max_memory_bytes)) {}
+
+    bool interrupted() const { return user_interrupt != NULL && *user_interrupt; }
+
+    // Request up to `requested` worker threads. The lease may hold fewer (including 0, meaning
+    // run on the calling thread) if other components of the operation are using the budget
+    ResourceLease acquireThreads(uint32_t requested) const {
+        if (!thread_budget) return ResourceLease(NULL, requested);
+        return ResourceLease(thread_budget, thread_budget->acquire(requested));
+    }
+
+    // Request up to `requested` bytes of buffer memory, but never less than `minimum`
+    ResourceLease acquireMemory(uint64_t requested, uint64_t minimum = 0) const {
+        if (!memory_budget) return ResourceLease(NULL, requested);
+        return ResourceLease(memory_budget, memory_budget->acquire(requested, minimum));
+    }
+
+    // Return a copy of this context which records into a new child of the current
+    // instrumentation node (or has no instrumentation if this context has none).
+    // Not thread-safe: call from the coordinating thread before launching workers
+    ExecutionContext child(std::string name) const {
+        ExecutionContext ret = *this;
+        if (instrumentation) ret.instrumentation = instrumentation->addChild(std::move(name));
+        return ret;
+    }
+};
+
+} // end namespace BPCells
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Opt-in performance instrumentation for loader pipelines.
+// Each InstrumentNode records counters for one stage of a pipeline (a MatrixLoader,
+// FragmentLoader, or NumReader), and holds its upstream stages as children so the
+// whole pipeline can be inspected as a tree once an operation completes.
+//
+// Instrumentation is disabled unless a node is attached, and the only cost in that
+// case is a null pointer check at chunk boundaries.
+//
+// Typical usage:
+//   auto mat_node = std::make_shared<InstrumentNode>("StoredMatrix");
+//   stored_mat.instrument(*mat_node);   // Adds child nodes for the underlying NumReaders
+//   auto root = std::make_shared<InstrumentNode>("log1p", mat_node);
+//   InstrumentedMatrix<double> timed(std::move(log1p_mat), root);
+//   timed.denseMultiplyLeft(B);
+//   std::cout << root->summary();
+
+namespace BPCells {
+
+class InstrumentNode {
+  public:
+    std::string name;
+    // Wall time spent inside this node, inclusive of time spent in children
+    double seconds = 0;
+    uint64_t entries = 0;    // Entries (matrix non-zeros, fragments, or numbers) passed downstream
+    uint64_t chunks = 0;     // Number of load() calls that returned data
+    uint64_t bytes_read = 0; // Bytes loaded from the underlying storage
+    uint64_t seeks = 0;      // Number of seek calls
+    std::vector<std::shared_ptr<InstrumentNode>> children;
+
+    InstrumentNode(std::string name) : name(std::move(name)) {}
+    InstrumentNode(std::string name, std::shared_ptr<InstrumentNode> child)
+        : name(std::move(name)) {
+        children.push_back(std::move(child));
+    }
+    InstrumentNode(std::string name, std::vector<std::shared_ptr<InstrumentNode>> children)
+        : name(std::move(name))
+        , children(std::move(children)) {}
+
+    // Create a new child node and return it
+    std::shared_ptr<InstrumentNode> addChild(std::string child_name) {
+        children.push_back(std::make_shared<InstrumentNode>(std::move(child_name)));
+        return children.back();
+    }
+
+    // Time spent in this node excluding time spent in children
+    double selfSeconds() const {
+        double ret = seconds;
+        for (const auto &c : children)
+            ret -= c->seconds;
+        return ret > 0 ? ret : 0;
+    }
+
+    // Sum of bytes read in this node and all descendants
+    uint64_t totalBytesRead() const {
+        uint64_t ret = bytes_read;
+        for (const auto &c : children)
+            ret += c->totalBytesRead();
+        return ret;
+    }
+
+    // Reset counters for this node and all descendants
+    void reset() {
+        seconds = 0;
+        entries = chunks = bytes_read = seeks = 0;
+        for (auto &c : children)
+            c->reset();
+    }
+
+    // Human-readable indented summary of the tree, one line per node
+    std::string summary() const {
+        std::ostringstream out;
+        summaryHelper(out, 0);
+        return out.str();
+    }
+
+  private:
+    void summaryHelper(std::ostringstream &out, int depth) const {
+        for (int i = 0; i < depth; i++)
+            out << "  ";
+        out << name << ": total_s=" << seconds << " self_s=" << selfSeconds()
+            << " entries=" << entries << " chunks=" << chunks << " bytes_read=" << bytes_read
+            << " seeks=" << seeks << "\n";
+        for (const auto &c : children)
+            c->summaryHelper(out, depth + 1);
+    }
+};
+
+// Add elapsed wall time to a node on destruction. A no-op if node is NULL
+class InstrumentTimer {
+  private:
+    InstrumentNode *node;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    InstrumentTimer(InstrumentNode *node) : node(node) {
+        if (node != NULL) start = std::chrono::steady_clock::now();
+    }
+    ~InstrumentTimer() {
+        if (node == NULL) return;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        node->seconds += elapsed.count();
+    }
+};
+
+} // end namespace BPCells
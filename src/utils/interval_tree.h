@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace BPCells {
+
+// Implicit augmented interval tree over half-open intervals sorted by start, as in Heng Li's
+// cgranges. The tree is laid out in-order over the sorted array: node i sits at level k when
+// the lowest k bits of i are 1, and we store the max end coordinate within each subtree.
+// Queries return the indices of every interval overlapping [start, end) in O(log n + hits),
+// no matter how deeply the intervals overlap each other.
+class IntervalTree {
+  private:
+    std::vector<uint64_t> starts, ends, max_end;
+    int max_level = -1;
+
+    struct StackItem {
+        uint64_t x;
+        int k;
+        bool left_done;
+    };
+    std::vector<StackItem> stack;
+
+  public:
+    IntervalTree() = default;
+
+    // `start` must be sorted in increasing order
+    IntervalTree(std::vector<uint64_t> start, std::vector<uint64_t> end)
+        : starts(std::move(start))
+        , ends(std::move(end))
+        , max_end(ends) {
+        uint64_t n = starts.size();
+        if (n == 0) return;
+        uint64_t last_i = 0, last = 0;
+        for (uint64_t i = 0; i < n; i += 2) {
+            last_i = i;
+            last = ends[i];
+        }
+        int k;
+        for (k = 1; (1ULL << k) <= n; k++) {
+            uint64_t x = 1ULL << (k - 1);
+            for (uint64_t i = (x << 1) - 1; i < n; i += x << 2) {
+                uint64_t left = max_end[i - x];
+                uint64_t right = i + x < n ? max_end[i + x] : last;
+                max_end[i] = std::max({ends[i], left, right});
+            }
+            // Track the max end of the rightmost node, which may not have a full subtree
+            last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+            if (last_i < n && max_end[last_i] > last) last = max_end[last_i];
+        }
+        max_level = k - 1;
+    }
+
+    uint64_t size() const { return starts.size(); }
+
+    // Append indices of intervals overlapping [start, end) to `out`, in increasing order
+    void overlaps(uint64_t start, uint64_t end, std::vector<uint32_t> &out) {
+        uint64_t n = starts.size();
+        if (max_level < 0) return;
+        stack.clear();
+        stack.push_back({(1ULL << max_level) - 1, max_level, false});
+        while (!stack.empty()) {
+            StackItem z = stack.back();
+            stack.pop_back();
+            if (z.k <= 3) {
+                // Small subtree: scan it directly
+                uint64_t i0 = z.x >> z.k << z.k;
+                uint64_t i1 = std::min<uint64_t>(i0 + (1ULL << (z.k + 1)) - 1, n);
+                for (uint64_t i = i0; i < i1 && starts[i] < end; i++) {
+                    if (start < ends[i]) out.push_back(i);
+                }
+            } else if (!z.left_done) {
+                // Visit the left child first if anything there can reach `start`
+                uint64_t y = z.x - (1ULL << (z.k - 1));
+                stack.push_back({z.x, z.k, true});
+                if (y >= n || max_end[y] > start) stack.push_back({y, z.k - 1, false});
+            } else if (z.x < n && starts[z.x] < end) {
+                if (start < ends[z.x]) out.push_back(z.x);
+                stack.push_back({z.x + (1ULL << (z.k - 1)), z.k - 1, false});
+            }
+        }
+    }
+};
+
+} // end namespace BPCells
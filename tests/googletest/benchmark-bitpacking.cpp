@@ -0,0 +1,161 @@
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <bitpacking/bp128.h>
+
+using namespace BPCells;
+
+// Benchmarks for BP128 pack + unpack kernels. This file is compiled once per SIMD
+// level (see CMakeLists.txt), and each benchmark is run at several bit widths.
+
+namespace {
+
+constexpr uint32_t blocks = 1024;
+
+// Generate blocks*128 integers, where adjacent differences fit in `bits` bits
+std::vector<uint32_t> sortedInput(uint32_t bits, uint32_t seed = 1256) {
+    std::mt19937 gen(seed);
+    uint32_t max_delta = bits == 0 ? 0 : (bits >= 31 ? (1U << 30) : (1U << bits) - 1);
+    std::uniform_int_distribution<uint32_t> delta(0, max_delta / 2);
+    std::vector<uint32_t> ret(128 * blocks);
+    uint32_t val = 0;
+    for (auto &x : ret) {
+        val += delta(gen);
+        x = val;
+    }
+    return ret;
+}
+
+std::vector<uint32_t> randomInput(uint32_t bits, uint32_t seed = 1256) {
+    std::mt19937 gen(seed);
+    uint32_t max_val = bits >= 32 ? UINT32_MAX : (1U << bits) - 1;
+    std::uniform_int_distribution<uint32_t> val(0, max_val);
+    std::vector<uint32_t> ret(128 * blocks);
+    for (auto &x : ret)
+        x = val(gen);
+    return ret;
+}
+
+void setCounters(benchmark::State &state) {
+    state.SetItemsProcessed(state.iterations() * 128 * blocks);
+    state.SetBytesProcessed(state.iterations() * 128 * blocks * sizeof(uint32_t));
+}
+
+} // namespace
+
+static void BM_Pack(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = randomInput(bits);
+    std::vector<uint32_t> out(4 * 32 * blocks);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++)
+            simdpack(&in[128 * i], &out[4 * bits * i], bits);
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_Unpack(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = randomInput(bits);
+    std::vector<uint32_t> packed(4 * 32 * blocks), out(128 * blocks);
+    for (uint32_t i = 0; i < blocks; i++)
+        simdpack(&in[128 * i], &packed[4 * bits * i], bits);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++)
+            simdunpack(&packed[4 * bits * i], &out[128 * i], bits);
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_PackD1(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = sortedInput(bits);
+    std::vector<uint32_t> out(4 * 32 * blocks);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++) {
+            uint32_t init = i == 0 ? 0 : in[128 * i - 1];
+            simdpackd1(init, &in[128 * i], &out[4 * bits * i], bits);
+        }
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_UnpackD1(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = sortedInput(bits);
+    std::vector<uint32_t> packed(4 * 32 * blocks), out(128 * blocks);
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t init = i == 0 ? 0 : in[128 * i - 1];
+        simdpackd1(init, &in[128 * i], &packed[4 * bits * i], bits);
+    }
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++) {
+            uint32_t init = i == 0 ? 0 : in[128 * i - 1];
+            simdunpackd1(init, &packed[4 * bits * i], &out[128 * i], bits);
+        }
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_UnpackD1Z(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = sortedInput(bits > 0 ? bits - 1 : 0);
+    std::vector<uint32_t> packed(4 * 32 * blocks), out(128 * blocks);
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint32_t init = i == 0 ? 0 : in[128 * i - 1];
+        simdpackd1z(init, &in[128 * i], &packed[4 * bits * i], bits);
+    }
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++) {
+            uint32_t init = i == 0 ? 0 : in[128 * i - 1];
+            simdunpackd1z(init, &packed[4 * bits * i], &out[128 * i], bits);
+        }
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_UnpackFOR(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = randomInput(bits);
+    for (auto &x : in)
+        x += 1;
+    std::vector<uint32_t> packed(4 * 32 * blocks), out(128 * blocks);
+    for (uint32_t i = 0; i < blocks; i++)
+        simdpackFOR(1, &in[128 * i], &packed[4 * bits * i], bits);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < blocks; i++)
+            simdunpackFOR(1, &packed[4 * bits * i], &out[128 * i], bits);
+        benchmark::ClobberMemory();
+    }
+    setCounters(state);
+}
+
+static void BM_MaxBits(benchmark::State &state) {
+    uint32_t bits = state.range(0);
+    auto in = randomInput(bits);
+    for (auto _ : state) {
+        uint32_t max_bits = 0;
+        for (uint32_t i = 0; i < blocks; i++)
+            max_bits = std::max(max_bits, simdmaxbits(&in[128 * i]));
+        benchmark::DoNotOptimize(max_bits);
+    }
+    setCounters(state);
+}
+
+#define BP128_BIT_ARGS ->Arg(1)->Arg(4)->Arg(8)->Arg(16)->Arg(31)
+BENCHMARK(BM_Pack) BP128_BIT_ARGS;
+BENCHMARK(BM_Unpack) BP128_BIT_ARGS;
+BENCHMARK(BM_PackD1) BP128_BIT_ARGS;
+BENCHMARK(BM_UnpackD1) BP128_BIT_ARGS;
+BENCHMARK(BM_UnpackD1Z) BP128_BIT_ARGS;
+BENCHMARK(BM_UnpackFOR) BP128_BIT_ARGS;
+BENCHMARK(BM_MaxBits) BP128_BIT_ARGS;
+
+BENCHMARK_MAIN();
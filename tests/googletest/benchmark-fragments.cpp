@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+
+#include <arrayIO/vector.h>
+#include <fragmentIterators/FragmentIterator.h>
+#include <fragmentIterators/MergeFragments.h>
+#include <fragmentIterators/StoredFragments.h>
+#include <matrixIterators/PeakMatrix.h>
+#include <matrixIterators/TileMatrix.h>
+
+#include "utils-fragments.h"
+
+using namespace BPCells;
+
+// Benchmarks for fragment scans, peak + tile matrix construction, and MergeFragments
+
+namespace {
+
+constexpr uint32_t n_frags = 2000000;
+constexpr uint32_t n_chr = 4;
+constexpr uint32_t chr_length = 20000000;
+constexpr uint32_t n_cells = 2000;
+
+struct FragmentFixture {
+    VecReaderWriterBuilder packed;
+    std::vector<std::string> chr_names;
+
+    FragmentFixture() {
+        auto frags = Testing::generateRealisticFrags(n_frags, n_chr, chr_length, n_cells);
+        auto unpacked = Testing::writeFragmentTuple(frags, n_cells);
+        StoredFragments in = StoredFragments::openUnpacked(*unpacked);
+        StoredFragmentsWriter::createPacked(packed).write(in);
+        for (uint32_t i = 0; i < n_chr; i++)
+            chr_names.push_back("chr" + std::to_string(i));
+    }
+
+    static FragmentFixture &get() {
+        static FragmentFixture fixture;
+        return fixture;
+    }
+
+    std::unique_ptr<FragmentLoader> open() {
+        return std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(packed));
+    }
+};
+
+uint64_t scanMatrix(MatrixLoader<uint32_t> &mat) {
+    uint64_t sum = 0;
+    mat.restart();
+    while (mat.nextCol()) {
+        while (mat.load()) {
+            uint32_t *val = mat.valData();
+            for (uint32_t i = 0; i < mat.capacity(); i++)
+                sum += val[i];
+        }
+    }
+    return sum;
+}
+
+} // namespace
+
+static void BM_FragmentScan(benchmark::State &state) {
+    auto frags = FragmentFixture::get().open();
+    for (auto _ : state) {
+        frags->restart();
+        uint64_t sum = 0;
+        while (frags->nextChr()) {
+            while (frags->load())
+                sum += frags->capacity();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n_frags);
+}
+BENCHMARK(BM_FragmentScan);
+
+static void BM_PeakMatrix(benchmark::State &state) {
+    std::vector<uint32_t> chr, start, end;
+    Testing::generateRegions(state.range(0), n_chr, chr_length, 500, chr, start, end);
+    for (auto _ : state) {
+        PeakFragmentMatrix mat(
+            FragmentFixture::get().open(),
+            chr,
+            start,
+            end,
+            std::make_unique<VecStringReader>(FragmentFixture::get().chr_names)
+        );
+        benchmark::DoNotOptimize(scanMatrix(mat));
+    }
+    state.SetItemsProcessed(state.iterations() * n_frags);
+}
+BENCHMARK(BM_PeakMatrix)
+    ->ArgName("peaks_per_chr")
+    ->Arg(1000)
+    ->Arg(20000)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_TileMatrix(benchmark::State &state) {
+    std::vector<uint32_t> chr, start, end, width;
+    for (uint32_t i = 0; i < n_chr; i++) {
+        chr.push_back(i);
+        start.push_back(0);
+        end.push_back(chr_length);
+        width.push_back(state.range(0));
+    }
+    for (auto _ : state) {
+        TileMatrix mat(
+            FragmentFixture::get().open(),
+            chr,
+            start,
+            end,
+            width,
+            std::make_unique<VecStringReader>(FragmentFixture::get().chr_names)
+        );
+        benchmark::DoNotOptimize(scanMatrix(mat));
+    }
+    state.SetItemsProcessed(state.iterations() * n_frags);
+}
+BENCHMARK(BM_TileMatrix)
+    ->ArgName("tile_width")
+    ->Arg(500)
+    ->Arg(5000)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_MergeFragments(benchmark::State &state) {
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<FragmentLoader>> inputs;
+        for (int64_t i = 0; i < state.range(0); i++)
+            inputs.push_back(FragmentFixture::get().open());
+        MergeFragments merged(std::move(inputs), FragmentFixture::get().chr_names);
+        uint64_t sum = 0;
+        while (merged.nextChr()) {
+            while (merged.load())
+                sum += merged.capacity();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * n_frags * state.range(0));
+}
+BENCHMARK(BM_MergeFragments)->ArgName("inputs")->Arg(2)->Arg(8)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
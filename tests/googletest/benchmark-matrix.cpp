@@ -0,0 +1,148 @@
+#include <utils/filesystem_compat.h>
+
+#include <benchmark/benchmark.h>
+
+#include <arrayIO/vector.h>
+#include <matrixIterators/CSparseMatrix.h>
+#include <matrixIterators/MatrixIterator.h>
+#include <matrixIterators/StoredMatrix.h>
+#include <matrixIterators/StoredMatrixTransposeWriter.h>
+#include <matrixIterators/StoredMatrixWriter.h>
+
+#include <Eigen/Core>
+
+#include "utils-matrix.h"
+
+using namespace BPCells;
+
+// Benchmarks for StoredMatrix scans, MatrixOps kernels, and transposes.
+// Matrices are shaped like a gene x cell count matrix with ~7% density
+
+namespace {
+
+constexpr uint32_t n_genes = 5000;
+constexpr uint32_t n_cells = 4000;
+constexpr double density = 0.07;
+
+// Lazily build the stored versions of the test matrix, shared across benchmarks
+struct MatrixFixture {
+    Eigen::SparseMatrix<double> mat;
+    VecReaderWriterBuilder packed, unpacked;
+
+    MatrixFixture() : mat(Testing::generateSparseMatrix(n_genes, n_cells, density)) {
+        MatrixConverterLoader<double, uint32_t> mat_i(
+            std::make_unique<CSparseMatrix>(Testing::getMap(mat))
+        );
+        StoredMatrixWriter<uint32_t>::createPacked(packed).write(mat_i);
+        mat_i.restart();
+        StoredMatrixWriter<uint32_t>::createUnpacked(unpacked).write(mat_i);
+    }
+
+    static MatrixFixture &get() {
+        static MatrixFixture fixture;
+        return fixture;
+    }
+};
+
+std::unique_ptr<MatrixLoader<double>> openDouble(bool packed) {
+    auto &f = MatrixFixture::get();
+    auto stored = std::make_unique<StoredMatrix<uint32_t>>(
+        packed ? StoredMatrix<uint32_t>::openPacked(f.packed)
+               : StoredMatrix<uint32_t>::openUnpacked(f.unpacked)
+    );
+    return std::make_unique<MatrixConverterLoader<uint32_t, double>>(std::move(stored));
+}
+
+void setCounters(benchmark::State &state) {
+    state.SetItemsProcessed(state.iterations() * MatrixFixture::get().mat.nonZeros());
+}
+
+} // namespace
+
+static void BM_StoredMatrixScan(benchmark::State &state) {
+    auto &f = MatrixFixture::get();
+    StoredMatrix<uint32_t> mat = state.range(0) ? StoredMatrix<uint32_t>::openPacked(f.packed)
+                                                : StoredMatrix<uint32_t>::openUnpacked(f.unpacked);
+    for (auto _ : state) {
+        mat.restart();
+        uint64_t sum = 0;
+        while (mat.nextCol()) {
+            while (mat.load()) {
+                uint32_t *val = mat.valData();
+                uint32_t *row = mat.rowData();
+                for (uint32_t i = 0; i < mat.capacity(); i++)
+                    sum += val[i] + row[i];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    setCounters(state);
+}
+BENCHMARK(BM_StoredMatrixScan)->ArgName("packed")->Arg(0)->Arg(1);
+
+static void BM_DenseMultiplyRight(benchmark::State &state) {
+    auto mat = openDouble(true);
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(n_cells, state.range(0));
+    for (auto _ : state) {
+        mat->restart();
+        benchmark::DoNotOptimize(
+            mat->denseMultiplyRight(Eigen::Map<Eigen::MatrixXd>(B.data(), B.rows(), B.cols()))
+        );
+    }
+    setCounters(state);
+}
+BENCHMARK(BM_DenseMultiplyRight)->ArgName("k")->Arg(1)->Arg(10)->Arg(50);
+
+static void BM_DenseMultiplyLeft(benchmark::State &state) {
+    auto mat = openDouble(true);
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(state.range(0), n_genes);
+    for (auto _ : state) {
+        mat->restart();
+        benchmark::DoNotOptimize(
+            mat->denseMultiplyLeft(Eigen::Map<Eigen::MatrixXd>(B.data(), B.rows(), B.cols()))
+        );
+    }
+    setCounters(state);
+}
+BENCHMARK(BM_DenseMultiplyLeft)->ArgName("k")->Arg(1)->Arg(10)->Arg(50);
+
+static void BM_RowColSums(benchmark::State &state) {
+    auto mat = openDouble(true);
+    for (auto _ : state) {
+        mat->restart();
+        if (state.range(0)) benchmark::DoNotOptimize(mat->rowSums());
+        else benchmark::DoNotOptimize(mat->colSums());
+    }
+    setCounters(state);
+}
+BENCHMARK(BM_RowColSums)->ArgName("rows")->Arg(0)->Arg(1);
+
+static void BM_MatrixStats(benchmark::State &state) {
+    auto mat = openDouble(true);
+    for (auto _ : state) {
+        mat->restart();
+        benchmark::DoNotOptimize(mat->computeMatrixStats(Stats::Variance, Stats::Variance));
+    }
+    setCounters(state);
+}
+BENCHMARK(BM_MatrixStats);
+
+static void BM_Transpose(benchmark::State &state) {
+    auto &f = MatrixFixture::get();
+    StoredMatrix<uint32_t> mat = StoredMatrix<uint32_t>::openPacked(f.packed);
+    std_fs::path tmp = std_fs::temp_directory_path() / "BPCells_benchmark_transpose";
+    for (auto _ : state) {
+        std_fs::remove_all(tmp);
+        VecReaderWriterBuilder out(1024);
+        StoredMatrixTransposeWriter<uint32_t> w(
+            out, tmp.string().c_str(), 1 << 18, (uint64_t)state.range(0) << 20
+        );
+        mat.restart();
+        w.write(mat);
+    }
+    std_fs::remove_all(tmp);
+    setCounters(state);
+}
+BENCHMARK(BM_Transpose)->ArgName("sort_buffer_mb")->Arg(4)->Arg(64)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+
 #include <arrayIO/array_interfaces.h>
 #include <arrayIO/binaryfile.h>
 #include <arrayIO/bp128.h>
+#include <arrayIO/checksum.h>
 #include <arrayIO/hdf5.h>
 #include <arrayIO/vector.h>
 #include <gtest/gtest.h>
@@ -120,6 +125,42 @@ TEST(ArrayIO, Vector) {
     readValues(r);
 }
 
+TEST(ArrayIO, VectorZeroCopy) {
+    std::vector<uint32_t> v(10000);
+    for (uint32_t i = 0; i < v.size(); i++)
+        v[i] = i + 1;
+
+    UIntReader r(std::make_unique<VecUIntReader>(v.data(), v.size()), 2040, 1024);
+    // Switching modes after reading keeps the current position
+    EXPECT_EQ(r.read_one(), 1);
+    ASSERT_TRUE(r.enableZeroCopy());
+    EXPECT_EQ(r.read_one(), 2);
+    r.seek(0);
+    readValues(r);
+
+    // data() points straight into the source vector
+    r.seek(500);
+    ASSERT_TRUE(r.requestCapacity(100));
+    EXPECT_EQ(r.data(), v.data() + 500);
+    EXPECT_EQ(r.capacity(), 1024);
+    r.loadRange(9990, 10);
+    EXPECT_EQ(r.data(), v.data() + 9990);
+    EXPECT_EQ(r.capacity(), 10);
+    EXPECT_ANY_THROW(r.loadRange(9995, 10));
+
+    UIntReader c = ConstNumReader<uint32_t>::create({5, 6, 7});
+    ASSERT_TRUE(c.enableZeroCopy());
+    EXPECT_EQ(c.read_one(), 5);
+    EXPECT_EQ(c.read_one(), 6);
+    EXPECT_EQ(c.read_one(), 7);
+    EXPECT_FALSE(c.requestCapacity());
+
+    // Readers that don't hold their data in memory keep copying
+    UIntReader conv = ConstNumReader<uint64_t>::create({1, 2}).convert<uint32_t>();
+    EXPECT_FALSE(conv.enableZeroCopy());
+    EXPECT_EQ(conv.read_one(), 1);
+}
+
 TEST(ArrayIO, Binaryfile) {
     SCOPED_TRACE("Binaryfile ArrayIO");
     std_fs::path p = std_fs::temp_directory_path() / "BPCells_arrayIO_test/bin_array";
@@ -148,6 +189,63 @@ TEST(ArrayIO, HDF5) {
     readValues(r);
 }
 
+TEST(ArrayIO, CRC32C) {
+    // Standard check value for CRC-32C
+    const char *check = "123456789";
+    EXPECT_EQ(crc32c(check, 9), 0xE3069283);
+    // Incremental updates match a single pass, including unaligned splits
+    for (int split = 0; split <= 9; split++) {
+        EXPECT_EQ(crc32c(check + split, 9 - split, crc32c(check, split)), 0xE3069283);
+    }
+    EXPECT_EQ(crc32c(check, 0), 0);
+}
+
+TEST(ArrayIO, ChecksumRoundTrip) {
+    VecReaderWriterBuilder vb(1024);
+    ChecksumWriterBuilder cwb(vb, 300);
+    {
+        UIntWriter w = cwb.createUIntWriter("ints");
+        writeValues(w);
+        DoubleWriter d = cwb.createDoubleWriter("doubles");
+        for (int i = 0; i < 1000; i++)
+            d.write_one(i * 0.5);
+        d.finalize();
+    }
+    // 10000 values in chunks of 300, plus the 2-entry header
+    EXPECT_EQ(vb.getIntVecs()["ints_crc32c"].size(), 34 + 2);
+    EXPECT_EQ(vb.getIntVecs()["ints"].size(), 10000);
+
+    ChecksumReaderBuilder crb(vb);
+    EXPECT_TRUE(crb.hasChecksums());
+    UIntReader r = crb.openUIntReader("ints");
+    readValues(r);
+
+    ChecksumReport report = verifyChecksums(vb);
+    EXPECT_EQ(report.arrays, 2);
+    EXPECT_EQ(report.chunks, 34 + 4);
+    EXPECT_EQ(report.bytes, 10000 * 4 + 1000 * 8);
+    EXPECT_TRUE(report.failures.empty());
+
+    // Corrupt a value in the middle of chunk 10
+    vb.getIntVecs()["ints"][3100] ^= 1 << 20;
+    report = verifyChecksums(vb);
+    ASSERT_EQ(report.failures.size(), 1);
+    EXPECT_EQ(report.failures[0], "ints: CRC32C mismatch in chunk 10");
+
+    // Reads only fail once they touch the corrupted chunk
+    UIntReader r2 = ChecksumReaderBuilder(vb).openUIntReader("ints");
+    r2.seek(6000);
+    EXPECT_EQ(r2.read_one(), 6001);
+    r2.seek(3000);
+    EXPECT_THROW(r2.read_one(), ChecksumError);
+
+    // Arrays without checksums pass through unchanged
+    UIntWriter plain = vb.createUIntWriter("plain");
+    plain.write_one(7);
+    plain.finalize();
+    EXPECT_EQ(ChecksumReaderBuilder(vb).openUIntReader("plain").read_one(), 7);
+}
+
 TEST(ArrayIO, BP128) {
     SCOPED_TRACE("BP128 ArrayIO");
     std::vector<uint32_t> data(0);
@@ -295,6 +393,185 @@ TEST(ArrayIO, BP128_FOR) {
     readValues(r, vals);
 }
 
+TEST(ArrayIO, BP128_Adaptive) {
+    SCOPED_TRACE("BP128_Adaptive ArrayIO");
+    std::vector<uint32_t> data(0);
+    std::vector<uint32_t> idx(0);
+    std::vector<uint64_t> idx_offsets(0);
+    std::vector<uint32_t> tags(0);
+    std::vector<uint32_t> params(0);
+    uint32_t vals = 10000;
+    {
+        UIntWriter w(
+            std::make_unique<BP128_Adaptive_UIntWriter>(
+                UIntWriter(std::make_unique<VecUIntWriter>(data), 1020),
+                UIntWriter(std::make_unique<VecUIntWriter>(idx), 1019),
+                ULongWriter(std::make_unique<VecNumWriter<uint64_t>>(idx_offsets), 1019),
+                UIntWriter(std::make_unique<VecUIntWriter>(tags), 1021),
+                UIntWriter(std::make_unique<VecUIntWriter>(params), 1022)
+            ),
+            1018
+        );
+        writeValues(w, vals);
+    }
+    // Sorted consecutive integers should always pick D1 encoding
+    for (auto tag : tags) {
+        ASSERT_EQ(tag & 0xff, (uint32_t)BP128Codec::D1);
+    }
+
+    UIntReader r(
+        std::make_unique<BP128_Adaptive_UIntReader>(
+            UIntReader(std::make_unique<VecUIntReader>(data.data(), data.size()), 2039, 1023),
+            UIntReader(std::make_unique<VecUIntReader>(idx.data(), idx.size()), 2040, 1024),
+            ULongReader(
+                std::make_unique<VecNumReader<uint64_t>>(idx_offsets.data(), idx_offsets.size()),
+                1019,
+                14
+            ),
+            UIntReader(std::make_unique<VecUIntReader>(tags.data(), tags.size()), 2039, 1023),
+            UIntReader(std::make_unique<VecUIntReader>(params.data(), params.size()), 2039, 1023),
+            vals
+        ),
+        2041,
+        1025
+    );
+    readValues(r, vals);
+}
+
+TEST(ArrayIO, BP128_Adaptive_MixedBlocks) {
+    // One block suited to each codec, with a trailing partial block
+    std::vector<uint32_t> input;
+    for (int i = 0; i < 128; i++) input.push_back(7);                          // Constant
+    for (int i = 0; i < 128; i++) input.push_back(1000 + (i * 37) % 13);      // FOR
+    for (int i = 0; i < 128; i++) input.push_back(500000 + i * 3);            // D1
+    for (int i = 0; i < 128; i++) input.push_back(500000 + i * 3 - (i % 2) * 5); // D1Z
+    for (int i = 0; i < 128; i++) input.push_back(i % 3 == 0 ? 1 : 3000000);  // Dict
+    for (int i = 0; i < 128; i++) input.push_back(i < 100 ? 1 : 2000000000);  // RLE
+    for (int i = 0; i < 50; i++) input.push_back(i % 2);
+
+    std::vector<uint32_t> data, idx, tags, params;
+    std::vector<uint64_t> idx_offsets;
+    {
+        UIntWriter w(
+            std::make_unique<BP128_Adaptive_UIntWriter>(
+                UIntWriter(std::make_unique<VecUIntWriter>(data), 1024),
+                UIntWriter(std::make_unique<VecUIntWriter>(idx), 1024),
+                ULongWriter(std::make_unique<VecNumWriter<uint64_t>>(idx_offsets), 1024),
+                UIntWriter(std::make_unique<VecUIntWriter>(tags), 1024),
+                UIntWriter(std::make_unique<VecUIntWriter>(params), 1024)
+            ),
+            1024
+        );
+        std::vector<uint32_t> copy = input;
+        w.ensureCapacity(copy.size());
+        std::memcpy(w.data(), copy.data(), copy.size() * sizeof(uint32_t));
+        w.advance(copy.size());
+        w.finalize();
+    }
+    ASSERT_EQ(tags.size(), 7);
+    std::vector<BP128Codec> expected = {
+        BP128Codec::Constant,
+        BP128Codec::FOR,
+        BP128Codec::D1,
+        BP128Codec::D1Z,
+        BP128Codec::Dict,
+        BP128Codec::RLE,
+        BP128Codec::FOR};
+    for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_EQ(tags[i] & 0xff, (uint32_t)expected[i]) << "block " << i;
+    }
+    // Constant blocks take no data
+    EXPECT_EQ(idx[1], 0);
+
+    UIntReader r(
+        std::make_unique<BP128_Adaptive_UIntReader>(
+            UIntReader(std::make_unique<VecUIntReader>(data.data(), data.size()), 1024),
+            UIntReader(std::make_unique<VecUIntReader>(idx.data(), idx.size()), 1024),
+            ULongReader(
+                std::make_unique<VecNumReader<uint64_t>>(idx_offsets.data(), idx_offsets.size()),
+                1024
+            ),
+            UIntReader(std::make_unique<VecUIntReader>(tags.data(), tags.size()), 1024),
+            UIntReader(std::make_unique<VecUIntReader>(params.data(), params.size()), 1024),
+            input.size()
+        ),
+        1024
+    );
+    for (size_t i = 0; i < input.size(); i++) {
+        ASSERT_EQ(r.read_one(), input[i]) << "index " << i;
+    }
+    // Seek into the middle of each block
+    for (size_t pos = 60; pos < input.size(); pos += 128) {
+        r.seek(pos);
+        ASSERT_EQ(r.read_one(), input[pos]) << "index " << pos;
+    }
+}
+
+TEST(ArrayIO, BP128_Adaptive_EliasFano) {
+    // Row indices of a sparse matrix: columns with a few hundred entries spread over 10M rows.
+    // Elias-Fano pays off most on blocks spanning column boundaries, where D1Z and FOR
+    // need full-width values
+    std::mt19937 gen(1245);
+    std::uniform_int_distribution<uint32_t> row_dist(0, 10'000'000);
+    std::uniform_int_distribution<uint32_t> nnz_dist(200, 400);
+    std::vector<uint32_t> input;
+    while (input.size() < 128 * 100 + 17) {
+        std::vector<uint32_t> col(nnz_dist(gen));
+        for (auto &x : col) x = row_dist(gen);
+        std::sort(col.begin(), col.end());
+        input.insert(input.end(), col.begin(), col.end());
+    }
+
+    auto write_blocks = [&](std::unique_ptr<UIntBulkWriter> &&bulk) {
+        UIntWriter w(std::move(bulk), 1024);
+        for (auto x : input) w.write_one(x);
+        w.finalize();
+    };
+
+    std::vector<uint32_t> data, idx, tags, params, d1z_data, d1z_idx, d1z_starts;
+    std::vector<uint64_t> idx_offsets, d1z_idx_offsets;
+    write_blocks(std::make_unique<BP128_Adaptive_UIntWriter>(
+        UIntWriter(std::make_unique<VecUIntWriter>(data), 1024),
+        UIntWriter(std::make_unique<VecUIntWriter>(idx), 1024),
+        ULongWriter(std::make_unique<VecNumWriter<uint64_t>>(idx_offsets), 1024),
+        UIntWriter(std::make_unique<VecUIntWriter>(tags), 1024),
+        UIntWriter(std::make_unique<VecUIntWriter>(params), 1024)
+    ));
+    write_blocks(std::make_unique<BP128_D1Z_UIntWriter>(
+        UIntWriter(std::make_unique<VecUIntWriter>(d1z_data), 1024),
+        UIntWriter(std::make_unique<VecUIntWriter>(d1z_idx), 1024),
+        ULongWriter(std::make_unique<VecNumWriter<uint64_t>>(d1z_idx_offsets), 1024),
+        UIntWriter(std::make_unique<VecUIntWriter>(d1z_starts), 1024)
+    ));
+
+    size_t ef_blocks = 0;
+    for (auto tag : tags) ef_blocks += (tag & 0xff) == (uint32_t)BP128Codec::EliasFano;
+    EXPECT_GT(ef_blocks, tags.size() / 10);
+    EXPECT_LT(data.size(), d1z_data.size());
+
+    UIntReader r(
+        std::make_unique<BP128_Adaptive_UIntReader>(
+            UIntReader(std::make_unique<VecUIntReader>(data.data(), data.size()), 1024),
+            UIntReader(std::make_unique<VecUIntReader>(idx.data(), idx.size()), 1024),
+            ULongReader(
+                std::make_unique<VecNumReader<uint64_t>>(idx_offsets.data(), idx_offsets.size()),
+                1024
+            ),
+            UIntReader(std::make_unique<VecUIntReader>(tags.data(), tags.size()), 1024),
+            UIntReader(std::make_unique<VecUIntReader>(params.data(), params.size()), 1024),
+            input.size()
+        ),
+        1024
+    );
+    for (size_t i = 0; i < input.size(); i++) {
+        ASSERT_EQ(r.read_one(), input[i]) << "index " << i;
+    }
+    for (int64_t pos = input.size() - 1; pos >= 0; pos -= 301) {
+        r.seek(pos);
+        ASSERT_EQ(r.read_one(), input[pos]) << "index " << pos;
+    }
+}
+
 TEST(ArrayIO, BP128_idx_offset_incompressible) {
     // Steps: 
     // 1. Set the idx_offset wraparound point abnormally low (4096)
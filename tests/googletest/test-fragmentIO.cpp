@@ -1,12 +1,20 @@
 #include <utils/filesystem_compat.h>
+#include <cstring>
+#include <fstream>
+#include <map>
 #include <sstream>
 
 #include <gtest/gtest.h>
 
+#include <arrayIO/binaryfile.h>
 #include <arrayIO/vector.h>
 #include <fragmentIterators/BedFragments.h>
+#include <fragmentIterators/Bgzf.h>
+#include <fragmentIterators/CellSelect.h>
 #include <fragmentIterators/ChrSelect.h>
 #include <fragmentIterators/FragmentIterator.h>
+#include <fragmentIterators/MergeFragments.h>
+#include <fragmentIterators/MultiSampleFragments.h>
 #include <fragmentIterators/StoredFragments.h>
 
 #include "utils-fragments.h"
@@ -87,6 +95,128 @@ TEST(FragmentIO, PackedVec) {
     ASSERT_TRUE(Testing::fragments_identical(loader, in));
 }
 
+TEST(FragmentIO, PackedPipelined) {
+    // Enough fragments for several worker handoffs per stream
+    uint32_t max_cell = 50;
+    auto frags_vec = Testing::generateFrags(300000, 3, 4000000, max_cell - 1, 100, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> v = writeFragmentTuple(frags_vec);
+    StoredFragments in = StoredFragments::openUnpacked(*v);
+
+    VecReaderWriterBuilder vb1(1024), vb2(1024);
+    StoredFragmentsWriter::createPacked(vb1).write(in);
+    StoredFragmentsWriter::createPacked(vb2, 1024, true).write(in);
+
+    // Output is identical to packing on the calling thread
+    EXPECT_EQ(vb1.getIntVecs(), vb2.getIntVecs());
+    EXPECT_EQ(vb1.getLongVecs(), vb2.getLongVecs());
+    auto loader = StoredFragmentsPacked::openPacked(vb2);
+    ASSERT_TRUE(Testing::fragments_identical(loader, in));
+}
+
+TEST(FragmentIO, SortedEnds) {
+    uint32_t max_cell = 50;
+    auto frags_vec = Testing::generateFrags(20000, 3, 40000, max_cell - 1, 500, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> v = writeFragmentTuple(frags_vec);
+    StoredFragments in = StoredFragments::openUnpacked(*v);
+    EXPECT_FALSE(in.hasSortedEnds());
+
+    // Expected (end, cell) pairs sorted per chromosome, ties in input order
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> expected(4);
+    FragmentIterator it(std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*v)));
+    while (it.nextChr()) {
+        while (it.nextFrag()) {
+            expected[it.chr()].push_back({it.end(), it.cell()});
+        }
+    }
+    for (auto &e : expected) {
+        std::stable_sort(e.begin(), e.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+    }
+
+    VecReaderWriterBuilder vb1(1024), vb2(1024), vb3(1024);
+    StoredFragmentsWriter::createUnpacked(vb1, true).write(in);
+    StoredFragmentsWriter::createPacked(vb2, 1024, false, true).write(in);
+    StoredFragmentsWriter::createPacked(vb3, 1024, true, true).write(in);
+    EXPECT_EQ(vb2.getIntVecs(), vb3.getIntVecs());
+
+    std::vector<std::unique_ptr<FragmentLoader>> loaders;
+    loaders.push_back(std::make_unique<StoredFragments>(StoredFragments::openUnpacked(vb1)));
+    loaders.push_back(
+        std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(vb2))
+    );
+    for (auto &loader : loaders) {
+        ASSERT_TRUE(loader->hasSortedEnds());
+        in.restart();
+        ASSERT_TRUE(Testing::fragments_identical(*loader, in));
+
+        // Sorted ends come back in full for each chromosome
+        loader->restart();
+        while (loader->nextChr()) {
+            std::vector<std::pair<uint32_t, uint32_t>> ends;
+            while (loader->loadSortedEnds()) {
+                for (uint32_t i = 0; i < loader->sortedEndCapacity(); i++) {
+                    ends.push_back({loader->sortedEndData()[i], loader->sortedEndCellData()[i]});
+                }
+            }
+            EXPECT_EQ(ends, expected[loader->currentChr()]);
+        }
+
+        // Seeks skip only ends < base
+        for (uint32_t chr : {2, 0, 1}) {
+            for (uint32_t base : {0, 133, 20000, 39000, 50000}) {
+                loader->seek(chr, base);
+                std::vector<std::pair<uint32_t, uint32_t>> ends;
+                while (loader->loadSortedEnds()) {
+                    for (uint32_t i = 0; i < loader->sortedEndCapacity(); i++) {
+                        ends.push_back({loader->sortedEndData()[i], loader->sortedEndCellData()[i]}
+                        );
+                    }
+                }
+                auto &e = expected[chr];
+                ASSERT_LE(ends.size(), e.size());
+                EXPECT_TRUE(std::equal(ends.begin(), ends.end(), e.end() - ends.size()));
+                for (size_t i = 0; i + ends.size() < e.size(); i++) {
+                    EXPECT_LT(e[i].first, base);
+                }
+            }
+        }
+    }
+}
+
+TEST(FragmentIO, InstrumentedPacked) {
+    uint32_t max_cell = 50;
+    auto frags_vec = Testing::generateFrags(2000, 3, 400, max_cell - 1, 100, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> v = writeFragmentTuple(frags_vec);
+    StoredFragments in = StoredFragments::openUnpacked(*v);
+
+    VecReaderWriterBuilder vb1(1024);
+    StoredFragmentsWriter::createPacked(vb1).write(in);
+
+    auto packed = std::make_unique<StoredFragmentsPacked>(StoredFragmentsPacked::openPacked(vb1));
+    auto root = std::make_shared<InstrumentNode>("StoredFragmentsPacked");
+    packed->instrument(*root);
+    InstrumentedFragments loader(std::move(packed), root);
+
+    in.restart();
+    ASSERT_TRUE(Testing::fragments_identical(loader, in));
+    EXPECT_EQ(root->entries, frags_vec.size());
+    EXPECT_GT(root->chunks, 0);
+    ASSERT_EQ(root->children.size(), 4);
+    EXPECT_EQ(root->children[0]->name, "cell");
+    EXPECT_GE(root->children[0]->entries, frags_vec.size());
+    EXPECT_GE(root->seconds, root->children[0]->seconds);
+
+    loader.seek(1, 100);
+    EXPECT_EQ(root->seeks, 1);
+    EXPECT_GT(root->children[1]->seeks, 0);
+
+    EXPECT_THROW(
+        InstrumentedFragments(std::make_unique<StoredFragments>(std::move(in)), nullptr),
+        std::invalid_argument
+    );
+}
+
 TEST(FragmentIO, ReducedCapacityWrite) {
     // Test writing StoredFragments when the reader loads more at a time than the
     // chunk size of the writer
@@ -132,4 +262,294 @@ TEST(FragmentIO, ChrSelectRoundTrip) {
 
     in.restart();
     ASSERT_TRUE(Testing::fragments_identical(in, l3));
-}
\ No newline at end of file
+}
+
+TEST(FragmentIO, MultiSampleContainer) {
+    // Samples with different cell counts, one of them missing chromosomes
+    std::vector<std::unique_ptr<VecReaderWriterBuilder>> inputs;
+    inputs.push_back(writeFragmentTuple(Testing::generateFrags(2000, 3, 400, 49, 100, 1)));
+    inputs.push_back(writeFragmentTuple(Testing::generateFrags(500, 1, 400, 9, 100, 2)));
+    inputs.push_back(writeFragmentTuple(Testing::generateFrags(3000, 3, 400, 79, 100, 3)));
+    auto open_input = [&](uint32_t i) -> std::unique_ptr<FragmentLoader> {
+        return std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*inputs[i]));
+    };
+    std::vector<std::string> chr_order = {"chr3", "chr0", "chr1", "chr2"};
+    auto merge_inputs = [&](std::vector<uint32_t> idx) {
+        std::vector<std::unique_ptr<FragmentLoader>> v;
+        for (auto i : idx) {
+            v.push_back(open_input(i));
+        }
+        return std::make_unique<MergeFragments>(std::move(v), chr_order);
+    };
+    std::vector<std::string> sample_names = {"s0", "s1", "s2"};
+
+    std_fs::path dir = std_fs::temp_directory_path() / "BPCells_fragmentIO_test/multi_sample";
+    if (std_fs::exists(dir)) std_fs::remove_all(dir);
+    FileWriterBuilder fwb(dir.string());
+    writeMultiSampleFragments(fwb, open_input, sample_names, chr_order);
+    VecReaderWriterBuilder vb(1024);
+    writeMultiSampleFragments(vb, open_input, sample_names, chr_order);
+
+    FileReaderBuilder frb(dir.string());
+    for (ReaderBuilder *rb : std::vector<ReaderBuilder *>{&frb, &vb}) {
+        MultiSampleFragments container(*rb);
+        ASSERT_EQ(container.sampleCount(), 3);
+        EXPECT_EQ(container.sampleNames(), sample_names);
+        EXPECT_EQ(container.chrNames(), chr_order);
+        EXPECT_EQ(container.sampleCellCount(1), 10);
+
+        // Keep all samples open at once, sharing the container's arrays
+        std::vector<std::unique_ptr<FragmentLoader>> samples;
+        for (uint32_t i = 0; i < 3; i++) {
+            samples.push_back(container.openSample(i));
+        }
+        for (uint32_t i = 0; i < 3; i++) {
+            SCOPED_TRACE(i);
+            ChrNameSelect expected(open_input(i), chr_order);
+            EXPECT_TRUE(Testing::fragments_identical(*samples[i], expected));
+        }
+
+        EXPECT_TRUE(
+            Testing::fragments_identical(*container.openSamples({2, 0}), *merge_inputs({2, 0}))
+        );
+        EXPECT_TRUE(Testing::fragments_identical(*container.openAll(), *merge_inputs({0, 1, 2})));
+
+        // After seeking, fragments overlapping the seek position match the reference
+        FragmentIterator it1(container.openAll()), it2(merge_inputs({0, 1, 2}));
+        it1.seek(2, 200);
+        it2.seek(2, 200);
+        uint32_t overlapping = 0;
+        while (true) {
+            bool res1, res2;
+            while ((res1 = it1.nextFrag()) && it1.end() <= 200) {}
+            while ((res2 = it2.nextFrag()) && it2.end() <= 200) {}
+            ASSERT_EQ(res1, res2);
+            if (!res1) break;
+            ASSERT_EQ(it1.start(), it2.start());
+            ASSERT_EQ(it1.end(), it2.end());
+            ASSERT_EQ(it1.cell(), it2.cell());
+            overlapping++;
+        }
+        EXPECT_GT(overlapping, 0);
+    }
+    EXPECT_THROW(MultiSampleFragments{*inputs[0]}, std::runtime_error);
+}
+
+// Decompress a BGZF file block by block, checking the block structure and recording the
+// uncompressed offset at the start of each block
+std::string readBgzf(const std::string &path, std::map<uint64_t, uint64_t> &block_starts) {
+    std::ifstream in(path, std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string text;
+    uint64_t pos = 0;
+    while (pos < file.size()) {
+        const unsigned char *block = (const unsigned char *)file.data() + pos;
+        EXPECT_EQ(block[0], 0x1f);
+        EXPECT_EQ(block[1], 0x8b);
+        EXPECT_EQ(block[3], 4);  // FEXTRA set
+        EXPECT_EQ(block[12], 'B');
+        EXPECT_EQ(block[13], 'C');
+        uint64_t block_size = block[16] + (block[17] << 8) + 1;
+        uint32_t isize = block[block_size - 4] + (block[block_size - 3] << 8) +
+                         (block[block_size - 2] << 16) + ((uint32_t)block[block_size - 1] << 24);
+        EXPECT_LE(isize, BgzfWriter::BLOCK_SIZE);
+
+        block_starts[pos] = text.size();
+        std::string out(isize, '\0');
+        z_stream zs = {};
+        inflateInit2(&zs, -15);
+        zs.next_in = (Bytef *)block + 18;
+        zs.avail_in = block_size - 26;
+        zs.next_out = (Bytef *)out.data();
+        zs.avail_out = isize;
+        EXPECT_EQ(inflate(&zs, Z_FINISH), Z_STREAM_END);
+        inflateEnd(&zs);
+        text += out;
+        pos += block_size;
+        // File ends with an empty end-of-file block
+        if (pos == file.size()) EXPECT_EQ(isize, 0);
+    }
+    return text;
+}
+
+TEST(FragmentIO, BedBgzfIndexed) {
+    uint32_t max_cell = 50;
+    // Coordinates span several 16kb tabix windows and many BGZF blocks
+    auto frags_vec = Testing::generateFrags(100000, 3, 2000000, max_cell - 1, 1000, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> v = writeFragmentTuple(frags_vec);
+    StoredFragments frags = StoredFragments::openUnpacked(*v);
+
+    std_fs::path dir = std_fs::temp_directory_path() / "BPCells_fragmentIO_test";
+    std::string p1 = (dir / "bgzf1.tsv.gz").string();
+    std::string p2 = (dir / "bgzf2.tsv.gz").string();
+    BedFragmentsWriter(p1.c_str()).write(frags);
+    BedFragmentsWriter(p2.c_str(), false, 1 << 20, 3, true).write(frags);
+    EXPECT_THROW(BedFragmentsWriter((dir / "plain.tsv").string().c_str(), false, 1 << 20, 1, true),
+                 std::invalid_argument);
+
+    std::ostringstream expected;
+    FragmentIterator it((std::unique_ptr<FragmentLoader>(&frags)));
+    it.preserve_input_loader();
+    it.restart();
+    while (it.nextChr()) {
+        while (it.nextFrag()) {
+            expected << it.chrNames(it.chr()) << "\t" << it.start() << "\t" << it.end() << "\t"
+                     << it.cellNames(it.cell()) << "\n";
+        }
+    }
+
+    // Compressing on worker threads gives byte-identical output
+    std::map<uint64_t, uint64_t> blocks1, blocks;
+    EXPECT_EQ(readBgzf(p1, blocks1), expected.str());
+    std::string text = readBgzf(p2, blocks);
+    EXPECT_EQ(text, expected.str());
+    EXPECT_EQ(blocks1, blocks);
+    EXPECT_GT(blocks.size(), 10);
+
+    // Parse the tabix index
+    gzFile gz = gzopen((p2 + ".tbi").c_str(), "rb");
+    ASSERT_NE(gz, nullptr);
+    std::string idx;
+    char buf[4096];
+    int n;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) idx.append(buf, n);
+    gzclose(gz);
+    uint64_t pos = 0;
+    auto read32 = [&]() {
+        int32_t x;
+        std::memcpy(&x, idx.data() + pos, 4);
+        pos += 4;
+        return x;
+    };
+    auto read64 = [&]() {
+        uint64_t x;
+        std::memcpy(&x, idx.data() + pos, 8);
+        pos += 8;
+        return x;
+    };
+    // Convert a virtual offset to an offset in the uncompressed text
+    auto text_offset = [&](uint64_t voffset) {
+        EXPECT_EQ(blocks.count(voffset >> 16), 1);
+        return blocks[voffset >> 16] + (voffset & 0xffff);
+    };
+    auto line_end = [&](uint64_t offset) {
+        uint64_t end = text.find('\n', offset);
+        std::istringstream line(text.substr(offset, end - offset));
+        std::string chr, cell;
+        uint32_t start, end_coord;
+        line >> chr >> start >> end_coord >> cell;
+        return std::make_pair(chr, end_coord);
+    };
+
+    ASSERT_EQ(idx.substr(0, 4), std::string("TBI\1", 4));
+    pos = 4;
+    int32_t n_ref = read32();
+    ASSERT_EQ(n_ref, 4);
+    EXPECT_EQ(read32(), 0x10000);
+    EXPECT_EQ(read32(), 1);
+    EXPECT_EQ(read32(), 2);
+    EXPECT_EQ(read32(), 3);
+    read32();
+    read32();
+    int32_t names_bytes = read32();
+    std::vector<std::string> names;
+    for (uint64_t i = pos; i < pos + names_bytes; i += names.back().size() + 1) {
+        names.push_back(std::string(idx.data() + i));
+    }
+    pos += names_bytes;
+    EXPECT_EQ(names, std::vector<std::string>({"chr0", "chr1", "chr2", "chr3"}));
+
+    for (int32_t r = 0; r < n_ref; r++) {
+        SCOPED_TRACE(names[r]);
+        // Chunks cover exactly the lines of this chromosome
+        uint64_t chunk_bytes = 0;
+        int32_t n_bin = read32();
+        for (int32_t b = 0; b < n_bin; b++) {
+            read32();
+            int32_t n_chunk = read32();
+            for (int32_t c = 0; c < n_chunk; c++) {
+                uint64_t begin = text_offset(read64());
+                uint64_t end = text_offset(read64());
+                ASSERT_TRUE(begin == 0 || text[begin - 1] == '\n');
+                ASSERT_EQ(text[end - 1], '\n');
+                ASSERT_EQ(line_end(begin).first, names[r]);
+                chunk_bytes += end - begin;
+            }
+        }
+        uint64_t chr_bytes = 0;
+        for (uint64_t i = 0; i < text.size(); i = text.find('\n', i) + 1) {
+            if (text.compare(i, names[r].size() + 1, names[r] + "\t") == 0) {
+                chr_bytes += text.find('\n', i) + 1 - i;
+            }
+        }
+        EXPECT_EQ(chunk_bytes, chr_bytes);
+
+        // Lines of this chromosome before each window's offset end before the window
+        int32_t n_intv = read32();
+        EXPECT_GT(n_intv, 100);
+        uint64_t chr_start = text.find(names[r] + "\t");
+        for (int32_t w = 0; w < n_intv; w++) {
+            uint64_t offset = text_offset(read64());
+            for (uint64_t i = chr_start; i < offset; i = text.find('\n', i) + 1) {
+                ASSERT_LE(line_end(i).second, (uint32_t)w << 14);
+            }
+            chr_start = offset;
+        }
+    }
+    EXPECT_EQ(pos, idx.size());
+}
+
+TEST(FragmentIO, BedFilterCells) {
+    uint32_t max_cell = 50;
+    auto frags_vec = Testing::generateFrags(5000, 3, 4000, max_cell - 1, 100, 1336);
+    // Add a chromosome whose fragments all come from a cell outside the whitelist below
+    for (uint32_t i = 0; i < 20; i++) {
+        frags_vec.push_back({4, i * 10, i * 10 + 50, 7});
+    }
+    std::unique_ptr<VecReaderWriterBuilder> v = writeFragmentTuple(frags_vec);
+    StoredFragments frags = StoredFragments::openUnpacked(*v);
+
+    std::string path =
+        (std_fs::temp_directory_path() / "BPCells_fragmentIO_test/filter.tsv").string();
+    BedFragmentsWriter(path.c_str()).write(frags);
+
+    // Fragment counts per barcode, in order of first appearance
+    std::vector<std::string> order;
+    std::map<std::string, uint32_t> counts;
+    FragmentIterator it(std::make_unique<BedFragments>(path.c_str()));
+    while (it.nextChr()) {
+        while (it.nextFrag()) {
+            std::string name = it.cellNames(it.cell());
+            if (counts[name]++ == 0) order.push_back(name);
+        }
+    }
+
+    std::vector<std::string> keep = {"c5", "c3", "c40"};
+    BedFragments whitelisted(path.c_str(), "", keep);
+    EXPECT_EQ(whitelisted.cellCount(), 3);
+    CellNameSelect expected1(std::make_unique<BedFragments>(path.c_str()), keep);
+    EXPECT_TRUE(Testing::fragments_identical(whitelisted, expected1));
+
+    uint32_t min_fragments = 105;
+    std::vector<std::string> abundant;
+    for (auto &name : order) {
+        if (counts[name] >= min_fragments) abundant.push_back(name);
+    }
+    ASSERT_GT(abundant.size(), 0);
+    ASSERT_LT(abundant.size(), order.size());
+    BedFragments thresholded(path.c_str(), "", {}, min_fragments);
+    EXPECT_EQ(thresholded.cellCount(), abundant.size());
+    CellNameSelect expected2(std::make_unique<BedFragments>(path.c_str()), abundant);
+    EXPECT_TRUE(Testing::fragments_identical(thresholded, expected2));
+
+    // Both filters together keep the whitelist order
+    std::vector<std::string> both;
+    for (auto &name : keep) {
+        if (counts[name] >= min_fragments) both.push_back(name);
+    }
+    BedFragments combined(path.c_str(), "", keep, min_fragments);
+    CellNameSelect expected3(std::make_unique<BedFragments>(path.c_str()), both);
+    EXPECT_TRUE(Testing::fragments_identical(combined, expected3));
+
+    EXPECT_THROW(BedFragments(path.c_str(), "", {"c1", "c1"}), std::invalid_argument);
+}
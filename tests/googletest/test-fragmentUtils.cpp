@@ -10,7 +10,10 @@
 #include <fragmentIterators/RegionSelect.h>
 #include <fragmentIterators/Rename.h>
 #include <fragmentIterators/StoredFragments.h>
+#include <fragmentUtils/FootprintMatrix.h>
 #include <fragmentUtils/InsertionIterator.h>
+#include <fragmentUtils/InsertionPileup.h>
+#include <utils/filesystem_compat.h>
 
 using namespace BPCells;
 
@@ -220,6 +223,63 @@ TEST(FragmentUtils, MergeFragments) {
     EXPECT_TRUE(Testing::fragments_identical(expected, merge));
 }
 
+TEST(FragmentUtils, MergeFragmentsManyInputs) {
+    // Many inputs with lots of tied start coordinates. Ties are output in input order,
+    // so the result matches a stable sort of the concatenated inputs
+    uint32_t max_cell = 10, n_inputs = 11;
+    auto by_coord = [](const Testing::Frag &a, const Testing::Frag &b) {
+        if (a.chr != b.chr) return a.chr < b.chr;
+        return a.start < b.start;
+    };
+
+    std::vector<std::unique_ptr<VecReaderWriterBuilder>> inputs;
+    std::vector<Testing::Frag> v;
+    for (uint32_t i = 0; i < n_inputs; i++) {
+        // Input 3 has no fragments on the last chromosome
+        auto frags = Testing::generateFrags(300, i == 3 ? 1 : 2, 100, max_cell - 1, 25, 1000 + i);
+        std::stable_sort(frags.begin(), frags.end(), by_coord);
+        inputs.push_back(writeFragmentTuple(frags, max_cell, true));
+        std::vector<std::string> &names = inputs.back()->getStringVecs().at("cell_names");
+        for (uint32_t j = 0; j < max_cell; j++) {
+            names[j] = std::string("c") + std::to_string(j + i * max_cell);
+        }
+        for (auto f : frags) {
+            f.cell += i * max_cell;
+            v.push_back(f);
+        }
+    }
+    std::stable_sort(v.begin(), v.end(), by_coord);
+    std::unique_ptr<VecReaderWriterBuilder> v_expect =
+        writeFragmentTuple(v, max_cell * n_inputs, true);
+    std::vector<std::string> chr_names = v_expect->getStringVecs().at("chr_names");
+
+    auto open_input = [&](uint32_t i) -> std::unique_ptr<FragmentLoader> {
+        return std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*inputs[i]));
+    };
+
+    std::vector<std::unique_ptr<FragmentLoader>> merge_vec;
+    for (uint32_t i = 0; i < n_inputs; i++) {
+        merge_vec.push_back(open_input(i));
+    }
+    // Small load size so output chunks end partway through runs from each input
+    MergeFragments merge(std::move(merge_vec), chr_names, 37);
+    StoredFragments expected = StoredFragments::openUnpacked(*v_expect);
+    EXPECT_TRUE(Testing::fragments_identical(expected, merge));
+
+    std_fs::path tmp = std_fs::temp_directory_path() / "BPCells_merge_hierarchical_test";
+    std_fs::remove_all(tmp);
+    for (uint32_t threads : {1, 3}) {
+        // 11 inputs with max_open 3 takes two rounds of group merges before the final merge
+        std::unique_ptr<FragmentLoader> hierarchical =
+            mergeFragmentsHierarchical(open_input, n_inputs, chr_names, tmp.string(), 3, threads);
+        expected.restart();
+        EXPECT_TRUE(Testing::fragments_identical(expected, *hierarchical));
+        hierarchical.reset();
+        std_fs::remove_all(tmp);
+    }
+    EXPECT_ANY_THROW(mergeFragmentsHierarchical(open_input, n_inputs, chr_names, tmp.string(), 1));
+}
+
 TEST(FragmentUtils, InsertionIterator) {
     uint32_t max_cell = 50;
     auto v = Testing::generateFrags(2000, 3, 400, max_cell - 1, 100, 1336);
@@ -267,6 +327,187 @@ TEST(FragmentUtils, InsertionIterator) {
     ASSERT_FALSE(it.nextChr());
 }
 
+TEST(FragmentUtils, InsertionIteratorSortedEnds) {
+    uint32_t max_cell = 50;
+    auto v = Testing::generateFrags(20000, 3, 40000, max_cell - 1, 500, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> d = writeFragmentTuple(v, max_cell);
+    StoredFragments frags = StoredFragments::openUnpacked(*d);
+
+    VecReaderWriterBuilder vb1(1024), vb2(1024);
+    StoredFragmentsWriter::createUnpacked(vb1, true).write(frags);
+    StoredFragmentsWriter::createPacked(vb2, 1024, false, true).write(frags);
+    StoredFragments sorted1 = StoredFragments::openUnpacked(vb1);
+    StoredFragmentsPacked sorted2 = StoredFragmentsPacked::openPacked(vb2);
+
+    auto collect = [](InsertionIterator &it, uint32_t min_coord) {
+        std::vector<std::array<uint32_t, 3>> ret;
+        while (it.nextInsertion()) {
+            if (it.coord() >= min_coord) ret.push_back({it.coord(), it.cell(), it.isStart()});
+        }
+        return ret;
+    };
+
+    for (FragmentLoader *loader : std::vector<FragmentLoader *>{&sorted1, &sorted2}) {
+        frags.restart();
+        loader->restart();
+        InsertionIterator expected(frags), it(*loader);
+        while (expected.nextChr()) {
+            ASSERT_TRUE(it.nextChr());
+            EXPECT_EQ(collect(it, 0), collect(expected, 0));
+        }
+        EXPECT_FALSE(it.nextChr());
+
+        for (uint32_t chr : {1, 0, 2}) {
+            for (uint32_t base : {0, 5000, 39900}) {
+                expected.seek(chr, base);
+                it.seek(chr, base);
+                EXPECT_EQ(collect(it, base), collect(expected, base));
+            }
+        }
+    }
+}
+
+TEST(FragmentUtils, FootprintMatrices) {
+    uint32_t max_cell = 50;
+    uint32_t flank = 20;
+    auto v = Testing::generateFrags(20000, 3, 20000, max_cell - 1, 300, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> d = writeFragmentTuple(v, max_cell);
+
+    std::vector<std::string> chr_levels = {"chr0", "chr1", "chr2", "chr3"};
+    std::vector<uint32_t> cell_groups;
+    std::vector<double> cell_weights;
+    for (uint32_t i = 0; i < max_cell; i++) {
+        cell_groups.push_back(i % 3);
+        cell_weights.push_back(1 + i % 2);
+    }
+
+    // Three site sets of different sizes, with more sites than fit in one task per chromosome
+    std::mt19937 gen(1337);
+    std::uniform_int_distribution<uint32_t> chr(0, 3), center(flank, 20000), strand(0, 1);
+    std::vector<FootprintSites> site_sets(3);
+    for (uint32_t s = 0; s < site_sets.size(); s++) {
+        for (uint32_t i = 0; i < 2000 + 4000 * s; i++) {
+            site_sets[s].chr.push_back(chr(gen));
+            site_sets[s].center.push_back(center(gen));
+            site_sets[s].strand.push_back(strand(gen) ? 1 : -1);
+        }
+    }
+
+    auto open_frags = [&]() {
+        return std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*d));
+    };
+    auto single = footprintMatrices(
+        open_frags,
+        site_sets,
+        flank,
+        std::make_unique<VecStringReader>(chr_levels),
+        cell_groups,
+        cell_weights,
+        1
+    );
+    auto threaded = footprintMatrices(
+        open_frags,
+        site_sets,
+        flank,
+        std::make_unique<VecStringReader>(chr_levels),
+        cell_groups,
+        cell_weights,
+        4
+    );
+    ASSERT_EQ(single.size(), site_sets.size());
+    ASSERT_EQ(threaded.size(), site_sets.size());
+
+    for (uint32_t s = 0; s < site_sets.size(); s++) {
+        auto frags = open_frags();
+        Eigen::MatrixXd expected = footprintMatrix(
+            *frags,
+            site_sets[s].chr,
+            site_sets[s].center,
+            site_sets[s].strand,
+            flank,
+            std::make_unique<VecStringReader>(chr_levels),
+            cell_groups,
+            cell_weights
+        );
+        // Integer weights, so sums are exact regardless of order
+        EXPECT_TRUE(single[s] == expected);
+        EXPECT_TRUE(threaded[s] == expected);
+    }
+
+    // Brute force check of the first site set
+    Eigen::MatrixXd brute_force = Eigen::MatrixXd::Zero(3, 2 * flank + 1);
+    const FootprintSites &sites = site_sets[0];
+    for (const auto &f : v) {
+        for (uint32_t i = 0; i < sites.chr.size(); i++) {
+            if (sites.chr[i] != f.chr) continue;
+            for (int64_t pos : {(int64_t)f.start, (int64_t)f.end - 1}) {
+                int64_t offset = pos - (int64_t)sites.center[i];
+                if (offset < -(int64_t)flank || offset > (int64_t)flank) continue;
+                int64_t col = flank + (sites.strand[i] == 1 ? offset : -offset);
+                brute_force(cell_groups[f.cell], col) += cell_weights[f.cell];
+            }
+        }
+    }
+    EXPECT_TRUE(single[0] == brute_force);
+}
+
+TEST(FragmentUtils, InsertionPileup) {
+    uint32_t max_cell = 50;
+    auto v = Testing::generateFrags(20000, 3, 20000, max_cell - 1, 300, 1336);
+    std::unique_ptr<VecReaderWriterBuilder> d = writeFragmentTuple(v, max_cell);
+    StoredFragments frags = StoredFragments::openUnpacked(*d);
+
+    // Cells in 4 groups, skipping every 7th cell
+    uint32_t n_groups = 4;
+    std::vector<uint32_t> cell_groups;
+    for (uint32_t i = 0; i < max_cell; i++) {
+        cell_groups.push_back(i % 7 == 0 ? UINT32_MAX : i % n_groups);
+    }
+    std::vector<double> group_scale = {1, 0.5, 2, 10};
+
+    // Regions out of order, including one with a partial last bin
+    std::vector<uint32_t> chr = {2, 0, 1, 2};
+    std::vector<uint32_t> start = {500, 100, 15000, 0};
+    std::vector<uint32_t> end = {2500, 1105, 19000, 20300};
+    std::vector<uint32_t> bin_width = {100, 10, 1000, 1};
+
+    Eigen::MatrixXd res = insertionPileup(
+        frags, chr, start, end, bin_width, cell_groups, n_groups, group_scale
+    );
+
+    std::vector<uint64_t> offset = {0};
+    for (size_t i = 0; i < chr.size(); i++) {
+        offset.push_back(offset.back() + (end[i] - start[i] + bin_width[i] - 1) / bin_width[i]);
+    }
+    ASSERT_EQ(res.rows(), n_groups);
+    ASSERT_EQ(res.cols(), offset.back());
+    EXPECT_EQ(offset[2] - offset[1], 101);
+
+    Eigen::MatrixXd expected = Eigen::MatrixXd::Zero(n_groups, offset.back());
+    for (const auto &f : v) {
+        uint32_t group = cell_groups[f.cell];
+        if (group == UINT32_MAX) continue;
+        for (uint32_t pos : {f.start, f.end - 1}) {
+            for (size_t i = 0; i < chr.size(); i++) {
+                if (f.chr != chr[i] || pos < start[i] || pos >= end[i]) continue;
+                expected(group, offset[i] + (pos - start[i]) / bin_width[i]) +=
+                    group_scale[group];
+            }
+        }
+    }
+    EXPECT_TRUE(res == expected);
+
+    // Same result when merging with a sorted end stream
+    VecReaderWriterBuilder vb(1024);
+    StoredFragmentsWriter::createPacked(vb, 1024, false, true).write(frags);
+    StoredFragmentsPacked sorted = StoredFragmentsPacked::openPacked(vb);
+    EXPECT_TRUE(
+        insertionPileup(
+            sorted, chr, start, end, bin_width, cell_groups, n_groups, group_scale
+        ) == expected
+    );
+}
+
 TEST(FragmentUtils, CellSelect) {
     uint32_t max_cell = 50;
     auto v = Testing::generateFrags(200, 3, 400, max_cell - 1, 100, 1336);
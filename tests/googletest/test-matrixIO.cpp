@@ -4,12 +4,16 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <arrayIO/checksum.h>
 #include <arrayIO/vector.h>
 #include <matrixIterators/CSparseMatrix.h>
 #include <matrixIterators/ConcatenateMatrix.h>
+#include <matrixIterators/DownsampleCounts.h>
 #include <matrixIterators/MatrixIndexSelect.h>
 #include <matrixIterators/MatrixIterator.h>
+#include <matrixIterators/MatrixOrientation.h>
 #include <matrixIterators/StoredMatrix.h>
+#include <matrixIterators/StoredMatrixParallel.h>
 #include <matrixIterators/StoredMatrixWriter.h>
 
 #include <matrixIterators/ImportMatrixHDF5.h>
@@ -123,6 +127,181 @@ TEST(MatrixIO, PackedVec) {
     EXPECT_TRUE(w2.getMat().isApprox(orig_mat));
 }
 
+TEST(MatrixIO, PackedAdaptiveVec) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(500, 300);
+
+    MatrixConverterLoader<double, uint32_t> mat_i(std::make_unique<CSparseMatrix>(get_map(orig_mat))
+    );
+
+    VecReaderWriterBuilder vb_fixed(1024), vb_adaptive(1024);
+    StoredMatrixWriter<uint32_t>::createPacked(vb_fixed).write(mat_i);
+    mat_i.restart();
+    StoredMatrixWriter<uint32_t>::createPacked(vb_adaptive, false, 1024, true).write(mat_i);
+    EXPECT_EQ(vb_adaptive.readVersion(), "packed-uint-matrix-v3");
+
+    // Per-block choice can never need more data words than the fixed codecs
+    for (auto name : {"index_data", "val_data"}) {
+        EXPECT_LE(vb_adaptive.getIntVecs()[name].size(), vb_fixed.getIntVecs()[name].size());
+    }
+
+    StoredMatrix<uint32_t> fixed = StoredMatrix<uint32_t>::openPacked(vb_fixed);
+    StoredMatrix<uint32_t> adaptive = StoredMatrix<uint32_t>::openPacked(vb_adaptive);
+    EXPECT_TRUE(matrix_identical(fixed, adaptive));
+
+    MatrixIterator<uint32_t> it(
+        std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb_adaptive))
+    );
+    for (auto j : {299, 17, 150, 0}) {
+        it.seekCol(j);
+        SparseMatrix<double>::InnerIterator orig(orig_mat, j);
+        while (it.nextValue()) {
+            ASSERT_TRUE(orig);
+            EXPECT_EQ(it.row(), orig.row());
+            EXPECT_EQ(it.val(), orig.value());
+            ++orig;
+        }
+        EXPECT_FALSE(orig);
+    }
+}
+
+TEST(MatrixIO, PackedChecksum) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(500, 300);
+
+    MatrixConverterLoader<double, uint32_t> mat_i(std::make_unique<CSparseMatrix>(get_map(orig_mat))
+    );
+    VecReaderWriterBuilder vb(1024);
+    ChecksumWriterBuilder cwb(vb, 4096);
+    StoredMatrixWriter<uint32_t>::createPacked(cwb).write(mat_i);
+    EXPECT_TRUE(vb.getIntVecs().count("index_data_crc32c"));
+    EXPECT_TRUE(vb.getLongVecs().count("idxptr"));
+    EXPECT_TRUE(vb.getIntVecs().count("idxptr_crc32c"));
+    EXPECT_TRUE(verifyChecksums(vb).failures.empty());
+
+    auto loader_double = MatrixConverterLoader<uint32_t, double>(
+        std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb))
+    );
+    CSparseMatrixWriter w;
+    w.write(loader_double);
+    EXPECT_TRUE(w.getMat().isApprox(orig_mat));
+
+    // Corrupted data is detected when read instead of producing wrong values
+    vb.getIntVecs()["val_data"][100] ^= 0x10;
+    EXPECT_EQ(verifyChecksums(vb).failures.size(), 1);
+    auto corrupt_double = MatrixConverterLoader<uint32_t, double>(
+        std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb))
+    );
+    CSparseMatrixWriter w2;
+    EXPECT_THROW(w2.write(corrupt_double), ChecksumError);
+}
+
+TEST(MatrixIO, PackedParallelColumnRanges) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(200, 301);
+
+    CSparseMatrix mat_d(get_map(orig_mat));
+    VecReaderWriterBuilder vb(1024);
+    StoredMatrixWriter<double>::createPacked(vb).write(mat_d);
+
+    std::function<StoredMatrix<double>()> open = [&]() {
+        return StoredMatrix<double>::openPacked(vb);
+    };
+    auto serial = openStoredMatrixParallel<double>(open, 1);
+    auto parallel = openStoredMatrixParallel<double>(open, 3);
+    EXPECT_EQ(parallel->cols(), 301);
+    EXPECT_EQ(parallel->rows(), 200);
+    EXPECT_TRUE(matrix_identical(*serial, *parallel));
+
+    // Column ranges have balanced non-zero counts
+    std::vector<uint32_t> splits = open().balancedColumnSplits(3);
+    ASSERT_EQ(splits.size(), 4);
+    for (int i = 0; i < 3; i++) {
+        uint64_t nnz =
+            orig_mat.outerIndexPtr()[splits[i + 1]] - orig_mat.outerIndexPtr()[splits[i]];
+        EXPECT_NEAR(nnz, orig_mat.nonZeros() / 3.0, 0.02 * orig_mat.nonZeros());
+    }
+    // Every range keeps at least 2 columns, even when asking for more ranges than that allows
+    splits = open().balancedColumnSplits(300);
+    EXPECT_LE(splits.size(), 151);
+    for (size_t i = 0; i + 1 < splits.size(); i++)
+        EXPECT_GE(splits[i + 1] - splits[i], 2);
+    EXPECT_EQ(open().balancedColumnSplits(1), std::vector<uint32_t>({0, 301}));
+
+    Eigen::MatrixXd b = Eigen::MatrixXd::Random(301, 4);
+    Eigen::MatrixXd res =
+        parallel->denseMultiplyRight(Eigen::Map<Eigen::MatrixXd>(b.data(), 301, 4));
+    EXPECT_TRUE(res.isApprox(orig_mat * b));
+    EXPECT_EQ(parallel->colSums(), serial->colSums());
+}
+
+template <typename T> void test_packed_write_parallel(const SparseMatrix<double> &orig_mat) {
+    MatrixConverterLoader<double, T> mat_t(std::make_unique<CSparseMatrix>(get_map(orig_mat)));
+    VecReaderWriterBuilder input(1024);
+    StoredMatrixWriter<T>::createUnpacked(input).write(mat_t);
+    std::function<StoredMatrix<T>()> open = [&]() { return StoredMatrix<T>::openUnpacked(input); };
+
+    for (bool adaptive : {false, true}) {
+        for (bool row_major : {false, true}) {
+            VecReaderWriterBuilder serial(1024), parallel(1024);
+            StoredMatrix<T> mat = open();
+            StoredMatrixWriter<T>::createPacked(serial, row_major, 1024, adaptive).write(mat);
+            // Small runs so the chunks from many runs get stitched together
+            writePackedMatrixParallel<T>(open, parallel, row_major, 3, adaptive, {}, true, 300);
+
+            EXPECT_EQ(parallel.readVersion(), serial.readVersion());
+            EXPECT_EQ(parallel.getIntVecs(), serial.getIntVecs());
+            EXPECT_EQ(parallel.getLongVecs(), serial.getLongVecs());
+            EXPECT_EQ(parallel.getFloatVecs(), serial.getFloatVecs());
+            EXPECT_EQ(parallel.getDoubleVecs(), serial.getDoubleVecs());
+            EXPECT_EQ(parallel.getStringVecs(), serial.getStringVecs());
+        }
+    }
+}
+
+TEST(MatrixIO, PackedWriteParallel) {
+    SparseMatrix<double> orig_mat = generate_mat(200, 301);
+    // Include some empty columns
+    orig_mat.col(3) *= 0;
+    orig_mat.col(300) *= 0;
+    orig_mat.prune(0.0);
+    test_packed_write_parallel<uint32_t>(orig_mat);
+    test_packed_write_parallel<float>(orig_mat);
+    test_packed_write_parallel<double>(generate_mat(50, 7));
+}
+
+TEST(MatrixIO, AxisPlanner) {
+    EXPECT_EQ(planAxisKernel(Axis::Col, false), AxisKernel::Streaming);
+    EXPECT_EQ(planAxisKernel(Axis::Row, false), AxisKernel::Scatter);
+    EXPECT_EQ(planAxisKernel(Axis::Row, true), AxisKernel::Streaming);
+    EXPECT_EQ(planAxisKernel(Axis::Col, true), AxisKernel::Scatter);
+
+    const SparseMatrix<double> orig_mat = generate_mat(40, 30);
+    const Eigen::MatrixXd dense(orig_mat);
+    for (bool row_major : {false, true}) {
+        CSparseMatrix mat_d(get_map(orig_mat));
+        VecReaderWriterBuilder vb(1024);
+        StoredMatrixWriter<double>::createPacked(vb, row_major).write(mat_d);
+        EXPECT_EQ(StoredMatrix<double>::isRowMajor(vb), row_major);
+
+        // Row-major outputs hold the transpose of the input, which loads back as the input
+        Eigen::MatrixXd logical = row_major ? Eigen::MatrixXd(dense.transpose()) : dense;
+        StoredMatrix<double> mat = StoredMatrix<double>::openPacked(vb);
+        for (Axis axis : {Axis::Row, Axis::Col}) {
+            Eigen::ArrayXXd stats = computeAxisStats(mat, axis, row_major, Stats::Variance);
+            std::vector<double> sums = axisSums(mat, axis, row_major);
+            Eigen::MatrixXd m = axis == Axis::Row ? logical : Eigen::MatrixXd(logical.transpose());
+            ASSERT_EQ(stats.cols(), m.rows());
+            ASSERT_EQ(sums.size(), m.rows());
+            for (Eigen::Index i = 0; i < m.rows(); i++) {
+                Eigen::ArrayXd x = m.row(i).array();
+                double mean = x.mean();
+                EXPECT_EQ(stats(0, i), (x != 0).count());
+                EXPECT_NEAR(stats(1, i), mean, 1e-9);
+                EXPECT_NEAR(stats(2, i), (x - mean).square().sum() / (x.size() - 1), 1e-9);
+                EXPECT_NEAR(sums[i], x.sum(), 1e-9);
+            }
+        }
+    }
+}
+
 TEST(MatrixIO, SeekCSparse) {
     std::vector<Triplet<double>> triplets;
     const uint32_t n_row = 6;
@@ -242,6 +421,111 @@ TEST(MatrixIO, RowSelectCSparse) {
     EXPECT_EQ(MatrixXd(writer2.getMat()), MatrixXd(mat)({0, 2, 4}, all));
 }
 
+TEST(MatrixIO, RowSelectStoredPushdown) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(3000, 40);
+
+    MatrixConverterLoader<double, uint32_t> mat_i(std::make_unique<CSparseMatrix>(get_map(orig_mat))
+    );
+    VecReaderWriterBuilder vb(1024);
+    StoredMatrixWriter<uint32_t>::createPacked(vb).write(mat_i);
+
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 2999; i >= 2900; i -= 7)
+        rows.push_back(i);
+    rows.push_back(0);
+    rows.push_back(1234);
+
+    // Reference: filter after decoding from an in-memory matrix
+    MatrixRowSelect<double> expected_sel(std::make_unique<CSparseMatrix>(get_map(orig_mat)), rows);
+    CSparseMatrixWriter expected;
+    expected.write(expected_sel);
+
+    auto stored = std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb));
+    auto node = std::make_shared<InstrumentNode>("stored");
+    stored->instrument(*node);
+    MatrixConverterLoader<uint32_t, double> pushed(
+        std::make_unique<MatrixRowSelect<uint32_t>>(std::move(stored), rows)
+    );
+    EXPECT_EQ(pushed.rows(), rows.size());
+
+    CSparseMatrixWriter res;
+    res.write(pushed);
+    EXPECT_TRUE(res.getMat().isApprox(expected.getMat()));
+
+    // Only a fraction of the value blocks should have been decoded
+    uint64_t val_entries = node->children[1]->entries;
+    uint64_t index_entries = node->children[0]->entries;
+    EXPECT_EQ(index_entries, orig_mat.nonZeros());
+    EXPECT_LT(val_entries, index_entries / 2);
+
+    // Seeking and restarting still work with the filter pushed down
+    pushed.restart();
+    res.write(pushed);
+    EXPECT_TRUE(res.getMat().isApprox(expected.getMat()));
+
+    MatrixIterator<double> it(std::make_unique<MatrixRowSelect<double>>(
+        std::make_unique<CSparseMatrix>(get_map(orig_mat)), rows
+    ));
+    MatrixIterator<double> it_pushed((std::unique_ptr<MatrixLoader<double>>(&pushed)));
+    it_pushed.preserve_input_loader();
+    for (auto j : {17, 3, 39, 4, 0}) {
+        it.seekCol(j);
+        it_pushed.seekCol(j);
+        while (it.nextValue()) {
+            ASSERT_TRUE(it_pushed.nextValue());
+            EXPECT_EQ(it.row(), it_pushed.row());
+            EXPECT_EQ(it.val(), it_pushed.val());
+        }
+        EXPECT_FALSE(it_pushed.nextValue());
+    }
+}
+
+TEST(MatrixIO, RowSelectStoredPushdownDense) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(20000, 4);
+
+    MatrixConverterLoader<double, uint32_t> mat_i(std::make_unique<CSparseMatrix>(get_map(orig_mat))
+    );
+    VecReaderWriterBuilder vb(1024);
+    StoredMatrixWriter<uint32_t>::createPacked(vb).write(mat_i);
+
+    auto check_selection = [&](const std::vector<uint32_t> &rows, bool expect_pushdown) {
+        MatrixRowSelect<double> expected_sel(
+            std::make_unique<CSparseMatrix>(get_map(orig_mat)), rows
+        );
+        CSparseMatrixWriter expected;
+        expected.write(expected_sel);
+
+        StoredMatrix<uint32_t> probe = StoredMatrix<uint32_t>::openPacked(vb);
+        EXPECT_EQ(probe.pushdownRowSelect(rows), expect_pushdown);
+
+        auto stored =
+            std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb));
+        auto node = std::make_shared<InstrumentNode>("stored");
+        stored->instrument(*node);
+        MatrixConverterLoader<uint32_t, double> selected(
+            std::make_unique<MatrixRowSelect<uint32_t>>(std::move(stored), rows)
+        );
+        CSparseMatrixWriter res;
+        res.write(selected);
+        EXPECT_TRUE(res.getMat().isApprox(expected.getMat()));
+        return node->children[1]->seeks;
+    };
+
+    // Half the rows: pushdown is declined, so values decode in order as for an unfiltered read
+    std::vector<uint32_t> dense_rows;
+    for (uint32_t i = 0; i < 20000; i += 2)
+        dense_rows.push_back(i);
+    check_selection(dense_rows, false);
+
+    // A contiguous run of rows spans several adjacent value blocks in each column, which
+    // should be decoded with one range load per column rather than one per block
+    std::vector<uint32_t> run_rows;
+    for (uint32_t i = 0; i < 2400; i++)
+        run_rows.push_back(i);
+    uint64_t val_seeks = check_selection(run_rows, true);
+    EXPECT_LE(val_seeks, 2 * orig_mat.cols());
+}
+
 TEST(MatrixIO, ConcatRows) {
     SparseMatrix<double> m1 = generate_mat(3000, 10, 12512);
     SparseMatrix<double> m2 =
@@ -297,6 +581,114 @@ TEST(MatrixIO, ConcatCols) {
     EXPECT_TRUE(res.getMat().isApprox(concat));
 }
 
+TEST(MatrixIO, CSparseExportParallel) {
+    SparseMatrix<double> m = generate_mat(50, 300, 2351);
+    std::vector<uint32_t> rev_rows(m.rows());
+    std::iota(rev_rows.rbegin(), rev_rows.rend(), 0);
+    MatrixXd rev_dense = MatrixXd(m).colwise().reverse();
+    SparseMatrix<double> rev = rev_dense.sparseView();
+
+    auto col_range = [](uint32_t start, uint32_t end) {
+        std::vector<uint32_t> ret(end - start);
+        std::iota(ret.begin(), ret.end(), start);
+        return ret;
+    };
+    // The first chunk knows its column counts and loads sorted rows. The others are counted
+    // by decoding and load rows in descending order
+    auto make_chunks = [&]() {
+        std::vector<std::unique_ptr<MatrixLoader<double>>> chunks;
+        chunks.push_back(std::make_unique<MatrixColSelect<double>>(
+            std::make_unique<CSparseMatrix>(get_map(rev)), col_range(0, 100)
+        ));
+        for (uint32_t start : {100, 250}) {
+            chunks.push_back(std::make_unique<MatrixColSelect<double>>(
+                std::make_unique<MatrixRowSelect<double>>(
+                    std::make_unique<CSparseMatrix>(get_map(m)), rev_rows
+                ),
+                col_range(start, start == 100 ? 250 : 300)
+            ));
+        }
+        return chunks;
+    };
+
+    std::vector<uint64_t> known;
+    EXPECT_TRUE(make_chunks()[0]->colEntryCounts(known));
+    EXPECT_FALSE(make_chunks()[1]->colEntryCounts(known));
+
+    for (uint32_t threads : {0, 1, 3}) {
+        auto chunks = make_chunks();
+        std::vector<uint64_t> col_ptr = csparseColPtr(chunks, threads);
+        ASSERT_EQ(col_ptr.size(), rev.cols() + 1);
+        EXPECT_TRUE(std::equal(col_ptr.begin(), col_ptr.end(), rev.outerIndexPtr()));
+
+        std::vector<int> row_idx(col_ptr.back());
+        std::vector<double> val(col_ptr.back());
+        fillCSparseEntries(chunks, col_ptr, row_idx.data(), val.data(), threads);
+        EXPECT_TRUE(std::equal(row_idx.begin(), row_idx.end(), rev.innerIndexPtr()));
+        EXPECT_TRUE(std::equal(val.begin(), val.end(), rev.valuePtr()));
+    }
+}
+
+TEST(MatrixIO, DownsampleCounts) {
+    SparseMatrix<double> m = generate_mat(200, 40, 7812);
+    std::vector<uint64_t> totals(m.cols()), targets(m.cols());
+    for (uint32_t c = 0; c < m.cols(); c++) {
+        totals[c] = m.col(c).sum();
+        targets[c] = c % 5 == 0 ? totals[c] + 10 : totals[c] * c / (2 * m.cols());
+    }
+    using Method = DownsampleCounts::Method;
+    auto downsample = [&](Method method, std::vector<uint64_t> t) {
+        return std::make_unique<DownsampleCounts>(
+            std::make_unique<MatrixConverterLoader<double, uint32_t>>(
+                std::make_unique<CSparseMatrix>(get_map(m), nullptr, nullptr, 16)
+            ),
+            totals,
+            t,
+            method,
+            1234
+        );
+    };
+
+    for (Method method : {Method::Binomial, Method::Hypergeometric}) {
+        auto ds = downsample(method, targets);
+        std::vector<uint32_t> sums = ds->colSums();
+        if (method == Method::Hypergeometric) {
+            for (uint32_t c = 0; c < m.cols(); c++) {
+                EXPECT_EQ(sums[c], std::min(targets[c], totals[c]));
+            }
+        }
+        uint64_t kept = std::accumulate(sums.begin(), sums.end(), (uint64_t)0);
+        uint64_t expected = 0;
+        for (uint32_t c = 0; c < m.cols(); c++) {
+            expected += std::min(targets[c], totals[c]);
+        }
+        EXPECT_NEAR((double)kept, (double)expected, 0.02 * expected);
+
+        // Entries only shrink, and zeros are dropped
+        MatrixIterator<uint32_t> it(downsample(method, targets));
+        while (it.nextCol()) {
+            while (it.nextValue()) {
+                EXPECT_GT(it.val(), 0);
+                EXPECT_LE(it.val(), m.coeff(it.row(), it.col()));
+            }
+        }
+
+        // Reproducible across restarts and column ranges read separately
+        auto again = downsample(method, targets);
+        EXPECT_TRUE(matrix_identical(*ds, *again));
+        std::vector<uint32_t> cols(15);
+        std::iota(cols.begin(), cols.end(), 20);
+        MatrixColSelect<uint32_t> range(downsample(method, targets), cols);
+        MatrixColSelect<uint32_t> full_range(std::move(ds), cols);
+        EXPECT_TRUE(matrix_identical(range, full_range));
+
+        // Targets at or above the totals keep every count
+        auto unchanged = downsample(method, totals);
+        MatrixConverterLoader<double, uint32_t> orig(std::make_unique<CSparseMatrix>(get_map(m)));
+        EXPECT_TRUE(matrix_identical(*unchanged, orig));
+    }
+}
+
 void test_order_rows(SparseMatrix<double> m, uint32_t load_size) {
     std::vector<uint64_t> col(m.outerIndexPtr(), m.outerIndexPtr() + m.cols() + 1);
     std::vector<uint32_t> row(m.innerIndexPtr(), m.innerIndexPtr() + m.nonZeros());
@@ -344,4 +736,59 @@ TEST(MatrixIO, OrderRows) {
     test_order_rows(generate_mat(5, 5), 100);
     test_order_rows(generate_mat(1000, 100), 16);
     test_order_rows(generate_mat(1000, 100), 1024);
-}
\ No newline at end of file
+}
+
+TEST(MatrixIO, InstrumentedPackedMatrix) {
+    const Eigen::SparseMatrix<double> orig_mat = generate_mat(300, 40);
+
+    MatrixConverterLoader<double, uint32_t> mat_i(std::make_unique<CSparseMatrix>(get_map(orig_mat))
+    );
+    VecReaderWriterBuilder vb1(1024);
+    StoredMatrixWriter<uint32_t>::createPacked(vb1).write(mat_i);
+
+    auto stored = std::make_unique<StoredMatrix<uint32_t>>(StoredMatrix<uint32_t>::openPacked(vb1));
+    auto stored_node = std::make_shared<InstrumentNode>("StoredMatrix");
+    stored->instrument(*stored_node);
+    auto root = std::make_shared<InstrumentNode>("colSums", stored_node);
+    InstrumentedMatrix<uint32_t> timed(
+        std::make_unique<InstrumentedMatrix<uint32_t>>(std::move(stored), stored_node), root
+    );
+
+    std::vector<uint32_t> sums = timed.colSums();
+    for (uint32_t i = 0; i < orig_mat.cols(); i++) {
+        EXPECT_EQ(sums[i], (uint32_t)orig_mat.col(i).sum());
+    }
+
+    EXPECT_EQ(root->entries, (uint64_t)orig_mat.nonZeros());
+    EXPECT_EQ(stored_node->entries, (uint64_t)orig_mat.nonZeros());
+    EXPECT_GT(root->chunks, 0);
+    EXPECT_GE(root->seconds, stored_node->seconds);
+    ASSERT_EQ(stored_node->children.size(), 3);
+    EXPECT_EQ(stored_node->children[0]->name, "index");
+    EXPECT_GE(stored_node->children[0]->entries, (uint64_t)orig_mat.nonZeros());
+
+    // Bitpacked arrays count storage reads in child nodes for their packed streams, separately
+    // from the decoded entries
+    const InstrumentNode &index = *stored_node->children[0];
+    EXPECT_EQ(index.bytes_read, 0);
+    ASSERT_GE(index.children.size(), 3);
+    EXPECT_EQ(index.children[0]->name, "data");
+    EXPECT_GT(index.children[0]->bytes_read, 0);
+    EXPECT_LT(index.totalBytesRead(), index.entries * sizeof(uint32_t));
+    EXPECT_GE(index.seconds, index.children[0]->seconds);
+    // The column pointers are stored unpacked, so count their bytes directly
+    EXPECT_EQ(stored_node->children[2]->children.size(), 0);
+    EXPECT_GT(stored_node->children[2]->bytes_read, 0);
+
+    root->reset();
+    EXPECT_EQ(stored_node->children[1]->bytes_read, 0);
+    timed.restart();
+    timed.seekCol(5);
+    EXPECT_EQ(root->seeks, 1);
+    EXPECT_EQ(stored_node->seeks, 1);
+
+    EXPECT_THROW(
+        InstrumentedMatrix<double>(std::make_unique<CSparseMatrix>(get_map(orig_mat)), nullptr),
+        std::invalid_argument
+    );
+}
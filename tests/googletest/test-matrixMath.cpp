@@ -125,6 +125,46 @@ TEST(MatrixMath, Multiply) {
     EXPECT_EQ(r4, ans4);
 }
 
+TEST(MatrixMath, NestedConcatThreadBudget) {
+    SparseMatrix<double> m1 = generate_mat(60, 40, 125123);
+    MatrixXd b_right = generate_dense_mat(40, 3);
+    MatrixXd b_left = generate_dense_mat(3, 60);
+
+    // ConcatRows of two ConcatCols, each asking for 2 threads
+    std::vector<SparseMatrix<double>> blocks;
+    blocks.reserve(4);
+    std::vector<std::unique_ptr<MatrixLoader<double>>> row_chunks;
+    for (int r = 0; r < 2; r++) {
+        std::vector<std::unique_ptr<MatrixLoader<double>>> col_chunks;
+        for (int c = 0; c < 2; c++) {
+            blocks.push_back(m1.block(r * 30, c * 20, 30, 20));
+            col_chunks.push_back(std::make_unique<CSparseMatrix>(get_map(blocks.back())));
+        }
+        row_chunks.push_back(std::make_unique<ConcatCols<double>>(std::move(col_chunks), 2));
+    }
+    ConcatRows<double> mat(std::move(row_chunks), 2);
+
+    // Budget only allows the outer concat to parallelize; inner ones fall back to serial
+    ExecutionContext ctx(NULL, 2, 1 << 20);
+    EXPECT_TRUE(mat.denseMultiplyRight(get_map<MatrixXd>(b_right), ctx).isApprox(m1 * b_right));
+    EXPECT_TRUE(mat.denseMultiplyLeft(get_map<MatrixXd>(b_left), ctx).isApprox(b_left * m1));
+
+    // All threads are returned to the budget once the operation finishes
+    EXPECT_EQ(ctx.thread_budget->acquire(100), 2);
+    ctx.thread_budget->release(2);
+
+    // With an exhausted budget everything runs on the calling thread
+    ResourceLease hog = ctx.acquireThreads(2);
+    EXPECT_EQ(hog.count(), 2);
+    EXPECT_EQ(ctx.acquireThreads(1).count(), 0);
+    EXPECT_TRUE(mat.denseMultiplyRight(get_map<MatrixXd>(b_right), ctx).isApprox(m1 * b_right));
+
+    // Minimum requests are granted even past the budget limit
+    EXPECT_EQ(ctx.acquireMemory(1 << 21, 1 << 10).count(), 1 << 20);
+    ResourceLease mem = ctx.acquireMemory(1 << 20);
+    EXPECT_EQ(ctx.acquireMemory(1 << 12, 1 << 10).count(), 1 << 10);
+}
+
 TEST(MatrixMath, Stats) {
     SparseMatrix<double> m1 = generate_mat(100, 50, 125123);
     // SparseMatrix<double> m1 = generate_mat(5, 3, 125123);
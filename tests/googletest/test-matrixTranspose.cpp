@@ -5,6 +5,8 @@
 
 #include <arrayIO/vector.h>
 #include <matrixIterators/CSparseMatrix.h>
+#include <matrixIterators/DualOrientationMatrix.h>
+#include <matrixIterators/MatrixIndexSelect.h>
 #include <matrixIterators/ImportMatrixHDF5.h>
 #include <matrixIterators/StoredMatrixTransposeWriter.h>
 #include <matrixIterators/StoredMatrixWriter.h>
@@ -88,6 +90,29 @@ TEST(MatrixTranspose, SmallIntMatrix) {
     test_transpose(generate_mat(2000, 100));
 }
 
+TEST(MatrixTranspose, MemoryBudget) {
+    SparseMatrix<double> orig_mat = generate_mat(300, 200);
+    CSparseMatrix mat(get_map(orig_mat));
+
+    VecReaderWriterBuilder vb(1024);
+    std_fs::remove_all(std_fs::temp_directory_path() / "tmp_storage_budget");
+    StoredMatrixTransposeWriter<double> w(
+        vb, (std_fs::temp_directory_path() / "tmp_storage_budget").string().c_str(), 512, 65536
+    );
+
+    // Budget is smaller than the requested sort buffer, so the sorter uses more merge rounds
+    ExecutionContext ctx(NULL, 1, 8192);
+    ctx.instrumentation = std::make_shared<InstrumentNode>("transpose");
+    w.write(mat, ctx);
+    EXPECT_EQ(ctx.instrumentation->entries, orig_mat.nonZeros());
+    EXPECT_EQ(ctx.memory_budget->acquire(UINT64_MAX), 8192);
+
+    StoredMatrix<double> loader = StoredMatrix<double>::openPacked(vb);
+    CSparseMatrixWriter mem;
+    mem.write(loader);
+    EXPECT_TRUE(mem.getMat().isApprox(orig_mat.transpose()));
+}
+
 // TEST(MatrixTranspose, MatFile) {
 //     auto mat =
 //     open10xFeatureMatrix("/Users/ben/Downloads/20k_PBMC_3p_HT_nextgem_Chromium_X_filtered_feature_bc_matrix.h5",
@@ -97,4 +122,82 @@ TEST(MatrixTranspose, SmallIntMatrix) {
 //     1073741824); mat_t.write(mat); auto mat_t_read = mat_t.read();
 //     VecReaderWriterBuilder data;
 //     StoredMatrixWriter<uint32_t>::createPacked(data).write(mat_t_read);
-// }
\ No newline at end of file
+// }
+TEST(MatrixTranspose, DualOrientation) {
+    const SparseMatrix<double> orig_mat = generate_mat(300, 200);
+    const Eigen::MatrixXd dense(orig_mat);
+
+    for (bool row_major : {false, true}) {
+        CSparseMatrix mat(get_map(orig_mat));
+        VecReaderWriterBuilder vb(1024);
+        std_fs::remove_all(std_fs::temp_directory_path() / "tmp_storage_dual");
+        writeDualOrientationMatrix<double>(
+            mat,
+            vb,
+            (std_fs::temp_directory_path() / "tmp_storage_dual").string().c_str(),
+            row_major,
+            512,
+            16384
+        );
+        EXPECT_TRUE(DualOrientationMatrix<double>::isDualOrientation(vb));
+        // The primary copy is a regular matrix for readers that don't know about dual storage
+        StoredMatrix<double> primary = StoredMatrix<double>::openPacked(vb);
+        CSparseMatrixWriter primary_mem;
+        primary_mem.write(primary);
+        EXPECT_TRUE(primary_mem.getMat().isApprox(orig_mat));
+
+        DualOrientationMatrix<double> dual = DualOrientationMatrix<double>::openPacked(vb);
+        std::vector<double> row_sums = dual.rowSums();
+        std::vector<double> col_sums = dual.colSums();
+        for (int i = 0; i < dense.rows(); i++)
+            EXPECT_DOUBLE_EQ(row_sums[i], dense.row(i).sum());
+        for (int j = 0; j < dense.cols(); j++)
+            EXPECT_DOUBLE_EQ(col_sums[j], dense.col(j).sum());
+
+        // Opening with explicit names, as R does, still reads row sums from the transposed copy
+        DualOrientationMatrix<double> named = DualOrientationMatrix<double>::openPacked(
+            vb,
+            1024,
+            std::make_unique<VecStringReader>(std::vector<std::string>{"r0"}),
+            std::make_unique<VecStringReader>(std::vector<std::string>{"c0"}),
+            dense.rows()
+        );
+        EXPECT_STREQ(named.rowNames(0), "r0");
+        EXPECT_EQ(named.rowSums(), row_sums);
+
+        StatsResult stats = dual.computeMatrixStats(Stats::Variance, Stats::None);
+        ASSERT_EQ(stats.row_stats.cols(), dense.rows());
+        ASSERT_EQ(stats.col_stats.rows(), 0);
+        for (int i = 0; i < dense.rows(); i++)
+            EXPECT_NEAR(stats.row_stats(1, i), dense.row(i).mean(), 1e-9);
+
+        Eigen::VectorXd v = Eigen::VectorXd::Random(dense.cols());
+        EXPECT_TRUE(dual.vecMultiplyRight(Eigen::Map<Eigen::VectorXd>(v.data(), v.size()))
+                        .isApprox(dense * v));
+        Eigen::MatrixXd B = Eigen::MatrixXd::Random(dense.cols(), 3);
+        EXPECT_TRUE(dual.denseMultiplyRight(Eigen::Map<Eigen::MatrixXd>(B.data(), B.rows(), 3))
+                        .isApprox(dense * B));
+
+        // Small selections are read from the transposed copy, large ones filter the primary,
+        // as do small selections over the memory limit
+        const uint64_t default_bytes = DualOrientationMatrix<double>::default_max_selection_bytes;
+        for (auto [n_rows, max_bytes] : std::vector<std::pair<uint32_t, uint64_t>>{
+                 {5, default_bytes}, {250, default_bytes}, {5, 0}
+             }) {
+            std::vector<uint32_t> rows;
+            for (uint32_t i = 0; i < n_rows; i++)
+                rows.push_back((i * 7 + 3) % 300);
+            auto loader = std::make_unique<DualOrientationMatrix<double>>(
+                DualOrientationMatrix<double>::openPacked(vb)
+            );
+            loader->setMaxSelectionBytes(max_bytes);
+            MatrixRowSelect<double> select(std::move(loader), rows);
+            CSparseMatrixWriter mem;
+            mem.write(select);
+            Eigen::MatrixXd expected(n_rows, dense.cols());
+            for (uint32_t i = 0; i < n_rows; i++)
+                expected.row(i) = dense.row(rows[i]);
+            EXPECT_TRUE(Eigen::MatrixXd(mem.getMat()).isApprox(expected));
+        }
+    }
+}
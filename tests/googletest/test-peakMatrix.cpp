@@ -9,6 +9,7 @@
 #include <matrixIterators/PeakMatrix.h>
 #include <matrixIterators/StoredMatrix.h>
 #include <matrixIterators/TileMatrix.h>
+#include <utils/interval_tree.h>
 
 #include <Eigen/SparseCore>
 
@@ -396,6 +397,219 @@ TEST(PeakMatrix, TileMatrixSeek) {
     }
 }
 
+TEST(PeakMatrix, AccumulatorStrategies) {
+    uint32_t chrs = 5;
+    uint32_t max_coord = 5000;
+    auto v = Testing::writeFragmentTuple(Testing::generateFrags(50000, chrs, max_coord, 50, 300));
+    std::vector<std::string> chr_levels;
+    for (uint32_t chr = 0; chr <= chrs; chr++) {
+        chr_levels.push_back(std::string("chr") + std::to_string(chr));
+    }
+
+    // Sparse peaks on even chromosomes and dense overlapping peaks on odd ones, so Auto mixes
+    // both accumulators
+    std::vector<uint32_t> p_chr, p_start, p_end;
+    for (uint32_t chr = 0; chr <= chrs; chr++) {
+        uint32_t step = chr % 2 == 0 ? 1500 : 10;
+        for (uint32_t start = 100; start < max_coord; start += step) {
+            p_chr.push_back(chr);
+            p_start.push_back(start);
+            p_end.push_back(start + 50);
+        }
+    }
+    std::vector<uint32_t> t_chr, t_start, t_end, t_width;
+    for (uint32_t chr = 0; chr <= chrs; chr++) {
+        t_chr.push_back(chr);
+        t_start.push_back(0);
+        t_end.push_back(max_coord);
+        t_width.push_back(chr % 2 == 0 ? 2500 : 20);
+    }
+
+    auto peak_mat = [&](AccumulatorStrategy strategy) {
+        return PeakFragmentMatrix(
+            std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*v)),
+            p_chr,
+            p_start,
+            p_end,
+            std::make_unique<VecStringReader>(chr_levels),
+            strategy
+        );
+    };
+    auto tile_mat = [&](AccumulatorStrategy strategy) {
+        return TileMatrix(
+            std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*v)),
+            t_chr,
+            t_start,
+            t_end,
+            t_width,
+            std::make_unique<VecStringReader>(chr_levels),
+            strategy
+        );
+    };
+
+    auto peak_sort = peak_mat(AccumulatorStrategy::Sort);
+    auto peak_dense = peak_mat(AccumulatorStrategy::Dense);
+    auto peak_auto = peak_mat(AccumulatorStrategy::Auto);
+    EXPECT_TRUE(matrix_identical_cpp(peak_sort, peak_dense));
+    EXPECT_TRUE(matrix_identical_cpp(peak_sort, peak_auto));
+
+    auto tile_sort = tile_mat(AccumulatorStrategy::Sort);
+    auto tile_dense = tile_mat(AccumulatorStrategy::Dense);
+    auto tile_auto = tile_mat(AccumulatorStrategy::Auto);
+    EXPECT_TRUE(matrix_identical_cpp(tile_sort, tile_dense));
+    EXPECT_TRUE(matrix_identical_cpp(tile_sort, tile_auto));
+}
+
+TEST(PeakMatrix, AccumulatorChoice) {
+    // 3 peaks of 100bp, only 2 of which fall in any one window
+    EXPECT_EQ(estimateActiveCols({0, 500, 2000}, {100, 600, 2100}, {100, 100, 100}, 1000), 2);
+    // A single long tiled region is capped by the tiles fitting in the window
+    EXPECT_EQ(estimateActiveCols({0}, {1000000}, {100}, 1000), 12);
+
+    MatrixAccumulator_adaptive<uint32_t> acc(1000, AccumulatorStrategy::Auto, 1 << 20);
+    acc.start_chr(4);
+    EXPECT_TRUE(acc.using_dense());
+    acc.start_chr(MatrixAccumulator_adaptive<uint32_t>::MAX_DENSE_ACTIVE_COLS + 1);
+    EXPECT_FALSE(acc.using_dense());
+
+    // Dense memory bound too large for the budget
+    MatrixAccumulator_adaptive<uint32_t> big(1 << 20, AccumulatorStrategy::Auto, 1 << 20);
+    big.start_chr(4);
+    EXPECT_FALSE(big.using_dense());
+
+    MatrixAccumulator_adaptive<uint32_t> forced(1 << 20, AccumulatorStrategy::Dense, 1 << 20);
+    forced.start_chr(1000);
+    EXPECT_TRUE(forced.using_dense());
+}
+
+TEST(PeakMatrix, IntervalTree) {
+    std::mt19937 gen(2024);
+    std::uniform_int_distribution<uint64_t> pos(0, 10000), len(1, 500);
+    std::vector<uint64_t> start, end;
+    for (int i = 0; i < 1000; i++) {
+        start.push_back(pos(gen));
+    }
+    std::sort(start.begin(), start.end());
+    for (auto s : start) {
+        end.push_back(s + len(gen));
+    }
+    IntervalTree tree(start, end);
+
+    std::vector<uint32_t> hits, expected;
+    for (int q = 0; q < 500; q++) {
+        uint64_t q_start = pos(gen);
+        uint64_t q_end = q_start + len(gen) / 10;
+        hits.clear();
+        expected.clear();
+        tree.overlaps(q_start, q_end, hits);
+        for (uint32_t i = 0; i < start.size(); i++) {
+            if (start[i] < q_end && q_start < end[i]) expected.push_back(i);
+        }
+        ASSERT_EQ(hits, expected);
+    }
+}
+
+template <int MODE> void check_overlap_engines() {
+    uint32_t chrs = 3;
+    uint32_t max_coord = 5000;
+    auto frags = Testing::generateFrags(20000, chrs, max_coord, 50, 300);
+    auto v = Testing::writeFragmentTuple(frags);
+    std::vector<std::string> chr_levels;
+    for (uint32_t chr = 0; chr <= chrs; chr++) {
+        chr_levels.push_back(std::string("chr") + std::to_string(chr));
+    }
+
+    // Multi-resolution windows centered every 50bp, so many peaks overlap each base
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> peaks;
+    for (uint32_t chr = 0; chr <= chrs; chr++) {
+        for (uint32_t center = 500; center < max_coord - 500; center += 50) {
+            for (uint32_t half_width : {10, 50, 200, 400}) {
+                peaks.push_back({chr, center + half_width, center - half_width});
+            }
+        }
+    }
+    std::sort(peaks.begin(), peaks.end());
+    std::vector<uint32_t> p_chr, p_start, p_end;
+    for (auto [chr, end, start] : peaks) {
+        p_chr.push_back(chr);
+        p_start.push_back(start);
+        p_end.push_back(end);
+    }
+
+    auto peak_mat = [&](PeakOverlapEngine engine) {
+        return PeakMatrixBase<MODE>(
+            std::make_unique<StoredFragments>(StoredFragments::openUnpacked(*v)),
+            p_chr,
+            p_start,
+            p_end,
+            std::make_unique<VecStringReader>(chr_levels),
+            AccumulatorStrategy::Auto,
+            engine
+        );
+    };
+    // Brute force reference counts
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (auto f : frags) {
+        for (uint32_t i = 0; i < p_chr.size(); i++) {
+            if (f.chr != p_chr[i]) continue;
+            bool has_start = f.start >= p_start[i] && f.start < p_end[i];
+            bool has_end = f.end > p_start[i] && f.end <= p_end[i];
+            double count = MODE == 0 ? has_start + has_end
+                           : MODE == 1 ? has_start || has_end
+                                       : f.start < p_end[i] && f.end > p_start[i];
+            if (count != 0) triplets.push_back({(int)f.cell, (int)i, count});
+        }
+    }
+    Eigen::SparseMatrix<double> brute_force(51, p_chr.size());
+    brute_force.setFromTriplets(triplets.begin(), triplets.end());
+    MatrixConverterLoader<double, uint32_t> brute_force_int(
+        std::make_unique<CSparseMatrix>(get_map(brute_force))
+    );
+
+    auto scan = peak_mat(PeakOverlapEngine::Scan);
+    auto tree = peak_mat(PeakOverlapEngine::IntervalTree);
+    auto automatic = peak_mat(PeakOverlapEngine::Auto);
+    EXPECT_FALSE(scan.usesIntervalTree());
+    EXPECT_TRUE(tree.usesIntervalTree());
+    EXPECT_TRUE(automatic.usesIntervalTree());
+    EXPECT_TRUE(matrix_identical_cpp(brute_force_int, tree));
+    EXPECT_TRUE(matrix_identical_cpp(scan, tree));
+    EXPECT_EQ(
+        std::string(tree.colNames(1)),
+        "chr0:" + std::to_string(p_start[1]) + "-" + std::to_string(p_end[1])
+    );
+
+    // Seeking to random columns gives the same columns as reading in order
+    CSparseMatrixWriter writer;
+    MatrixConverterLoader<uint32_t, double> scan_double(
+        std::make_unique<PeakMatrixBase<MODE>>(peak_mat(PeakOverlapEngine::Scan))
+    );
+    writer.write(scan_double);
+    Eigen::SparseMatrix<double> expected = writer.getMat();
+
+    MatrixIterator<uint32_t> tree_it(
+        std::make_unique<PeakMatrixBase<MODE>>(peak_mat(PeakOverlapEngine::IntervalTree))
+    );
+    std::mt19937 gen(1337);
+    std::uniform_int_distribution col(0, (int)p_chr.size() - 1);
+    for (int i = 0; i < 20; i++) {
+        uint32_t c = col(gen);
+        tree_it.seekCol(c);
+        for (SparseMatrix<double>::InnerIterator it(expected, c); it; ++it) {
+            ASSERT_TRUE(tree_it.nextValue());
+            ASSERT_EQ(tree_it.row(), it.row());
+            ASSERT_EQ(tree_it.val(), it.value());
+        }
+        EXPECT_FALSE(tree_it.nextValue());
+    }
+}
+
+TEST(PeakMatrix, OverlapEngines) {
+    check_overlap_engines<0>();
+    check_overlap_engines<1>();
+    check_overlap_engines<2>();
+}
+
 bool matrix_identical_cpp(MatrixLoader<uint32_t> &mat1, MatrixLoader<uint32_t> &mat2) {
     mat1.restart();
     mat2.restart();
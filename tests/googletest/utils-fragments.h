@@ -1,3 +1,4 @@
+#include <iostream>
 #include <memory>
 #include <random>
 
@@ -112,6 +113,69 @@ std::vector<Frag> generateFrags(
     return ret;
 }
 
+// Generate fragments with a more realistic shape for performance testing:
+// cells have log-normally distributed depth, and fragment widths follow a
+// nucleosome-like mixture of short (<150bp) and mono/di-nucleosome lengths
+std::vector<Frag> generateRealisticFrags(
+    uint32_t n,
+    uint32_t n_chr,
+    uint32_t chr_length,
+    uint32_t n_cells,
+    uint32_t seed = 12548
+) {
+    std::mt19937 gen(seed);
+    std::lognormal_distribution<> cell_depth(0.0, 1.0);
+    std::vector<double> cell_weights(n_cells);
+    for (auto &w : cell_weights)
+        w = cell_depth(gen);
+    std::discrete_distribution<uint32_t> cell(cell_weights.begin(), cell_weights.end());
+    std::uniform_int_distribution<uint32_t> chr(0, n_chr - 1);
+    std::uniform_int_distribution<uint32_t> start(0, chr_length);
+    std::discrete_distribution<int> width_class({0.5, 0.35, 0.15});
+    std::normal_distribution<> width[3] = {
+        std::normal_distribution<>(80, 20),
+        std::normal_distribution<>(200, 25),
+        std::normal_distribution<>(380, 30)
+    };
+
+    std::vector<Frag> ret;
+    ret.reserve(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = start(gen);
+        uint32_t w = std::max(10, (int)width[width_class(gen)](gen));
+        ret.push_back(Frag{chr(gen), s, s + w, cell(gen)});
+    }
+    return ret;
+}
+
+// Generate n_per_chr non-overlapping regions on each chromosome, sorted by (chr, start).
+// Output is in chr, start, end vectors as used by PeakMatrix and TileMatrix
+void generateRegions(
+    uint32_t n_per_chr,
+    uint32_t n_chr,
+    uint32_t chr_length,
+    uint32_t width,
+    std::vector<uint32_t> &chr,
+    std::vector<uint32_t> &start,
+    std::vector<uint32_t> &end,
+    uint32_t seed = 12548
+) {
+    std::mt19937 gen(seed);
+    uint32_t spacing = chr_length / n_per_chr;
+    std::uniform_int_distribution<uint32_t> offset(0, spacing > width ? spacing - width : 0);
+    chr.clear();
+    start.clear();
+    end.clear();
+    for (uint32_t c = 0; c < n_chr; c++) {
+        for (uint32_t i = 0; i < n_per_chr; i++) {
+            uint32_t s = i * spacing + offset(gen);
+            chr.push_back(c);
+            start.push_back(s);
+            end.push_back(s + width);
+        }
+    }
+}
+
 bool fragments_identical(BPCells::FragmentLoader &fragments1, BPCells::FragmentLoader &fragments2) {
     using namespace BPCells;
     fragments1.restart();
@@ -0,0 +1,44 @@
+#include <random>
+
+#include <Eigen/SparseCore>
+
+namespace Testing {
+
+// Generate a random sparse matrix with the given fraction of non-zero entries.
+// Values are drawn from a geometric distribution to mimic count data
+Eigen::SparseMatrix<double> generateSparseMatrix(
+    uint32_t n_row, uint32_t n_col, double density, uint32_t seed = 125124
+) {
+    std::mt19937 gen(seed);
+    std::geometric_distribution<int> val(0.3);
+    std::binomial_distribution<uint32_t> col_nnz(n_row, density);
+    std::uniform_int_distribution<int> row(0, n_row - 1);
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve((size_t)(n_row * (double)n_col * density * 1.1));
+    for (uint32_t j = 0; j < n_col; j++) {
+        uint32_t nnz = col_nnz(gen);
+        for (uint32_t k = 0; k < nnz; k++) {
+            triplets.push_back({row(gen), (int)j, (double)(1 + val(gen))});
+        }
+    }
+
+    Eigen::SparseMatrix<double> mat(n_row, n_col);
+    // Duplicate (row, col) entries are summed
+    mat.setFromTriplets(triplets.begin(), triplets.end());
+    mat.makeCompressed();
+    return mat;
+}
+
+Eigen::Map<Eigen::SparseMatrix<double>> getMap(const Eigen::SparseMatrix<double> &mat) {
+    return Eigen::Map<Eigen::SparseMatrix<double>>(
+        mat.rows(),
+        mat.cols(),
+        mat.nonZeros(),
+        (int *)mat.outerIndexPtr(),
+        (int *)mat.innerIndexPtr(),
+        (double *)mat.valuePtr()
+    );
+}
+
+} // namespace Testing